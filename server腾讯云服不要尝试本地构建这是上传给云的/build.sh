@@ -53,6 +53,8 @@ echo "可执行文件位置: $(pwd)/bin/WebSocketServer"
 echo ""
 echo "使用方法:"
 echo "  ./bin/WebSocketServer --port 8765"
+echo "  ./bin/WebSocketServer --port 8765 --workers 4   # 房间工作线程数，默认按CPU核数"
+echo "  ./bin/WebSocketServer --port 8765 --metrics-port 9102   # Prometheus 指标 http://127.0.0.1:9102/metrics，0 为关闭"
 echo "  ./bin/WebSocketServer --help"
 echo ""
 echo "要安装到系统目录，请运行:"
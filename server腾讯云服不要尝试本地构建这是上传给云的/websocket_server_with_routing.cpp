@@ -12,6 +12,854 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QStringView>
+#include <QThread>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QMutex>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+
+// 二进制消息头部解析（与客户端 src/common/PacketHeader.h 保持一致；服务器单独构建，故在此内联）
+// 8 字节字：低 48 位为毫秒时间戳；高 16 位：bit56-63 = 标记，bit48-49 = 时间层ID，bit50 = 关键帧，bit52-55 = 流ID
+// 标记 0xA5：旧格式视频包（8 字节头部）；0xA6：版本 1 消息（16 字节头部，字节 8 版本，字节 9 消息类型）
+enum PacketMessageType {
+    kMsgVideo = 1,
+    kMsgAudio = 2,
+    kMsgViewerAudio = 3,
+    kMsgCursor = 4,
+    kMsgAnnotation = 5,
+    kMsgImage = 6
+};
+
+struct PacketLayerInfo {
+    qint64 timestampMs = 0; // 毫秒采集时间戳（推流端时钟，低 48 位）
+    int temporalId = 0;
+    bool keyFrame = false;
+    int streamId = 0;       // simulcast 流ID，旧格式视为第 0 路
+    bool tagged = false;
+    bool valid = true;      // false：版本 1 头部不完整或版本/类型不支持，丢弃
+    int type = kMsgVideo;   // 旧格式数据包均为视频
+};
+
+// 视频类消息按流/层选择性转发，其余类型按方向整包转发
+static bool isVideoLike(const PacketLayerInfo &info)
+{
+    return info.type == kMsgVideo || info.type == kMsgImage;
+}
+
+static const int kMaxSimulcastStreams = 3;
+static const quint64 kSubscriberFrameSize = 8 * 1024 * 1024;  // 订阅者出站帧上限（退回 QWebSocket 成帧时，覆盖单个关键帧）
+
+// 预成帧扇出（与 src/common/WebSocketFrame.h 一致）：每条消息只生成一次服务器帧（FIN + 二进制，不加掩码），
+// 同一个 QByteArray 写入所有订阅者的底层 QTcpSocket。Qt 6 对 4 KB 以上的 QByteArray 写入直接引用进
+// socket 写缓冲，N 个订阅者共享一份帧；sendBinaryMessage 则每个订阅者各成帧一次并拷贝负载
+static QByteArray buildBinaryFrame(const QByteArray &payload)
+{
+    const quint64 size = static_cast<quint64>(payload.size());
+    QByteArray frame;
+    frame.reserve(payload.size() + 10);
+    frame.append(char(0x82));
+    if (size < 126) {
+        frame.append(char(size));
+    } else if (size <= 0xFFFF) {
+        frame.append(char(126));
+        frame.append(char((size >> 8) & 0xFF));
+        frame.append(char(size & 0xFF));
+    } else {
+        frame.append(char(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(char((size >> shift) & 0xFF));
+        }
+    }
+    frame.append(payload);
+    return frame;
+}
+
+// 订阅者连接的底层 socket：QWebSocketServer 升级得到的 QWebSocket 以 QTcpSocket 为子对象（随 moveToThread 迁移）；
+// 找不到时返回 nullptr，退回 sendBinaryMessage
+static QTcpSocket *subscriberTransport(QWebSocket *socket)
+{
+    return socket ? socket->findChild<QTcpSocket *>() : nullptr;
+}
+
+static PacketLayerInfo readPacketLayerInfo(const QByteArray &packet)
+{
+    PacketLayerInfo info;
+    if (packet.size() < 8) {
+        return info;
+    }
+    quint64 v = 0;
+    memcpy(&v, packet.constData(), sizeof(v));
+    const quint64 marker = v >> 56;
+    if (marker == 0xA5 || marker == 0xA6) {
+        info.timestampMs = static_cast<qint64>(v & ((quint64(1) << 48) - 1));
+        info.temporalId = static_cast<int>((v >> 48) & 0x3);
+        info.keyFrame = ((v >> 50) & 0x1) != 0;
+        info.streamId = static_cast<int>((v >> 52) & 0xF);
+        info.tagged = true;
+    }
+    if (marker == 0xA6) {
+        const int type = packet.size() >= 16 ? static_cast<quint8>(packet.at(9)) : 0;
+        if (packet.size() < 16 || static_cast<quint8>(packet.at(8)) != 1 || type < kMsgVideo || type > kMsgImage) {
+            info.valid = false;
+            return info;
+        }
+        info.type = type;
+    }
+    return info;
+}
+
+// 文本消息快速分类：只扫描顶层对象取 "type" 字段的字符串值，不构建 QJsonDocument、不转 UTF-8。
+// 客户端用 QJsonDocument 紧凑输出（键按字母序），type 不在固定位置；扫描时跳过字符串（含转义）
+// 与嵌套对象/数组，嵌套层里的 "type" 不会误判。格式不符或值含转义时返回空，按未知类型转发。
+static int skipJsonString(QStringView json, int i, bool *escaped = nullptr)
+{
+    // i 指向起始引号，返回结束引号之后的位置；未闭合返回 -1
+    for (++i; i < json.size(); ++i) {
+        const QChar c = json.at(i);
+        if (c == QLatin1Char('\\')) {
+            if (escaped) *escaped = true;
+            ++i;
+        } else if (c == QLatin1Char('"')) {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+static int skipJsonSpace(QStringView json, int i)
+{
+    while (i < json.size() && json.at(i).isSpace()) ++i;
+    return i;
+}
+
+static QStringView sniffMessageType(QStringView json)
+{
+    int i = skipJsonSpace(json, 0);
+    if (i >= json.size() || json.at(i) != QLatin1Char('{')) {
+        return QStringView();
+    }
+    int depth = 0;
+    while (i < json.size()) {
+        const QChar c = json.at(i);
+        if (c == QLatin1Char('"')) {
+            const int start = i;
+            const int end = skipJsonString(json, i);
+            if (end < 0) return QStringView();
+            i = end;
+            if (depth != 1) continue;
+            // 顶层字符串后紧跟冒号的是键
+            const int colon = skipJsonSpace(json, i);
+            if (colon >= json.size() || json.at(colon) != QLatin1Char(':')) continue;
+            if (json.mid(start + 1, end - start - 2) != QLatin1String("type")) {
+                i = colon + 1;
+                continue;
+            }
+            const int value = skipJsonSpace(json, colon + 1);
+            if (value >= json.size() || json.at(value) != QLatin1Char('"')) return QStringView();
+            bool escaped = false;
+            const int valueEnd = skipJsonString(json, value, &escaped);
+            if (valueEnd < 0 || escaped) return QStringView();
+            return json.mid(value + 1, valueEnd - value - 2);
+        }
+        if (c == QLatin1Char('{') || c == QLatin1Char('[')) {
+            ++depth;
+        } else if (c == QLatin1Char('}') || c == QLatin1Char(']')) {
+            if (--depth <= 0) break;
+        }
+        ++i;
+    }
+    return QStringView();
+}
+
+// 房间内需要服务器读取字段的文本消息（观看端信令）：只有这些类型做完整 JSON 解析，
+// 音频/鼠标/光标/标注等高频消息只按类型与角色转发
+static bool isRoomSignalling(QStringView type)
+{
+    return type == QLatin1String("watch_request") || type == QLatin1String("viewer_exit")
+        || type == QLatin1String("stop_streaming") || type == QLatin1String("select_stream");
+}
+
+// 单个订阅者的时间层过滤：发送缓冲积压越多转发的层越少，回落后在基础层帧或关键帧处恢复全部层
+// （与 PacketHeader::TemporalLayerFilter 一致；基础层帧不依赖增强层，可作为升层起点）
+class TemporalLayerFilter
+{
+public:
+    bool accept(const PacketLayerInfo &info, qint64 backlogBytes)
+    {
+        if (!info.tagged) {
+            return true;    // 旧版推流端：不区分层，全部转发
+        }
+        if (backlogBytes > 512 * 1024) {
+            m_maxTemporalId = 0;
+        } else if (backlogBytes > 192 * 1024) {
+            m_maxTemporalId = std::min(m_maxTemporalId, 1);
+        } else if (backlogBytes < 64 * 1024 && (info.keyFrame || info.temporalId == 0)) {
+            m_maxTemporalId = 2;
+        }
+        return info.keyFrame || info.temporalId <= m_maxTemporalId;
+    }
+
+private:
+    int m_maxTemporalId = 2;
+};
+
+// 单个订阅者的多路流选择（与 PacketHeader::SimulcastSelector 一致）：
+// 订阅者通过 select_stream 指定期望的流，不存在时就近选择（优先更高分辨率）；
+// 积压持续 2 秒降一级，积压消除 5 秒回升一级；只在目标流关键帧处切换
+class SimulcastSelector
+{
+public:
+    void setRequested(int streamId)
+    {
+        m_requested = std::max(0, std::min(streamId, kMaxSimulcastStreams - 1));
+        m_penalty = 0;
+    }
+
+    int requested() const { return m_requested; }
+    int target() const { return m_target; }
+
+    // 新订阅者从 GOP 缓存补发时直接从该流开始（缓存以关键帧开头）
+    void startAt(int streamId)
+    {
+        m_current = m_target = std::max(0, std::min(streamId, kMaxSimulcastStreams - 1));
+    }
+
+    bool accept(const PacketLayerInfo &info, qint64 backlogBytes, quint32 activeStreams, qint64 nowMs)
+    {
+        if (backlogBytes > 512 * 1024) {
+            m_clearSinceMs = 0;
+            if (m_overloadSinceMs == 0) {
+                m_overloadSinceMs = nowMs;
+            } else if (nowMs - m_overloadSinceMs >= 2000 && m_penalty < kMaxSimulcastStreams - 1) {
+                ++m_penalty;
+                m_overloadSinceMs = nowMs;
+            }
+        } else {
+            m_overloadSinceMs = 0;
+            if (backlogBytes < 64 * 1024 && m_penalty > 0) {
+                if (m_clearSinceMs == 0) {
+                    m_clearSinceMs = nowMs;
+                } else if (nowMs - m_clearSinceMs >= 5000) {
+                    --m_penalty;
+                    m_clearSinceMs = nowMs;
+                }
+            }
+        }
+
+        m_target = resolve(activeStreams);
+        if (m_target != m_current && info.streamId == m_target && info.keyFrame) {
+            m_current = m_target;
+        }
+        return info.streamId == m_current;
+    }
+
+    // 切换未完成时每秒最多一次，提示向推流端请求目标流关键帧
+    bool takeKeyFrameRequest(qint64 nowMs)
+    {
+        if (m_target == m_current || nowMs - m_lastKeyFrameRequestMs < 1000) {
+            return false;
+        }
+        m_lastKeyFrameRequestMs = nowMs;
+        return true;
+    }
+
+private:
+    int resolve(quint32 activeStreams) const
+    {
+        if (activeStreams == 0) {
+            return m_current;
+        }
+        int s = -1;
+        for (int i = m_requested; i >= 0 && s < 0; --i) {
+            if (activeStreams & (1u << i)) s = i;
+        }
+        for (int i = m_requested + 1; i < kMaxSimulcastStreams && s < 0; ++i) {
+            if (activeStreams & (1u << i)) s = i;
+        }
+        for (int step = 0; step < m_penalty; ++step) {
+            int lower = -1;
+            for (int i = s + 1; i < kMaxSimulcastStreams && lower < 0; ++i) {
+                if (activeStreams & (1u << i)) lower = i;
+            }
+            if (lower < 0) break;
+            s = lower;
+        }
+        return s;
+    }
+
+    int m_requested = 0;
+    int m_current = 0;
+    int m_target = 0;
+    int m_penalty = 0;
+    qint64 m_overloadSinceMs = 0;
+    qint64 m_clearSinceMs = 0;
+    qint64 m_lastKeyFrameRequestMs = 0;
+};
+
+// ---- 监控指标（本地 HTTP /metrics，Prometheus 文本格式） ----
+// 转发热路径只做 relaxed 原子累加，采集时不加锁读取；房间/订阅者的指标对象以 shared_ptr 与注册表共享，
+// 注册表只在登记与采集时加锁（不在转发路径上），采集时顺带清理已销毁对象（weak_ptr 过期）。
+// 码率与消息速率以累计计数器导出，由 Prometheus 的 rate() 计算。
+
+// 按消息类型计数的下标：0 为文本信令，其余与 PacketMessageType 数值相同
+static const int kMetricTypeSlots = kMsgImage + 1;
+
+static const char *metricTypeName(int slot)
+{
+    static const char *const names[kMetricTypeSlots] = {
+        "text", "video", "audio", "viewer_audio", "cursor", "annotation", "image"
+    };
+    return (slot >= 0 && slot < kMetricTypeSlots) ? names[slot] : "unknown";
+}
+
+struct SubscriberMetrics {
+    std::atomic<qint64> queuedBytes{0};
+    std::atomic<qint64> peakBytes{0};          // 本统计周期（printStats）内的队列峰值
+    std::atomic<quint64> sentFrames{0};
+    std::atomic<quint64> sentBytes{0};
+    std::atomic<quint64> droppedFrames{0};
+    std::atomic<quint64> droppedBytes{0};
+    std::atomic<quint64> overflows{0};
+    std::atomic<quint64> keyFrameRequests{0};
+};
+
+struct RoomMetrics {
+    std::atomic<quint64> ingressBytes{0};      // 房间内客户端发来的字节
+    std::atomic<quint64> egressBytes{0};       // 转发给房间内客户端的字节（文本按字符数近似）
+    std::atomic<quint64> messages[kMetricTypeSlots] = {};
+    std::atomic<int> subscribers{0};
+    std::atomic<int> publisherConnected{0};
+
+    void countIngress(int typeSlot, qint64 bytes)
+    {
+        ingressBytes.fetch_add(static_cast<quint64>(bytes), std::memory_order_relaxed);
+        if (typeSlot >= 0 && typeSlot < kMetricTypeSlots) {
+            messages[typeSlot].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void countEgress(qint64 bytes)
+    {
+        egressBytes.fetch_add(static_cast<quint64>(bytes), std::memory_order_relaxed);
+    }
+};
+
+// 事件循环延迟直方图：所属线程的定时器按固定间隔触发，实际间隔超出设定的部分即事件循环的排队延迟
+class LoopLagHistogram
+{
+public:
+    static const int kBuckets = 10;
+
+    static double boundMs(int i)
+    {
+        static const double bounds[kBuckets] = {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000};
+        return bounds[i];
+    }
+
+    void observe(double lagMs)
+    {
+        int i = 0;
+        while (i < kBuckets && lagMs > boundMs(i)) ++i;
+        m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sumUs.fetch_add(static_cast<quint64>(lagMs * 1000.0), std::memory_order_relaxed);
+    }
+
+    // 在 owner 所在线程启动探测（需在该线程调用）
+    void startProbe(QObject *owner, int intervalMs = 100)
+    {
+        QTimer *timer = new QTimer(owner);
+        timer->setTimerType(Qt::PreciseTimer);
+        auto elapsed = std::make_shared<QElapsedTimer>();
+        elapsed->start();
+        QObject::connect(timer, &QTimer::timeout, owner, [this, elapsed, intervalMs]() {
+            observe(std::max<qint64>(0, elapsed->nsecsElapsed() / 1000 - qint64(intervalMs) * 1000) / 1000.0);
+            elapsed->restart();
+        });
+        timer->start(intervalMs);
+    }
+
+    quint64 bucket(int i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    double sumSeconds() const { return m_sumUs.load(std::memory_order_relaxed) / 1e6; }
+
+private:
+    std::atomic<quint64> m_buckets[kBuckets + 1] = {};   // 最后一个为 +Inf
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sumUs{0};
+};
+
+class MetricsRegistry
+{
+public:
+    void registerRoom(const QString &roomId, int worker, const std::shared_ptr<RoomMetrics> &metrics)
+    {
+        QMutexLocker locker(&m_mutex);
+        pruneIfLarge(m_rooms, m_roomsPruneAt);
+        m_rooms.append({roomId, worker, metrics});
+    }
+
+    // slot 为房间内订阅者序号（Room::assignMetricsSlot），断开后复用：标签数不超过房间同时在线的订阅者数，
+    // 不随连接次数/对端地址增长
+    void registerSubscriber(const QString &roomId, int slot, const std::shared_ptr<SubscriberMetrics> &metrics)
+    {
+        QMutexLocker locker(&m_mutex);
+        pruneIfLarge(m_subscribers, m_subscribersPruneAt);
+        m_subscribers.append({roomId, slot, metrics});
+    }
+
+    // 线程启动前在控制线程登记；直方图与注册表同生命周期
+    LoopLagHistogram *addLoop(const QString &thread)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_loops.push_back({thread, std::make_unique<LoopLagHistogram>()});
+        return m_loops.back().second.get();
+    }
+
+    QByteArray render(const QByteArray &extra = QByteArray())
+    {
+        // first 为该对象的标签集
+        QVector<QPair<QString, std::shared_ptr<RoomMetrics>>> rooms;
+        QVector<QPair<QString, std::shared_ptr<SubscriberMetrics>>> subscribers;
+        {
+            QMutexLocker locker(&m_mutex);
+            for (int i = m_rooms.size() - 1; i >= 0; --i) {
+                if (auto m = m_rooms[i].metrics.lock()) {
+                    rooms.append({labels({{"room", m_rooms[i].roomId}, {"worker", QString::number(m_rooms[i].worker)}}), m});
+                } else {
+                    m_rooms.remove(i);
+                }
+            }
+            for (int i = m_subscribers.size() - 1; i >= 0; --i) {
+                if (auto m = m_subscribers[i].metrics.lock()) {
+                    subscribers.append({labels({{"room", m_subscribers[i].roomId}, {"slot", QString::number(m_subscribers[i].slot)}}), m});
+                } else {
+                    m_subscribers.remove(i);
+                }
+            }
+        }
+
+        QByteArray out = extra;
+        const auto header = [&out](const char *name, const char *type, const char *help) {
+            out += QByteArray("# HELP ") + name + ' ' + help + "\n# TYPE " + name + ' ' + type + '\n';
+        };
+        const auto sample = [&out](const char *name, const QString &labelSet, double value) {
+            out += name + labelSet.toUtf8() + ' ' + QByteArray::number(value, 'g', 15) + '\n';
+        };
+
+        header("relay_room_ingress_bytes_total", "counter", "Bytes received from clients of the room.");
+        for (const auto &r : rooms) {
+            sample("relay_room_ingress_bytes_total", r.first, r.second->ingressBytes.load(std::memory_order_relaxed));
+        }
+        header("relay_room_egress_bytes_total", "counter", "Bytes forwarded to clients of the room.");
+        for (const auto &r : rooms) {
+            sample("relay_room_egress_bytes_total", r.first, r.second->egressBytes.load(std::memory_order_relaxed));
+        }
+        header("relay_room_messages_total", "counter", "Messages received in the room by type.");
+        for (const auto &r : rooms) {
+            for (int t = 0; t < kMetricTypeSlots; ++t) {
+                QString typed = r.first;
+                typed.insert(typed.size() - 1, QStringLiteral(",type=\"%1\"").arg(QLatin1String(metricTypeName(t))));
+                sample("relay_room_messages_total", typed, r.second->messages[t].load(std::memory_order_relaxed));
+            }
+        }
+        header("relay_room_subscribers", "gauge", "Connected subscribers in the room.");
+        for (const auto &r : rooms) {
+            sample("relay_room_subscribers", r.first, r.second->subscribers.load(std::memory_order_relaxed));
+        }
+        header("relay_room_publisher_connected", "gauge", "Whether the room has a publisher.");
+        for (const auto &r : rooms) {
+            sample("relay_room_publisher_connected", r.first, r.second->publisherConnected.load(std::memory_order_relaxed));
+        }
+
+        header("relay_subscriber_queued_bytes", "gauge", "Bytes waiting in the subscriber send queue.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_queued_bytes", s.first, s.second->queuedBytes.load(std::memory_order_relaxed));
+        }
+        header("relay_subscriber_sent_bytes_total", "counter", "Video bytes written to the subscriber socket.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_sent_bytes_total", s.first, s.second->sentBytes.load(std::memory_order_relaxed));
+        }
+        header("relay_subscriber_dropped_frames_total", "counter", "Video frames dropped by the subscriber send queue.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_dropped_frames_total", s.first, s.second->droppedFrames.load(std::memory_order_relaxed));
+        }
+        header("relay_subscriber_dropped_bytes_total", "counter", "Video bytes dropped by the subscriber send queue.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_dropped_bytes_total", s.first, s.second->droppedBytes.load(std::memory_order_relaxed));
+        }
+        header("relay_subscriber_queue_overflows_total", "counter", "Send queue overflow events.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_queue_overflows_total", s.first, s.second->overflows.load(std::memory_order_relaxed));
+        }
+        header("relay_subscriber_keyframe_requests_total", "counter", "Key frame requests sent to the publisher after overflow.");
+        for (const auto &s : subscribers) {
+            sample("relay_subscriber_keyframe_requests_total", s.first, s.second->keyFrameRequests.load(std::memory_order_relaxed));
+        }
+
+        header("relay_event_loop_lag_seconds", "histogram", "Event loop scheduling delay per thread.");
+        QMutexLocker locker(&m_mutex);
+        for (const auto &loop : m_loops) {
+            const LoopLagHistogram &h = *loop.second;
+            quint64 cumulative = 0;
+            for (int i = 0; i <= LoopLagHistogram::kBuckets; ++i) {
+                cumulative += h.bucket(i);
+                const QString le = i < LoopLagHistogram::kBuckets
+                    ? QString::number(LoopLagHistogram::boundMs(i) / 1000.0, 'g', 6) : QStringLiteral("+Inf");
+                sample("relay_event_loop_lag_seconds_bucket", labels({{"thread", loop.first}, {"le", le}}), cumulative);
+            }
+            sample("relay_event_loop_lag_seconds_sum", labels({{"thread", loop.first}}), h.sumSeconds());
+            sample("relay_event_loop_lag_seconds_count", labels({{"thread", loop.first}}), h.count());
+        }
+        return out;
+    }
+
+    static QString labels(std::initializer_list<QPair<QString, QString>> pairs)
+    {
+        QStringList parts;
+        for (const auto &p : pairs) {
+            QString value = p.second;
+            value.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+                 .replace(QLatin1Char('"'), QLatin1String("\\\""))
+                 .replace(QLatin1Char('\n'), QLatin1String("\\n"));
+            parts.append(p.first + QStringLiteral("=\"") + value + QLatin1Char('"'));
+        }
+        return QLatin1Char('{') + parts.join(QLatin1Char(',')) + QLatin1Char('}');
+    }
+
+private:
+    struct RoomEntry {
+        QString roomId;
+        int worker;
+        std::weak_ptr<RoomMetrics> metrics;
+    };
+    struct SubscriberEntry {
+        QString roomId;
+        int slot;
+        std::weak_ptr<SubscriberMetrics> metrics;
+    };
+
+    // 已失效的条目平时在采集时清理；未开启 /metrics 或长时间无人采集时在登记时清理，列表不随连接次数增长
+    template <typename Entry>
+    static void pruneIfLarge(QVector<Entry> &entries, int &pruneAt)
+    {
+        if (entries.size() < pruneAt) {
+            return;
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry &e) { return e.metrics.expired(); }),
+                      entries.end());
+        pruneAt = std::max(256, static_cast<int>(entries.size()) * 2);   // 均摊 O(1)
+    }
+
+    QMutex m_mutex;
+    QVector<RoomEntry> m_rooms;
+    QVector<SubscriberEntry> m_subscribers;
+    int m_roomsPruneAt = 256;
+    int m_subscribersPruneAt = 256;
+    std::vector<std::pair<QString, std::unique_ptr<LoopLagHistogram>>> m_loops;
+};
+
+// 最小 HTTP 服务：只响应 GET /metrics，单次请求后关闭连接；在控制线程运行
+class MetricsHttpServer : public QObject
+{
+public:
+    MetricsHttpServer(std::function<QByteArray()> render, QObject *parent = nullptr)
+        : QObject(parent), m_render(std::move(render)), m_server(new QTcpServer(this))
+    {
+        connect(m_server, &QTcpServer::newConnection, this, &MetricsHttpServer::onNewConnection);
+    }
+
+    bool listen(const QHostAddress &address, quint16 port) { return m_server->listen(address, port); }
+    QString errorString() const { return m_server->errorString(); }
+
+private:
+    void onNewConnection()
+    {
+        while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+            QTimer::singleShot(5000, socket, [socket]() { socket->abort(); });
+        }
+    }
+
+    void onReadyRead(QTcpSocket *socket)
+    {
+        QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+        if (!request.contains("\r\n\r\n") && request.size() < 8192) {
+            socket->setProperty("request", request);
+            return;
+        }
+        disconnect(socket, nullptr, this, nullptr);   // 每个连接只应答一次
+        const QList<QByteArray> line = request.left(request.indexOf("\r\n")).split(' ');
+        const QByteArray path = line.value(1).split('?').value(0);
+        QByteArray status = "404 Not Found";
+        QByteArray body = "not found\n";
+        if (line.value(0) == "GET" && path == "/metrics") {
+            status = "200 OK";
+            body = m_render();
+        }
+        socket->write("HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n" + body);
+        socket->disconnectFromHost();
+    }
+
+    std::function<QByteArray()> m_render;
+    QTcpServer *m_server;
+};
+
+// 单个订阅者的有界发送队列：视频帧先入队，socket 写缓冲低于低水位时再写入，
+// 慢速链路的积压留在这里按字节与时长限制，而不是无限堆在 Qt 的写缓冲里。
+// 溢出时只保留队列中最新关键帧及其后续帧；没有关键帧可保留时清空视频帧，
+// 丢弃后续增量帧直到下一个关键帧再恢复，只有这种情况才需要向推流端请求关键帧。
+class SubscriberSendQueue
+{
+public:
+    static constexpr qint64 kMaxBytes = 2 * 1024 * 1024;           // 队列字节上限
+    static constexpr qint64 kMaxDelayMs = 1000;                    // 队首帧最长排队时间
+    static constexpr qint64 kSocketLowWatermarkBytes = 128 * 1024; // socket 写缓冲低于此值才继续写入
+    // 队列与 GOP 缓存中的帧和推流端收到的是同一个 QByteArray（隐式共享），N 个订阅者不产生 N 份负载；
+    // 广播时生成的预成帧同样由各订阅者队列共享
+    // 统计放在共享的原子计数器里，/metrics 采集线程可直接读取；只有所属工作线程写入
+
+    SubscriberSendQueue() : m_stats(std::make_shared<SubscriberMetrics>()) {}
+
+    // 入队；frame 为共享的预成帧（可为空，写出时再成帧）；返回 true 表示队列已无可用的关键帧，需要向推流端请求
+    bool push(const QByteArray &message, bool keyFrame, qint64 nowMs, const QByteArray &frame = QByteArray())
+    {
+        if (m_waitKeyFrame) {
+            if (!keyFrame) {
+                add(m_stats->droppedFrames, 1);
+                add(m_stats->droppedBytes, message.size());
+                return false;
+            }
+            m_waitKeyFrame = false;
+        }
+
+        m_items.push_back({message, frame, nowMs, keyFrame});
+        setBytes(m_bytes + message.size());
+        if (m_bytes > m_stats->peakBytes.load(std::memory_order_relaxed)) {
+            m_stats->peakBytes.store(m_bytes, std::memory_order_relaxed);
+        }
+        if (m_bytes <= kMaxBytes && nowMs - m_items.front().enqueuedMs <= kMaxDelayMs) {
+            return false;
+        }
+        return overflow();
+    }
+
+    // 写入 socket 直到其写缓冲到达低水位（入队后与 bytesWritten 时调用）；返回本次写入的字节数
+    // transport 非空时直接写入预成帧，否则交给 QWebSocket 成帧
+    qint64 pump(QWebSocket *socket, QTcpSocket *transport)
+    {
+        qint64 written = 0;
+        while (!m_items.empty() && socket->bytesToWrite() < kSocketLowWatermarkBytes) {
+            const Item &item = m_items.front();
+            if (transport) {
+                transport->write(item.frame.isEmpty() ? buildBinaryFrame(item.message) : item.frame);
+            } else {
+                socket->sendBinaryMessage(item.message);
+            }
+            written += item.message.size();
+            add(m_stats->sentFrames, 1);
+            add(m_stats->sentBytes, item.message.size());
+            setBytes(m_bytes - item.message.size());
+            m_items.pop_front();
+        }
+        return written;
+    }
+
+    qint64 bytes() const { return m_bytes; }
+    int frames() const { return static_cast<int>(m_items.size()); }
+    qint64 delayMs(qint64 nowMs) const { return m_items.empty() ? 0 : nowMs - m_items.front().enqueuedMs; }
+    bool waitingKeyFrame() const { return m_waitKeyFrame; }
+    const SubscriberMetrics &stats() const { return *m_stats; }
+    const std::shared_ptr<SubscriberMetrics> &metrics() const { return m_stats; }
+    void countKeyFrameRequest() { add(m_stats->keyFrameRequests, 1); }
+    void resetPeak() { m_stats->peakBytes.store(m_bytes, std::memory_order_relaxed); }
+
+private:
+    struct Item {
+        QByteArray message;
+        QByteArray frame;
+        qint64 enqueuedMs;
+        bool keyFrame;
+    };
+
+    static void add(std::atomic<quint64> &counter, qint64 value)
+    {
+        counter.fetch_add(static_cast<quint64>(value), std::memory_order_relaxed);
+    }
+
+    void setBytes(qint64 bytes)
+    {
+        m_bytes = bytes;
+        m_stats->queuedBytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    bool overflow()
+    {
+        add(m_stats->overflows, 1);
+        // 最新关键帧之前的帧对观看端已无意义；关键帧之后的增量帧只依赖它，可以保留
+        auto keep = m_items.end();
+        for (auto it = m_items.begin(); it != m_items.end(); ++it) {
+            if (it->keyFrame) {
+                keep = it;
+            }
+        }
+        if (keep != m_items.end() && keep != m_items.begin()) {
+            dropRange(m_items.begin(), keep);
+            if (m_bytes <= kMaxBytes) {
+                return false;
+            }
+        }
+        // 仍然超限（或没有关键帧）：清空，等待下一个关键帧
+        dropRange(m_items.begin(), m_items.end());
+        m_waitKeyFrame = true;
+        return true;
+    }
+
+    void dropRange(std::deque<Item>::iterator first, std::deque<Item>::iterator last)
+    {
+        for (auto it = first; it != last; ++it) {
+            add(m_stats->droppedFrames, 1);
+            add(m_stats->droppedBytes, it->message.size());
+            setBytes(m_bytes - it->message.size());
+        }
+        m_items.erase(first, last);
+    }
+
+    std::deque<Item> m_items;
+    qint64 m_bytes = 0;
+    bool m_waitKeyFrame = false;
+    std::shared_ptr<SubscriberMetrics> m_stats;
+};
+
+// GOP 缓存（与 PacketHeader::GopCache 一致）：每路流保存最近关键帧及其后的增量帧，
+// 新订阅者立即补发，首帧不必等待推流端关键帧。基础层增量帧到达时丢弃缓存中的增强层帧；
+// 超过字节/帧数/时长上限时清空该路直到下一个关键帧，不为补充缓存请求关键帧（新订阅者走无缓存路径，
+// 由加入时的 start_streaming 触发推流端关键帧）；未打标签的旧格式包不缓存
+class GopCache
+{
+public:
+    static constexpr qint64 kMaxBytesPerStream = 2 * 1024 * 1024;
+    static constexpr int kMaxFramesPerStream = 150;
+    static constexpr qint64 kMaxAgeMs = 10000;   // 周期保活默认 8 秒，正常不会触发
+
+    void add(const QByteArray &message, const PacketLayerInfo &info)
+    {
+        if (!info.tagged || !isVideoLike(info) || info.streamId >= kMaxSimulcastStreams) {
+            return;
+        }
+        Stream &s = m_streams[info.streamId];
+        if (info.keyFrame || info.type == kMsgImage) {
+            reset(s);
+            s.valid = true;
+            s.keyTimestampMs = info.timestampMs;
+        } else if (!s.valid) {
+            return;
+        } else if (info.temporalId == 0) {
+            auto end = std::remove_if(s.frames.begin(), s.frames.end(), [&s](const Entry &e) {
+                if (e.temporalId == 0) return false;
+                s.bytes -= e.message.size();
+                return true;
+            });
+            s.frames.erase(end, s.frames.end());
+        }
+        s.frames.append({message, info.temporalId});
+        s.bytes += message.size();
+        if (s.bytes > kMaxBytesPerStream || s.frames.size() > kMaxFramesPerStream
+            || info.timestampMs - s.keyTimestampMs > kMaxAgeMs) {
+            reset(s);
+        }
+    }
+
+    bool has(int streamId) const
+    {
+        return streamId >= 0 && streamId < kMaxSimulcastStreams && m_streams[streamId].valid;
+    }
+
+    // 离 requested 最近的有缓存的流（优先更高分辨率）；没有返回 -1
+    int nearest(int requested) const
+    {
+        for (int i = std::min(requested, kMaxSimulcastStreams - 1); i >= 0; --i) {
+            if (has(i)) return i;
+        }
+        for (int i = requested + 1; i < kMaxSimulcastStreams; ++i) {
+            if (has(i)) return i;
+        }
+        return -1;
+    }
+
+    // 补发内容：第一个为关键帧，按原顺序
+    QVector<QByteArray> frames(int streamId) const
+    {
+        QVector<QByteArray> out;
+        if (!has(streamId)) {
+            return out;
+        }
+        out.reserve(m_streams[streamId].frames.size());
+        for (const Entry &e : m_streams[streamId].frames) {
+            out.append(e.message);
+        }
+        return out;
+    }
+
+    qint64 bytes() const
+    {
+        qint64 total = 0;
+        for (const Stream &s : m_streams) total += s.bytes;
+        return total;
+    }
+
+    void clear()
+    {
+        for (Stream &s : m_streams) reset(s);
+    }
+
+private:
+    struct Entry {
+        QByteArray message;
+        int temporalId = 0;
+    };
+    struct Stream {
+        QVector<Entry> frames;
+        qint64 bytes = 0;
+        qint64 keyTimestampMs = 0;     // 缓存中关键帧的采集时间戳（推流端时钟）
+        bool valid = false;
+    };
+
+    static void reset(Stream &s)
+    {
+        s.frames.clear();
+        s.bytes = 0;
+        s.keyTimestampMs = 0;
+        s.valid = false;
+    }
+
+    Stream m_streams[kMaxSimulcastStreams];
+};
+
+// 订阅者转发状态：所选流 + 时间层 + 发送队列
+// needsKeyFrame：发送队列溢出后在等关键帧。关键帧请求按流每秒限一次、多个订阅者合并，
+// 单次请求可能被限速吞掉，所以等待期间每次推送都重试，直到关键帧进入队列
+struct SubscriberRoute {
+    SimulcastSelector stream;
+    TemporalLayerFilter layers;
+    SubscriberSendQueue queue;
+    bool needsKeyFrame = false;
+    int metricsSlot = -1;             // /metrics 标签中的订阅者序号
+    QTcpSocket *transport = nullptr;  // 底层 socket（QWebSocket 的子对象），写入预成帧
+};
 
 // 房间管理类
 class Room
@@ -20,6 +868,13 @@ public:
     QString roomId;
     QWebSocket *publisher = nullptr;  // 推流端
     QSet<QWebSocket*> subscribers;    // 订阅端集合
+    QHash<QWebSocket*, SubscriberRoute> routes;  // 订阅端转发状态（所选流、时间层）
+    qint64 streamSeenMs[kMaxSimulcastStreams] = {};  // 各路流最近一次收到数据的时间
+    qint64 keyFrameRequestMs[kMaxSimulcastStreams] = {};  // 各路流最近一次请求关键帧的时间（多个订阅者合并）
+    GopCache gop;                     // 各路流最近关键帧及后续帧，新订阅者立即补发
+    quint64 gopBursts = 0;            // 从缓存补发的次数
+    int connections = 0;              // 指向本房间的连接数（RoomWorker::m_clients），为 0 才可删除
+    std::shared_ptr<RoomMetrics> metrics = std::make_shared<RoomMetrics>();  // /metrics 导出的计数器
     QDateTime createdTime;
     quint64 messageCount = 0;
     quint64 totalBytes = 0;
@@ -28,12 +883,15 @@ public:
     
     void addSubscriber(QWebSocket *socket) {
         subscribers.insert(socket);
+        metrics->subscribers.store(subscribers.size(), std::memory_order_relaxed);
         qDebug() << QDateTime::currentDateTime().toString()
                  << "房间" << roomId << "新增订阅者，当前订阅者数量:" << subscribers.size();
     }
     
     void removeSubscriber(QWebSocket *socket) {
         subscribers.remove(socket);
+        routes.remove(socket);
+        metrics->subscribers.store(subscribers.size(), std::memory_order_relaxed);
         qDebug() << QDateTime::currentDateTime().toString()
                  << "房间" << roomId << "移除订阅者，当前订阅者数量:" << subscribers.size();
     }
@@ -44,55 +902,688 @@ public:
                      << "房间" << roomId << "替换推流端";
         }
         publisher = socket;
+        gop.clear();
+        metrics->publisherConnected.store(1, std::memory_order_relaxed);
         qDebug() << QDateTime::currentDateTime().toString()
                  << "房间" << roomId << "设置推流端";
     }
     
     void removePublisher() {
         publisher = nullptr;
+        gop.clear();
+        metrics->publisherConnected.store(0, std::memory_order_relaxed);
         qDebug() << QDateTime::currentDateTime().toString()
                  << "房间" << roomId << "推流端断开";
     }
-    
+    
+    // 为订阅者分配 /metrics 序号：房间内当前未被占用的最小序号（断开的订阅者随路由移除，序号即释放）
+    int assignMetricsSlot(QWebSocket *subscriber) {
+        QSet<int> used;
+        for (auto it = routes.cbegin(); it != routes.cend(); ++it) {
+            if (it.key() != subscriber) {
+                used.insert(it->metricsSlot);
+            }
+        }
+        int slot = 0;
+        while (used.contains(slot)) {
+            ++slot;
+        }
+        routes[subscriber].metricsSlot = slot;
+        return slot;
+    }
+
     // 广播消息给所有订阅者
-    int broadcastToSubscribers(const QByteArray &message) {
+    int broadcastToSubscribers(const QByteArray &message, const PacketLayerInfo &info) {
         messageCount++;
         totalBytes += message.size();
         
+        // 只看头部，不解析负载：每个订阅者只收所选的一路流，积压的订阅者再跳过增强层
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        if (info.streamId < kMaxSimulcastStreams) {
+            streamSeenMs[info.streamId] = nowMs;
+        }
+        gop.add(message, info);
+        quint32 activeStreams = 0;
+        for (int i = 0; i < kMaxSimulcastStreams; ++i) {
+            if (streamSeenMs[i] > 0 && nowMs - streamSeenMs[i] <= 2000) {
+                activeStreams |= (1u << i);
+            }
+        }
+
         int sentCount = 0;
+        QByteArray frame;  // 第一个需要的订阅者处成帧一次，其余订阅者队列共享
         auto it = subscribers.begin();
         while (it != subscribers.end()) {
             QWebSocket *subscriber = *it;
             if (subscriber->state() == QAbstractSocket::ConnectedState) {
-                subscriber->sendBinaryMessage(message);
-                sentCount++;
+                SubscriberRoute &route = routes[subscriber];
+                const qint64 backlog = subscriber->bytesToWrite() + route.queue.bytes();
+                const bool selected = route.stream.accept(info, backlog, activeStreams, nowMs);
+                if (route.stream.takeKeyFrameRequest(nowMs)) {
+                    requestKeyFrame(route.stream.target(), nowMs);
+                }
+                if (selected && route.layers.accept(info, backlog)) {
+                    if (route.transport && frame.isEmpty()) {
+                        frame = buildBinaryFrame(message);
+                    }
+                    if (route.queue.push(message, info.keyFrame, nowMs, frame)) {
+                        route.needsKeyFrame = true;
+                    } else if (route.needsKeyFrame && !route.queue.waitingKeyFrame()) {
+                        route.needsKeyFrame = false; // 关键帧已入队
+                    }
+                    if (route.needsKeyFrame && requestKeyFrame(route.stream.target(), nowMs)) {
+                        route.queue.countKeyFrameRequest();
+                    }
+                    metrics->countEgress(route.queue.pump(subscriber, route.transport));
+                    sentCount++;
+                }
                 ++it;
             } else {
                 // 移除断开的连接
+                routes.remove(subscriber);
                 it = subscribers.erase(it);
+                metrics->subscribers.store(subscribers.size(), std::memory_order_relaxed);
             }
         }
         return sentCount;
     }
     
+    // 推流中途加入的订阅者：缓存的关键帧及后续帧经发送队列立即补发；没有缓存返回 false
+    bool sendGopBurst(QWebSocket *subscriber) {
+        SubscriberRoute &route = routes[subscriber];
+        const int stream = gop.nearest(route.stream.requested());
+        if (stream < 0) {
+            return false;
+        }
+        route.stream.startAt(stream);
+        const QVector<QByteArray> burst = gop.frames(stream);
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        for (int i = 0; i < burst.size(); ++i) {
+            route.queue.push(burst[i], i == 0, nowMs);
+        }
+        metrics->countEgress(route.queue.pump(subscriber, route.transport));
+        ++gopBursts;
+        qDebug() << QDateTime::currentDateTime().toString()
+                 << "房间" << roomId << "从 GOP 缓存补发" << burst.size() << "帧（流" << stream << "）";
+        return true;
+    }
+
+    // 订阅者 socket 写出数据后继续发送队列中的帧
+    void pumpSubscriber(QWebSocket *subscriber) {
+        auto it = routes.find(subscriber);
+        if (it != routes.end() && subscriber->state() == QAbstractSocket::ConnectedState) {
+            metrics->countEgress(it->queue.pump(subscriber, it->transport));
+        }
+    }
+
+    // 向推流端请求某路流的关键帧；同一路流每秒最多一次，多个订阅者的请求合并
+    bool requestKeyFrame(int stream, qint64 nowMs) {
+        if (!publisher || publisher->state() != QAbstractSocket::ConnectedState
+            || stream < 0 || stream >= kMaxSimulcastStreams
+            || nowMs - keyFrameRequestMs[stream] < 1000) {
+            return false;
+        }
+        keyFrameRequestMs[stream] = nowMs;
+        QJsonObject req;
+        req["type"] = "request_keyframe";
+        req["stream"] = stream;
+        publisher->sendTextMessage(QJsonDocument(req).toJson(QJsonDocument::Compact));
+        return true;
+    }
+
+    // 非视频消息（推流端音频/鼠标、观看端对讲）整包转发给订阅者，except 为发送者自身
+    int sendToSubscribers(const QByteArray &message, QWebSocket *except = nullptr) {
+        int sentCount = 0;
+        QByteArray frame;
+        for (QWebSocket *subscriber : subscribers) {
+            if (subscriber != except && subscriber->state() == QAbstractSocket::ConnectedState) {
+                const auto route = routes.constFind(subscriber);
+                QTcpSocket *transport = route != routes.constEnd() ? route->transport : nullptr;
+                if (transport) {
+                    if (frame.isEmpty()) {
+                        frame = buildBinaryFrame(message);
+                    }
+                    transport->write(frame);
+                } else {
+                    subscriber->sendBinaryMessage(message);
+                }
+                sentCount++;
+            }
+        }
+        metrics->countEgress(qint64(sentCount) * message.size());
+        return sentCount;
+    }
+
+    int sendTextToSubscribers(const QString &message, QWebSocket *except = nullptr) {
+        int sentCount = 0;
+        for (QWebSocket *subscriber : subscribers) {
+            if (subscriber != except && subscriber->state() == QAbstractSocket::ConnectedState) {
+                subscriber->sendTextMessage(message);
+                sentCount++;
+            }
+        }
+        metrics->countEgress(qint64(sentCount) * message.size());
+        return sentCount;
+    }
+
     bool isEmpty() const {
         return !publisher && subscribers.isEmpty();
     }
 };
 
+// 房间工作线程：一组房间及其推流端/订阅端连接都归属同一线程，转发在该线程内完成，
+// 不同房间分散到多个线程并行。房间按 roomId 哈希固定分配，同一房间的所有连接总在同一工作线程。
+// 与登录连接（控制线程）的交互只通过排队调用/信号：
+// - 控制线程 → 房间：sendToPublisher（start_streaming、同意观看等信令）
+// - 房间 → 控制线程：loginUserMessage（通知房主登录连接 viewer_exit）
+class RoomWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    RoomWorker(int index, MetricsRegistry *metrics, LoopLagHistogram *loopLag)
+        : m_index(index), m_metrics(metrics), m_loopLag(loopLag) {}
+
+    ~RoomWorker() override
+    {
+        qDeleteAll(m_rooms);
+    }
+
+    int index() const { return m_index; }
+    quint64 totalMessages() const { return m_totalMessages.load(std::memory_order_relaxed); }
+    quint64 totalBytes() const { return m_totalBytes.load(std::memory_order_relaxed); }
+    int roomCount() const { return m_roomCount.load(std::memory_order_relaxed); }
+
+signals:
+    // 发给 userId 对应的登录连接（控制线程处理）
+    void loginUserMessage(const QString &userId, const QString &message);
+
+public slots:
+    // 工作线程启动后调用：定时器需在所属线程创建
+    void start()
+    {
+        QTimer *cleanupTimer = new QTimer(this);
+        connect(cleanupTimer, &QTimer::timeout, this, &RoomWorker::cleanupEmptyRooms);
+        cleanupTimer->start(60000); // 每分钟清理一次
+        m_loopLag->startProbe(this);
+    }
+
+    // 接管控制线程移交的连接（socket 已 moveToThread 到本线程）
+    void attach(QWebSocket *socket, const QString &action, const QString &roomId)
+    {
+        socket->setParent(this);
+        if (socket->state() != QAbstractSocket::ConnectedState) {
+            socket->deleteLater();
+            return;
+        }
+
+        // 获取或创建房间
+        Room *&slot = m_rooms[roomId];
+        if (!slot) {
+            slot = new Room(roomId);
+            m_metrics->registerRoom(roomId, m_index, slot->metrics);
+            m_roomCount.store(m_rooms.size(), std::memory_order_relaxed);
+            qDebug() << "[工作线程" << m_index << "] 创建新房间:" << roomId;
+        }
+        
+        Room *room = slot;
+        RoomClient &client = m_clients[socket];
+        client.room = room;
+        client.publisher = action == "publish";
+        ++room->connections;
+        
+        // 根据操作类型处理连接
+        if (client.publisher) {
+            room->setPublisher(socket);
+            
+            // 自动触发推流：如果有订阅者加入且推流端在线，发送start_streaming
+            if (!room->subscribers.isEmpty()) {
+                QJsonObject startStreamingMsg;
+                startStreamingMsg["type"] = "start_streaming";
+                QJsonDocument startDoc(startStreamingMsg);
+                socket->sendTextMessage(startDoc.toJson(QJsonDocument::Compact));
+                qDebug() << "推流端加入，已有订阅者，自动触发推流" << roomId;
+            }
+        } else { // subscribe
+            room->addSubscriber(socket);
+            // 预成帧写入底层 socket；取不到时退回 QWebSocket 成帧，每条消息只写一个帧
+            // （Qt 默认把 512 KB 以上的消息按订阅者逐个拆帧）
+            room->routes[socket].transport = subscriberTransport(socket);
+            socket->setOutgoingFrameSize(std::min<quint64>(kSubscriberFrameSize, QWebSocket::maxOutgoingFrameSize()));
+            m_metrics->registerSubscriber(roomId, room->assignMetricsSlot(socket), room->routes[socket].queue.metrics());
+            room->sendGopBurst(socket);
+            
+            // 自动触发推流：如果有订阅者加入且推流端在线，发送start_streaming
+            if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+                QJsonObject startStreamingMsg;
+                startStreamingMsg["type"] = "start_streaming";
+                QJsonDocument startDoc(startStreamingMsg);
+                room->publisher->sendTextMessage(startDoc.toJson(QJsonDocument::Compact));
+                qDebug() << "订阅者加入，自动触发推流端" << roomId;
+            }
+        }
+        
+        // 连接信号槽（本线程直接调用）
+        connect(socket, &QWebSocket::binaryMessageReceived,
+                this, &RoomWorker::onBinaryMessageReceived);
+        connect(socket, &QWebSocket::textMessageReceived,
+                this, &RoomWorker::onTextMessageReceived);
+        connect(socket, &QWebSocket::disconnected,
+                this, &RoomWorker::onClientDisconnected);
+        if (!client.publisher) {
+            connect(socket, &QWebSocket::bytesWritten,
+                    this, &RoomWorker::onSubscriberBytesWritten);
+        }
+    }
+
+    void sendToPublisher(const QString &roomId, const QString &message)
+    {
+        Room *room = m_rooms.value(roomId, nullptr);
+        if (!room) {
+            qDebug() << QDateTime::currentDateTime().toString()
+                     << "房间" << roomId << "不存在";
+            return;
+        }
+        if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+            room->publisher->sendTextMessage(message);
+            room->metrics->countEgress(message.size());
+            qDebug() << QDateTime::currentDateTime().toString()
+                     << "已向推流端" << roomId << "转发控制消息";
+        } else {
+            qDebug() << QDateTime::currentDateTime().toString()
+                     << "推流端" << roomId << "不在线或连接已断开";
+        }
+    }
+
+    void printStats()
+    {
+        for (auto it = m_rooms.begin(); it != m_rooms.end(); ++it) {
+            Room *room = it.value();
+            qDebug() << "  [工作线程" << m_index << "] 房间" << room->roomId << ":"
+                     << "推流端:" << (room->publisher ? "在线" : "离线")
+                     << "订阅者:" << room->subscribers.size()
+                     << "消息数:" << room->messageCount
+                     << "流量:" << QString("%1 MB").arg(room->totalBytes / 1024.0 / 1024.0, 0, 'f', 2)
+                     << "GOP缓存:" << QString("%1 KB").arg(room->gop.bytes() / 1024.0, 0, 'f', 1)
+                     << "缓存补发:" << room->gopBursts;
+
+            // 订阅者发送队列：当前排队、本周期峰值与累计丢帧
+            const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+            for (auto r = room->routes.begin(); r != room->routes.end(); ++r) {
+                QWebSocket *subscriber = r.key();
+                SubscriberSendQueue &queue = r->queue;
+                const SubscriberMetrics &s = queue.stats();
+                const QString viewerId = m_clients.value(subscriber).viewerId;
+                qDebug() << "    订阅者" << (viewerId.isEmpty()
+                                              ? subscriber->peerAddress().toString() + ":" + QString::number(subscriber->peerPort())
+                                              : viewerId)
+                         << "流:" << r->stream.target()
+                         << "排队:" << queue.frames() << "帧"
+                         << QString("%1 KB").arg(queue.bytes() / 1024.0, 0, 'f', 1)
+                         << queue.delayMs(nowMs) << "ms"
+                         << "峰值:" << QString("%1 KB").arg(s.peakBytes.load() / 1024.0, 0, 'f', 1)
+                         << "socket缓冲:" << QString("%1 KB").arg(subscriber->bytesToWrite() / 1024.0, 0, 'f', 1)
+                         << "已发:" << s.sentFrames.load()
+                         << "丢帧:" << s.droppedFrames.load()
+                         << QString("(%1 KB)").arg(s.droppedBytes.load() / 1024.0, 0, 'f', 1)
+                         << "溢出:" << s.overflows.load()
+                         << "关键帧请求:" << s.keyFrameRequests.load()
+                         << (queue.waitingKeyFrame() ? "等待关键帧" : "");
+                queue.resetPeak();
+            }
+        }
+    }
+
+private slots:
+    void onBinaryMessageReceived(const QByteArray &message)
+    {
+        QWebSocket *sender = qobject_cast<QWebSocket*>(this->sender());
+        if (!sender) return;
+        const auto client = m_clients.constFind(sender);
+        if (client == m_clients.constEnd()) return;
+        Room *room = client->room;
+
+        // 只读头部决定去向：视频类只能由推流端发出；观看端的光标/标注/对讲发往推流端，对讲同时发给其他观看端
+        const PacketLayerInfo info = readPacketLayerInfo(message);
+        if (!info.valid) {
+            return;
+        }
+        room->metrics->countIngress(info.type, message.size());
+        if (!client->publisher) {
+            if (isVideoLike(info)) {
+                qDebug() << "订阅端尝试发送视频数据，忽略";
+                return;
+            }
+            if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+                room->publisher->sendBinaryMessage(message);
+                room->metrics->countEgress(message.size());
+            }
+            if (info.type == kMsgViewerAudio) {
+                room->sendToSubscribers(message, sender);
+            }
+            return;
+        }
+
+        int sentCount = isVideoLike(info) ? room->broadcastToSubscribers(message, info)
+                                          : room->sendToSubscribers(message);
+        
+        const quint64 handled = m_totalMessages.fetch_add(1, std::memory_order_relaxed) + 1;
+        m_totalBytes.fetch_add(static_cast<quint64>(message.size()), std::memory_order_relaxed);
+        
+        // 每1000条消息输出一次转发统计
+        if (handled % 1000 == 0) {
+            qDebug() << QDateTime::currentDateTime().toString()
+                     << "房间" << room->roomId << "已处理" << room->messageCount 
+                     << "条消息，当前转发给" << sentCount << "个订阅者";
+        }
+    }
+
+    void onSubscriberBytesWritten()
+    {
+        QWebSocket *subscriber = qobject_cast<QWebSocket*>(this->sender());
+        if (!subscriber) return;
+        const auto client = m_clients.constFind(subscriber);
+        if (client != m_clients.constEnd()) {
+            client->room->pumpSubscriber(subscriber);
+        }
+    }
+
+    void onTextMessageReceived(const QString &message)
+    {
+        QWebSocket *sender = qobject_cast<QWebSocket*>(this->sender());
+        if (!sender) return;
+        
+        const auto client = m_clients.find(sender);
+        if (client == m_clients.end()) return;
+        Room *room = client->room;
+        const QString &roomId = room->roomId;
+        const bool publisher = client->publisher;
+        
+        // 减少日志输出：仅在非鼠标位置消息时打印
+        // qDebug() << QDateTime::currentDateTime().toString()
+        //          << "房间" << roomId << role << "发送文本消息:" << message.left(100);
+        
+        // 按顶层 type 字段分流，不做完整解析；只有观看端信令才解析 JSON 读取字段
+        const QStringView type = sniffMessageType(message);
+        if (!publisher && isRoomSignalling(type)) {
+            const QJsonObject obj = QJsonDocument::fromJson(message.toUtf8()).object();
+            if (type == QLatin1String("watch_request")) {
+                const QString viewerId = obj.value("viewer_id").toString();
+                if (!viewerId.isEmpty()) {
+                    client->viewerId = viewerId;
+                }
+            } else if (type == QLatin1String("select_stream")) {
+                // 在服务器生效，同时照常转发给推流端（推流端据此按需开启对应编码）
+                room->routes[sender].stream.setRequested(obj.value("stream").toInt(0));
+            } else {
+                // viewer_exit / stop_streaming
+                const QString viewerId = obj.value("viewer_id").toString();
+                const QString targetId = obj.value("target_id").toString();
+                if (!viewerId.isEmpty()) {
+                    // 房主的登录连接在控制线程
+                    QJsonObject msg = obj;
+                    msg["type"] = "viewer_exit";
+                    msg["viewer_id"] = viewerId;
+                    msg["target_id"] = targetId.isEmpty() ? roomId : targetId;
+                    msg["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+                    emit loginUserMessage(roomId, QJsonDocument(msg).toJson(QJsonDocument::Compact));
+                }
+                client->viewerId.clear();
+            }
+        }
+
+        room->metrics->countIngress(0, message.size());
+
+        // 处理鼠标位置消息 - 只从推流端转发给订阅者
+        if (type == QLatin1String("mouse_position") && publisher) {
+            room->sendTextToSubscribers(message);
+            return; // 鼠标消息处理完毕，不再进行通用转发
+        }
+        if (type == QLatin1String("audio_opus")) {
+            // 降低日志频率：每100个包打印一次（计数按工作线程独立）
+            if (++m_audioForwardCount % 100 == 0) {
+                qDebug() << "工作线程" << m_index << "转发音频包 序号:" << m_audioForwardCount
+                         << " 来源:" << sender->peerAddress().toString();
+            }
+            // 转发给房间内的所有订阅者
+            room->sendTextToSubscribers(message, sender); // 防止回音：不要发回给发送者
+            return;
+        }
+
+        // 文本消息转发
+        if (!publisher && type == QLatin1String("viewer_audio_opus")) {
+            if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+                room->publisher->sendTextMessage(message);
+                room->metrics->countEgress(message.size());
+            }
+            // 恢复转发：允许消费者之间互通 (Consumer -> Consumer)
+            // 之前为了防回音禁用了它，但导致了“岔路”不通。
+            // 现在的策略是：全通路打通，回音问题交给客户端处理或用户配置（如佩戴耳机）。
+            room->sendTextToSubscribers(message, sender);
+        } else if (publisher) {
+            room->sendTextToSubscribers(message);
+        } else {
+            if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+                room->publisher->sendTextMessage(message);
+                room->metrics->countEgress(message.size());
+            }
+        }
+    }
+    
+    void onClientDisconnected()
+    {
+        QWebSocket *client = qobject_cast<QWebSocket*>(sender());
+        if (!client) return;
+        
+        QString clientInfo = QString("%1:%2").arg(client->peerAddress().toString())
+                                             .arg(client->peerPort());
+        
+        // 房间系统客户端断开处理
+        const auto it = m_clients.find(client);
+        if (it == m_clients.end()) {
+            client->deleteLater();
+            return;
+        }
+        const RoomClient info = it.value();
+        m_clients.erase(it);
+        Room *room = info.room;
+        const QString &roomId = room->roomId;
+        --room->connections;
+
+        qDebug() << QDateTime::currentDateTime().toString()
+                 << "客户端断开连接:" << clientInfo << "房间:" << roomId << "角色:" << (info.publisher ? "publisher" : "subscriber");
+
+        // 从房间中移除客户端
+        if (info.publisher) {
+            // 被新推流端替换的旧连接断开时不影响当前推流端
+            if (room->publisher == client) {
+                room->removePublisher();
+            }
+        } else {
+            const QString &viewerId = info.viewerId;
+            if (!viewerId.isEmpty()) {
+                QJsonObject msg;
+                msg["type"] = "viewer_exit";
+                msg["viewer_id"] = viewerId;
+                msg["target_id"] = roomId;
+                msg["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+                const QString payload = QJsonDocument(msg).toJson(QJsonDocument::Compact);
+                if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
+                    room->publisher->sendTextMessage(payload);
+                }
+                emit loginUserMessage(roomId, payload);
+            }
+            room->removeSubscriber(client);
+        }
+        
+        client->deleteLater();
+    }
+    
+    void cleanupEmptyRooms()
+    {
+        QStringList emptyRooms;
+        for (auto it = m_rooms.begin(); it != m_rooms.end(); ++it) {
+            if (it.value()->isEmpty() && it.value()->connections == 0) {
+                emptyRooms.append(it.key());
+            }
+        }
+        
+        for (const QString &roomId : emptyRooms) {
+            qDebug() << "清理空房间:" << roomId;
+            delete m_rooms.take(roomId);
+        }
+        m_roomCount.store(m_rooms.size(), std::memory_order_relaxed);
+    }
+
+private:
+    int m_index;
+    MetricsRegistry *m_metrics;                             // 由 WebSocketServerApp 持有
+    LoopLagHistogram *m_loopLag;
+    // 连接 → 所在房间与角色。房间持有推流端/订阅者集合，连接直接指回房间；
+    // 订阅者的 viewerId 即其登录会话的 userId，控制线程按该键 O(1) 找到登录连接
+    struct RoomClient {
+        Room *room = nullptr;
+        bool publisher = false;
+        QString viewerId;
+    };
+    QHash<QString, Room*> m_rooms;                          // 本线程的房间
+    QHash<QWebSocket*, RoomClient> m_clients;
+    std::atomic<quint64> m_totalMessages{0};                // 统计由控制线程读取
+    std::atomic<quint64> m_totalBytes{0};
+    std::atomic<int> m_roomCount{0};
+    quint64 m_audioForwardCount = 0;                        // 仅本线程访问，只用于限频日志
+};
+
+// 登录连接注册表（控制线程）：每个登录连接一个会话，按 socket 与 userId 双索引，
+// 登录信令转发、房间线程回传的 viewer_exit、心跳检查与断开处理都是 O(1) 查找，不再逐个扫描在线用户。
+// 同一 userId 重复登录时 userId 索引指向最新的连接，旧连接断开不影响新连接的在线状态。
+// 会话与房间的关联：房间以房主 userId 命名（workerForRoom 按同一键定位工作线程），订阅者的 viewerId 即观看者 userId。
+struct LoginSession {
+    QWebSocket *socket = nullptr;
+    QString userId;                 // 未登录为空；心跳超时后保留，但已不在 userId 索引中
+    QString userName;
+    int iconId = -1;                // -1 为未知，用默认头像
+    qint64 lastHeartbeatMs = 0;
+    bool deltaUpdates = false;      // 登录时声明 user_list_deltas：在线列表只收增量，否则收完整列表
+};
+
+class SessionRegistry
+{
+public:
+    SessionRegistry() = default;
+    SessionRegistry(const SessionRegistry &) = delete;
+    SessionRegistry &operator=(const SessionRegistry &) = delete;
+    ~SessionRegistry() { qDeleteAll(m_bySocket); }
+
+    // 登录连接建立
+    LoginSession *add(QWebSocket *socket)
+    {
+        LoginSession *&session = m_bySocket[socket];
+        if (!session) {
+            session = new LoginSession;
+            session->socket = socket;
+        }
+        return session;
+    }
+
+    LoginSession *session(QWebSocket *socket) const { return m_bySocket.value(socket, nullptr); }
+    LoginSession *user(const QString &userId) const { return m_byUser.value(userId, nullptr); }
+
+    // userId 当前登录连接；没有返回 nullptr
+    QWebSocket *socketOf(const QString &userId) const
+    {
+        const LoginSession *s = user(userId);
+        return s ? s->socket : nullptr;
+    }
+
+    LoginSession *login(QWebSocket *socket, const QString &userId, const QString &userName, int iconId, qint64 nowMs)
+    {
+        LoginSession *s = add(socket);
+        unindex(s);
+        s->userId = userId;
+        s->userName = userName;
+        s->iconId = iconId;
+        s->lastHeartbeatMs = nowMs;
+        m_byUser.insert(userId, s);
+        return s;
+    }
+
+    bool touch(const QString &userId, qint64 nowMs)
+    {
+        LoginSession *s = user(userId);
+        if (!s) return false;
+        s->lastHeartbeatMs = nowMs;
+        return true;
+    }
+
+    // 连接断开；返回该连接是否为某个在线用户的当前连接（在线列表需要更新）
+    bool remove(QWebSocket *socket)
+    {
+        LoginSession *s = m_bySocket.take(socket);
+        if (!s) return false;
+        const bool wasOnline = unindex(s);
+        delete s;
+        return wasOnline;
+    }
+
+    // 心跳超时的用户下线（会话保留到连接真正断开），返回这些会话以便关闭连接；单次遍历在线用户
+    QList<LoginSession*> expire(qint64 nowMs, qint64 timeoutMs)
+    {
+        QList<LoginSession*> expired;
+        for (auto it = m_byUser.begin(); it != m_byUser.end();) {
+            LoginSession *s = it.value();
+            if (s->lastHeartbeatMs > 0 && nowMs - s->lastHeartbeatMs > timeoutMs) {
+                expired.append(s);
+                it = m_byUser.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return expired;
+    }
+
+    bool contains(QWebSocket *socket) const { return m_bySocket.contains(socket); }
+    const QHash<QWebSocket*, LoginSession*> &sessions() const { return m_bySocket; }
+    const QHash<QString, LoginSession*> &users() const { return m_byUser; }
+
+private:
+    // 从 userId 索引摘除（只有索引仍指向该会话时）；返回是否摘除
+    bool unindex(LoginSession *s)
+    {
+        if (s->userId.isEmpty()) return false;
+        const auto it = m_byUser.find(s->userId);
+        if (it == m_byUser.end() || it.value() != s) return false;
+        m_byUser.erase(it);
+        return true;
+    }
+
+    QHash<QWebSocket*, LoginSession*> m_bySocket;   // 全部登录连接（含未登录）
+    QHash<QString, LoginSession*> m_byUser;         // 在线用户 → 当前连接
+};
+
+// 控制线程：监听端口、登录连接、在线用户列表与跨房间信令；房间连接握手后移交给对应的工作线程
 class WebSocketServerApp : public QObject
 {
     Q_OBJECT
 
 public:
-    WebSocketServerApp(int port = 8765, QObject *parent = nullptr) : QObject(parent), m_port(port)
+    WebSocketServerApp(int port = 8765, int workerCount = 1, quint16 metricsPort = 0,
+                       const QHostAddress &metricsAddress = QHostAddress::LocalHost, QObject *parent = nullptr)
+        : QObject(parent), m_port(port)
     {
+        startWorkers(qMax(1, workerCount));
+        m_metrics.addLoop(QStringLiteral("control"))->startProbe(this);
+        if (metricsPort > 0) {
+            startMetricsServer(metricsAddress, metricsPort);
+        }
+
         m_server = new QWebSocketServer(QStringLiteral("Screen Stream Server with Routing"), 
                                        QWebSocketServer::NonSecureMode, this);
         
         if (m_server->listen(QHostAddress::Any, port)) {
             qDebug() << QDateTime::currentDateTime().toString() 
-                     << "WebSocket路由服务器启动成功，监听端口:" << port;
+                     << "WebSocket路由服务器启动成功，监听端口:" << port
+                     << "房间工作线程数:" << m_workers.size();
             connect(m_server, &QWebSocketServer::newConnection,
                     this, &WebSocketServerApp::onNewConnection);
             
@@ -101,18 +1592,30 @@ public:
             connect(statsTimer, &QTimer::timeout, this, &WebSocketServerApp::printStats);
             statsTimer->start(30000); // 每30秒输出一次统计
             
-            // 定时清理空房间
-            QTimer *cleanupTimer = new QTimer(this);
-            connect(cleanupTimer, &QTimer::timeout, this, &WebSocketServerApp::cleanupEmptyRooms);
-            cleanupTimer->start(60000); // 每分钟清理一次
             m_heartbeatTimer = new QTimer(this);
             connect(m_heartbeatTimer, &QTimer::timeout, this, &WebSocketServerApp::checkHeartbeatTimeouts);
             m_heartbeatTimer->start(5000);
+
+            m_userListFlushTimer = new QTimer(this);
+            m_userListFlushTimer->setSingleShot(true);
+            connect(m_userListFlushTimer, &QTimer::timeout, this, &WebSocketServerApp::broadcastOnlineUsersChanges);
         } else {
             qDebug() << QDateTime::currentDateTime().toString()
                      << "WebSocket服务器启动失败:" << m_server->errorString();
         }
     }
+
+    ~WebSocketServerApp() override
+    {
+        // 工作线程退出后在其线程内删除 RoomWorker（连至 finished 的 deleteLater），房间连接随之释放
+        for (QThread *thread : m_workerThreads) {
+            thread->quit();
+        }
+        for (QThread *thread : m_workerThreads) {
+            thread->wait();
+            delete thread;
+        }
+    }
     
 private slots:
     void onNewConnection()
@@ -129,14 +1632,12 @@ private slots:
         // 特殊处理登录连接
         if (path == "/login" || path == "/") {
             qDebug() << "登录系统连接，使用简单广播模式";
-            connect(socket, &QWebSocket::binaryMessageReceived,
-                    this, &WebSocketServerApp::onBinaryMessageReceived);
             connect(socket, &QWebSocket::textMessageReceived,
                     this, &WebSocketServerApp::onTextMessageReceived);
             connect(socket, &QWebSocket::disconnected,
                     this, &WebSocketServerApp::onClientDisconnected);
             
-            m_loginClients.append(socket);
+            m_sessions.add(socket);
             m_totalConnections++;
             return;
         }
@@ -159,93 +1660,24 @@ private slots:
             return;
         }
         
-        // 获取或创建房间
-        if (!m_rooms.contains(roomId)) {
-            m_rooms[roomId] = new Room(roomId);
-            qDebug() << "创建新房间:" << roomId;
-        }
-        
-        Room *room = m_rooms[roomId];
-        
-        // 根据操作类型处理连接
-        if (action == "publish") {
-            room->setPublisher(socket);
-            m_clientRoles[socket] = QPair<QString, QString>(roomId, "publisher");
-            
-            // 自动触发推流：如果有订阅者加入且推流端在线，发送start_streaming
-            if (!room->subscribers.isEmpty()) {
-                QJsonObject startStreamingMsg;
-                startStreamingMsg["type"] = "start_streaming";
-                QJsonDocument startDoc(startStreamingMsg);
-                socket->sendTextMessage(startDoc.toJson(QJsonDocument::Compact));
-                qDebug() << "推流端加入，已有订阅者，自动触发推流" << roomId;
-            }
-        } else { // subscribe
-            room->addSubscriber(socket);
-            m_clientRoles[socket] = QPair<QString, QString>(roomId, "subscriber");
-            
-            // 自动触发推流：如果有订阅者加入且推流端在线，发送start_streaming
-            if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                QJsonObject startStreamingMsg;
-                startStreamingMsg["type"] = "start_streaming";
-                QJsonDocument startDoc(startStreamingMsg);
-                room->publisher->sendTextMessage(startDoc.toJson(QJsonDocument::Compact));
-                qDebug() << "订阅者加入，自动触发推流端" << roomId;
-            }
-        }
-        
-        // 连接信号槽
-        connect(socket, &QWebSocket::binaryMessageReceived,
-                this, &WebSocketServerApp::onBinaryMessageReceived);
-        connect(socket, &QWebSocket::textMessageReceived,
-                this, &WebSocketServerApp::onTextMessageReceived);
-        connect(socket, &QWebSocket::disconnected,
-                this, &WebSocketServerApp::onClientDisconnected);
+        // 同一房间的推流端与订阅端总落在同一工作线程
+        RoomWorker *worker = workerForRoom(roomId);
+        socket->setParent(nullptr);
+        socket->moveToThread(worker->thread());
+        QMetaObject::invokeMethod(worker, [worker, socket, action, roomId]() {
+            worker->attach(socket, action, roomId);
+        }, Qt::QueuedConnection);
         
         m_totalConnections++;
     }
     
-    void onBinaryMessageReceived(const QByteArray &message)
-    {
-        QWebSocket *sender = qobject_cast<QWebSocket*>(this->sender());
-        if (!sender || !m_clientRoles.contains(sender)) return;
-        
-        QPair<QString, QString> roleInfo = m_clientRoles[sender];
-        QString roomId = roleInfo.first;
-        QString role = roleInfo.second;
-        
-        // 只有推流端可以发送二进制消息
-        if (role != "publisher") {
-            qDebug() << "订阅端尝试发送二进制消息，忽略";
-            return;
-        }
-        
-        if (!m_rooms.contains(roomId)) {
-            qDebug() << "房间不存在:" << roomId;
-            return;
-        }
-        
-        Room *room = m_rooms[roomId];
-        int sentCount = room->broadcastToSubscribers(message);
-        
-        m_totalMessages++;
-        m_totalBytes += message.size();
-        
-        // 每1000条消息输出一次转发统计
-        if (m_totalMessages % 1000 == 0) {
-            qDebug() << QDateTime::currentDateTime().toString()
-                     << "房间" << roomId << "已处理" << room->messageCount 
-                     << "条消息，当前转发给" << sentCount << "个订阅者";
-        }
-    }
-    
     void onTextMessageReceived(const QString &message)
     {
         QWebSocket *sender = qobject_cast<QWebSocket*>(this->sender());
         if (!sender) return;
         
         // 检查是否是登录系统客户端
-        if (m_loginClients.contains(sender)) {
+        if (m_sessions.contains(sender)) {
             qDebug() << QDateTime::currentDateTime().toString()
                      << "登录系统消息:" << message.left(100);
             
@@ -263,7 +1695,8 @@ private slots:
                     QString userName = data["name"].toString();
                     // 解析icon_id（优先使用icon_id，其次viewer_icon_id）
                     // 默认沿用已知服务器记录；若无记录则设为-1（未知，用默认头像）
-                    int iconId = m_userIcons.value(userId, -1);
+                    const LoginSession *existing = m_sessions.user(userId);
+                    int iconId = existing ? existing->iconId : -1;
                     if (data.contains("icon_id")) {
                         int parsed = data["icon_id"].toInt(-1);
                         if (parsed >= 3 && parsed <= 21) {
@@ -276,10 +1709,14 @@ private slots:
                         }
                     }
                     
-                    // 存储用户信息
-                    m_loginUsers[sender] = QPair<QString, QString>(userId, userName);
-                    m_userIcons[userId] = iconId;
-                    m_userLastHeartbeat[userId] = QDateTime::currentMSecsSinceEpoch();
+                    // 存储用户信息（同一连接换账号登录时，原账号也计入在线列表变更）
+                    const QString previousUserId = m_sessions.session(sender)->userId;
+                    if (!previousUserId.isEmpty() && previousUserId != userId) {
+                        noteUserChange(previousUserId);
+                    }
+                    noteUserChange(userId);
+                    LoginSession *session = m_sessions.login(sender, userId, userName, iconId, QDateTime::currentMSecsSinceEpoch());
+                    session->deltaUpdates = data.value("user_list_deltas").toBool();
                     
                     // 发送登录成功响应
                     QJsonObject response;
@@ -296,8 +1733,12 @@ private slots:
                     QJsonDocument responseDoc(response);
                     sender->sendTextMessage(responseDoc.toJson(QJsonDocument::Compact));
                     
-                    // 广播在线用户列表
-                    broadcastOnlineUsersList();
+                    // 新登录的连接立即收到完整列表，其他连接在合并窗口结束后收到增量
+                    sendOnlineUsersSnapshot(sender);
+                    return;
+                } else if (type == "online_users_sync") {
+                    // 客户端发现版本不连续时请求完整列表
+                    sendOnlineUsersSnapshot(sender);
                     return;
                 } else if (type == "watch_request") {
                     // 处理观看请求
@@ -308,18 +1749,12 @@ private slots:
                              << "收到观看请求，观看者:" << viewerId << "目标:" << targetId;
                     
                     // 查找目标用户的WebSocket连接
-                    QWebSocket *targetSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == targetId) {
-                            targetSocket = it.key();
-                            break;
-                        }
-                    }
+                    QWebSocket *targetSocket = m_sessions.socketOf(targetId);
                     
                     bool targetOnline = false;
                     if (targetSocket && targetSocket->state() == QAbstractSocket::ConnectedState) {
                         qint64 now = QDateTime::currentMSecsSinceEpoch();
-                        qint64 ts = m_userLastHeartbeat.value(targetId, 0);
+                        qint64 ts = m_sessions.user(targetId)->lastHeartbeatMs;
                         if (ts > 0 && now - ts <= 15000) {
                             targetOnline = true;
                         }
@@ -363,13 +1798,7 @@ private slots:
                              << "收到取消观看请求，观看者:" << viewerId << "目标:" << targetId;
                     
                     // 查找目标用户的WebSocket连接
-                    QWebSocket *targetSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == targetId) {
-                            targetSocket = it.key();
-                            break;
-                        }
-                    }
+                    QWebSocket *targetSocket = m_sessions.socketOf(targetId);
                     
                     if (targetSocket && targetSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
@@ -387,13 +1816,7 @@ private slots:
                              << "收到推流OK响应，观看者:" << viewerId << "目标:" << targetId;
                     
                     // 查找观看者的WebSocket连接
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) {
-                            viewerSocket = it.key();
-                            break;
-                        }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         // 向观看者发送推流OK响应
@@ -413,34 +1836,15 @@ private slots:
                                  << "观看者" << viewerId << "不在线或连接已断开";
                     }
                     
-                    // 【关键修复】向推流端发送start_streaming消息来触发实际推流
-                    if (m_rooms.contains(targetId)) {
-                        Room *room = m_rooms[targetId];
-                        if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                            QJsonObject startStreamingMsg;
-                            startStreamingMsg["type"] = "start_streaming";
-                            
-                            QJsonDocument startDoc(startStreamingMsg);
-                            room->publisher->sendTextMessage(startDoc.toJson(QJsonDocument::Compact));
-                            
-                            qDebug() << QDateTime::currentDateTime().toString()
-                                     << "已向推流端" << targetId << "发送start_streaming消息";
-                        } else {
-                            qDebug() << QDateTime::currentDateTime().toString()
-                                     << "推流端" << targetId << "不在线或连接已断开";
-                        }
-                    } else {
-                        qDebug() << QDateTime::currentDateTime().toString()
-                                 << "房间" << targetId << "不存在";
-                    }
+                    // 【关键修复】向推流端发送start_streaming消息来触发实际推流（房间在其工作线程上）
+                    QJsonObject startStreamingMsg;
+                    startStreamingMsg["type"] = "start_streaming";
+                    sendToRoomPublisher(targetId, QJsonDocument(startStreamingMsg).toJson(QJsonDocument::Compact));
                     return;
                 } else if (type == "approval_required") {
                     QString viewerId = obj.value("viewer_id").toString();
                     QString targetId = obj.value("target_id").toString();
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) { viewerSocket = it.key(); break; }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         viewerSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -453,10 +1857,7 @@ private slots:
                     QString targetId = obj.value("target_id").toString();
                     
                     // 1. 转发给观看者 (Viewer)
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) { viewerSocket = it.key(); break; }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         viewerSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -465,23 +1866,12 @@ private slots:
                     }
 
                     // 2. 转发给推流端 (Publisher) 以触发推流
-                    if (m_rooms.contains(targetId)) {
-                        Room *room = m_rooms[targetId];
-                        if (room && room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                            QJsonDocument doc(obj);
-                            room->publisher->sendTextMessage(doc.toJson(QJsonDocument::Compact));
-                            qDebug() << QDateTime::currentDateTime().toString()
-                                     << "已向推流端" << targetId << "转发同意消息(触发推流)";
-                        }
-                    }
+                    sendToRoomPublisher(targetId, QJsonDocument(obj).toJson(QJsonDocument::Compact));
                     return;
                 } else if (type == "watch_request_rejected") {
                     QString viewerId = obj.value("viewer_id").toString();
                     QString targetId = obj.value("target_id").toString();
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) { viewerSocket = it.key(); break; }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         viewerSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -492,10 +1882,7 @@ private slots:
                 } else if (type == "streaming_ok") {
                     QString viewerId = obj.value("viewer_id").toString();
                     QString targetId = obj.value("target_id").toString();
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) { viewerSocket = it.key(); break; }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         viewerSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -506,10 +1893,7 @@ private slots:
                 } else if (type == "kick_viewer") {
                     QString viewerId = obj.value("viewer_id").toString();
                     QString targetId = obj.value("target_id").toString();
-                    QWebSocket *viewerSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == viewerId) { viewerSocket = it.key(); break; }
-                    }
+                    QWebSocket *viewerSocket = m_sessions.socketOf(viewerId);
                     if (viewerSocket && viewerSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         viewerSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -526,10 +1910,7 @@ private slots:
                     if (viewerId.isEmpty() || targetId.isEmpty()) {
                         return;
                     }
-                    QWebSocket *targetSocket = nullptr;
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == targetId) { targetSocket = it.key(); break; }
-                    }
+                    QWebSocket *targetSocket = m_sessions.socketOf(targetId);
                     if (targetSocket && targetSocket->state() == QAbstractSocket::ConnectedState) {
                         QJsonDocument doc(obj);
                         targetSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -538,158 +1919,31 @@ private slots:
                 } else if (type == "heartbeat") {
                     QString uid = obj.value("id").toString();
                     if (uid.isEmpty()) {
-                        QPair<QString, QString> ui = m_loginUsers.value(sender);
-                        uid = ui.first;
+                        uid = m_sessions.session(sender)->userId;
                     }
                     if (!uid.isEmpty()) {
-                        m_userLastHeartbeat[uid] = QDateTime::currentMSecsSinceEpoch();
+                        m_sessions.touch(uid, QDateTime::currentMSecsSinceEpoch());
                     }
                     return;
                 } else if (type == "ping") {
                     // 处理轻量级心跳
-                    QPair<QString, QString> ui = m_loginUsers.value(sender);
-                    QString uid = ui.first;
+                    const QString &uid = m_sessions.session(sender)->userId;
                     if (!uid.isEmpty()) {
-                        m_userLastHeartbeat[uid] = QDateTime::currentMSecsSinceEpoch();
+                        m_sessions.touch(uid, QDateTime::currentMSecsSinceEpoch());
                     }
                     return;
                 }
             }
             
             // 其他登录系统消息广播给所有登录客户端 - 已禁用以防止全员广播干扰
-            // for (QWebSocket *client : m_loginClients) {
+            // for (const LoginSession *session : m_sessions.sessions()) {
+            //     QWebSocket *client = session->socket;
             //     if (client != sender && client->state() == QAbstractSocket::ConnectedState) {
             //         client->sendTextMessage(message);
             //     }
             // }
             return;
         }
-        
-        // 房间系统消息处理
-        if (!m_clientRoles.contains(sender)) return;
-        
-        QPair<QString, QString> roleInfo = m_clientRoles[sender];
-        QString roomId = roleInfo.first;
-        QString role = roleInfo.second;
-        
-        // 减少日志输出：仅在非鼠标位置消息时打印
-        // qDebug() << QDateTime::currentDateTime().toString()
-        //          << "房间" << roomId << role << "发送文本消息:" << message.left(100);
-        
-        // 解析JSON消息以处理特定类型
-        QJsonParseError error;
-        QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8(), &error);
-        
-        if (error.error == QJsonParseError::NoError && doc.isObject()) {
-            QJsonObject obj = doc.object();
-            QString type = obj["type"].toString();
-
-            if (role == "subscriber") {
-                if (type == "watch_request") {
-                    const QString viewerId = obj.value("viewer_id").toString();
-                    if (!viewerId.isEmpty()) {
-                        m_subscriberViewerIds[sender] = viewerId;
-                    }
-                } else if (type == "viewer_exit" || type == "stop_streaming") {
-                    const QString viewerId = obj.value("viewer_id").toString();
-                    const QString targetId = obj.value("target_id").toString();
-                    if (!viewerId.isEmpty()) {
-                        for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                            if (it.value().first == roomId) {
-                                QWebSocket *targetLoginSocket = it.key();
-                                if (targetLoginSocket && targetLoginSocket->state() == QAbstractSocket::ConnectedState) {
-                                    QJsonObject msg = obj;
-                                    msg["type"] = "viewer_exit";
-                                    msg["viewer_id"] = viewerId;
-                                    msg["target_id"] = targetId.isEmpty() ? roomId : targetId;
-                                    msg["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-                                    targetLoginSocket->sendTextMessage(QJsonDocument(msg).toJson(QJsonDocument::Compact));
-                                }
-                                break;
-                            }
-                        }
-                    }
-                    m_subscriberViewerIds.remove(sender);
-                }
-            }
-            
-            // 处理鼠标位置消息 - 只从推流端转发给订阅者
-            if (type == "mouse_position" && role == "publisher") {
-                if (m_rooms.contains(roomId)) {
-                    Room *room = m_rooms[roomId];
-                    int sentCount = 0;
-                    
-                    for (QWebSocket *subscriber : room->subscribers) {
-                        if (subscriber->state() == QAbstractSocket::ConnectedState) {
-                            subscriber->sendTextMessage(message);
-                            sentCount++;
-                        }
-                    }
-                    
-                    // 每1000条鼠标消息输出一次统计（避免日志过多）
-                    static int mouseMessageCount = 0;
-                    mouseMessageCount++;
-                    if (mouseMessageCount % 1000 == 0) {
-                        // qDebug() << QDateTime::currentDateTime().toString()
-                        //          << "房间" << roomId << "已转发" << mouseMessageCount 
-                        //          << "条鼠标位置消息给" << sentCount << "个订阅者";
-                    }
-                }
-                return; // 鼠标消息处理完毕，不再进行通用转发
-            } else if (type == "audio_opus") {
-                // 降低日志频率：每100个包打印一次，或者每秒一次
-                static int audioCount = 0;
-                if (++audioCount % 100 == 0) {
-                    qDebug() << "转发音频包 序号:" << audioCount << " 来源:" << sender->peerAddress().toString();
-                }
-                // 转发给房间内的所有订阅者
-                if (m_rooms.contains(roomId)) {
-                    Room *room = m_rooms[roomId];
-                    for (QWebSocket *subscriber : room->subscribers) {
-                        if (subscriber == sender) continue; // 防止回音：不要发回给发送者
-                        if (subscriber->state() == QAbstractSocket::ConnectedState) {
-                            subscriber->sendTextMessage(message);
-                        }
-                    }
-                }
-                return;
-            }
-        }
-        
-        // 文本消息转发
-        if (m_rooms.contains(roomId)) {
-            Room *room = m_rooms[roomId];
-            QJsonParseError jerr;
-            QJsonDocument jdoc = QJsonDocument::fromJson(message.toUtf8(), &jerr);
-            QString t = QString();
-            if (jerr.error == QJsonParseError::NoError && jdoc.isObject()) {
-                t = jdoc.object().value("type").toString();
-            }
-            if (role == "subscriber" && t == "viewer_audio_opus") {
-                if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                    room->publisher->sendTextMessage(message);
-                }
-                // 恢复转发：允许消费者之间互通 (Consumer -> Consumer)
-                // 之前为了防回音禁用了它，但导致了“岔路”不通。
-                // 现在的策略是：全通路打通，回音问题交给客户端处理或用户配置（如佩戴耳机）。
-                for (QWebSocket *subscriber : room->subscribers) {
-                    if (subscriber == sender) continue;
-                    if (subscriber->state() == QAbstractSocket::ConnectedState) {
-                        subscriber->sendTextMessage(message);
-                    }
-                }
-            } else if (role == "publisher") {
-                for (QWebSocket *subscriber : room->subscribers) {
-                    if (subscriber->state() == QAbstractSocket::ConnectedState) {
-                        subscriber->sendTextMessage(message);
-                    }
-                }
-            } else {
-                if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                    room->publisher->sendTextMessage(message);
-                }
-            }
-        }
     }
     
     void onClientDisconnected()
@@ -701,188 +1955,452 @@ private slots:
                                              .arg(client->peerPort());
         
         // 检查是否是登录系统客户端
-        if (m_loginClients.contains(client)) {
+        if (const LoginSession *session = m_sessions.session(client)) {
             qDebug() << QDateTime::currentDateTime().toString()
                      << "登录系统客户端断开连接:" << clientInfo;
-            
-            // 从登录用户列表中移除
-            if (m_loginUsers.contains(client)) {
-                QPair<QString, QString> userInfo = m_loginUsers[client];
+            if (!session->userId.isEmpty()) {
                 qDebug() << QDateTime::currentDateTime().toString()
-                         << "用户登出:" << userInfo.first << "(" << userInfo.second << ")";
-                m_loginUsers.remove(client);
-                // 同步移除头像记录
-                m_userIcons.remove(userInfo.first);
-                m_userLastHeartbeat.remove(userInfo.first);
-                
-                // 广播更新后的在线用户列表
-                broadcastOnlineUsersList();
+                         << "用户登出:" << session->userId << "(" << session->userName << ")";
             }
             
-            m_loginClients.removeAll(client);
-            client->deleteLater();
-            return;
-        }
-        
-        // 房间系统客户端断开处理
-        if (!m_clientRoles.contains(client)) {
+            // 从登录用户列表中移除；只有当前连接下线才会产生在线列表变更
+            if (!session->userId.isEmpty()) {
+                noteUserChange(session->userId);
+            }
+            m_sessions.remove(client);
+            
             client->deleteLater();
             return;
         }
         
-        QPair<QString, QString> roleInfo = m_clientRoles[client];
-        QString roomId = roleInfo.first;
-        QString role = roleInfo.second;
-
-        qDebug() << QDateTime::currentDateTime().toString()
-                 << "客户端断开连接:" << clientInfo << "房间:" << roomId << "角色:" << role;
-
-        // 从房间中移除客户端
-        if (m_rooms.contains(roomId)) {
-            Room *room = m_rooms[roomId];
-            if (role == "publisher") {
-                room->removePublisher();
-            } else {
-                const QString viewerId = m_subscriberViewerIds.value(client);
-                if (!viewerId.isEmpty()) {
-                    QJsonObject msg;
-                    msg["type"] = "viewer_exit";
-                    msg["viewer_id"] = viewerId;
-                    msg["target_id"] = roomId;
-                    msg["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-                    const QString payload = QJsonDocument(msg).toJson(QJsonDocument::Compact);
-                    if (room->publisher && room->publisher->state() == QAbstractSocket::ConnectedState) {
-                        room->publisher->sendTextMessage(payload);
-                    }
-                    for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                        if (it.value().first == roomId) {
-                            QWebSocket *targetLoginSocket = it.key();
-                            if (targetLoginSocket && targetLoginSocket->state() == QAbstractSocket::ConnectedState) {
-                                targetLoginSocket->sendTextMessage(payload);
-                            }
-                            break;
-                        }
-                    }
-                }
-                m_subscriberViewerIds.remove(client);
-                room->removeSubscriber(client);
-            }
-        }
-        
-        m_clientRoles.remove(client);
         client->deleteLater();
     }
-    
-    void cleanupEmptyRooms()
+
+    // 房间线程发来的消息：转给 userId 的登录连接
+    void sendToLoginUser(const QString &userId, const QString &message)
     {
-        QStringList emptyRooms;
-        for (auto it = m_rooms.begin(); it != m_rooms.end(); ++it) {
-            if (it.value()->isEmpty()) {
-                emptyRooms.append(it.key());
-            }
-        }
-        
-        for (const QString &roomId : emptyRooms) {
-            qDebug() << "清理空房间:" << roomId;
-            delete m_rooms[roomId];
-            m_rooms.remove(roomId);
+        QWebSocket *targetLoginSocket = m_sessions.socketOf(userId);
+        if (targetLoginSocket && targetLoginSocket->state() == QAbstractSocket::ConnectedState) {
+            targetLoginSocket->sendTextMessage(message);
         }
     }
     
     void printStats()
     {
+        quint64 totalMessages = 0;
+        quint64 totalBytes = 0;
+        int roomCount = 0;
+        for (RoomWorker *worker : m_workers) {
+            totalMessages += worker->totalMessages();
+            totalBytes += worker->totalBytes();
+            roomCount += worker->roomCount();
+        }
         qDebug() << "=== 路由服务器统计信息 ===" 
                  << QDateTime::currentDateTime().toString();
         qDebug() << "监听端口:" << m_port;
-        qDebug() << "活跃房间数:" << m_rooms.size();
+        qDebug() << "房间工作线程数:" << m_workers.size();
+        qDebug() << "活跃房间数:" << roomCount;
         qDebug() << "总连接数:" << m_totalConnections;
-        qDebug() << "总消息数:" << m_totalMessages;
-        qDebug() << "总流量:" << QString("%1 MB").arg(m_totalBytes / 1024.0 / 1024.0, 0, 'f', 2);
+        qDebug() << "总消息数:" << totalMessages;
+        qDebug() << "总流量:" << QString("%1 MB").arg(totalBytes / 1024.0 / 1024.0, 0, 'f', 2);
         
-        // 输出每个房间的详细信息
-        for (auto it = m_rooms.begin(); it != m_rooms.end(); ++it) {
-            Room *room = it.value();
-            qDebug() << "  房间" << room->roomId << ":"
-                     << "推流端:" << (room->publisher ? "在线" : "离线")
-                     << "订阅者:" << room->subscribers.size()
-                     << "消息数:" << room->messageCount
-                     << "流量:" << QString("%1 MB").arg(room->totalBytes / 1024.0 / 1024.0, 0, 'f', 2);
+        // 每个房间的详细信息由所属工作线程输出
+        for (RoomWorker *worker : m_workers) {
+            QMetaObject::invokeMethod(worker, "printStats", Qt::QueuedConnection);
         }
-        qDebug() << "===================";
     }
 
 private:
     QWebSocketServer *m_server;
-    QMap<QString, Room*> m_rooms;                           // 房间管理
-    QMap<QWebSocket*, QPair<QString, QString>> m_clientRoles; // 客户端角色 (roomId, role)
-    QMap<QWebSocket*, QString> m_subscriberViewerIds;
-    QList<QWebSocket*> m_loginClients;                      // 登录系统客户端列表
-    QMap<QWebSocket*, QPair<QString, QString>> m_loginUsers; // 登录用户信息 (socket -> (userId, userName))
-    QMap<QString, int> m_userIcons;                         // 登录用户头像 (userId -> iconId)
-    QMap<QString, qint64> m_userLastHeartbeat;              // 登录用户最近心跳
+    QVector<RoomWorker*> m_workers;                         // 房间工作线程（按 roomId 哈希分配）
+    QVector<QThread*> m_workerThreads;
+    static constexpr int kUserListCoalesceMs = 200;         // 在线列表变更合并窗口
+
+    struct PendingUserChange {
+        bool wasOnline = false;
+        QString name;
+        int iconId = -1;
+    };
+
+    SessionRegistry m_sessions;                             // 登录连接与在线用户（socket / userId 索引）
+    QHash<QString, PendingUserChange> m_pendingUserChanges; // 合并窗口内有变更的用户 → 窗口开始时的状态
+    QTimer *m_userListFlushTimer = nullptr;                 // 在线列表合并窗口
+    quint64 m_usersVersion = 0;                             // 在线列表版本，每发出一次增量加一
     QTimer *m_heartbeatTimer = nullptr;                     // 心跳检查定时器
     int m_port;
     quint64 m_totalConnections = 0;
-    quint64 m_totalMessages = 0;
-    quint64 m_totalBytes = 0;
+    MetricsRegistry m_metrics;                              // 工作线程全部退出后才析构
+
+    void startWorkers(int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            QThread *thread = new QThread();
+            thread->setObjectName(QStringLiteral("RoomWorker-%1").arg(i));
+            RoomWorker *worker = new RoomWorker(i, &m_metrics, m_metrics.addLoop(thread->objectName()));
+            worker->moveToThread(thread);
+            connect(thread, &QThread::started, worker, &RoomWorker::start);
+            connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+            connect(worker, &RoomWorker::loginUserMessage, this, &WebSocketServerApp::sendToLoginUser,
+                    Qt::QueuedConnection);
+            thread->start();
+            m_workers.append(worker);
+            m_workerThreads.append(thread);
+        }
+    }
+
+    // Prometheus 抓取入口：房间/订阅者/事件循环指标来自注册表，连接与房间总数在控制线程汇总
+    void startMetricsServer(const QHostAddress &address, quint16 port)
+    {
+        MetricsHttpServer *http = new MetricsHttpServer([this]() {
+            QByteArray out;
+            out += "# HELP relay_connections_total WebSocket connections accepted.\n"
+                   "# TYPE relay_connections_total counter\n"
+                   "relay_connections_total " + QByteArray::number(m_totalConnections) + "\n";
+            out += "# HELP relay_login_clients Connected login clients.\n"
+                   "# TYPE relay_login_clients gauge\n"
+                   "relay_login_clients " + QByteArray::number(m_sessions.sessions().size()) + "\n";
+            out += "# HELP relay_worker_rooms Rooms owned by each worker thread.\n"
+                   "# TYPE relay_worker_rooms gauge\n";
+            for (RoomWorker *worker : m_workers) {
+                out += "relay_worker_rooms{worker=\"" + QByteArray::number(worker->index()) + "\"} "
+                     + QByteArray::number(worker->roomCount()) + "\n";
+            }
+            return m_metrics.render(out);
+        }, this);
+        if (http->listen(address, port)) {
+            qDebug() << "监控指标地址: http://" + address.toString() + ":" + QString::number(port) + "/metrics";
+        } else {
+            qDebug() << "监控指标端口监听失败:" << http->errorString();
+        }
+    }
+
+    RoomWorker *workerForRoom(const QString &roomId) const
+    {
+        return m_workers.at(static_cast<int>(qHash(roomId) % static_cast<uint>(m_workers.size())));
+    }
+
+    // 登录信令需要通知推流端时，转到房间所在的工作线程发送
+    void sendToRoomPublisher(const QString &roomId, const QString &message)
+    {
+        RoomWorker *worker = workerForRoom(roomId);
+        QMetaObject::invokeMethod(worker, [worker, roomId, message]() {
+            worker->sendToPublisher(roomId, message);
+        }, Qt::QueuedConnection);
+    }
     
-    // 广播在线用户列表
-    void broadcastOnlineUsersList()
+    // 在线用户列表：变更按版本号发增量（join / leave / update），合并窗口内同一用户的多次变更合并为一条。
+    // 变更前先调用 noteUserChange 记下该用户在窗口开始时的状态，窗口结束时与当前状态比较：
+    // 上线 → joined，下线 → left，名字或头像变化 → updated，其余（如重连、登录又登出）不发。
+    // 声明了 user_list_deltas 的客户端只收增量，版本不连续时发 online_users_sync 取完整列表；
+    // 旧客户端仍在每个窗口收到一次完整列表（online_users_update）。增量可重复应用，
+    // 完整列表发出后紧跟的增量可能已包含在列表里。
+    void noteUserChange(const QString &userId)
+    {
+        noteUserChange(userId, m_sessions.user(userId));
+    }
+
+    // before 为变更前该用户的在线会话（不在线为 nullptr）
+    void noteUserChange(const QString &userId, const LoginSession *before)
+    {
+        if (!m_pendingUserChanges.contains(userId)) {
+            PendingUserChange change;
+            if (before) {
+                change.wasOnline = true;
+                change.name = before->userName;
+                change.iconId = before->iconId;
+            }
+            m_pendingUserChanges.insert(userId, change);
+        }
+        if (!m_userListFlushTimer->isActive()) {
+            m_userListFlushTimer->start(kUserListCoalesceMs);
+        }
+    }
+
+    static QJsonObject userJson(const LoginSession *session)
+    {
+        QJsonObject userObj;
+        userObj["id"] = session->userId;
+        userObj["name"] = session->userName;
+        userObj["icon_id"] = session->iconId;
+        return userObj;
+    }
+
+    QString onlineUsersSnapshot() const
     {
-        QJsonObject broadcast;
-        broadcast["type"] = "online_users_update";
-        
         QJsonArray usersArray;
-        for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-            QPair<QString, QString> userInfo = it.value();
-            QJsonObject userObj;
-            userObj["id"] = userInfo.first;
-            userObj["name"] = userInfo.second;
-            userObj["icon_id"] = m_userIcons.value(userInfo.first, 3);
-            usersArray.append(userObj);
-        }
-        broadcast["data"] = usersArray;
-        
-        QJsonDocument doc(broadcast);
-        QString message = doc.toJson(QJsonDocument::Compact);
-        
-        // 发送给所有登录客户端
-        for (QWebSocket *client : m_loginClients) {
-            if (client->state() == QAbstractSocket::ConnectedState) {
-                client->sendTextMessage(message);
+        for (const LoginSession *session : m_sessions.users()) {
+            usersArray.append(userJson(session));
+        }
+        QJsonObject snapshot;
+        snapshot["type"] = "online_users_update";
+        snapshot["version"] = static_cast<qint64>(m_usersVersion);
+        snapshot["data"] = usersArray;
+        return QJsonDocument(snapshot).toJson(QJsonDocument::Compact);
+    }
+
+    void sendOnlineUsersSnapshot(QWebSocket *socket)
+    {
+        if (socket->state() == QAbstractSocket::ConnectedState) {
+            socket->sendTextMessage(onlineUsersSnapshot());
+        }
+    }
+
+    // 合并窗口结束：生成一个版本的增量并发出
+    void broadcastOnlineUsersChanges()
+    {
+        QJsonArray joined;
+        QJsonArray left;
+        QJsonArray updated;
+        for (auto it = m_pendingUserChanges.cbegin(); it != m_pendingUserChanges.cend(); ++it) {
+            const PendingUserChange &before = it.value();
+            const LoginSession *now = m_sessions.user(it.key());
+            if (now && !before.wasOnline) {
+                joined.append(userJson(now));
+            } else if (!now && before.wasOnline) {
+                left.append(it.key());
+            } else if (now && (now->userName != before.name || now->iconId != before.iconId)) {
+                updated.append(userJson(now));
+            }
+        }
+        m_pendingUserChanges.clear();
+        if (joined.isEmpty() && left.isEmpty() && updated.isEmpty()) {
+            return;
+        }
+
+        ++m_usersVersion;
+        QJsonObject delta;
+        delta["type"] = "online_users_delta";
+        delta["version"] = static_cast<qint64>(m_usersVersion);
+        delta["base"] = static_cast<qint64>(m_usersVersion - 1);
+        delta["joined"] = joined;
+        delta["left"] = left;
+        delta["updated"] = updated;
+        const QString deltaMessage = QJsonDocument(delta).toJson(QJsonDocument::Compact);
+        QString snapshotMessage;   // 只有存在旧客户端时才生成
+
+        int deltaClients = 0;
+        int snapshotClients = 0;
+        for (const LoginSession *session : m_sessions.sessions()) {
+            if (session->socket->state() != QAbstractSocket::ConnectedState) {
+                continue;
+            }
+            if (session->deltaUpdates) {
+                session->socket->sendTextMessage(deltaMessage);
+                ++deltaClients;
+            } else {
+                if (snapshotMessage.isEmpty()) {
+                    snapshotMessage = onlineUsersSnapshot();
+                }
+                session->socket->sendTextMessage(snapshotMessage);
+                ++snapshotClients;
             }
         }
         
         qDebug() << QDateTime::currentDateTime().toString()
-                 << "广播在线用户列表给" << m_loginClients.size() << "个登录客户端，用户数:" << usersArray.size();
+                 << "在线列表版本" << m_usersVersion << "上线:" << joined.size() << "下线:" << left.size()
+                 << "更新:" << updated.size() << "增量发给" << deltaClients << "个客户端，完整列表发给"
+                 << snapshotClients << "个客户端，在线用户数:" << m_sessions.users().size();
     }
 
     void checkHeartbeatTimeouts()
     {
-        qint64 now = QDateTime::currentMSecsSinceEpoch();
-        QList<QString> toRemove;
-        for (auto it = m_userLastHeartbeat.begin(); it != m_userLastHeartbeat.end(); ++it) {
-            if (it.value() > 0 && now - it.value() > 15000) {
-                toRemove.append(it.key());
+        // 超时用户先从在线列表摘除并计入变更，连接关闭后的断开处理不会重复产生变更
+        const QList<LoginSession*> expired = m_sessions.expire(QDateTime::currentMSecsSinceEpoch(), 15000);
+        QList<QWebSocket*> sockets;
+        for (const LoginSession *session : expired) {
+            noteUserChange(session->userId, session);
+            sockets.append(session->socket);
+        }
+        for (QWebSocket *sock : sockets) {
+            sock->close();
+        }
+    }
+};
+
+// 文本消息分类微基准（--bench-routing N）：单线程对典型房间消息混合（音频、鼠标、观看端光标/标注、
+// 少量信令）比较旧路径（每条完整 JSON 解析，通用转发再解析一次）与快速分类路径的每核消息吞吐。
+// 只测分类开销，不含 socket 发送。
+static int runRoutingBenchmark(int iterations)
+{
+    const QString opus = QString::fromLatin1(QByteArray(120, 'x').toBase64());
+    const QStringList corpus = {
+        QStringLiteral("{\"channels\":1,\"data_base64\":\"%1\",\"frame_samples\":960,\"sample_rate\":48000,\"seq\":1234,\"timestamp\":1735000000000000,\"type\":\"audio_opus\"}").arg(opus),
+        QStringLiteral("{\"channels\":1,\"data_base64\":\"%1\",\"frame_samples\":960,\"sample_rate\":48000,\"target_id\":\"100001\",\"timestamp\":1735000000000,\"type\":\"viewer_audio_opus\",\"viewer_id\":\"100002\"}").arg(opus),
+        QStringLiteral("{\"name\":\"张三\",\"timestamp\":1735000000000000,\"type\":\"mouse_position\",\"x\":812,\"y\":433}"),
+        QStringLiteral("{\"frame_h\":1080,\"frame_w\":1920,\"target_id\":\"100001\",\"timestamp\":1735000000000,\"type\":\"viewer_cursor\",\"viewer_id\":\"100002\",\"viewer_name\":\"李四\",\"x\":640,\"y\":360}"),
+        QStringLiteral("{\"color_id\":2,\"frame_h\":1080,\"frame_w\":1920,\"phase\":\"move\",\"target_id\":\"100001\",\"timestamp\":1735000000000,\"type\":\"annotation_event\",\"viewer_id\":\"100002\",\"x\":100,\"y\":200}"),
+        QStringLiteral("{\"stream\":1,\"type\":\"select_stream\",\"viewer_id\":\"100002\"}"),
+    };
+    // 权重：音频与鼠标占绝大多数，信令极少
+    const int weights[] = {40, 20, 30, 5, 4, 1};
+    QVector<const QString *> mix;
+    for (int k = 0; k < corpus.size(); ++k) {
+        for (int w = 0; w < weights[k]; ++w) mix.append(&corpus[k]);
+    }
+
+    int sink = 0;
+    auto legacy = [&](const QString &message) {
+        // 旧实现：特定类型处理前解析一次，通用转发前再解析一次
+        QJsonObject obj = QJsonDocument::fromJson(message.toUtf8()).object();
+        const QString type = obj["type"].toString();
+        if (type == "mouse_position" || type == "audio_opus") {
+            sink += type.size();
+            return;
+        }
+        const QString t = QJsonDocument::fromJson(message.toUtf8()).object().value("type").toString();
+        sink += t.size();
+    };
+    auto fast = [&](const QString &message) {
+        const QStringView type = sniffMessageType(message);
+        if (isRoomSignalling(type)) {
+            sink += QJsonDocument::fromJson(message.toUtf8()).object().size();
+        }
+        sink += type.size();
+    };
+
+    auto measure = [&](const char *name, const std::function<void(const QString &)> &fn) {
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 total = qint64(iterations) * mix.size();
+        for (int it = 0; it < iterations; ++it) {
+            for (const QString *m : mix) fn(*m);
+        }
+        const double sec = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+        qInfo().noquote() << QStringLiteral("%1: %2 msgs in %3 ms, %4 msgs/s/core")
+                                 .arg(QLatin1String(name)).arg(total)
+                                 .arg(sec * 1000.0, 0, 'f', 1)
+                                 .arg(total / sec, 0, 'f', 0);
+        return total / sec;
+    };
+
+    // 先确认两种分类结果一致
+    for (const QString &m : corpus) {
+        const QString parsed = QJsonDocument::fromJson(m.toUtf8()).object().value("type").toString();
+        if (sniffMessageType(m) != parsed) {
+            qWarning() << "快速分类结果与 JSON 解析不一致:" << m.left(80);
+            return 1;
+        }
+    }
+    const double before = measure("legacy_parse", legacy);
+    const double after = measure("fast_sniff", fast);
+    qInfo().noquote() << QStringLiteral("speedup: %1x (sink=%2)").arg(after / before, 0, 'f', 1).arg(sink);
+    return 0;
+}
+
+// 登录会话注册表扩展性基准（--bench-sessions N，如 10000）：在 1000 / 5000 / N 个在线用户下比较
+// 旧结构（QMap<socket, (userId, name)> 按 userId 线性查找，心跳检查逐个超时用户再扫描一遍）与 SessionRegistry：
+// 按 userId 查找登录连接（信令转发、viewer_exit 回传）、心跳刷新、1% 用户超时的心跳检查、登录/登出。
+// socket 指针只作为键，不解引用。
+static int runSessionBenchmark(int maxUsers)
+{
+    using LegacyUsers = QMap<QWebSocket*, QPair<QString, QString>>;
+    const auto fakeSocket = [](int i) { return reinterpret_cast<QWebSocket*>(quintptr(0x10000) + quintptr(i) * 64); };
+    const auto userId = [](int i) { return QString::number(100000 + i); };
+    const qint64 now = 1000000;
+    const int lookups = 20000;
+    quint64 sink = 0;
+
+    QVector<int> sizes = {1000, 5000, maxUsers};
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    for (int n : sizes) {
+        LegacyUsers legacyUsers;
+        QMap<QString, int> legacyIcons;
+        QMap<QString, qint64> legacyHeartbeat;
+        SessionRegistry registry;
+        for (int i = 0; i < n; ++i) {
+            legacyUsers[fakeSocket(i)] = qMakePair(userId(i), QStringLiteral("user%1").arg(i));
+            legacyIcons[userId(i)] = 3 + i % 19;
+            legacyHeartbeat[userId(i)] = now;
+            registry.login(fakeSocket(i), userId(i), QStringLiteral("user%1").arg(i), 3 + i % 19, now);
+        }
+        QVector<QString> keys;
+        for (int k = 0; k < lookups; ++k) keys.append(userId(int((quint64(k) * 2654435761u) % quint64(n))));
+
+        QElapsedTimer timer;
+        // 按 userId 查找登录连接
+        timer.start();
+        for (const QString &id : keys) {
+            for (auto it = legacyUsers.begin(); it != legacyUsers.end(); ++it) {
+                if (it.value().first == id) { sink += quintptr(it.key()); break; }
             }
         }
-        for (const QString &uid : toRemove) {
-            QWebSocket *sock = nullptr;
-            for (auto it = m_loginUsers.begin(); it != m_loginUsers.end(); ++it) {
-                if (it.value().first == uid) { sock = it.key(); break; }
+        const double legacyLookupNs = double(timer.nsecsElapsed()) / lookups;
+        timer.restart();
+        for (const QString &id : keys) sink += quintptr(registry.socketOf(id));
+        const double indexedLookupNs = double(timer.nsecsElapsed()) / lookups;
+
+        // 心跳刷新
+        timer.restart();
+        for (const QString &id : keys) legacyHeartbeat[id] = now + 1;
+        const double legacyTouchNs = double(timer.nsecsElapsed()) / lookups;
+        timer.restart();
+        for (const QString &id : keys) sink += registry.touch(id, now + 1);
+        const double indexedTouchNs = double(timer.nsecsElapsed()) / lookups;
+
+        // 心跳检查：每 100 个用户有 1 个超时
+        for (int i = 0; i < n; i += 100) {
+            legacyHeartbeat[userId(i)] = now - 20000;
+            registry.user(userId(i))->lastHeartbeatMs = now - 20000;
+        }
+        timer.restart();
+        {
+            QList<QString> toRemove;
+            for (auto it = legacyHeartbeat.begin(); it != legacyHeartbeat.end(); ++it) {
+                if (it.value() > 0 && now - it.value() > 15000) toRemove.append(it.key());
             }
-            if (sock) {
-                m_loginUsers.remove(sock);
-                sock->close();
+            for (const QString &uid : toRemove) {
+                QWebSocket *sock = nullptr;
+                for (auto it = legacyUsers.begin(); it != legacyUsers.end(); ++it) {
+                    if (it.value().first == uid) { sock = it.key(); break; }
+                }
+                if (sock) legacyUsers.remove(sock);
+                legacyIcons.remove(uid);
+                legacyHeartbeat.remove(uid);
             }
-            m_userIcons.remove(uid);
-            m_userLastHeartbeat.remove(uid);
+            sink += toRemove.size();
+        }
+        const double legacySweepMs = timer.nsecsElapsed() / 1e6;
+        timer.restart();
+        const QList<LoginSession*> expired = registry.expire(now, 15000);
+        sink += expired.size();
+        for (LoginSession *session : expired) registry.remove(session->socket);
+        const double indexedSweepMs = timer.nsecsElapsed() / 1e6;
+
+        // 登录/登出（新连接登录后立即断开）
+        timer.restart();
+        for (int k = 0; k < lookups; ++k) {
+            QWebSocket *sock = fakeSocket(n + k);
+            const QString id = userId(n + k);
+            legacyUsers[sock] = qMakePair(id, id);
+            legacyIcons[id] = 3;
+            legacyHeartbeat[id] = now;
+            legacyUsers.remove(sock);
+            legacyIcons.remove(id);
+            legacyHeartbeat.remove(id);
         }
-        if (!toRemove.isEmpty()) {
-            broadcastOnlineUsersList();
+        const double legacyChurnNs = double(timer.nsecsElapsed()) / lookups;
+        timer.restart();
+        for (int k = 0; k < lookups; ++k) {
+            QWebSocket *sock = fakeSocket(n + k);
+            const QString id = userId(n + k);
+            registry.login(sock, id, id, 3, now);
+            sink += registry.remove(sock);
         }
+        const double indexedChurnNs = double(timer.nsecsElapsed()) / lookups;
+
+        qInfo().noquote() << QStringLiteral("users=%1 lookup: %2 -> %3 ns, heartbeat: %4 -> %5 ns, "
+                                            "sweep(1% expired): %6 -> %7 ms, login+logout: %8 -> %9 ns")
+                                 .arg(n)
+                                 .arg(legacyLookupNs, 0, 'f', 0).arg(indexedLookupNs, 0, 'f', 0)
+                                 .arg(legacyTouchNs, 0, 'f', 0).arg(indexedTouchNs, 0, 'f', 0)
+                                 .arg(legacySweepMs, 0, 'f', 2).arg(indexedSweepMs, 0, 'f', 2)
+                                 .arg(legacyChurnNs, 0, 'f', 0).arg(indexedChurnNs, 0, 'f', 0);
     }
-};
+    qInfo().noquote() << QStringLiteral("(sink=%1)").arg(sink);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -898,12 +2416,39 @@ int main(int argc, char *argv[])
     QCommandLineOption portOption(QStringList() << "p" << "port",
                                   "监听端口 (默认: 8765)", "port", "8765");
     parser.addOption(portOption);
+
+    QCommandLineOption workersOption(QStringList() << "w" << "workers",
+                                     "房间工作线程数 (默认: 0，按CPU核数)", "count", "0");
+    parser.addOption(workersOption);
     
     QCommandLineOption daemonOption(QStringList() << "d" << "daemon",
                                     "以守护进程模式运行");
     parser.addOption(daemonOption);
+
+    QCommandLineOption metricsPortOption(QStringList() << "metrics-port",
+                                         "Prometheus 指标端口，GET /metrics (默认: 9102，0 为关闭)", "port", "9102");
+    parser.addOption(metricsPortOption);
+
+    QCommandLineOption metricsBindOption(QStringList() << "metrics-bind",
+                                         "指标端口监听地址 (默认: 127.0.0.1，仅本机抓取)", "address", "127.0.0.1");
+    parser.addOption(metricsBindOption);
+
+    QCommandLineOption benchRoutingOption(QStringList() << "bench-routing",
+                                          "运行文本消息分类微基准后退出（参数为轮数）", "rounds");
+    parser.addOption(benchRoutingOption);
+
+    QCommandLineOption benchSessionsOption(QStringList() << "bench-sessions",
+                                           "运行登录会话注册表扩展性基准后退出（参数为最大在线用户数）", "users");
+    parser.addOption(benchSessionsOption);
     
     parser.process(app);
+
+    if (parser.isSet(benchRoutingOption)) {
+        return runRoutingBenchmark(qMax(1, parser.value(benchRoutingOption).toInt()));
+    }
+    if (parser.isSet(benchSessionsOption)) {
+        return runSessionBenchmark(qMax(100, parser.value(benchSessionsOption).toInt()));
+    }
     
     int port = parser.value(portOption).toInt();
     if (port <= 0 || port > 65535) {
@@ -921,7 +2466,20 @@ int main(int argc, char *argv[])
         qDebug() << "以守护进程模式运行";
     }
     
-    WebSocketServerApp serverApp(port);
+    int workers = parser.value(workersOption).toInt();
+    if (workers <= 0) {
+        workers = qMax(1, QThread::idealThreadCount());
+    }
+    qDebug() << "房间工作线程数:" << workers;
+    
+    const int metricsPort = parser.value(metricsPortOption).toInt();
+    const QHostAddress metricsAddress(parser.value(metricsBindOption));
+    if (metricsPort < 0 || metricsPort > 65535 || metricsAddress.isNull()) {
+        qDebug() << "错误：无效的指标端口或监听地址";
+        return 1;
+    }
+
+    WebSocketServerApp serverApp(port, workers, static_cast<quint16>(metricsPort), metricsAddress);
     
     // 优雅关闭处理
     QObject::connect(&app, &QCoreApplication::aboutToQuit, [&]() {
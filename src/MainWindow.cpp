@@ -1957,6 +1957,8 @@ void MainWindow::sendLoginRequest()
     // 同步发送两种字段，兼容服务器不同实现
     userData["icon_id"] = loadOrGenerateIconId();
     userData["viewer_icon_id"] = loadOrGenerateIconId();
+    // 在线列表只收增量（online_users_delta），服务器不支持时仍发完整列表
+    userData["user_list_deltas"] = true;
     loginRequest["data"] = userData;
     
     QJsonDocument doc(loginRequest);
@@ -2145,6 +2147,111 @@ void MainWindow::updateUserList(const QJsonArray& users)
     }
 }
 
+static int parseUserIconId(const QJsonObject &userObj)
+{
+    const QJsonValue v = userObj.contains("icon_id") ? userObj.value("icon_id") : userObj.value("viewer_icon_id");
+    if (v.isUndefined()) return -1;
+    return v.isString() ? v.toString().toInt() : v.toInt(-1);
+}
+
+// 在线列表增量：只处理变化的用户，不重建列表。版本须紧接本地版本，
+// 否则（漏收或尚未收到完整列表）丢弃并请求完整列表；已包含在完整列表中的旧增量直接忽略
+void MainWindow::applyUserListDelta(const QJsonObject& delta)
+{
+    const qint64 version = static_cast<qint64>(delta.value("version").toDouble(-1));
+    const qint64 base = static_cast<qint64>(delta.value("base").toDouble(-1));
+    if (m_onlineUsersVersion >= 0 && version <= m_onlineUsersVersion) {
+        return;
+    }
+    if (m_onlineUsersVersion < 0 || base != m_onlineUsersVersion) {
+        if (!m_onlineUsersSyncRequested && m_loginWebSocket
+            && m_loginWebSocket->state() == QAbstractSocket::ConnectedState) {
+            QJsonObject sync;
+            sync["type"] = "online_users_sync";
+            m_loginWebSocket->sendTextMessage(QJsonDocument(sync).toJson(QJsonDocument::Compact));
+            m_onlineUsersSyncRequested = true;
+        }
+        return;
+    }
+    m_onlineUsersVersion = version;
+
+    const QJsonArray joined = delta.value("joined").toArray();
+    const QJsonArray left = delta.value("left").toArray();
+    const QJsonArray updated = delta.value("updated").toArray();
+    const bool shouldToast = loadOnlineNotificationEnabledFromConfig() && m_userListInitialized;
+
+    auto findItem = [this](const QString &uid) -> QListWidgetItem* {
+        for (int i = 0; i < m_listWidget->count(); ++i) {
+            QListWidgetItem *item = m_listWidget->item(i);
+            if (item && item->data(Qt::UserRole).toString() == uid) return item;
+        }
+        return nullptr;
+    };
+
+    for (const QJsonValue &v : left) {
+        const QString uid = v.toString();
+        if (uid.isEmpty() || !m_serverOnlineUsers.remove(uid)) continue;
+        QListWidgetItem *item = findItem(uid);
+        if (shouldToast && uid != m_userId) {
+            QString name = item ? item->text() : QString();
+            const int idx = name.lastIndexOf(" (");
+            if (idx != -1) name = name.left(idx);
+            showUserOfflineToast(uid, name, -1);
+        }
+        if (item) {
+            delete m_listWidget->takeItem(m_listWidget->row(item));
+        }
+    }
+
+    QJsonArray changed = joined;
+    for (const QJsonValue &v : updated) changed.append(v);
+    for (const QJsonValue &v : changed) {
+        const QJsonObject userObj = v.toObject();
+        const QString uid = userObj.value("id").toString();
+        if (uid.isEmpty()) continue;
+        const QString userName = userObj.value("name").toString();
+        if (!m_serverOnlineUsers.contains(uid)) {
+            m_serverOnlineUsers.insert(uid);
+            if (shouldToast && uid != m_userId) {
+                showUserOnlineToast(uid, userName, parseUserIconId(userObj));
+            }
+        }
+        const QString displayText = QString("%1 (%2)").arg(userName).arg(uid);
+        if (QListWidgetItem *item = findItem(uid)) {
+            if (item->text() != displayText) item->setText(displayText);
+        } else {
+            QListWidgetItem *newItem = new QListWidgetItem(displayText);
+            newItem->setData(Qt::UserRole, uid);
+            m_listWidget->addItem(newItem);
+        }
+    }
+
+    // 提示项（无 UserRole）只在没有真实用户时显示
+    for (int j = m_listWidget->count() - 1; j >= 0; --j) {
+        if (m_listWidget->item(j)->data(Qt::UserRole).toString().isEmpty() && !m_serverOnlineUsers.isEmpty()) {
+            delete m_listWidget->takeItem(j);
+        }
+    }
+    if (m_listWidget->count() == 0 && m_serverOnlineUsers.isEmpty()) {
+        m_listWidget->addItem("暂无在线用户");
+    }
+
+    if (m_transparentImageList) {
+        m_transparentImageList->applyUserListDelta(joined, left, updated);
+    }
+
+    // 目标用户上下线
+    if (!m_currentTargetId.isEmpty() && m_videoWindow) {
+        if (auto *videoWidget = m_videoWindow->getVideoDisplayWidget()) {
+            if (!m_serverOnlineUsers.contains(m_currentTargetId)) {
+                videoWidget->notifyTargetOffline(QStringLiteral("对方已离线或退出"));
+            } else {
+                videoWidget->clearOfflineReminder();
+            }
+        }
+    }
+}
+
 static QPixmap buildSquarePixmapForToast(const QPixmap &src, int size)
 {
     const int s = qMax(8, size);
@@ -2367,6 +2474,8 @@ void MainWindow::onLoginWebSocketDisconnected()
     // 因为相对我而言，所有人都“掉线”了
     m_serverOnlineUsers.clear();
     m_userListInitialized = false;
+    m_onlineUsersVersion = -1;
+    m_onlineUsersSyncRequested = false;
     m_transparentImageList->clearUserList();
     const QList<QWidget*> toasts = m_onlineToasts;
     for (QWidget *toast : toasts) {
@@ -2425,6 +2534,9 @@ void MainWindow::onLoginWebSocketTextMessageReceived(const QString &message)
         }
         
         QJsonArray users = dataValue.toArray();
+        // 完整列表对应的版本；旧服务器不带版本号，后续也不会收到增量
+        m_onlineUsersVersion = obj.contains("version") ? static_cast<qint64>(obj.value("version").toDouble()) : -1;
+        m_onlineUsersSyncRequested = false;
         
         // 详细记录每个用户信息
         for (int i = 0; i < users.size(); ++i) {
@@ -2440,6 +2552,8 @@ void MainWindow::onLoginWebSocketTextMessageReceived(const QString &message)
         }
         updateUserList(users);
         if (!m_appReadyEmitted) { emit appReady(); m_appReadyEmitted = true; }
+    } else if (type == "online_users_delta") {
+        applyUserListDelta(obj);
     } else if (type == "start_streaming_request") {
         QString viewerId = obj["viewer_id"].toString();
         QString targetId = obj["target_id"].toString();
@@ -148,6 +148,7 @@ private:
     void sendLoginRequest();
     void sendHeartbeat();
     void updateUserList(const QJsonArray& users);
+    void applyUserListDelta(const QJsonObject& delta);
     void sendWatchRequest(const QString& targetDeviceId);
     void startVideoReceiving(const QString& targetDeviceId);
     void startPlayerProcess(const QString& targetDeviceId);  // 启动播放进程
@@ -224,6 +225,8 @@ private:
     // 在线用户蓄水池
     QSet<QString> m_serverOnlineUsers;
     bool m_userListInitialized = false;
+    qint64 m_onlineUsersVersion = -1;      // 本地在线列表对应的服务器版本，-1 为未知
+    bool m_onlineUsersSyncRequested = false;
     QList<QWidget*> m_onlineToasts;
     QTimer *m_userCleanupTimer;
     QTimer *m_reconnectTimer; // 统一的重连定时器
@@ -966,6 +966,7 @@ void NewUiWindow::updateListWidget(const QJsonArray &users)
 
         // Remove label reference
         m_userLabels.remove(id);
+        m_userNameLabels.remove(id);
         m_talkButtons.remove(id);
         m_talkOverlays.remove(id);
         m_talkSpinnerAngles.remove(id);
@@ -1170,6 +1171,7 @@ void NewUiWindow::updateListWidget(const QJsonArray &users)
         // --- Track & Subscribe ---
         m_userItems.insert(id, item);
         m_userLabels.insert(id, imgLabel);
+        m_userNameLabels.insert(id, txtLabel);
 
         // Create Client
         StreamClient *client = new StreamClient(this);
@@ -3861,6 +3863,7 @@ void NewUiWindow::addUser(const QString &userId, const QString &userName, int ic
     m_userItems.insert(userId, item);
     m_userLabels.insert(userId, imgLabel);
     m_userAvatarLabels.insert(userId, avatarLabel);
+    m_userNameLabels.insert(userId, txtLabel);
 
     // Start Stream Subscription
     StreamClient *client = new StreamClient(this);
@@ -3947,6 +3950,7 @@ void NewUiWindow::removeUser(const QString &userId)
 
     m_userLabels.remove(userId);
     m_userAvatarLabels.remove(userId);
+    m_userNameLabels.remove(userId);
 
     if (m_avatarSubscribers.contains(userId)) {
         StreamClient *client = m_avatarSubscribers.take(userId);
@@ -4135,6 +4139,37 @@ void NewUiWindow::updateUserAvatar(const QString &userId, int iconId)
     }
 }
 
+void NewUiWindow::updateUserName(const QString &userId, const QString &userName)
+{
+    QLabel *label = m_userNameLabels.value(userId, nullptr);
+    const QString displayName = userName.isEmpty() ? userId : userName;
+    if (label && label->text() != displayName) {
+        label->setText(displayName);
+    }
+}
+
+void NewUiWindow::applyUserListDelta(const QJsonArray &joined, const QJsonArray &left, const QJsonArray &updated)
+{
+    for (const QJsonValue &v : left) {
+        removeUser(v.toString());
+    }
+    for (const QJsonValue &v : joined) {
+        const QJsonObject user = v.toObject();
+        addUser(user.value("id").toString(), user.value("name").toString(), user.value("icon_id").toInt(-1));
+    }
+    // Existing cards keep their stream subscription; only the name and avatar change
+    for (const QJsonValue &v : updated) {
+        const QJsonObject user = v.toObject();
+        const QString id = user.value("id").toString();
+        if (!m_userItems.contains(id)) {
+            addUser(id, user.value("name").toString(), user.value("icon_id").toInt(-1));
+            continue;
+        }
+        updateUserName(id, user.value("name").toString());
+        updateUserAvatar(id, user.value("icon_id").toInt(-1));
+    }
+}
+
 QString NewUiWindow::getCurrentUserId() const
 {
     return m_myStreamId;
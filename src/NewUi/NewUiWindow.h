@@ -65,6 +65,9 @@ public:
     void removeUser(const QString &userId);
     void clearUserList();
     void updateUserAvatar(const QString &userId, int iconId);
+    void updateUserName(const QString &userId, const QString &userName);
+    // Apply an online_users_delta: only the listed users are added, removed or updated
+    void applyUserListDelta(const QJsonArray &joined, const QJsonArray &left, const QJsonArray &updated);
     void restartUserStreamSubscription(const QString &userId);
     void onVideoReceivingStopped(const QString &targetId);
     QString getCurrentUserId() const; // Returns the local user ID
@@ -164,6 +167,7 @@ private:
     QMap<QString, QListWidgetItem*> m_userItems;  // userId -> ListWidgetItem
     QMap<QString, QLabel*> m_userLabels;          // userId -> Image Label (for updating frame)
     QMap<QString, QLabel*> m_userAvatarLabels;    // userId -> Avatar Label (top-left overlay)
+    QMap<QString, QLabel*> m_userNameLabels;      // userId -> Name Label (bottom bar)
     QMap<QString, QPushButton*> m_talkButtons;    // userId -> Talk Button (end/get)
     QMap<QString, QLabel*> m_talkOverlays;        // userId -> "通话中" overlay label
     QTimer *m_talkSpinnerTimer = nullptr;
@@ -6,6 +6,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include "../common/AppConfig.h"
+#include "../common/BinaryMessage.h"
 
 static QString wsRoleTagFromUrl(const QUrl &url)
 {
@@ -348,7 +349,8 @@ void StreamClient::sendFrame(const QPixmap &pixmap, bool force)
         return;
     }
 
-    const qint64 sent = m_webSocket->sendBinaryMessage(bytes);
+    // Versioned binary header so relays route it like video without inspecting the payload
+    const qint64 sent = m_webSocket->sendBinaryMessage(BinaryMessage::encodeImage(m_txSeq++, nowMs, bytes));
     if (sent > 0) {
         m_lastSentBytes = bytes;
         m_lastSentAtMs = nowMs;
@@ -554,9 +556,18 @@ void StreamClient::onTextMessageReceived(const QString &message)
     }
 }
 
-void StreamClient::onBinaryMessageReceived(const QByteArray &message)
+void StreamClient::onBinaryMessageReceived(const QByteArray &packet)
 {
-    // Handle received binary data (e.g. video frames from other streams)
+    // Handle received binary data (e.g. video frames from other streams).
+    // Image messages carry the JPEG after the header; older senders send the raw JPEG.
+    const PacketHeader::Info info = PacketHeader::read(packet);
+    QByteArray message = packet;
+    if (BinaryMessage::isMessage(info)) {
+        if (info.type != PacketHeader::MessageType::Image) {
+            return;
+        }
+        message = BinaryMessage::payload(packet, info);
+    }
     if (!m_lastReceivedBytes.isEmpty() && message == m_lastReceivedBytes) {
         const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
         if (nowMs - m_lastRxSkipLogAtMs > 5000) {
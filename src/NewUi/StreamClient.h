@@ -35,7 +35,7 @@ private slots:
     void onConnected();
     void onDisconnected();
     void onTextMessageReceived(const QString &message);
-    void onBinaryMessageReceived(const QByteArray &message);
+    void onBinaryMessageReceived(const QByteArray &packet);
     void onError(QAbstractSocket::SocketError error);
     void attemptReconnect();
 
@@ -53,6 +53,7 @@ private:
     bool m_isConnected;
     QByteArray m_lastSentBytes;
     qint64 m_lastSentAtMs = 0;
+    quint32 m_txSeq = 0;
     QByteArray m_lastReceivedBytes;
     int m_jpegQuality = 30;
     QTimer *m_reconnectTimer = nullptr;
@@ -0,0 +1,206 @@
+#include "AdaptiveBitrateController.h"
+#include <algorithm>
+
+namespace {
+// 拥塞判定阈值
+constexpr int kQueueDepthCongested = 6;          // 发送队列（上限 12）积压过半
+constexpr qint64 kMinBacklogBytes = 64 * 1024;   // socket 未写出字节下限
+constexpr double kMaxBacklogSeconds = 0.5;       // 未写出数据超过 0.5 秒的目标码率即视为拥塞
+constexpr double kLossCongestedPct = 5.0;
+constexpr double kLossHoldPct = 2.0;
+constexpr double kQueueDelayCongestedMs = 250.0;
+constexpr double kQueueDelayHoldMs = 120.0;
+constexpr double kJitterCongestedMs = 80.0;
+constexpr qint64 kReportStaleMs = 6000;          // 观看端每 2 秒上报一次，3 次未到视为失效
+
+// 码率调整
+constexpr double kDecreaseFactor = 0.85;
+constexpr double kThroughputFactor = 0.9;
+constexpr double kIncreaseFactor = 1.05;
+constexpr int kIncreaseStepBps = 10000;
+constexpr qint64 kHoldAfterCongestionMs = 3000;
+constexpr qint64 kLevelUpHoldMs = 5000;          // 降档后至少保持 5 秒才允许升档
+constexpr double kLevelUpMargin = 1.2;           // 升档需超过阈值 20%（滞回）
+
+// 档位：先降帧率，再降分辨率（VP9 内部缩放比例 1, 4/5, 3/5, 1/2）
+const AdaptiveBitrateController::Level kLevels[] = {
+    {1, 1, 66},
+    {1, 1, 100},
+    {4, 5, 100},
+    {3, 5, 125},
+    {1, 2, 200},
+};
+// 目标码率 / 上限 低于该比例时进入对应档位（下标 i 对应进入档位 i+1）
+const double kLevelRatios[] = { 0.6, 0.4, 0.28, 0.2 };
+}
+
+AdaptiveBitrateController::AdaptiveBitrateController()
+    : m_minBitrate(80000)
+    , m_maxBitrate(400000)
+    , m_targetBitrate(400000)
+{
+}
+
+int AdaptiveBitrateController::levelCount()
+{
+    return static_cast<int>(sizeof(kLevels) / sizeof(kLevels[0]));
+}
+
+AdaptiveBitrateController::Level AdaptiveBitrateController::levelAt(int level)
+{
+    level = std::max(0, std::min(level, levelCount() - 1));
+    return kLevels[level];
+}
+
+void AdaptiveBitrateController::setBitrateRange(int minBps, int maxBps)
+{
+    m_maxBitrate = std::max(1, maxBps);
+    m_minBitrate = std::max(1, std::min(minBps, m_maxBitrate));
+    m_targetBitrate = std::max(m_minBitrate, std::min(m_targetBitrate, m_maxBitrate));
+}
+
+void AdaptiveBitrateController::reset(qint64 nowMs)
+{
+    m_targetBitrate = m_maxBitrate;
+    m_level = 0;
+    m_holdIncreaseUntilMs = 0;
+    m_levelChangedAtMs = nowMs;
+    m_links.clear();
+    m_reports.clear();
+}
+
+void AdaptiveBitrateController::onReceiverReport(const QString &viewerId, double jitterMs, double lossPct,
+                                                 double queueDelayMs, qint64 nowMs)
+{
+    ReceiverReport &r = m_reports[viewerId];
+    r.jitterMs = std::max(0.0, jitterMs);
+    r.lossPct = std::max(0.0, lossPct);
+    r.queueDelayMs = std::max(0.0, queueDelayMs);
+    r.receivedAtMs = nowMs;
+}
+
+void AdaptiveBitrateController::removeViewer(const QString &viewerId)
+{
+    m_reports.remove(viewerId);
+}
+
+int AdaptiveBitrateController::levelForBitrate(int bitrate) const
+{
+    const double ratio = static_cast<double>(bitrate) / m_maxBitrate;
+    int level = 0;
+    for (double threshold : kLevelRatios) {
+        if (ratio >= threshold) break;
+        ++level;
+    }
+    return level;
+}
+
+AdaptiveBitrateController::Decision AdaptiveBitrateController::makeDecision(bool congested, bool levelChanged) const
+{
+    const Level &lv = kLevels[m_level];
+    Decision d;
+    d.bitrate = m_targetBitrate;
+    d.level = m_level;
+    d.captureIntervalMs = lv.intervalMs;
+    d.scaleNum = lv.scaleNum;
+    d.scaleDen = lv.scaleDen;
+    d.congested = congested;
+    d.levelChanged = levelChanged;
+    return d;
+}
+
+AdaptiveBitrateController::Decision AdaptiveBitrateController::update(const QVector<SenderSample> &samples, qint64 nowMs)
+{
+    bool congested = false;
+    bool hold = false;
+    qint64 minThroughputBps = -1;
+
+    // 发送端：对比上一次快照得到丢帧增量与实际写出速率
+    QHash<int, LinkState> links;
+    for (const SenderSample &s : samples) {
+        LinkState cur;
+        cur.droppedByAge = s.droppedByAge;
+        cur.droppedByQueue = s.droppedByQueue;
+        cur.bytesToWrite = s.bytesToWrite;
+        cur.bytesSent = s.bytesSent;
+        cur.sampleMs = nowMs;
+        links.insert(s.linkId, cur);
+
+        if (s.queueDepth >= kQueueDepthCongested) {
+            congested = true;
+        }
+        const qint64 backlogLimit = std::max<qint64>(kMinBacklogBytes,
+            static_cast<qint64>(m_targetBitrate / 8.0 * kMaxBacklogSeconds));
+        if (s.bytesToWrite > backlogLimit) {
+            congested = true;
+        }
+
+        auto it = m_links.constFind(s.linkId);
+        if (it == m_links.constEnd()) {
+            hold = true; // 新链路首个周期没有增量，先不升码率
+            continue;
+        }
+        const LinkState &prev = it.value();
+        const qint64 dt = nowMs - prev.sampleMs;
+        if (dt <= 0) {
+            continue;
+        }
+        const qint64 drops = std::max<qint64>(0, s.droppedByAge - prev.droppedByAge)
+                           + std::max<qint64>(0, s.droppedByQueue - prev.droppedByQueue);
+        if (drops > 0) {
+            congested = true;
+        }
+        // 交给 socket 的字节减去仍积压在 socket 缓冲中的增量 = 实际写出的字节
+        const qint64 written = (s.bytesSent - prev.bytesSent) - (s.bytesToWrite - prev.bytesToWrite);
+        if (written > 0) {
+            const qint64 bps = written * 8 * 1000 / dt;
+            minThroughputBps = (minThroughputBps < 0) ? bps : std::min(minThroughputBps, bps);
+        }
+    }
+    m_links = links; // 已停止推流的链路随之移除
+
+    // 接收端：丢弃超时的上报，取最差观看端
+    for (auto it = m_reports.begin(); it != m_reports.end();) {
+        if (nowMs - it.value().receivedAtMs > kReportStaleMs) {
+            it = m_reports.erase(it);
+            continue;
+        }
+        const ReceiverReport &r = it.value();
+        if (r.lossPct > kLossCongestedPct || r.queueDelayMs > kQueueDelayCongestedMs
+            || r.jitterMs > kJitterCongestedMs) {
+            congested = true;
+        } else if (r.lossPct > kLossHoldPct || r.queueDelayMs > kQueueDelayHoldMs) {
+            hold = true;
+        }
+        ++it;
+    }
+
+    if (congested) {
+        double next = m_targetBitrate * kDecreaseFactor;
+        if (minThroughputBps > 0) {
+            // 不低于当前目标的一半，避免静态画面（发送量本就很小）时被实测吞吐拉到谷底
+            next = std::min(next, std::max(minThroughputBps * kThroughputFactor, m_targetBitrate * 0.5));
+        }
+        m_targetBitrate = std::max(m_minBitrate, static_cast<int>(next));
+        m_holdIncreaseUntilMs = nowMs + kHoldAfterCongestionMs;
+    } else if (!hold && nowMs >= m_holdIncreaseUntilMs) {
+        const double next = m_targetBitrate * kIncreaseFactor + kIncreaseStepBps;
+        m_targetBitrate = std::min(m_maxBitrate, static_cast<int>(next));
+    }
+
+    // 档位：降档立即生效；升档需要保持时间与码率余量，每次只升一档
+    bool levelChanged = false;
+    const int desired = levelForBitrate(m_targetBitrate);
+    if (desired > m_level) {
+        m_level = desired;
+        m_levelChangedAtMs = nowMs;
+        levelChanged = true;
+    } else if (desired < m_level && !congested && nowMs - m_levelChangedAtMs >= kLevelUpHoldMs
+               && levelForBitrate(static_cast<int>(m_targetBitrate / kLevelUpMargin)) < m_level) {
+        m_level -= 1;
+        m_levelChangedAtMs = nowMs;
+        levelChanged = true;
+    }
+
+    return makeDecision(congested, levelChanged);
+}
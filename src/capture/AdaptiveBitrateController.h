@@ -0,0 +1,97 @@
+#ifndef ADAPTIVEBITRATECONTROLLER_H
+#define ADAPTIVEBITRATECONTROLLER_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// 闭环自适应码率控制器（纯逻辑，不依赖线程/网络，由主线程每秒调用一次 update）
+// 输入：
+// - 发送端：发送队列深度、按时间/队列丢弃计数、socket bytesToWrite、累计发送字节
+// - 接收端：观看端周期性上报的到达抖动、丢包率、排队时延（receiver_report）
+// 输出：目标码率、采集间隔、分辨率档位（对应 VP9 内部缩放，不重建编码器）
+// 策略：检测到拥塞时乘性降码率并冻结升档，链路通畅时加性+乘性缓慢回升；
+//      码率落到阈值以下先降帧率、再降分辨率，回升时带滞回，避免档位来回抖动。
+class AdaptiveBitrateController
+{
+public:
+    // 单条发送链路（云端/局域网）的累计计数快照
+    struct SenderSample {
+        int linkId = 0;
+        int queueDepth = 0;
+        qint64 droppedByAge = 0;
+        qint64 droppedByQueue = 0;
+        qint64 bytesToWrite = 0;
+        qint64 bytesSent = 0;
+    };
+
+    // 分辨率/帧率档位
+    struct Level {
+        int scaleNum;       // 分辨率缩放比例（分子/分母）
+        int scaleDen;
+        int intervalMs;     // 采集间隔
+    };
+
+    struct Decision {
+        int bitrate = 0;            // bps
+        int level = 0;
+        int captureIntervalMs = 66;
+        int scaleNum = 1;
+        int scaleDen = 1;
+        bool congested = false;
+        bool levelChanged = false;
+    };
+
+    AdaptiveBitrateController();
+
+    // 码率区间（上限来自画质预设），当前目标会被夹到区间内
+    void setBitrateRange(int minBps, int maxBps);
+    int minBitrate() const { return m_minBitrate; }
+    int maxBitrate() const { return m_maxBitrate; }
+
+    // 推流开始/编码器重建时调用：回到最高档，清空链路与观看端历史
+    void reset(qint64 nowMs);
+
+    // 观看端上报（任意时刻调用，按 viewerId 保留最新一条，超时自动失效）
+    void onReceiverReport(const QString &viewerId, double jitterMs, double lossPct,
+                          double queueDelayMs, qint64 nowMs);
+    void removeViewer(const QString &viewerId);
+
+    // 周期调用（建议 1 秒），传入当前处于推流状态的各链路快照
+    Decision update(const QVector<SenderSample> &samples, qint64 nowMs);
+
+    int targetBitrate() const { return m_targetBitrate; }
+    int level() const { return m_level; }
+    static int levelCount();
+    static Level levelAt(int level);
+
+private:
+    struct LinkState {
+        qint64 droppedByAge = 0;
+        qint64 droppedByQueue = 0;
+        qint64 bytesToWrite = 0;
+        qint64 bytesSent = 0;
+        qint64 sampleMs = 0;
+    };
+
+    struct ReceiverReport {
+        double jitterMs = 0.0;
+        double lossPct = 0.0;
+        double queueDelayMs = 0.0;
+        qint64 receivedAtMs = 0;
+    };
+
+    int levelForBitrate(int bitrate) const;
+    Decision makeDecision(bool congested, bool levelChanged) const;
+
+    int m_minBitrate;
+    int m_maxBitrate;
+    int m_targetBitrate;
+    int m_level = 0;
+    qint64 m_holdIncreaseUntilMs = 0;   // 拥塞后一段时间内不升码率
+    qint64 m_levelChangedAtMs = 0;
+    QHash<int, LinkState> m_links;
+    QHash<QString, ReceiverReport> m_reports;
+};
+
+#endif // ADAPTIVEBITRATECONTROLLER_H
@@ -0,0 +1,87 @@
+#include "CapturePacer.h"
+
+#include <algorithm>
+
+namespace {
+// 变化面积占比达到该值视为运动（滚动/视频）
+constexpr double kMotionRatio = 0.02;
+// 最后一次变化之后保持当前节奏的时间：连续操作的间隙（如打字停顿）不降帧率
+constexpr int kHoldMs = 600;
+}
+
+void CapturePacer::setMinIntervalMs(int ms)
+{
+    m_minIntervalMs = std::max(1, ms);
+    m_idleIntervalMs = std::max(m_idleIntervalMs, m_minIntervalMs);
+    m_intervalMs = std::max(m_intervalMs, m_minIntervalMs);
+}
+
+void CapturePacer::setIdleIntervalMs(int ms)
+{
+    m_idleIntervalMs = std::max(ms, m_minIntervalMs);
+    m_intervalMs = std::min(m_intervalMs, m_idleIntervalMs);
+}
+
+void CapturePacer::reset(Clock::time_point now)
+{
+    m_intervalMs = m_minIntervalMs;
+    m_deadline = now;
+    m_lastCapture = now - std::chrono::milliseconds(m_minIntervalMs);
+    m_lastChange = now;
+}
+
+void CapturePacer::onActivity(double dirtyRatio, Clock::time_point now)
+{
+    if (dirtyRatio <= 0.0) {
+        return;
+    }
+    const int target = dirtyRatio >= kMotionRatio ? m_minIntervalMs
+                                                  : std::min(m_minIntervalMs * 2, m_idleIntervalMs);
+    m_lastChange = now;
+    if (target >= m_intervalMs) {
+        return;
+    }
+    m_intervalMs = target;
+    // 从空闲节奏恢复：下一帧按新间隔从上次采集算起，不等旧的长间隔结束
+    const Clock::time_point earliest = std::max(now, m_lastCapture + std::chrono::milliseconds(m_intervalMs));
+    if (earliest < m_deadline) {
+        m_deadline = earliest;
+    }
+}
+
+void CapturePacer::onCapture(Clock::time_point now)
+{
+    m_lastCapture = now;
+    if (now - m_lastChange >= std::chrono::milliseconds(kHoldMs)) {
+        // 静止：每帧放慢 1.5 倍，数帧内退到空闲间隔
+        m_intervalMs = std::min(m_idleIntervalMs, std::max(m_intervalMs + 1, m_intervalMs * 3 / 2));
+    }
+
+    // 从上一截止时间累加，不累积定时器误差；采集耗时超过间隔时下一帧立即开始（不补发）
+    m_deadline += std::chrono::milliseconds(m_intervalMs);
+    if (m_deadline < now) {
+        m_deadline = now;
+    }
+}
+
+void CapturePacer::onSkipped(Clock::time_point now)
+{
+    m_deadline = now + std::chrono::milliseconds(m_intervalMs);
+}
+
+void CapturePacer::wake(Clock::time_point now)
+{
+    const Clock::time_point earliest = std::max(now, m_lastCapture + std::chrono::milliseconds(m_minIntervalMs));
+    if (earliest < m_deadline) {
+        m_deadline = earliest;
+    }
+}
+
+int CapturePacer::delayMs(Clock::time_point now) const
+{
+    if (m_deadline <= now) {
+        return 0;
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(m_deadline - now).count();
+    return static_cast<int>((us + 999) / 1000);
+}
@@ -0,0 +1,48 @@
+#ifndef CAPTUREPACER_H
+#define CAPTUREPACER_H
+
+#include <chrono>
+
+// 内容自适应采集节奏：根据最近的画面变化（脏区域占比）决定下一次采集的时间
+// - 大面积变化（滚动、视频、拖动窗口）：立即回到最高帧率（最小间隔）
+// - 小范围变化（打字、光标闪烁）：最小间隔的 2 倍
+// - 静止：保持当前节奏一段时间后逐步放慢，直到空闲间隔
+// 截止时间按单调时钟累加（上一截止时间 + 间隔），不随定时器误差漂移。
+// 非线程安全：只在采集线程使用。
+class CapturePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 最小间隔（最高帧率，由画质/自适应码率决定）与静止时的最长间隔
+    void setMinIntervalMs(int ms);
+    void setIdleIntervalMs(int ms);
+    int minIntervalMs() const { return m_minIntervalMs; }
+    int currentIntervalMs() const { return m_intervalMs; }
+
+    // 开始推流：从最高帧率开始，立即采集第一帧
+    void reset(Clock::time_point now);
+    // 画面变化：dirtyRatio 为变化面积占比（采集端损坏区域或编码端脏块检测），0 或负数（未知）忽略。
+    // 变快时下一次采集相应提前
+    void onActivity(double dirtyRatio, Clock::time_point now);
+    // 一次采集完成：静止超过保持时间则放慢，并计算下一截止时间
+    void onCapture(Clock::time_point now);
+    // 本次定时未采集（暂停/热切换中）：按当前间隔顺延
+    void onSkipped(Clock::time_point now);
+    // 需要尽快出帧（关键帧请求）：提前到最早允许的时间，但不超过最高帧率
+    void wake(Clock::time_point now);
+
+    Clock::time_point nextDeadline() const { return m_deadline; }
+    // 距下一次采集的毫秒数（向上取整，已过期为 0）
+    int delayMs(Clock::time_point now) const;
+
+private:
+    int m_minIntervalMs = 66;
+    int m_idleIntervalMs = 500;
+    int m_intervalMs = 66;
+    Clock::time_point m_deadline;
+    Clock::time_point m_lastCapture;
+    Clock::time_point m_lastChange;
+};
+
+#endif // CAPTUREPACER_H
@@ -0,0 +1,467 @@
+#include "CapturePipeline.h"
+#include "ScreenCapture.h"
+#include "VP9Encoder.h"
+
+#include <QThread>
+#include <QTimer>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QDebug>
+#include <libyuv.h>
+#include <algorithm>
+
+CapturePipeline::CapturePipeline(ScreenCapture *capture, VP9Encoder *encoder, QObject *parent)
+    : QObject(parent)
+    , m_capture(capture)
+    , m_captureThread(new QThread(this))
+    , m_captureTimer(new QTimer())
+{
+    // 各路状态在构造时全部创建，之后数组不再变化，采集线程可无锁遍历
+    for (auto &stream : m_streams) {
+        stream.reset(new EncodeStream);
+    }
+
+    // 采集输出直接写入缓冲池，主流与各级缩放流、静态检测与编码按引用共享
+    m_capture->setFramePool(&m_framePool);
+
+    m_captureThread->setObjectName(QStringLiteral("CaptureThread"));
+    // 单次触发：每帧按单调时钟上的截止时间重新计算等待时长，间隔可逐帧变化
+    m_captureTimer->setSingleShot(true);
+    m_captureTimer->setTimerType(Qt::PreciseTimer);
+    m_captureTimer->moveToThread(m_captureThread);
+
+    // 以定时器自身为上下文：槽在采集线程执行
+    QObject::connect(m_captureTimer, &QTimer::timeout, m_captureTimer, [this]() {
+        captureOnce();
+        scheduleNextCapture();
+    });
+
+    EncodeStream &primary = *m_streams[0];
+    primary.encoder = encoder;
+    primary.thread = new QThread(this);
+    primary.thread->setObjectName(QStringLiteral("EncodeThread"));
+    primary.context = new QObject();
+    primary.context->moveToThread(primary.thread);
+    primary.enabled.store(true, std::memory_order_release);
+    connectEncoder(0);
+
+    m_captureThread->start();
+    primary.thread->start(QThread::HighPriority);
+}
+
+CapturePipeline::~CapturePipeline()
+{
+    shutdown();
+}
+
+void CapturePipeline::connectEncoder(int streamId)
+{
+    // 编码输出在编码线程内直接入队（编码器持锁期间回调，不能在此调用编码器方法）
+    QObject::connect(m_streams[streamId]->encoder, &VP9Encoder::packetEncoded, this,
+                     [this, streamId](const QByteArray &packet, const PacketMeta &meta) {
+        onPacketEncoded(streamId, packet, meta);
+    }, Qt::DirectConnection);
+}
+
+void CapturePipeline::addSimulcastEncoder(int streamId, VP9Encoder *encoder)
+{
+    if (streamId <= 0 || streamId >= kMaxStreams || !encoder || m_streams[streamId]->encoder) {
+        return;
+    }
+    EncodeStream &stream = *m_streams[streamId];
+    stream.encoder = encoder;
+    stream.thread = new QThread(this);
+    stream.thread->setObjectName(QStringLiteral("EncodeThread%1").arg(streamId));
+    stream.context = new QObject();
+    stream.context->moveToThread(stream.thread);
+    connectEncoder(streamId);
+    // 附加流优先级低于主编码线程：CPU 紧张时优先保证原始分辨率
+    stream.thread->start(QThread::NormalPriority);
+}
+
+void CapturePipeline::setStreamTarget(int streamId, const QSize &size)
+{
+    if (streamId <= 0 || streamId >= kMaxStreams || !m_streams[streamId]->encoder) {
+        return;
+    }
+    EncodeStream &stream = *m_streams[streamId];
+    {
+        QMutexLocker locker(&m_streamMutex);
+        stream.target = size;
+    }
+    const bool enable = !size.isEmpty();
+    if (stream.enabled.exchange(enable, std::memory_order_acq_rel) != enable) {
+        if (enable) {
+            stream.keyFrameRequested.store(true, std::memory_order_release);
+        } else {
+            stream.frames.clear();
+        }
+    }
+}
+
+bool CapturePipeline::isStreamEnabled(int streamId) const
+{
+    if (streamId < 0 || streamId >= kMaxStreams) {
+        return false;
+    }
+    return m_streams[streamId]->enabled.load(std::memory_order_acquire);
+}
+
+VP9Encoder *CapturePipeline::streamEncoder(int streamId) const
+{
+    if (streamId < 0 || streamId >= kMaxStreams) {
+        return nullptr;
+    }
+    return m_streams[streamId]->encoder;
+}
+
+int CapturePipeline::sendQueueDepth() const
+{
+    int depth = 0;
+    for (const auto &stream : m_streams) {
+        depth += stream->packets.depth();
+    }
+    return depth;
+}
+
+quint64 CapturePipeline::encodedFrames(int streamId) const
+{
+    if (streamId < 0 || streamId >= kMaxStreams) {
+        return 0;
+    }
+    return m_streams[streamId]->encodedFrames.load(std::memory_order_relaxed);
+}
+
+void CapturePipeline::start(int intervalMs)
+{
+    m_intervalMs.store(intervalMs, std::memory_order_relaxed);
+    m_running.store(true, std::memory_order_release);
+    if (!m_captureThread->isRunning()) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_captureTimer, [this, intervalMs]() {
+        m_pacer.setIdleIntervalMs(m_idleIntervalMs.load(std::memory_order_relaxed));
+        m_pacer.setMinIntervalMs(intervalMs);
+        m_pacer.reset(CapturePacer::Clock::now());
+        m_pacedIntervalMs.store(m_pacer.currentIntervalMs(), std::memory_order_relaxed);
+        m_captureTimer->start(0);
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::stop()
+{
+    m_running.store(false, std::memory_order_release);
+    if (m_captureThread->isRunning()) {
+        QMetaObject::invokeMethod(m_captureTimer, [this]() {
+            m_captureTimer->stop();
+        }, Qt::QueuedConnection);
+    }
+    // 丢弃尚未编码的旧画面；已编码数据包由 drainSend 继续送出或随下次启动清空
+    for (auto &stream : m_streams) {
+        stream->frames.clear();
+    }
+    // 停止推流后归还空闲帧缓冲，降低常驻内存（在途缓冲释放后回池，下次启动复用）
+    m_framePool.trim();
+}
+
+void CapturePipeline::setCaptureInterval(int intervalMs)
+{
+    if (intervalMs <= 0 || m_intervalMs.exchange(intervalMs, std::memory_order_relaxed) == intervalMs) {
+        return;
+    }
+    if (!m_captureThread->isRunning()) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_captureTimer, [this, intervalMs]() {
+        // 只调整最高帧率：未启动时仅记录，下次 start 使用调用方给定的间隔；下一帧起生效
+        m_pacer.setMinIntervalMs(intervalMs);
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::setIdleInterval(int intervalMs)
+{
+    if (intervalMs <= 0 || m_idleIntervalMs.exchange(intervalMs, std::memory_order_relaxed) == intervalMs) {
+        return;
+    }
+    if (!m_captureThread->isRunning()) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_captureTimer, [this, intervalMs]() {
+        m_pacer.setIdleIntervalMs(intervalMs);
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::setSwitching(bool switching)
+{
+    m_switching.store(switching, std::memory_order_release);
+    if (switching) {
+        for (auto &stream : m_streams) {
+            stream->frames.clear();
+        }
+    }
+}
+
+void CapturePipeline::requestKeyFrame()
+{
+    for (auto &stream : m_streams) {
+        stream->keyFrameRequested.store(true, std::memory_order_release);
+    }
+    wakeCapture();
+}
+
+void CapturePipeline::requestStreamKeyFrame(int streamId)
+{
+    if (streamId < 0 || streamId >= kMaxStreams) {
+        return;
+    }
+    m_streams[streamId]->keyFrameRequested.store(true, std::memory_order_release);
+    wakeCapture();
+}
+
+void CapturePipeline::wakeCapture()
+{
+    if (!m_captureThread->isRunning()) {
+        return;
+    }
+    // 静止画面下采集间隔可能已放慢到空闲间隔，关键帧不能等到下一次定时采集
+    QMetaObject::invokeMethod(m_captureTimer, [this]() {
+        if (m_captureTimer->isActive()) {
+            m_pacer.wake(CapturePacer::Clock::now());
+            scheduleNextCapture();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::reportActivity(double dirtyRatio)
+{
+    if (dirtyRatio <= 0.0 || !m_captureThread->isRunning()) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_captureTimer, [this, dirtyRatio]() {
+        if (m_captureTimer->isActive()) {
+            m_pacer.onActivity(dirtyRatio, CapturePacer::Clock::now());
+            scheduleNextCapture();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::shutdown()
+{
+    m_running.store(false, std::memory_order_release);
+    if (m_captureThread->isRunning()) {
+        // 定时器必须在其所属线程停止；采集线程从不阻塞等待主线程，这里同步等待是安全的
+        QMetaObject::invokeMethod(m_captureTimer, [this]() {
+            m_captureTimer->stop();
+        }, Qt::BlockingQueuedConnection);
+        m_captureThread->quit();
+        m_captureThread->wait(1500);
+    }
+    for (auto &stream : m_streams) {
+        stream->enabled.store(false, std::memory_order_release);
+        if (stream->thread && stream->thread->isRunning()) {
+            stream->thread->quit();
+            stream->thread->wait(3000);
+        }
+        if (stream->context && !(stream->thread && stream->thread->isRunning())) {
+            delete stream->context;
+            stream->context = nullptr;
+        }
+        stream->frames.clear();
+    }
+    if (m_captureTimer && !m_captureThread->isRunning()) {
+        delete m_captureTimer;
+        m_captureTimer = nullptr;
+    }
+}
+
+void CapturePipeline::captureOnce()
+{
+    if (!isActive()) { // 只有在推流状态且非热切换时才抓帧
+        m_pacer.onSkipped(CapturePacer::Clock::now());
+        return;
+    }
+
+    FrameBuffer frameData;
+    QSize capSize;
+    QVector<QRect> damage;
+    bool hasDamage = false;
+    {
+        QMutexLocker locker(&m_captureMutex);
+        if (!isActive()) {
+            m_pacer.onSkipped(CapturePacer::Clock::now());
+            return;
+        }
+        frameData = m_capture->captureScreen();
+        capSize = m_capture->getScreenSize();
+        hasDamage = m_capture->takeDamage(damage);
+    }
+    const CapturePacer::Clock::time_point now = CapturePacer::Clock::now();
+    if (hasDamage && !capSize.isEmpty()) {
+        // 采集端已给出变化区域：本帧即可决定节奏（无损坏区域的后端由编码线程的脏块检测上报）
+        qint64 area = 0;
+        for (const QRect &r : damage) {
+            area += qint64(r.width()) * r.height();
+        }
+        m_pacer.onActivity(std::min(1.0, double(area) / (qint64(capSize.width()) * capSize.height())), now);
+    }
+    m_pacer.onCapture(now);
+    if (frameData.isNull()) {
+        return;
+    }
+
+    const quint64 seq = ++m_captureSeq;
+    CapturedFrame *frame = new CapturedFrame;
+    frame->seq = seq;
+    frame->data = frameData;
+    frame->size = capSize;
+    frame->damage = damage;
+    frame->hasDamage = hasDamage;
+    pushFrame(0, frame);
+    m_capturedFrames.fetch_add(1, std::memory_order_relaxed);
+
+    pushSimulcastFrames(seq, frameData, capSize);
+}
+
+void CapturePipeline::scheduleNextCapture()
+{
+    if (!isRunning()) {
+        return; // 已停止：不再重新启动定时器
+    }
+    m_pacedIntervalMs.store(m_pacer.currentIntervalMs(), std::memory_order_relaxed);
+    m_captureTimer->start(m_pacer.delayMs(CapturePacer::Clock::now()));
+}
+
+void CapturePipeline::pushFrame(int streamId, CapturedFrame *frame)
+{
+    EncodeStream &stream = *m_streams[streamId];
+    stream.frames.push(frame);
+
+    // 合并投递：编码线程尚未处理的任务只保留一个
+    if (!stream.encodeScheduled.exchange(true, std::memory_order_acq_rel) && stream.context) {
+        QMetaObject::invokeMethod(stream.context, [this, streamId]() {
+            drainEncode(streamId);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void CapturePipeline::pushSimulcastFrames(quint64 seq, const FrameBuffer &source, const QSize &sourceSize)
+{
+    QSize targets[kMaxStreams];
+    {
+        QMutexLocker locker(&m_streamMutex);
+        for (int i = 1; i < kMaxStreams; ++i) {
+            if (m_streams[i]->enabled.load(std::memory_order_acquire)) {
+                targets[i] = m_streams[i]->target;
+            }
+        }
+    }
+
+    // 缩放金字塔：每一级优先从上一级缩小（源更小、缓存更友好），上一级不够大时回到原始画面
+    if (source.frameSize() != sourceSize) {
+        return;
+    }
+    FrameBuffer level = source;
+    QSize levelSize = sourceSize;
+    for (int i = 1; i < kMaxStreams; ++i) {
+        const QSize target = targets[i];
+        if (target.isEmpty()) {
+            continue;
+        }
+        const FrameBuffer *from = &level;
+        QSize fromSize = levelSize;
+        if (target.width() > fromSize.width() || target.height() > fromSize.height()) {
+            from = &source;
+            fromSize = sourceSize;
+        }
+
+        FrameBuffer scaled;
+        if (target == fromSize) {
+            scaled = *from;
+        } else {
+            scaled = m_framePool.acquire(target);
+            if (scaled.isNull()) {
+                continue;
+            }
+            libyuv::ARGBScale(from->constData(), fromSize.width() * 4,
+                              fromSize.width(), fromSize.height(),
+                              scaled.data(), target.width() * 4,
+                              target.width(), target.height(),
+                              libyuv::kFilterBox);
+        }
+
+        CapturedFrame *frame = new CapturedFrame;
+        frame->seq = seq;
+        frame->data = scaled;
+        frame->size = target;
+        pushFrame(i, frame);
+
+        level = scaled;
+        levelSize = target;
+    }
+}
+
+void CapturePipeline::drainEncode(int streamId)
+{
+    EncodeStream &stream = *m_streams[streamId];
+    stream.encodeScheduled.store(false, std::memory_order_release);
+
+    while (CapturedFrame *frame = stream.frames.takeNewest()) {
+        if (isActive() && stream.enabled.load(std::memory_order_acquire)) {
+            if (stream.keyFrameRequested.exchange(false, std::memory_order_acq_rel)) {
+                stream.encoder->forceKeyFrame();
+            }
+            // encode 内部会根据初始化尺寸和输入尺寸自动判断是否需要缩放
+            // 中间有帧被最新帧队列丢弃时 damage 不完整，交给编码器整帧比较
+            const bool damageUsable = frame->hasDamage && frame->seq == stream.lastEncodedSeq + 1;
+            stream.encoder->encode(frame->data.bytes(), frame->size.width(), frame->size.height(),
+                                   damageUsable ? &frame->damage : nullptr);
+            stream.lastEncodedSeq = frame->seq;
+            stream.encodedFrames.fetch_add(1, std::memory_order_relaxed);
+            if (streamId == 0 && !frame->hasDamage && stream.encoder->dirtyRegions().hasHistory()) {
+                // 主流脏块占比驱动采集节奏（脏块检测在 encode 内完成，此处仍在编码线程）
+                reportActivity(stream.encoder->dirtyRegions().dirtyRatio());
+            }
+        }
+        delete frame;
+    }
+}
+
+void CapturePipeline::onPacketEncoded(int streamId, const QByteArray &packet, const PacketMeta &meta)
+{
+    EncodeStream &stream = *m_streams[streamId];
+    if (stream.dropUntilKeyFrame) {
+        if (!meta.keyFrame) {
+            m_sendDrops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        stream.dropUntilKeyFrame = false;
+    }
+
+    EncodedPacket pkt;
+    pkt.data = packet;
+    pkt.meta = meta;
+    if (!stream.packets.push(std::move(pkt))) {
+        // 发送端积压：丢掉当前包并等待关键帧，保证观看端参考链完整
+        m_sendDrops.fetch_add(1, std::memory_order_relaxed);
+        stream.dropUntilKeyFrame = true;
+        requestStreamKeyFrame(streamId);
+    }
+
+    if (!m_sendScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, [this]() {
+            drainSend();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void CapturePipeline::drainSend()
+{
+    m_sendScheduled.store(false, std::memory_order_release);
+
+    EncodedPacket pkt;
+    for (auto &stream : m_streams) {
+        while (stream->packets.pop(pkt)) {
+            emit packetReady(pkt.data, pkt.meta.keyFrame);
+        }
+    }
+}
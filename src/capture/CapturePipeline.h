@@ -0,0 +1,160 @@
+#ifndef CAPTUREPIPELINE_H
+#define CAPTUREPIPELINE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QSize>
+#include <QRect>
+#include <QVector>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+
+#include "FrameQueue.h"
+#include "PacketBufferPool.h"
+#include "FrameBufferPool.h"
+#include "CapturePacer.h"
+
+class QThread;
+class QTimer;
+class ScreenCapture;
+class VP9Encoder;
+
+// 采集→编码→发送 三级流水线
+// - 采集线程：定时抓屏，写入“最新帧”队列（编码跟不上时旧帧直接被覆盖）
+// - 编码线程：只取最新一帧进行 VP9 编码，输出写入有界环形队列
+// - 发送阶段：在 QWebSocket 所属线程（主线程）批量取出数据包，通过 packetReady 交给发送器
+// 抓屏、编码、网络写互不阻塞，单阶段抖动不会拖慢其它阶段。
+//
+// 多路编码（simulcast）：第 0 路为主编码器；附加编码器（第 1、2 路，分辨率依次降低）
+// 各自运行在独立编码线程。采集线程每帧只抓一次屏，并逐级缩小得到共享的缩放金字塔
+// （每一级在上一级基础上缩小），各路直接编码对应尺寸的画面，数据包头部携带流ID，
+// 由中继按观看端选择转发。
+//
+// 采集节奏按内容自适应（CapturePacer）：画面变化时以 captureInterval 的最高帧率采集，
+// 静止后逐步放慢到空闲间隔；关键帧请求会立即唤醒采集，保证静止画面也能及时出关键帧。
+class CapturePipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxStreams = PacketHeader::kMaxSimulcastStreams;
+
+    explicit CapturePipeline(ScreenCapture *capture, VP9Encoder *encoder, QObject *parent = nullptr);
+    ~CapturePipeline();
+
+    // 附加编码器（streamId 1..kMaxStreams-1），创建对应编码线程；默认关闭，需 setStreamTarget 开启
+    void addSimulcastEncoder(int streamId, VP9Encoder *encoder);
+    // 开启附加流并设置其编码输入尺寸（金字塔该级的尺寸）；空尺寸表示关闭
+    // 尺寸须随 streamId 递增而递减。调用方负责在开启前初始化对应编码器
+    void setStreamTarget(int streamId, const QSize &size);
+    bool isStreamEnabled(int streamId) const;
+    VP9Encoder *streamEncoder(int streamId) const;
+
+    // 启停（对应 isCapturing）
+    void start(int intervalMs);
+    void stop();
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+    // 运行中调整采集间隔（自适应码率降帧率），不影响启停状态；该间隔是画面变化时的最小间隔
+    void setCaptureInterval(int intervalMs);
+    int captureInterval() const { return m_intervalMs.load(std::memory_order_relaxed); }
+    // 画面静止时放慢到的最长采集间隔
+    void setIdleInterval(int intervalMs);
+    // 当前实际采集间隔（随画面变化在 captureInterval 与空闲间隔之间调整）
+    int pacedInterval() const { return m_pacedIntervalMs.load(std::memory_order_relaxed); }
+
+    // 热切换期间暂停抓帧（对应 isSwitching），不断流
+    void setSwitching(bool switching);
+    bool isSwitching() const { return m_switching.load(std::memory_order_acquire); }
+
+    // 主线程重建 ScreenCapture 前必须持有此锁，采集线程抓屏期间同样持有
+    QMutex *captureMutex() { return &m_captureMutex; }
+
+    // 统计信息（任意线程可读；队列与编码计数为主编码流）
+    int captureQueueDepth() const { return m_streams[0]->frames.depth(); }
+    int sendQueueDepth() const;
+    quint64 capturedFrames() const { return m_capturedFrames.load(std::memory_order_relaxed); }
+    quint64 encodedFrames() const { return m_streams[0]->encodedFrames.load(std::memory_order_relaxed); }
+    quint64 encodedFrames(int streamId) const;
+    quint64 captureDrops() const { return m_streams[0]->frames.droppedCount(); }
+    quint64 sendDrops() const { return m_sendDrops.load(std::memory_order_relaxed); }
+    FrameBufferPool::Stats framePoolStats() const { return m_framePool.stats(); }
+
+signals:
+    // 在主线程发出，直接连接到 WebSocketSender::enqueueFrame
+    void packetReady(const QByteArray &packet, bool keyFrame);
+
+public slots:
+    // 线程安全：只置标志，由编码线程在下一帧前交给各路关键帧策略（策略负责合并与限频）
+    void requestKeyFrame();
+    // 只请求某一路的关键帧（中继为观看端切换到该路时发出）
+    void requestStreamKeyFrame(int streamId);
+    void shutdown();
+
+private:
+    struct CapturedFrame {
+        quint64 seq = 0;
+        FrameBuffer data;                // 缓冲池中的帧，各路按引用共享，最后释放者归还
+        QSize size;
+        QVector<QRect> damage;           // 采集端报告的变化区域（相对上一次采集）
+        bool hasDamage = false;          // damage 是否可信（否则编码器整帧比较）
+    };
+
+    struct EncodedPacket {
+        QByteArray data;
+        PacketMeta meta;
+    };
+
+    // 单路编码：编码器、所属线程与队列
+    struct EncodeStream {
+        VP9Encoder *encoder = nullptr;
+        QThread *thread = nullptr;
+        QObject *context = nullptr;      // 归属编码线程，用于投递编码任务
+        LatestFrameQueue<CapturedFrame> frames{2};
+        SpscRingQueue<EncodedPacket> packets{16}; // 发送队列容量，超出则丢弃到下一个关键帧
+        QSize target;                    // 附加流的编码输入尺寸（m_streamMutex 保护）
+        std::atomic<bool> enabled{false};
+        std::atomic<bool> encodeScheduled{false};
+        std::atomic<bool> keyFrameRequested{false};
+        std::atomic<quint64> encodedFrames{0};
+        bool dropUntilKeyFrame = false;  // 仅编码线程访问：发送队列溢出后丢弃到下一个关键帧
+        quint64 lastEncodedSeq = 0;      // 仅编码线程访问：damage 只在与上一编码帧相邻时可用
+    };
+
+    void captureOnce();                  // 采集线程
+    void scheduleNextCapture();          // 采集线程
+    void reportActivity(double dirtyRatio); // 任意线程：画面变化，必要时提前下一次采集
+    void wakeCapture();                  // 任意线程：尽快采集一帧（关键帧请求）
+    void pushFrame(int streamId, CapturedFrame *frame); // 采集线程
+    void pushSimulcastFrames(quint64 seq, const FrameBuffer &source, const QSize &sourceSize); // 采集线程
+    void drainEncode(int streamId);      // 对应编码线程
+    void drainSend();                    // 主线程
+    void onPacketEncoded(int streamId, const QByteArray &packet, const PacketMeta &meta); // 编码线程（DirectConnection）
+    void connectEncoder(int streamId);
+    bool isActive() const { return isRunning() && !isSwitching(); }
+
+    ScreenCapture *m_capture;
+
+    QThread *m_captureThread;
+    QTimer *m_captureTimer;      // 归属采集线程（单次触发，每次采集后按节奏重新启动）
+    CapturePacer m_pacer;        // 仅采集线程访问
+
+    QMutex m_captureMutex;
+    mutable QMutex m_streamMutex;
+    // 采集帧缓冲池：须先于各路队列构造、晚于其析构（队列中的帧析构时归还缓冲）
+    FrameBufferPool m_framePool;
+    std::unique_ptr<EncodeStream> m_streams[kMaxStreams];
+
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_intervalMs{66};
+    std::atomic<int> m_idleIntervalMs{500};
+    std::atomic<int> m_pacedIntervalMs{66};
+    std::atomic<bool> m_switching{false};
+    std::atomic<bool> m_sendScheduled{false};
+
+    quint64 m_captureSeq = 0;         // 仅采集线程访问
+    std::atomic<quint64> m_capturedFrames{0};
+    std::atomic<quint64> m_sendDrops{0};
+};
+
+#endif // CAPTUREPIPELINE_H
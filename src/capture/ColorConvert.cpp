@@ -0,0 +1,211 @@
+#include "ColorConvert.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLORCONVERT_SSE2 1
+#endif
+
+namespace ColorConvert {
+
+namespace {
+
+constexpr int kYShift = 10;            // Q10 定点
+constexpr int kUVShift = kYShift + 2;  // 色度为 2x2 四像素之和，再除以 4
+
+inline uint8_t clampByte(int v)
+{
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// 标量实现：处理一对行中 [x0, width) 范围（SIMD 剩余部分或非 x86 平台）
+void convertRowPairScalar(const uint8_t *row0, const uint8_t *row1,
+                          uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                          int x0, int width, bool hasSecondRow, const Coefficients &c)
+{
+    for (int x = x0; x < width; x += 2) {
+        const int xn = (x + 1 < width) ? x + 1 : x;
+        const uint8_t *p[4] = { row0 + x * 4, row0 + xn * 4, row1 + x * 4, row1 + xn * 4 };
+
+        y0[x] = clampByte(((c.yr * p[0][2] + c.yg * p[0][1] + c.yb * p[0][0] + (1 << (kYShift - 1))) >> kYShift) + 16);
+        if (xn != x) {
+            y0[xn] = clampByte(((c.yr * p[1][2] + c.yg * p[1][1] + c.yb * p[1][0] + (1 << (kYShift - 1))) >> kYShift) + 16);
+        }
+        if (hasSecondRow) {
+            y1[x] = clampByte(((c.yr * p[2][2] + c.yg * p[2][1] + c.yb * p[2][0] + (1 << (kYShift - 1))) >> kYShift) + 16);
+            if (xn != x) {
+                y1[xn] = clampByte(((c.yr * p[3][2] + c.yg * p[3][1] + c.yb * p[3][0] + (1 << (kYShift - 1))) >> kYShift) + 16);
+            }
+        }
+
+        const int b = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+        const int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+        const int r = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+        u[x >> 1] = clampByte(((c.ur * r + c.ug * g + c.ub * b + (1 << (kUVShift - 1))) >> kUVShift) + 128);
+        v[x >> 1] = clampByte(((c.vr * r + c.vg * g + c.vb * b + (1 << (kUVShift - 1))) >> kUVShift) + 128);
+    }
+}
+
+#if defined(COLORCONVERT_SSE2)
+// madd 结果为 [b*cb+g*cg, r*cr, ...]，相邻 32 位相加后压缩为连续 4 个结果
+inline __m128i dot4(__m128i lo, __m128i hi, __m128i coef)
+{
+    __m128i ml = _mm_madd_epi16(lo, coef);
+    __m128i mh = _mm_madd_epi16(hi, coef);
+    ml = _mm_add_epi32(ml, _mm_srli_epi64(ml, 32));
+    mh = _mm_add_epi32(mh, _mm_srli_epi64(mh, 32));
+    ml = _mm_shuffle_epi32(ml, _MM_SHUFFLE(3, 1, 2, 0));
+    mh = _mm_shuffle_epi32(mh, _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_unpacklo_epi64(ml, mh);
+}
+
+inline void storeLuma8(uint8_t *dst, __m128i p0, __m128i p1, __m128i coefY,
+                       __m128i roundY, __m128i offsetY)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = dot4(_mm_unpacklo_epi8(p0, zero), _mm_unpackhi_epi8(p0, zero), coefY);
+    __m128i b = dot4(_mm_unpacklo_epi8(p1, zero), _mm_unpackhi_epi8(p1, zero), coefY);
+    a = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(a, roundY), kYShift), offsetY);
+    b = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(b, roundY), kYShift), offsetY);
+    const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), zero);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+}
+
+inline void storeChroma4(uint8_t *dst, __m128i c01, __m128i c23, __m128i coef,
+                         __m128i roundUV, __m128i offsetUV)
+{
+    __m128i s = dot4(c01, c23, coef);
+    s = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(s, roundUV), kUVShift), offsetUV);
+    const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(s, s), s);
+    const int out = _mm_cvtsi128_si32(packed);
+    memcpy(dst, &out, 4);
+}
+
+// 一对行中 8 像素一组的向量化处理，返回已处理到的 x
+int convertRowPairSSE2(const uint8_t *row0, const uint8_t *row1,
+                       uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                       int width, bool hasSecondRow, const Coefficients &c)
+{
+    // 内存序 BGRA：16 位通道 [B, G, R, A, B, G, R, A]
+    const __m128i coefY = _mm_set_epi16(0, c.yr, c.yg, c.yb, 0, c.yr, c.yg, c.yb);
+    const __m128i coefU = _mm_set_epi16(0, c.ur, c.ug, c.ub, 0, c.ur, c.ug, c.ub);
+    const __m128i coefV = _mm_set_epi16(0, c.vr, c.vg, c.vb, 0, c.vr, c.vg, c.vb);
+    const __m128i roundY = _mm_set1_epi32(1 << (kYShift - 1));
+    const __m128i offsetY = _mm_set1_epi32(16);
+    const __m128i roundUV = _mm_set1_epi32(1 << (kUVShift - 1));
+    const __m128i offsetUV = _mm_set1_epi32(128);
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 4));
+        const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 4 + 16));
+        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 4));
+        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 4 + 16));
+
+        storeLuma8(y0 + x, a0, a1, coefY, roundY, offsetY);
+        if (hasSecondRow) {
+            storeLuma8(y1 + x, b0, b1, coefY, roundY, offsetY);
+        }
+
+        // 2x2 求和：先纵向相加，再把相邻两像素相加
+        const __m128i lo0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        const __m128i hi0 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        const __m128i lo1 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        const __m128i hi1 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+        const __m128i c01 = _mm_add_epi16(_mm_unpacklo_epi64(lo0, hi0), _mm_unpackhi_epi64(lo0, hi0));
+        const __m128i c23 = _mm_add_epi16(_mm_unpacklo_epi64(lo1, hi1), _mm_unpackhi_epi64(lo1, hi1));
+
+        storeChroma4(u + (x >> 1), c01, c23, coefU, roundUV, offsetUV);
+        storeChroma4(v + (x >> 1), c01, c23, coefV, roundUV, offsetUV);
+    }
+    return x;
+}
+#endif
+
+bool convertFrame(const uint8_t *argb, int argbStride,
+                  uint8_t *dstY, int strideY,
+                  uint8_t *dstU, int strideU,
+                  uint8_t *dstV, int strideV,
+                  int width, int height,
+                  const Coefficients &coeffs, bool allowSimd)
+{
+    if (!argb || !dstY || !dstU || !dstV || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    for (int y = 0; y < height; y += 2) {
+        const bool hasSecondRow = (y + 1 < height);
+        const uint8_t *row0 = argb + static_cast<long long>(y) * argbStride;
+        const uint8_t *row1 = hasSecondRow ? row0 + argbStride : row0;
+        uint8_t *y0 = dstY + static_cast<long long>(y) * strideY;
+        uint8_t *y1 = hasSecondRow ? y0 + strideY : y0;
+        uint8_t *u = dstU + static_cast<long long>(y >> 1) * strideU;
+        uint8_t *v = dstV + static_cast<long long>(y >> 1) * strideV;
+
+        int x = 0;
+#if defined(COLORCONVERT_SSE2)
+        if (allowSimd) {
+            x = convertRowPairSSE2(row0, row1, y0, y1, u, v, width, hasSecondRow, coeffs);
+        }
+#else
+        (void)allowSimd;
+#endif
+        if (x < width) {
+            convertRowPairScalar(row0, row1, y0, y1, u, v, x, width, hasSecondRow, coeffs);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+Coefficients makeCoefficients(Matrix matrix, double uGain, double vGain)
+{
+    // Studio Range (Y: 16-235, UV: 16-240) 浮点系数
+    double kr, kg, kb, ur, ug, ub, vr, vg, vb;
+    if (matrix == Matrix::Bt709) {
+        kr = 0.1826; kg = 0.6142; kb = 0.0620;
+        ur = -0.1006; ug = -0.3386; ub = 0.4392;
+        vr = 0.4392; vg = -0.3989; vb = -0.0403;
+    } else {
+        kr = 0.2568; kg = 0.5041; kb = 0.0979;
+        ur = -0.1482; ug = -0.2910; ub = 0.4392;
+        vr = 0.4392; vg = -0.3678; vb = -0.0714;
+    }
+
+    const double scale = static_cast<double>(1 << kYShift);
+    auto q = [scale](double v) { return static_cast<int>(std::lround(v * scale)); };
+
+    Coefficients c;
+    c.yr = q(kr); c.yg = q(kg); c.yb = q(kb);
+    c.ur = q(ur * uGain); c.ug = q(ug * uGain); c.ub = q(ub * uGain);
+    c.vr = q(vr * vGain); c.vg = q(vg * vGain); c.vb = q(vb * vGain);
+    return c;
+}
+
+bool argbToI420(const uint8_t *argb, int argbStride,
+                uint8_t *dstY, int strideY,
+                uint8_t *dstU, int strideU,
+                uint8_t *dstV, int strideV,
+                int width, int height,
+                const Coefficients &coeffs)
+{
+    return convertFrame(argb, argbStride, dstY, strideY, dstU, strideU, dstV, strideV,
+                        width, height, coeffs, true);
+}
+
+bool argbToI420Scalar(const uint8_t *argb, int argbStride,
+                      uint8_t *dstY, int strideY,
+                      uint8_t *dstU, int strideU,
+                      uint8_t *dstV, int strideV,
+                      int width, int height,
+                      const Coefficients &coeffs)
+{
+    return convertFrame(argb, argbStride, dstY, strideY, dstU, strideU, dstV, strideV,
+                        width, height, coeffs, false);
+}
+
+} // namespace ColorConvert
@@ -0,0 +1,44 @@
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include <cstdint>
+
+// ARGB(BGRA 内存序) → I420 融合转换
+// 一次遍历同时完成：色彩矩阵(BT.601/BT.709, Studio Range)、2x2 色度下采样、U/V 色偏修正，
+// 直接写入目标平面（例如 vpx_image_t::planes），不再经过中间缓冲和额外的修正/拷贝。
+namespace ColorConvert {
+
+enum class Matrix {
+    Bt601,  // 与 libyuv::ARGBToI420 / I420ToARGB 一致
+    Bt709   // 与 libyuv::H420ToARGB 一致
+};
+
+// 定点系数（Q10），由矩阵与 U/V 增益预先合成
+struct Coefficients {
+    int yr, yg, yb;
+    int ur, ug, ub;
+    int vr, vg, vb;
+};
+
+// uGain/vGain 为色度偏移修正增益（围绕 128 缩放），1.0 表示不修正
+Coefficients makeCoefficients(Matrix matrix, double uGain = 1.0, double vGain = 1.0);
+
+// 宽高可以为奇数（末行/末列与自身配对下采样）
+bool argbToI420(const uint8_t *argb, int argbStride,
+                uint8_t *dstY, int strideY,
+                uint8_t *dstU, int strideU,
+                uint8_t *dstV, int strideV,
+                int width, int height,
+                const Coefficients &coeffs);
+
+// 只走标量路径，输出与 argbToI420 逐字节一致（ColorConvertCheck 用于校验 SIMD 路径）
+bool argbToI420Scalar(const uint8_t *argb, int argbStride,
+                      uint8_t *dstY, int strideY,
+                      uint8_t *dstU, int strideU,
+                      uint8_t *dstV, int strideV,
+                      int width, int height,
+                      const Coefficients &coeffs);
+
+} // namespace ColorConvert
+
+#endif // COLORCONVERT_H
@@ -0,0 +1,267 @@
+#include "DirtyRegionDetector.h"
+#include <QPair>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DIRTY_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIRTY_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DIRTY_SIMD_NEON 1
+#endif
+
+namespace {
+
+// 每块累加器通道数（与向量宽度一致，标量路径使用相同布局保证结果一致）
+#if defined(DIRTY_SIMD_AVX2)
+constexpr int kLanes = 8;
+#else
+constexpr int kLanes = 4;
+#endif
+
+// Fletcher 风格累加：A += w, B += A（32位通道，按位置加权）
+// 任意单个像素变化必然改变 A；两处变化同时抵消 A 与 B 的概率可忽略
+inline void accumulateRow(const uint8_t *p, int bytes, uint32_t *a, uint32_t *b)
+{
+    int i = 0;
+#if defined(DIRTY_SIMD_AVX2)
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+    for (; i + 32 <= bytes; i += 32) {
+        va = _mm256_add_epi32(va, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+        vb = _mm256_add_epi32(vb, va);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), va);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b), vb);
+#elif defined(DIRTY_SIMD_SSE2)
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+    for (; i + 16 <= bytes; i += 16) {
+        va = _mm_add_epi32(va, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        vb = _mm_add_epi32(vb, va);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(a), va);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b), vb);
+#elif defined(DIRTY_SIMD_NEON)
+    uint32x4_t va = vld1q_u32(a);
+    uint32x4_t vb = vld1q_u32(b);
+    for (; i + 16 <= bytes; i += 16) {
+        va = vaddq_u32(va, vreinterpretq_u32_u8(vld1q_u8(p + i)));
+        vb = vaddq_u32(vb, va);
+    }
+    vst1q_u32(a, va);
+    vst1q_u32(b, vb);
+#else
+    for (; i + kLanes * 4 <= bytes; i += kLanes * 4) {
+        for (int l = 0; l < kLanes; ++l) {
+            uint32_t w;
+            memcpy(&w, p + i + l * 4, 4);
+            a[l] += w;
+        }
+        for (int l = 0; l < kLanes; ++l) {
+            b[l] += a[l];
+        }
+    }
+#endif
+    // 行尾不足一个向量的像素（宽度非对齐时）按通道顺序标量处理
+    for (int l = 0; i + 4 <= bytes; i += 4, ++l) {
+        uint32_t w;
+        memcpy(&w, p + i, 4);
+        a[l] += w;
+        b[l] += a[l];
+    }
+}
+
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t finalizeTile(const uint32_t *a, const uint32_t *b)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (int l = 0; l < kLanes; ++l) {
+        h = mix64(h ^ ((static_cast<uint64_t>(a[l]) << 32) | b[l]));
+    }
+    return h;
+}
+
+} // namespace
+
+void DirtyRegionDetector::reset()
+{
+    m_hasHistory = false;
+    m_frameSize = QSize();
+    m_tilesX = 0;
+    m_tilesY = 0;
+    m_dirtyTiles = 0;
+    m_dirtyRatio = 1.0;
+    m_hashes.clear();
+    m_dirty.clear();
+    m_rects.clear();
+}
+
+void DirtyRegionDetector::resizeFor(int width, int height)
+{
+    m_frameSize = QSize(width, height);
+    m_tilesX = (width + kTileSize - 1) / kTileSize;
+    m_tilesY = (height + kTileSize - 1) / kTileSize;
+    const int tiles = m_tilesX * m_tilesY;
+    m_hashes.fill(0, tiles);
+    m_dirty.fill(1, tiles);
+    m_accA.fill(0, m_tilesX * kLanes);
+    m_accB.fill(0, m_tilesX * kLanes);
+    m_hasHistory = false;
+}
+
+double DirtyRegionDetector::process(const uint8_t *argb, int width, int height, int stride)
+{
+    if (!argb || width <= 0 || height <= 0 || stride < width * 4) {
+        reset();
+        return 1.0;
+    }
+
+    const bool sizeChanged = (m_frameSize != QSize(width, height));
+    if (sizeChanged) {
+        resizeFor(width, height);
+    }
+    return processTiles(argb, width, height, stride, nullptr);
+}
+
+double DirtyRegionDetector::processWithDamage(const uint8_t *argb, int width, int height, int stride,
+                                              const QVector<QRect> &damage)
+{
+    if (!m_hasHistory || m_frameSize != QSize(width, height)) {
+        return process(argb, width, height, stride);
+    }
+    if (!argb || stride < width * 4) {
+        reset();
+        return 1.0;
+    }
+
+    m_damageMask.fill(0, m_tilesX * m_tilesY);
+    const QRect bounds(0, 0, width, height);
+    for (const QRect &rect : damage) {
+        const QRect r = rect.intersected(bounds);
+        if (r.isEmpty()) {
+            continue;
+        }
+        const int tx0 = r.left() / kTileSize;
+        const int tx1 = r.right() / kTileSize;
+        for (int ty = r.top() / kTileSize; ty <= r.bottom() / kTileSize; ++ty) {
+            memset(m_damageMask.data() + ty * m_tilesX + tx0, 1, tx1 - tx0 + 1);
+        }
+    }
+    return processTiles(argb, width, height, stride, m_damageMask.constData());
+}
+
+double DirtyRegionDetector::processTiles(const uint8_t *argb, int width, int height, int stride, const uint8_t *mask)
+{
+    uint64_t *hashes = m_hashes.data();
+    uint8_t *dirty = m_dirty.data();
+    uint32_t *accA = m_accA.data();
+    uint32_t *accB = m_accB.data();
+    const int rowBytesFull = kTileSize * 4;
+    int dirtyTiles = 0;
+    qint64 dirtyArea = 0;
+
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        const int y0 = ty * kTileSize;
+        const int y1 = std::min(y0 + kTileSize, height);
+        const uint8_t *rowMask = mask ? mask + ty * m_tilesX : nullptr;
+        if (rowMask && std::find(rowMask, rowMask + m_tilesX, 1) == rowMask + m_tilesX) {
+            // 整行块均不在损坏区域内：不读像素
+            std::fill(dirty + ty * m_tilesX, dirty + (ty + 1) * m_tilesX, 0);
+            continue;
+        }
+        std::fill(accA, accA + m_tilesX * kLanes, 0u);
+        std::fill(accB, accB + m_tilesX * kLanes, 0u);
+
+        // 逐行顺序扫描整帧（对缓存友好），每行按块宽切段累加到对应块
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t *row = argb + static_cast<qint64>(y) * stride;
+            for (int tx = 0; tx < m_tilesX; ++tx) {
+                if (rowMask && !rowMask[tx]) continue;
+                const int x0 = tx * kTileSize;
+                const int bytes = (tx == m_tilesX - 1) ? (width - x0) * 4 : rowBytesFull;
+                accumulateRow(row + x0 * 4, bytes, accA + tx * kLanes, accB + tx * kLanes);
+            }
+        }
+
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            const int idx = ty * m_tilesX + tx;
+            if (rowMask && !rowMask[tx]) {
+                dirty[idx] = 0;
+                continue;
+            }
+            const uint64_t h = finalizeTile(accA + tx * kLanes, accB + tx * kLanes);
+            const bool changed = !m_hasHistory || h != hashes[idx];
+            hashes[idx] = h;
+            dirty[idx] = changed ? 1 : 0;
+            if (changed) {
+                ++dirtyTiles;
+                const int tw = std::min(kTileSize, width - tx * kTileSize);
+                dirtyArea += static_cast<qint64>(tw) * (y1 - y0);
+            }
+        }
+    }
+
+    m_hasHistory = true;
+    m_dirtyTiles = dirtyTiles;
+    m_dirtyRatio = static_cast<double>(dirtyArea) / (static_cast<qint64>(width) * height);
+    buildRects();
+    return m_dirtyRatio;
+}
+
+void DirtyRegionDetector::buildRects()
+{
+    m_rects.clear();
+    if (m_dirtyTiles == 0) {
+        return;
+    }
+    const QRect bounds(QPoint(0, 0), m_frameSize);
+    if (m_dirtyTiles == m_tilesX * m_tilesY) {
+        m_rects.append(bounds);
+        return;
+    }
+
+    // 上一块行中尚可向下延伸的行段 [起始块, 结束块) -> m_rects 下标
+    QVector<QPair<QPair<int, int>, int>> open;
+    QVector<QPair<QPair<int, int>, int>> next;
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        next.clear();
+        const uint8_t *rowBits = m_dirty.constData() + ty * m_tilesX;
+        int tx = 0;
+        while (tx < m_tilesX) {
+            if (!rowBits[tx]) { ++tx; continue; }
+            const int start = tx;
+            while (tx < m_tilesX && rowBits[tx]) ++tx;
+            const QPair<int, int> run(start, tx);
+
+            int rectIndex = -1;
+            for (const auto &o : open) {
+                if (o.first == run) { rectIndex = o.second; break; }
+            }
+            if (rectIndex >= 0) {
+                QRect &r = m_rects[rectIndex];
+                r.setBottom(std::min((ty + 1) * kTileSize, m_frameSize.height()) - 1);
+            } else {
+                QRect r(start * kTileSize, ty * kTileSize,
+                        (tx - start) * kTileSize, kTileSize);
+                m_rects.append(r.intersected(bounds));
+                rectIndex = m_rects.size() - 1;
+            }
+            next.append(qMakePair(run, rectIndex));
+        }
+        open.swap(next);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef DIRTYREGIONDETECTOR_H
+#define DIRTYREGIONDETECTOR_H
+
+#include <QVector>
+#include <QRect>
+#include <QSize>
+#include <cstdint>
+
+// 基于分块哈希的脏区域检测器
+// 将 ARGB 帧按 64x64 像素分块，单次遍历为每块计算哈希（SSE2/AVX2/NEON 向量化），
+// 与上一帧的块哈希比较得到脏块位图与合并后的脏矩形。
+// 只保留每块一个 64 位哈希，不再保存整帧副本。
+class DirtyRegionDetector
+{
+public:
+    static constexpr int kTileSize = 64;
+
+    DirtyRegionDetector() = default;
+
+    // 清空历史，下一帧视为全部变化
+    void reset();
+
+    // 处理一帧（stride 为每行字节数），返回脏区域面积占比 (0.0-1.0)
+    // 首帧或尺寸变化时所有块均标记为脏
+    double process(const uint8_t *argb, int width, int height, int stride);
+    // 带采集端损坏区域提示（如 X11 XDamage）：只对与 damage 相交的块计算哈希，其余块视为未变化；
+    // 无历史或尺寸变化时退化为整帧 process()
+    double processWithDamage(const uint8_t *argb, int width, int height, int stride,
+                             const QVector<QRect> &damage);
+
+    // 是否已有上一帧的块哈希（首帧之后为 true）
+    bool hasHistory() const { return m_hasHistory; }
+
+    // 最近一帧的结果（坐标为输入帧像素坐标）
+    QSize frameSize() const { return m_frameSize; }
+    int tilesX() const { return m_tilesX; }
+    int tilesY() const { return m_tilesY; }
+    int dirtyTileCount() const { return m_dirtyTiles; }
+    double dirtyRatio() const { return m_dirtyRatio; }
+    bool isTileDirty(int tx, int ty) const { return m_dirty[ty * m_tilesX + tx] != 0; }
+    // 行优先的脏块位图，每块一个字节（1=脏）
+    const QVector<uint8_t> &dirtyBitmap() const { return m_dirty; }
+    // 相邻脏块合并后的矩形（先横向合并为行段，再纵向合并相同行段）
+    const QVector<QRect> &dirtyRects() const { return m_rects; }
+
+private:
+    void resizeFor(int width, int height);
+    // mask 为 nullptr 时处理全部块，否则只处理 mask 非零的块
+    double processTiles(const uint8_t *argb, int width, int height, int stride, const uint8_t *mask);
+    void buildRects();
+
+    QSize m_frameSize;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    bool m_hasHistory = false;
+    int m_dirtyTiles = 0;
+    double m_dirtyRatio = 1.0;
+
+    QVector<uint64_t> m_hashes;   // 上一帧每块哈希
+    QVector<uint8_t> m_dirty;     // 当前帧脏块位图
+    QVector<QRect> m_rects;
+    QVector<uint32_t> m_accA;     // 当前块行的累加器（每块 kLanes 个通道）
+    QVector<uint32_t> m_accB;
+    QVector<uint8_t> m_damageMask; // 损坏区域覆盖的块
+};
+
+#endif // DIRTYREGIONDETECTOR_H
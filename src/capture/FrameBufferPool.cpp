@@ -0,0 +1,253 @@
+#include "FrameBufferPool.h"
+
+#include <QMutexLocker>
+#include <cstdlib>
+#include <algorithm>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// 64 字节对齐：整行 SIMD 读取（哈希、色彩转换、缩放）不跨缓存行起始
+constexpr size_t kAlignment = 64;
+
+uchar *allocAligned(qint64 bytes)
+{
+    const size_t size = static_cast<size_t>(std::max<qint64>(bytes, 1));
+#ifdef _WIN32
+    return static_cast<uchar *>(_aligned_malloc(size, kAlignment));
+#else
+    void *p = nullptr;
+    return posix_memalign(&p, kAlignment, size) == 0 ? static_cast<uchar *>(p) : nullptr;
+#endif
+}
+
+void freeAligned(uchar *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+FrameBufferSlot *newSlot(qint64 bytes)
+{
+    FrameBufferSlot *slot = new FrameBufferSlot;
+    slot->data = allocAligned(bytes);
+    slot->capacity = slot->data ? bytes : 0;
+    return slot;
+}
+
+void deleteSlot(FrameBufferSlot *slot)
+{
+    freeAligned(slot->data);
+    delete slot;
+}
+
+} // namespace
+
+FrameBuffer::FrameBuffer(const FrameBuffer &other)
+    : m_slot(other.m_slot)
+{
+    if (m_slot) {
+        m_slot->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer &&other) noexcept
+    : m_slot(other.m_slot)
+{
+    other.m_slot = nullptr;
+}
+
+FrameBuffer &FrameBuffer::operator=(const FrameBuffer &other)
+{
+    if (m_slot != other.m_slot) {
+        FrameBuffer copy(other);
+        std::swap(m_slot, copy.m_slot);
+    }
+    return *this;
+}
+
+FrameBuffer &FrameBuffer::operator=(FrameBuffer &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_slot = other.m_slot;
+        other.m_slot = nullptr;
+    }
+    return *this;
+}
+
+FrameBuffer FrameBuffer::allocate(const QSize &size)
+{
+    if (size.isEmpty()) {
+        return FrameBuffer();
+    }
+    FrameBufferSlot *slot = newSlot(qint64(size.width()) * size.height() * 4);
+    if (!slot->data) {
+        deleteSlot(slot);
+        return FrameBuffer();
+    }
+    slot->size = size;
+    slot->refs.store(1, std::memory_order_relaxed);
+    return FrameBuffer(slot);
+}
+
+void FrameBuffer::release()
+{
+    FrameBufferSlot *slot = m_slot;
+    m_slot = nullptr;
+    if (!slot || slot->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (slot->pool) {
+        slot->pool->recycle(slot);
+    } else {
+        deleteSlot(slot);
+    }
+}
+
+QByteArray FrameBuffer::bytes() const
+{
+    if (!m_slot) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_slot->data), byteSize());
+}
+
+FrameBufferPool::FrameBufferPool(int maxSlots)
+    : m_maxSlots(std::max(1, maxSlots))
+{
+    m_slots.reserve(m_maxSlots);
+    m_free.reserve(m_maxSlots);
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+    QMutexLocker locker(&m_mutex);
+    for (FrameBufferSlot *slot : m_slots) {
+        deleteSlot(slot);
+    }
+    m_slots.clear();
+    m_free.clear();
+}
+
+void FrameBufferPool::addResident(qint64 bytes)
+{
+    const qint64 now = m_residentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    qint64 peak = m_peakResidentBytes.load(std::memory_order_relaxed);
+    while (now > peak && !m_peakResidentBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+FrameBuffer FrameBufferPool::acquire(const QSize &size)
+{
+    if (size.isEmpty()) {
+        return FrameBuffer();
+    }
+    m_acquires.fetch_add(1, std::memory_order_relaxed);
+    const qint64 bytes = qint64(size.width()) * size.height() * 4;
+
+    FrameBufferSlot *slot = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        // 最佳适配：容量足够的空闲槽位中取最小的（主流与各级缩放流尺寸不同，避免小帧占用大槽位）
+        int best = -1;
+        for (int i = 0; i < m_free.size(); ++i) {
+            if (m_free[i]->capacity >= bytes && (best < 0 || m_free[i]->capacity < m_free[best]->capacity)) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            slot = m_free.takeAt(best);
+            m_reuses.fetch_add(1, std::memory_order_relaxed);
+        } else if (m_slots.size() < m_maxSlots) {
+            slot = newSlot(bytes);
+            if (!slot->data) {
+                deleteSlot(slot);
+                return FrameBuffer();
+            }
+            slot->pool = this;
+            slot->pooled = true;
+            m_slots.append(slot);
+            addResident(bytes);
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+        } else if (!m_free.isEmpty()) {
+            // 槽位数已满且空闲槽位都偏小（分辨率变大）：扩容其中最大的一个
+            int largest = 0;
+            for (int i = 1; i < m_free.size(); ++i) {
+                if (m_free[i]->capacity > m_free[largest]->capacity) {
+                    largest = i;
+                }
+            }
+            slot = m_free.takeAt(largest);
+            uchar *data = allocAligned(bytes);
+            if (!data) {
+                m_free.append(slot);
+                return FrameBuffer();
+            }
+            freeAligned(slot->data);
+            addResident(bytes - slot->capacity);
+            slot->data = data;
+            slot->capacity = bytes;
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (!slot) {
+        // 全部槽位在用（下游积压）：临时分配，释放后直接归还系统
+        m_exhaustions.fetch_add(1, std::memory_order_relaxed);
+        slot = newSlot(bytes);
+        if (!slot->data) {
+            deleteSlot(slot);
+            return FrameBuffer();
+        }
+        slot->pool = this;
+        slot->pooled = false;
+        addResident(bytes);
+    }
+
+    slot->size = size;
+    slot->refs.store(1, std::memory_order_release);
+    return FrameBuffer(slot);
+}
+
+void FrameBufferPool::recycle(FrameBufferSlot *slot)
+{
+    if (!slot->pooled) {
+        m_residentBytes.fetch_sub(slot->capacity, std::memory_order_relaxed);
+        deleteSlot(slot);
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_free.append(slot);
+}
+
+void FrameBufferPool::trim()
+{
+    QMutexLocker locker(&m_mutex);
+    for (FrameBufferSlot *slot : m_free) {
+        m_slots.removeOne(slot);
+        m_residentBytes.fetch_sub(slot->capacity, std::memory_order_relaxed);
+        deleteSlot(slot);
+    }
+    m_free.clear();
+}
+
+FrameBufferPool::Stats FrameBufferPool::stats() const
+{
+    Stats s;
+    s.acquires = m_acquires.load(std::memory_order_relaxed);
+    s.reuses = m_reuses.load(std::memory_order_relaxed);
+    s.allocations = m_allocations.load(std::memory_order_relaxed);
+    s.exhaustions = m_exhaustions.load(std::memory_order_relaxed);
+    s.residentBytes = m_residentBytes.load(std::memory_order_relaxed);
+    s.peakResidentBytes = m_peakResidentBytes.load(std::memory_order_relaxed);
+    QMutexLocker locker(&m_mutex);
+    s.slots = m_slots.size();
+    s.inUse = m_slots.size() - m_free.size();
+    return s;
+}
@@ -0,0 +1,102 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSize>
+#include <QVector>
+#include <atomic>
+
+class FrameBufferPool;
+
+// 帧缓冲槽位：64 字节对齐的紧凑 ARGB 内存（stride = width * 4）
+struct FrameBufferSlot {
+    uchar *data = nullptr;
+    qint64 capacity = 0;
+    QSize size;
+    std::atomic<int> refs{0};
+    FrameBufferPool *pool = nullptr;   // nullptr：独立分配，最后释放时直接归还系统
+    bool pooled = false;               // false：池耗尽时的临时缓冲，释放后不回池
+};
+
+// 帧缓冲句柄：采集、静态检测、缩放与编码之间按引用共享同一块内存。
+// 复制句柄只增加引用计数；最后一个句柄 release()/析构时缓冲回到池中。
+// 句柄可跨线程传递，但只有唯一持有者（刚 acquire 时）可以写入。
+class FrameBuffer
+{
+public:
+    FrameBuffer() = default;
+    FrameBuffer(const FrameBuffer &other);
+    FrameBuffer(FrameBuffer &&other) noexcept;
+    FrameBuffer &operator=(const FrameBuffer &other);
+    FrameBuffer &operator=(FrameBuffer &&other) noexcept;
+    ~FrameBuffer() { release(); }
+
+    // 不经过缓冲池的独立分配（未设置缓冲池时使用）
+    static FrameBuffer allocate(const QSize &size);
+
+    void release();
+    bool isNull() const { return !m_slot; }
+    QSize frameSize() const { return m_slot ? m_slot->size : QSize(); }
+    int stride() const { return m_slot ? m_slot->size.width() * 4 : 0; }
+    int byteSize() const { return m_slot ? m_slot->size.width() * m_slot->size.height() * 4 : 0; }
+    uchar *data() { return m_slot ? m_slot->data : nullptr; }
+    const uchar *constData() const { return m_slot ? m_slot->data : nullptr; }
+    // 零拷贝 QByteArray 视图，供只在调用期间读取数据的接口使用（如 VP9Encoder::encode），
+    // 视图不持有引用，调用方须同时持有句柄
+    QByteArray bytes() const;
+
+private:
+    friend class FrameBufferPool;
+    explicit FrameBuffer(FrameBufferSlot *slot) : m_slot(slot) {}
+    FrameBufferSlot *m_slot = nullptr;
+};
+
+// 采集帧缓冲池：固定数量的预分配槽位，acquire 取最合适的空闲槽位（容量够用且最小），
+// 稳态下每帧零分配。全部槽位在用时退化为临时分配并计入耗尽次数。
+// 线程安全；缓冲池必须比其发出的所有句柄活得更久。
+class FrameBufferPool
+{
+public:
+    struct Stats {
+        quint64 acquires = 0;
+        quint64 reuses = 0;
+        quint64 allocations = 0;        // 新建或扩容槽位次数
+        quint64 exhaustions = 0;        // 槽位全部在用、改为临时分配的次数
+        int slots = 0;
+        int inUse = 0;
+        qint64 residentBytes = 0;       // 池内槽位 + 在用临时缓冲
+        qint64 peakResidentBytes = 0;
+    };
+
+    explicit FrameBufferPool(int maxSlots = 12);
+    ~FrameBufferPool();
+
+    FrameBufferPool(const FrameBufferPool &) = delete;
+    FrameBufferPool &operator=(const FrameBufferPool &) = delete;
+
+    FrameBuffer acquire(const QSize &size);
+    // 释放全部空闲槽位（停止推流/切屏后尺寸变化时调用，降低常驻内存）
+    void trim();
+
+    Stats stats() const;
+
+private:
+    friend class FrameBuffer;
+    void recycle(FrameBufferSlot *slot);
+    void addResident(qint64 bytes);
+
+    mutable QMutex m_mutex;
+    QVector<FrameBufferSlot *> m_slots;
+    QVector<FrameBufferSlot *> m_free;
+    int m_maxSlots;
+
+    std::atomic<quint64> m_acquires{0};
+    std::atomic<quint64> m_reuses{0};
+    std::atomic<quint64> m_allocations{0};
+    std::atomic<quint64> m_exhaustions{0};
+    std::atomic<qint64> m_residentBytes{0};
+    std::atomic<qint64> m_peakResidentBytes{0};
+};
+
+#endif // FRAMEBUFFERPOOL_H
@@ -0,0 +1,150 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 捕获→编码之间的“最新帧”队列（无锁，单生产者/单消费者）
+// 生产端写满时直接覆盖最旧的槽位；消费端一次取走全部槽位，只保留序号最大的一帧，
+// 其余全部计为丢弃。编码端永远只处理最新画面，慢编码不会导致积压。
+template <typename T>
+class LatestFrameQueue
+{
+public:
+    explicit LatestFrameQueue(std::size_t capacity = 2)
+        : m_slots(capacity < 1 ? 1 : capacity)
+    {
+        for (auto &s : m_slots) {
+            s.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~LatestFrameQueue()
+    {
+        clear();
+    }
+
+    LatestFrameQueue(const LatestFrameQueue &) = delete;
+    LatestFrameQueue &operator=(const LatestFrameQueue &) = delete;
+
+    // 生产端：写入一帧（接管所有权）。item 需带有单调递增的 seq 字段
+    void push(T *item)
+    {
+        const std::size_t idx = m_writeIndex++ % m_slots.size();
+        T *old = m_slots[idx].exchange(item, std::memory_order_acq_rel);
+        if (old) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            delete old;
+        } else {
+            m_depth.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 消费端：取出最新的一帧（调用方接管所有权），无数据时返回 nullptr
+    T *takeNewest()
+    {
+        T *newest = nullptr;
+        for (auto &s : m_slots) {
+            T *p = s.exchange(nullptr, std::memory_order_acq_rel);
+            if (!p) continue;
+            m_depth.fetch_sub(1, std::memory_order_relaxed);
+            if (!newest || p->seq > newest->seq) {
+                if (newest) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    delete newest;
+                }
+                newest = p;
+            } else {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                delete p;
+            }
+        }
+        return newest;
+    }
+
+    void clear()
+    {
+        for (auto &s : m_slots) {
+            T *p = s.exchange(nullptr, std::memory_order_acq_rel);
+            if (p) {
+                m_depth.fetch_sub(1, std::memory_order_relaxed);
+                delete p;
+            }
+        }
+    }
+
+    int depth() const { return m_depth.load(std::memory_order_relaxed); }
+    std::uint64_t droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+    std::uint64_t pushedCount() const { return m_pushed.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<std::atomic<T*>> m_slots;
+    std::size_t m_writeIndex = 0; // 仅生产端访问
+    std::atomic<int> m_depth{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<std::uint64_t> m_pushed{0};
+};
+
+// 编码→发送之间的有界 FIFO（无锁，单生产者/单消费者，经典环形缓冲）
+// 编码后的数据包不能随意丢弃（会破坏参考链），因此满时拒绝写入，由调用方决定
+// 丢弃到下一个关键帧。
+template <typename T>
+class SpscRingQueue
+{
+public:
+    explicit SpscRingQueue(std::size_t capacity = 16)
+        : m_buffer(roundUpPow2(capacity < 2 ? 2 : capacity))
+        , m_mask(m_buffer.size() - 1)
+    {
+    }
+
+    bool push(T &&item)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        if (tail - head >= m_buffer.size()) {
+            return false;
+        }
+        m_buffer[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &out)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        const std::size_t tail = m_tail.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+        out = std::move(m_buffer[head & m_mask]);
+        m_buffer[head & m_mask] = T();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    int depth() const
+    {
+        return static_cast<int>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+    }
+
+    int capacity() const { return static_cast<int>(m_buffer.size()); }
+
+private:
+    static std::size_t roundUpPow2(std::size_t v)
+    {
+        std::size_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    std::vector<T> m_buffer;
+    const std::size_t m_mask;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,104 @@
+#include "KeyFramePolicy.h"
+
+KeyFramePolicy::Mode KeyFramePolicy::modeFromString(const QString &name, Mode fallback)
+{
+    const QString v = name.trimmed().toLower();
+    if (v == QStringLiteral("on_demand") || v == QStringLiteral("ondemand")) {
+        return Mode::OnDemand;
+    }
+    if (v == QStringLiteral("periodic")) {
+        return Mode::Periodic;
+    }
+    if (v == QStringLiteral("intra_refresh") || v == QStringLiteral("intrarefresh")) {
+        return Mode::IntraRefresh;
+    }
+    return fallback;
+}
+
+QString KeyFramePolicy::modeName(Mode mode)
+{
+    switch (mode) {
+    case Mode::OnDemand:
+        return QStringLiteral("on_demand");
+    case Mode::Periodic:
+        return QStringLiteral("periodic");
+    case Mode::IntraRefresh:
+        return QStringLiteral("intra_refresh");
+    }
+    return QString();
+}
+
+void KeyFramePolicy::request()
+{
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    m_pendingRequests.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void KeyFramePolicy::reset()
+{
+    m_forceNext.store(true, std::memory_order_release);
+}
+
+bool KeyFramePolicy::shouldForceKeyFrame(qint64 nowMs)
+{
+    if (m_forceNext.load(std::memory_order_acquire)) {
+        return true;
+    }
+    const qint64 sinceKey = nowMs - m_lastKeyFrameMs;
+    if (m_pendingRequests.load(std::memory_order_acquire) > 0 && sinceKey >= m_minIntervalMs) {
+        return true;
+    }
+    if (m_mode == Mode::Periodic && sinceKey >= m_periodMs) {
+        return true;
+    }
+    return false;
+}
+
+void KeyFramePolicy::onFrameEncoded(bool keyFrame, int bytes, qint64 nowMs)
+{
+    if (!keyFrame) {
+        m_deltaFrames.fetch_add(1, std::memory_order_relaxed);
+        m_deltaFrameBytes.fetch_add(static_cast<quint64>(bytes), std::memory_order_relaxed);
+        return;
+    }
+
+    // 一个关键帧满足此前全部请求：第一个请求计为触发，其余计为合并
+    m_forceNext.store(false, std::memory_order_release);
+    const int pending = m_pendingRequests.exchange(0, std::memory_order_acq_rel);
+    if (pending > 1) {
+        m_coalescedRequests.fetch_add(static_cast<quint64>(pending - 1), std::memory_order_relaxed);
+    }
+
+    if (m_lastKeyFrameMs > 0) {
+        const qint64 interval = nowMs - m_lastKeyFrameMs;
+        const qint64 avg = m_avgKeyIntervalMs.load(std::memory_order_relaxed);
+        m_avgKeyIntervalMs.store(avg > 0 ? (avg * 7 + interval) / 8 : interval, std::memory_order_relaxed);
+    }
+    m_lastKeyFrameMs = nowMs;
+    m_keyFrames.fetch_add(1, std::memory_order_relaxed);
+    m_keyFrameBytes.fetch_add(static_cast<quint64>(bytes), std::memory_order_relaxed);
+    m_lastKeyFrameBytes.store(bytes, std::memory_order_relaxed);
+}
+
+bool KeyFramePolicy::keyFrameDue(qint64 nowMs) const
+{
+    if (m_forceNext.load(std::memory_order_acquire)
+        || m_pendingRequests.load(std::memory_order_acquire) > 0) {
+        return true;
+    }
+    return m_mode == Mode::Periodic && nowMs - m_lastKeyFrameMs >= m_periodMs;
+}
+
+KeyFramePolicy::Stats KeyFramePolicy::stats() const
+{
+    Stats s;
+    s.keyFrames = m_keyFrames.load(std::memory_order_relaxed);
+    s.keyFrameBytes = m_keyFrameBytes.load(std::memory_order_relaxed);
+    s.deltaFrames = m_deltaFrames.load(std::memory_order_relaxed);
+    s.deltaFrameBytes = m_deltaFrameBytes.load(std::memory_order_relaxed);
+    s.requests = m_requests.load(std::memory_order_relaxed);
+    s.coalescedRequests = m_coalescedRequests.load(std::memory_order_relaxed);
+    s.lastKeyFrameBytes = m_lastKeyFrameBytes.load(std::memory_order_relaxed);
+    s.avgKeyIntervalMs = m_avgKeyIntervalMs.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,82 @@
+#ifndef KEYFRAMEPOLICY_H
+#define KEYFRAMEPOLICY_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// 关键帧策略：每个编码器一个实例，统一决定哪一帧强制为关键帧（替代编码器内固定节奏、
+// 采集循环 8 秒保活与各处零散请求）
+// - OnDemand：只在请求时生成；多个观看端的请求在同一关键帧内合并，且两次关键帧间隔不小于
+//   最小间隔（期间到达的请求延后到间隔结束，不丢弃）
+// - Periodic（默认）：按需之外，距上一关键帧超过周期（默认 8 秒）时生成，即关键帧保活：
+//   中继 GOP 缓存随之更新，请求丢失的观看端最迟一个周期后恢复
+// - IntraRefresh：按需生成，平时由编码器循环帧内刷新（VP9 cyclic refresh）逐帧刷新部分块，
+//   不再周期性插入整帧关键帧（没有保活，只在显式配置时使用）
+// 编码器自行产生的关键帧（如尺寸变化）同样计入，并满足尚未处理的请求。
+// 线程：request() 与 stats() 任意线程；其余在编码线程（持编码器锁）调用。
+class KeyFramePolicy
+{
+public:
+    enum class Mode {
+        OnDemand,
+        Periodic,
+        IntraRefresh
+    };
+
+    struct Stats {
+        quint64 keyFrames = 0;
+        quint64 keyFrameBytes = 0;
+        quint64 deltaFrames = 0;
+        quint64 deltaFrameBytes = 0;
+        quint64 requests = 0;           // 收到的请求总数
+        quint64 coalescedRequests = 0;  // 被合并（未单独产生关键帧）的请求数
+        qint64 lastKeyFrameBytes = 0;
+        qint64 avgKeyIntervalMs = 0;    // 关键帧间隔的指数平均
+    };
+
+    void setMode(Mode mode) { m_mode = mode; }
+    Mode mode() const { return m_mode; }
+    void setPeriodMs(int periodMs) { m_periodMs = periodMs > 0 ? periodMs : 8000; }
+    int periodMs() const { return m_periodMs; }
+    void setMinIntervalMs(int intervalMs) { m_minIntervalMs = intervalMs > 0 ? intervalMs : 0; }
+
+    // "on_demand" / "periodic" / "intra_refresh"，无法识别时返回 fallback
+    static Mode modeFromString(const QString &name, Mode fallback);
+    static QString modeName(Mode mode);
+
+    // 任意线程：登记一次关键帧请求
+    void request();
+    // 编码器新建/推流重新开始：下一帧必须为关键帧（不受最小间隔限制）
+    void reset();
+
+    // 编码线程：本帧是否强制关键帧
+    bool shouldForceKeyFrame(qint64 nowMs);
+    // 编码线程：记录本帧结果（keyFrame 以编码器实际输出为准）
+    void onFrameEncoded(bool keyFrame, int bytes, qint64 nowMs);
+    // 编码线程：下一帧是否应为关键帧（未满足的请求或周期保活到期）；
+    // 跳过静态帧前必须检查，否则静止画面下请求与保活都发不出去
+    bool keyFrameDue(qint64 nowMs) const;
+
+    Stats stats() const;
+
+private:
+    Mode m_mode = Mode::Periodic;
+    int m_periodMs = 8000;
+    int m_minIntervalMs = 1000;
+
+    std::atomic<int> m_pendingRequests{0};
+    std::atomic<bool> m_forceNext{true};
+    qint64 m_lastKeyFrameMs = 0;        // 仅编码线程访问
+
+    std::atomic<quint64> m_keyFrames{0};
+    std::atomic<quint64> m_keyFrameBytes{0};
+    std::atomic<quint64> m_deltaFrames{0};
+    std::atomic<quint64> m_deltaFrameBytes{0};
+    std::atomic<quint64> m_requests{0};
+    std::atomic<quint64> m_coalescedRequests{0};
+    std::atomic<qint64> m_lastKeyFrameBytes{0};
+    std::atomic<qint64> m_avgKeyIntervalMs{0};
+};
+
+#endif // KEYFRAMEPOLICY_H
@@ -3,7 +3,8 @@
 #include <QGuiApplication>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <chrono>
+#include <QDateTime>
+#include "../common/BinaryMessage.h"
 
 MouseCapture::MouseCapture(QObject *parent)
     : QObject(parent)
@@ -65,9 +66,8 @@ void MouseCapture::checkMousePosition()
         // 发送位置变化信号
         emit mousePositionChanged(currentPosition);
         
-        // 生成JSON消息并发送
-        QString jsonMessage = createMousePositionMessage(currentPosition);
-        emit mousePositionMessage(jsonMessage);
+        // 生成二进制光标消息并发送
+        emit mousePositionMessage(createMousePositionMessage(currentPosition));
         
         // 每100次位置更新输出一次调试信息（避免日志过多）
         static int positionUpdateCount = 0;
@@ -137,20 +137,10 @@ QPoint MouseCapture::getSystemMousePosition() const
 #endif
 }
 
-QString MouseCapture::createMousePositionMessage(const QPoint &position)
+QByteArray MouseCapture::createMousePositionMessage(const QPoint &position)
 {
-    // 创建JSON消息
-    QJsonObject messageObj;
-    messageObj["type"] = "mouse_position";
-    messageObj["x"] = position.x();
-    messageObj["y"] = position.y();
-    
-    // 添加时间戳（微秒）
-    auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-    messageObj["timestamp"] = static_cast<qint64>(timestamp);
-    
-    // 转换为JSON字符串
-    QJsonDocument doc(messageObj);
-    return doc.toJson(QJsonDocument::Compact);
+    BinaryMessage::Cursor cursor;
+    cursor.x = position.x();
+    cursor.y = position.y();
+    return BinaryMessage::encodeCursor(m_messageSeq++, QDateTime::currentMSecsSinceEpoch(), cursor);
 }
\ No newline at end of file
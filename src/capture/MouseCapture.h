@@ -26,13 +26,14 @@ public:
     
     // 设置捕获区域和目标分辨率（处理坐标偏移和缩放）
     void setScreenRect(const QRect &sourceRect, const QSize &targetSize);
+    QRect screenRect() const { return m_sourceRect; }
 
     QPoint getCurrentPosition() const;
     bool isCapturing() const { return m_isCapturing; }
     
 signals:
     void mousePositionChanged(const QPoint &position);
-    void mousePositionMessage(const QString &jsonMessage);
+    void mousePositionMessage(const QByteArray &message); // 二进制光标消息（BinaryMessage::Cursor）
 
 private slots:
     void checkMousePosition();
@@ -49,7 +50,8 @@ private:
     bool m_needScaling;
 
     QPoint getSystemMousePosition() const;
-    QString createMousePositionMessage(const QPoint &position);
+    QByteArray createMousePositionMessage(const QPoint &position);
+    quint32 m_messageSeq = 0;
 };
 
 #endif // MOUSECAPTURE_H
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "PacketBufferPool.h"
+#include <cstring>
+#include <algorithm>
+
+namespace {
+// 首次分配的最小容量，避免小包（静态画面）之后的大包（关键帧）反复扩容
+constexpr int kMinCapacity = 64 * 1024;
+}
+
+PacketBufferPool::PacketBufferPool(int maxPooled)
+    : m_maxPooled(std::max(1, maxPooled))
+{
+    m_buffers.reserve(m_maxPooled);
+}
+
+QByteArray PacketBufferPool::build(const PacketMeta &meta, const char *payload, int payloadSize)
+{
+    m_builds.fetch_add(1, std::memory_order_relaxed);
+    const int total = kPacketHeaderSize + payloadSize;
+
+    // 轮询查找下游已释放的缓冲（只有池自身持有引用）
+    QByteArray *slot = nullptr;
+    const int n = m_buffers.size();
+    for (int i = 0; i < n; ++i) {
+        const int idx = (m_nextIndex + i) % n;
+        if (m_buffers[idx].isDetached()) {
+            slot = &m_buffers[idx];
+            m_nextIndex = (idx + 1) % n;
+            break;
+        }
+    }
+    if (!slot && n < m_maxPooled) {
+        m_buffers.append(QByteArray());
+        slot = &m_buffers.last();
+        m_pooled.store(m_buffers.size(), std::memory_order_relaxed);
+    }
+
+    QByteArray out;
+    QByteArray &buf = slot ? *slot : out; // 池已满且全部在途：退化为一次性缓冲
+    if (buf.capacity() < total) {
+        buf.reserve(std::max(kMinCapacity, total + total / 2));
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        m_reuses.fetch_add(1, std::memory_order_relaxed);
+    }
+    buf.resize(total);
+
+    // 头部：毫秒时间戳 + 时间层/关键帧/流ID 标签 + 消息类型与序号/基础层序号
+    char *dst = buf.data();
+    PacketHeader::writeMessage(dst, PacketHeader::MessageType::Video, meta.seq, meta.timestampMs,
+                               meta.streamId, meta.temporalId, meta.keyFrame, meta.baseSeq);
+    if (payloadSize > 0) {
+        memcpy(dst + kPacketHeaderSize, payload, payloadSize);
+    }
+
+    return slot ? *slot : out;
+}
+
+void PacketBufferPool::clear()
+{
+    m_buffers.clear();
+    m_nextIndex = 0;
+    m_pooled.store(0, std::memory_order_relaxed);
+}
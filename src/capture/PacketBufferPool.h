@@ -0,0 +1,54 @@
+#ifndef PACKETBUFFERPOOL_H
+#define PACKETBUFFERPOOL_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QMetaType>
+#include <atomic>
+
+#include "../common/PacketHeader.h"
+
+// 视频数据包：版本 1 消息头部（16 字节：时间戳、层/关键帧/流ID、类型、序号）+ VP9 负载，格式见 PacketHeader.h
+constexpr int kPacketHeaderSize = PacketHeader::kMessageHeaderSize;
+
+// 数据包元信息：随数据包在进程内传递（序号、基础层序号、关键帧标志、时间层、流ID）
+struct PacketMeta {
+    qint64 timestampMs = 0;
+    quint32 seq = 0;
+    quint16 baseSeq = 0;
+    bool keyFrame = false;
+    quint8 temporalId = 0;
+    quint8 streamId = 0;
+};
+Q_DECLARE_METATYPE(PacketMeta)
+
+// 编码输出缓冲池
+// 编码器把头部与负载一次写入池中的缓冲，同一块内存经发送队列直达 socket；
+// 下游释放引用后（QByteArray 引用计数回到 1）缓冲自动回到可用状态，稳态下每帧零分配。
+// 非线程安全：只能在编码线程内调用 build；统计计数可在任意线程读取。
+class PacketBufferPool
+{
+public:
+    explicit PacketBufferPool(int maxPooled = 32);
+
+    // 写入头部（时间戳与层标签）与负载，返回共享引用
+    QByteArray build(const PacketMeta &meta, const char *payload, int payloadSize);
+
+    void clear();
+
+    quint64 buildCount() const { return m_builds.load(std::memory_order_relaxed); }
+    quint64 allocationCount() const { return m_allocations.load(std::memory_order_relaxed); }
+    quint64 reuseCount() const { return m_reuses.load(std::memory_order_relaxed); }
+    int pooledCount() const { return m_pooled.load(std::memory_order_relaxed); }
+
+private:
+    QVector<QByteArray> m_buffers;
+    int m_maxPooled;
+    int m_nextIndex = 0;
+    std::atomic<quint64> m_builds{0};
+    std::atomic<quint64> m_allocations{0};
+    std::atomic<quint64> m_reuses{0};
+    std::atomic<int> m_pooled{0};
+};
+
+#endif // PACKETBUFFERPOOL_H
@@ -0,0 +1,307 @@
+#include "RawFrameFile.h"
+
+#include <cstddef>
+#include <cstring>
+
+RawFrameReader::~RawFrameReader()
+{
+    close();
+}
+
+bool RawFrameReader::mapFile(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_fileSize = m_file.size();
+    m_data = m_fileSize > 0 ? m_file.map(0, m_fileSize) : nullptr;
+    if (!m_data) {
+        m_error = QStringLiteral("mmap failed: %1").arg(m_file.errorString());
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool RawFrameReader::open(const QString &path)
+{
+    using namespace RawFrameFormat;
+    if (!mapFile(path)) {
+        return false;
+    }
+
+    FileHeader header;
+    if (m_fileSize < qint64(sizeof(header))) {
+        m_error = QStringLiteral("file too small");
+        close();
+        return false;
+    }
+    memcpy(&header, m_data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.width == 0 || header.height == 0 || header.stride < header.width * 4) {
+        m_error = QStringLiteral("not a raw frame file");
+        close();
+        return false;
+    }
+
+    m_size = QSize(int(header.width), int(header.height));
+    m_stride = int(header.stride);
+    m_fps = header.fpsHint > 0 ? int(header.fpsHint) : 30;
+    m_headerless = false;
+
+    // 解析一条帧记录：校验边界并登记像素偏移，返回下一条记录偏移（失败返回 -1）
+    const qint64 pixelBytes = qint64(m_stride) * m_size.height();
+    qint64 lastPixels = -1;
+    auto addRecord = [&](qint64 offset) -> qint64 {
+        FrameHeader fh;
+        if (offset < qint64(sizeof(header)) || offset + qint64(sizeof(fh)) > m_fileSize) {
+            return -1;
+        }
+        memcpy(&fh, m_data + offset, sizeof(fh));
+        if (fh.rectCount > quint32(m_fileSize / qint64(sizeof(DirtyRect)))) {
+            return -1;
+        }
+        const qint64 body = alignUp(offset + qint64(sizeof(fh)) + qint64(fh.rectCount) * qint64(sizeof(DirtyRect)));
+        qint64 pixels = body;
+        qint64 next = body;
+        if (fh.flags & kRepeat) {
+            if (lastPixels < 0) {
+                return -1;
+            }
+            pixels = lastPixels;
+        } else {
+            if (body + pixelBytes > m_fileSize) {
+                return -1;
+            }
+            next = alignUp(body + pixelBytes);
+        }
+        lastPixels = pixels;
+        m_offsets.append(offset);
+        m_pixelOffsets.append(pixels);
+        return next;
+    };
+
+    const qint64 indexBytes = qint64(header.frameCount) * qint64(sizeof(quint64));
+    if (header.indexOffset != 0 && qint64(header.indexOffset) + indexBytes <= m_fileSize) {
+        m_offsets.reserve(int(header.frameCount));
+        m_pixelOffsets.reserve(int(header.frameCount));
+        for (quint32 i = 0; i < header.frameCount; ++i) {
+            quint64 offset = 0;
+            memcpy(&offset, m_data + header.indexOffset + i * sizeof(quint64), sizeof(offset));
+            if (addRecord(qint64(offset)) < 0) {
+                break;
+            }
+        }
+    } else {
+        // 录制未正常结束：从头顺序扫描，截断到最后一条完整记录
+        qint64 offset = alignUp(qint64(sizeof(header)));
+        while (offset > 0 && offset < m_fileSize) {
+            offset = addRecord(offset);
+        }
+    }
+    return true;
+}
+
+bool RawFrameReader::openRaw(const QString &path, const QSize &size, int fps)
+{
+    if (size.isEmpty()) {
+        m_error = QStringLiteral("frame size required for headerless input");
+        return false;
+    }
+    if (!mapFile(path)) {
+        return false;
+    }
+    m_size = size;
+    m_stride = size.width() * 4;
+    m_fps = fps > 0 ? fps : 30;
+    m_headerless = true;
+    const qint64 frameBytes = qint64(m_stride) * size.height();
+    const qint64 count = m_fileSize / frameBytes;
+    m_offsets.reserve(int(count));
+    for (qint64 i = 0; i < count; ++i) {
+        m_offsets.append(i * frameBytes);
+    }
+    return true;
+}
+
+void RawFrameReader::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_fileSize = 0;
+    m_offsets.clear();
+    m_pixelOffsets.clear();
+}
+
+RawFrameReader::Frame RawFrameReader::frame(int index) const
+{
+    using namespace RawFrameFormat;
+    Frame f;
+    if (!m_data || index < 0 || index >= m_offsets.size()) {
+        return f;
+    }
+    const qint64 offset = m_offsets.at(index);
+    f.stride = m_stride;
+    if (m_headerless) {
+        f.argb = m_data + offset;
+        f.timestampUs = qint64(index) * 1000000 / m_fps;
+        return f;
+    }
+
+    FrameHeader fh;
+    memcpy(&fh, m_data + offset, sizeof(fh));
+    f.timestampUs = fh.timestampUs;
+    f.fullFrame = (fh.flags & kFullFrame) != 0;
+    const uchar *rects = m_data + offset + sizeof(fh);
+    f.dirtyRects.reserve(int(fh.rectCount));
+    for (quint32 i = 0; i < fh.rectCount; ++i) {
+        DirtyRect r;
+        memcpy(&r, rects + i * sizeof(DirtyRect), sizeof(r));
+        f.dirtyRects.append(QRect(r.x, r.y, r.width, r.height));
+    }
+    f.argb = m_data + m_pixelOffsets.at(index);
+    return f;
+}
+
+qint64 RawFrameReader::timestampUs(int index) const
+{
+    if (!m_data || index < 0 || index >= m_offsets.size()) {
+        return 0;
+    }
+    if (m_headerless) {
+        return qint64(index) * 1000000 / m_fps;
+    }
+    qint64 ts = 0;
+    memcpy(&ts, m_data + m_offsets.at(index) + offsetof(RawFrameFormat::FrameHeader, timestampUs), sizeof(ts));
+    return ts;
+}
+
+RawFrameWriter::~RawFrameWriter()
+{
+    finish();
+}
+
+bool RawFrameWriter::open(const QString &path, const QSize &size, int fpsHint)
+{
+    using namespace RawFrameFormat;
+    finish();
+    if (size.isEmpty()) {
+        m_error = QStringLiteral("invalid frame size");
+        return false;
+    }
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_size = size;
+    m_fps = fpsHint > 0 ? fpsHint : 30;
+    m_pos = 0;
+    m_offsets.clear();
+
+    // 先写未完成的头部（indexOffset = 0），finish() 时回填
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.headerSize = sizeof(FileHeader);
+    header.width = quint32(size.width());
+    header.height = quint32(size.height());
+    header.stride = quint32(size.width() * 4);
+    header.fpsHint = quint32(m_fps);
+    if (!writeBytes(&header, sizeof(header))) {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool RawFrameWriter::append(const uchar *argb, int stride, qint64 timestampUs,
+                            const QVector<QRect> &dirtyRects, bool fullFrame)
+{
+    using namespace RawFrameFormat;
+    if (!m_file.isOpen() || !argb) {
+        return false;
+    }
+
+    const bool repeat = !fullFrame && dirtyRects.isEmpty() && !m_offsets.isEmpty();
+    FrameHeader fh;
+    fh.timestampUs = timestampUs;
+    fh.rectCount = repeat ? 0 : quint32(dirtyRects.size());
+    fh.flags = repeat ? kRepeat : (fullFrame || m_offsets.isEmpty() ? kFullFrame : 0);
+
+    const qint64 recordOffset = m_pos;
+    bool ok = writeBytes(&fh, sizeof(fh));
+    for (quint32 i = 0; ok && i < fh.rectCount; ++i) {
+        const QRect &r = dirtyRects.at(int(i));
+        const DirtyRect dr = { r.x(), r.y(), r.width(), r.height() };
+        ok = writeBytes(&dr, sizeof(dr));
+    }
+    ok = ok && padTo64();
+    if (ok && !repeat) {
+        const int rowBytes = m_size.width() * 4;
+        if (stride == rowBytes) {
+            ok = writeBytes(argb, qint64(rowBytes) * m_size.height());
+        } else {
+            for (int y = 0; ok && y < m_size.height(); ++y) {
+                ok = writeBytes(argb + qint64(y) * stride, rowBytes);
+            }
+        }
+        ok = ok && padTo64();
+    }
+    if (!ok) {
+        m_file.close();
+        return false;
+    }
+    m_offsets.append(quint64(recordOffset));
+    return true;
+}
+
+bool RawFrameWriter::finish()
+{
+    using namespace RawFrameFormat;
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    const quint64 indexOffset = quint64(m_pos);
+    bool ok = writeBytes(m_offsets.constData(), qint64(m_offsets.size()) * qint64(sizeof(quint64)));
+    if (ok) {
+        const quint32 frameCount = quint32(m_offsets.size());
+        ok = m_file.seek(offsetof(FileHeader, frameCount))
+             && m_file.write(reinterpret_cast<const char *>(&frameCount), sizeof(frameCount)) == sizeof(frameCount)
+             && m_file.seek(offsetof(FileHeader, indexOffset))
+             && m_file.write(reinterpret_cast<const char *>(&indexOffset), sizeof(indexOffset)) == sizeof(indexOffset);
+        if (!ok) {
+            m_error = m_file.errorString();
+        }
+    }
+    m_file.close();
+    return ok;
+}
+
+bool RawFrameWriter::writeBytes(const void *data, qint64 size)
+{
+    if (size <= 0) {
+        return true;
+    }
+    if (m_file.write(static_cast<const char *>(data), size) != size) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_pos += size;
+    return true;
+}
+
+bool RawFrameWriter::padTo64()
+{
+    static const char zeros[RawFrameFormat::kAlignment] = {};
+    return writeBytes(zeros, RawFrameFormat::alignUp(m_pos) - m_pos);
+}
@@ -0,0 +1,148 @@
+#ifndef RAWFRAMEFILE_H
+#define RAWFRAMEFILE_H
+
+#include <QFile>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// 原始帧序列文件（ARGB，可内存映射），用于编码基准测试、回放与回归
+// 文件布局（小端）：
+//   FileHeader（64 字节）
+//   帧记录 × N：FrameHeader（16 字节）+ 脏矩形 × rectCount（各 16 字节）+ 填充到 64 字节对齐
+//              + ARGB 像素（kRepeat 帧无像素，沿用上一帧）+ 填充到 64 字节对齐
+//   帧索引：N 个 quint64，指向各帧记录的文件偏移
+// 录制中断（未写索引）时读取端按记录顺序扫描恢复。
+// 另支持无头部的裸 ARGB 拼接文件（如 ffmpeg -pix_fmt bgra -f rawvideo 输出），需调用方给出宽高与帧率。
+namespace RawFrameFormat {
+
+constexpr char kMagic[8] = { 'I', 'R', 'R', 'A', 'W', 'F', 'R', '1' };
+constexpr quint32 kVersion = 1;
+constexpr int kAlignment = 64;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    quint32 width;
+    quint32 height;
+    quint32 stride;         // 每行字节数（width * 4）
+    quint32 frameCount;
+    quint64 indexOffset;    // 帧索引偏移（0 表示未写完）
+    quint32 fpsHint;        // 录制时的采集帧率（仅供参考，回放按时间戳）
+    quint8 reserved[20];
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+struct FrameHeader {
+    qint64 timestampUs;     // 相对首帧的采集时间
+    quint32 rectCount;      // 脏矩形数量（0 且 flags 无 kFullFrame 表示与上一帧相同）
+    quint32 flags;
+};
+static_assert(sizeof(FrameHeader) == 16, "FrameHeader must be 16 bytes");
+
+constexpr quint32 kFullFrame = 0x1;  // 整帧变化（首帧或脏区域未知）
+constexpr quint32 kRepeat = 0x2;     // 画面与上一帧相同，记录不带像素
+
+struct DirtyRect {
+    qint32 x;
+    qint32 y;
+    qint32 width;
+    qint32 height;
+};
+static_assert(sizeof(DirtyRect) == 16, "DirtyRect must be 16 bytes");
+
+inline qint64 alignUp(qint64 value)
+{
+    return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+} // namespace RawFrameFormat
+
+// 只读访问：整个文件一次映射，帧数据直接指向映射内存（零拷贝）
+class RawFrameReader
+{
+public:
+    struct Frame {
+        const uchar *argb = nullptr;
+        int stride = 0;
+        qint64 timestampUs = 0;
+        bool fullFrame = true;
+        QVector<QRect> dirtyRects;
+    };
+
+    RawFrameReader() = default;
+    ~RawFrameReader();
+
+    RawFrameReader(const RawFrameReader &) = delete;
+    RawFrameReader &operator=(const RawFrameReader &) = delete;
+
+    // 带头部的录制文件
+    bool open(const QString &path);
+    // 裸 ARGB 拼接文件
+    bool openRaw(const QString &path, const QSize &size, int fps);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    QSize frameSize() const { return m_size; }
+    int frameCount() const { return m_offsets.size(); }
+    int fpsHint() const { return m_fps; }
+    QString errorString() const { return m_error; }
+
+    // index 越界时返回空帧（argb 为 nullptr）
+    Frame frame(int index) const;
+    // 只取时间戳（回放按时间定位帧时使用，不解析脏矩形）
+    qint64 timestampUs(int index) const;
+
+private:
+    bool mapFile(const QString &path);
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_fileSize = 0;
+    QSize m_size;
+    int m_stride = 0;
+    int m_fps = 30;
+    bool m_headerless = false;
+    QVector<qint64> m_offsets;          // 帧记录偏移
+    QVector<qint64> m_pixelOffsets;     // 帧像素偏移（kRepeat 帧指向上一帧像素）
+    QString m_error;
+};
+
+// 顺序写入：采集线程逐帧追加，finish() 写入帧索引并回填头部
+class RawFrameWriter
+{
+public:
+    RawFrameWriter() = default;
+    ~RawFrameWriter();
+
+    RawFrameWriter(const RawFrameWriter &) = delete;
+    RawFrameWriter &operator=(const RawFrameWriter &) = delete;
+
+    bool open(const QString &path, const QSize &size, int fpsHint);
+    // argb 为紧凑或带 stride 的帧；dirtyRects 为空且 fullFrame 为 false 时写入不带像素的重复帧
+    bool append(const uchar *argb, int stride, qint64 timestampUs,
+                const QVector<QRect> &dirtyRects, bool fullFrame);
+    bool finish();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    QSize frameSize() const { return m_size; }
+    int frameCount() const { return m_offsets.size(); }
+    qint64 bytesWritten() const { return m_pos; }
+    QString errorString() const { return m_error; }
+
+private:
+    bool writeBytes(const void *data, qint64 size);
+    bool padTo64();
+
+    QFile m_file;
+    QSize m_size;
+    int m_fps = 30;
+    qint64 m_pos = 0;
+    QVector<quint64> m_offsets;
+    QString m_error;
+};
+
+#endif // RAWFRAMEFILE_H
@@ -4,7 +4,38 @@
 #include <QImageWriter>
 #include <QGuiApplication>
 #include <cstring> // for memcpy
+#include <algorithm>
 #include <QRect>
+#include <QDebug>
+
+#ifdef IRULER_HAVE_X11
+// Xlib 头文件放在 Qt 头文件之后（其 None/Bool/Status 等宏会干扰 Qt 声明）
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+struct ScreenCapture::X11State {
+    Display *display = nullptr;
+    Window root = 0;
+    XImage *image = nullptr;         // 数据指向共享内存段，整个会话复用
+    XShmSegmentInfo shm;
+    bool shmAttached = false;
+    Damage damage = 0;
+    XserverRegion region = 0;        // 每帧从 damage 取出的区域
+    QRect area;                      // 采集区域（根窗口坐标）
+    bool needFullFrame = true;       // 首帧无损坏区域信息，必须整屏抓取
+
+    X11State()
+    {
+        memset(&shm, 0, sizeof(shm));
+        shm.shmid = -1;
+    }
+};
+#endif
 
 ScreenCapture::ScreenCapture(QObject *parent)
     : QObject(parent)
@@ -19,11 +50,14 @@ ScreenCapture::ScreenCapture(QObject *parent)
 ScreenCapture::~ScreenCapture()
 {
     cleanup();
+    finishRecording();
 }
 
 bool ScreenCapture::initialize()
 {
-    
+    if (!m_replayPath.isEmpty()) {
+        return initializeReplay();
+    }
     
     // 选择目标屏幕（默认主屏幕；如设置了索引则使用对应屏幕）
     const auto screens = QGuiApplication::screens();
@@ -50,13 +84,37 @@ bool ScreenCapture::initialize()
     }
 #else
     m_useD3D11 = false;
-    
+#ifdef IRULER_HAVE_X11
+    m_useX11 = initializeX11();
+#endif
 #endif
     
     m_initialized = true;
     return true;
 }
 
+bool ScreenCapture::initializeReplay()
+{
+    // 切屏等路径会 cleanup + initialize：回放文件保持打开，时间轴继续走
+    if (!m_replayReader.isOpen()) {
+        if (!m_replayReader.open(m_replayPath) || m_replayReader.frameCount() == 0) {
+            const QString reason = m_replayReader.isOpen() ? QStringLiteral("no frames") : m_replayReader.errorString();
+            qWarning() << "[ScreenCapture] Replay source failed:" << m_replayPath << reason;
+            emit error(QStringLiteral("Replay source failed: %1").arg(reason));
+            m_replayReader.close();
+            return false;
+        }
+        m_replayIndex = -1;
+        m_replayClock.invalidate();
+        qInfo() << "[ScreenCapture] Replaying" << m_replayPath << m_replayReader.frameSize()
+                << "frames:" << m_replayReader.frameCount() << (m_replayLoop ? "(loop)" : "");
+    }
+    m_screenSize = m_replayReader.frameSize();
+    m_useD3D11 = false;
+    m_initialized = true;
+    return true;
+}
+
 void ScreenCapture::cleanup()
 {
     if (!m_initialized) {
@@ -78,35 +136,192 @@ void ScreenCapture::cleanup()
     m_d3dContext.Reset();
     m_d3dDevice.Reset();
 #endif
+#ifdef IRULER_HAVE_X11
+    cleanupX11();
+    m_useX11 = false;
+#endif
     
     m_initialized = false;
 }
 
-QByteArray ScreenCapture::captureScreen()
+FrameBuffer ScreenCapture::captureScreen()
 {
     if (!m_initialized) {
-        return QByteArray();
+        return FrameBuffer();
     }
     
     m_frameCounter++;
+    m_hasDamage = false;
     
-    QByteArray frameData;
+    FrameBuffer frame = m_replayReader.isOpen() ? captureFromReplay() : captureFromScreen();
+    if (!m_recordPath.isEmpty() && !frame.isNull()) {
+        recordFrame(frame);
+    }
+    return frame;
+}
+
+FrameBuffer ScreenCapture::allocateFrame(const QSize &size)
+{
+    return m_framePool ? m_framePool->acquire(size) : FrameBuffer::allocate(size);
+}
+
+FrameBuffer ScreenCapture::captureFromScreen()
+{
+    FrameBuffer frame;
     
 #ifdef _WIN32
     if (m_useD3D11) {
-        CaptureResult result = captureWithD3D11(frameData);
+        CaptureResult result = captureWithD3D11(frame);
         
         if (result == Success) {
-            return frameData;
+            return frame;
         } else if (result == HardwareError) {
             m_useD3D11 = false;
         }
     }
 #endif
+#ifdef IRULER_HAVE_X11
+    if (m_useX11) {
+        frame = captureWithX11();
+        if (!frame.isNull()) {
+            return frame;
+        }
+        // XShmGetImage 失败（如屏幕布局变化）：退回 grabWindow，切屏重新 initialize 时再尝试
+        qWarning() << "[ScreenCapture] X11 capture failed, falling back to grabWindow";
+        cleanupX11();
+        m_useX11 = false;
+    }
+#endif
     
-    frameData = captureWithQt();
+    frame = captureWithQt();
     
-    return frameData;
+    return frame;
+}
+
+bool ScreenCapture::takeDamage(QVector<QRect> &rects)
+{
+    if (!m_hasDamage) {
+        return false;
+    }
+    rects = m_damage;
+    m_damage.clear();
+    m_hasDamage = false;
+    return true;
+}
+
+FrameBuffer ScreenCapture::captureFromReplay()
+{
+    const int count = m_replayReader.frameCount();
+    if (count == 0) {
+        return FrameBuffer();
+    }
+    if (!m_replayClock.isValid()) {
+        m_replayClock.start();
+        m_replayIndex = -1;
+    }
+
+    // 定位到时间已到的最后一帧：采集间隔大于录制间隔时跳过中间帧，与实时桌面一致；
+    // 画面未变化时仍返回当前帧（与 grabWindow 兜底路径一致，保证关键帧请求能被满足）
+    const qint64 firstUs = m_replayReader.timestampUs(0);
+    const qint64 durationUs = m_replayReader.timestampUs(count - 1) - firstUs
+                              + 1000000 / std::max(1, m_replayReader.fpsHint());
+    qint64 elapsedUs = m_replayClock.nsecsElapsed() / 1000;
+    if (elapsedUs >= durationUs && m_replayLoop) {
+        m_replayClock.restart();
+        m_replayIndex = -1;
+        elapsedUs = 0;
+    }
+    const int previous = m_replayIndex;
+    while (m_replayIndex + 1 < count
+           && m_replayReader.timestampUs(m_replayIndex + 1) - firstUs <= elapsedUs) {
+        ++m_replayIndex;
+    }
+    if (m_replayIndex < 0) {
+        m_replayIndex = 0;
+    }
+
+    // 变化区域：合并期间跳过的各帧的录制脏矩形；首帧/循环重启/整帧记录无可信区域
+    m_damage.clear();
+    m_hasDamage = previous >= 0;
+    for (int i = previous + 1; m_hasDamage && i <= m_replayIndex; ++i) {
+        const RawFrameReader::Frame skipped = m_replayReader.frame(i);
+        if (skipped.fullFrame) {
+            m_hasDamage = false;
+        } else {
+            m_damage += skipped.dirtyRects;
+        }
+    }
+
+    const RawFrameReader::Frame source = m_replayReader.frame(m_replayIndex);
+    if (!source.argb) {
+        return FrameBuffer();
+    }
+    const int height = m_screenSize.height();
+    const int rowBytes = m_screenSize.width() * 4;
+    FrameBuffer frame = allocateFrame(m_screenSize);
+    if (frame.isNull()) {
+        return frame;
+    }
+    uchar *dst = frame.data();
+    if (source.stride == rowBytes) {
+        memcpy(dst, source.argb, frame.byteSize());
+    } else {
+        for (int y = 0; y < height; ++y) {
+            memcpy(dst + y * rowBytes, source.argb + qint64(y) * source.stride, rowBytes);
+        }
+    }
+    return frame;
+}
+
+void ScreenCapture::recordFrame(const FrameBuffer &frame)
+{
+    if (m_recordStopped) {
+        return;
+    }
+    const int width = m_screenSize.width();
+    const int height = m_screenSize.height();
+    if (!m_recorder.isOpen()) {
+        if (!m_recorder.open(m_recordPath, m_screenSize, m_recordFpsHint)) {
+            qWarning() << "[ScreenCapture] Recording disabled:" << m_recordPath << m_recorder.errorString();
+            m_recordStopped = true;
+            return;
+        }
+        m_recordClock.start();
+        m_recordDetector.reset();
+        qInfo() << "[ScreenCapture] Recording frames to" << m_recordPath << m_screenSize;
+    }
+    // 录制文件尺寸固定：切屏/分辨率变化后结束录制
+    if (m_screenSize != m_recorder.frameSize() || frame.frameSize() != m_screenSize) {
+        qWarning() << "[ScreenCapture] Capture size changed, recording stopped at"
+                   << m_recorder.frameCount() << "frames";
+        finishRecording();
+        return;
+    }
+
+    const uint8_t *argb = frame.constData();
+    const bool hadHistory = m_recordDetector.hasHistory();
+    if (m_hasDamage) {
+        m_recordDetector.processWithDamage(argb, width, height, width * 4, m_damage);
+    } else {
+        m_recordDetector.process(argb, width, height, width * 4);
+    }
+    const bool fullFrame = !hadHistory;
+    if (!m_recorder.append(argb, width * 4, m_recordClock.nsecsElapsed() / 1000,
+                           fullFrame ? QVector<QRect>() : m_recordDetector.dirtyRects(), fullFrame)) {
+        qWarning() << "[ScreenCapture] Recording write failed:" << m_recorder.errorString();
+        m_recordStopped = true;
+    }
+}
+
+void ScreenCapture::finishRecording()
+{
+    if (m_recorder.isOpen()) {
+        const int frames = m_recorder.frameCount();
+        const qint64 bytes = m_recorder.bytesWritten();
+        m_recorder.finish();
+        qInfo() << "[ScreenCapture] Recording finished:" << frames << "frames," << bytes / (1024 * 1024) << "MB";
+    }
+    m_recordStopped = true;
 }
 
     // 瓦片系统相关方法已移除
@@ -233,7 +448,7 @@ bool ScreenCapture::initializeD3D11()
     return true;
 }
 
-ScreenCapture::CaptureResult ScreenCapture::captureWithD3D11(QByteArray &frameData)
+ScreenCapture::CaptureResult ScreenCapture::captureWithD3D11(FrameBuffer &frame)
 {
     if (!m_d3dDevice || !m_dxgiOutputDuplication || !m_stagingTexture) {
         return HardwareError;
@@ -312,10 +527,15 @@ ScreenCapture::CaptureResult ScreenCapture::captureWithD3D11(QByteArray &frameDa
     int height = m_screenSize.height();
     int bytesPerPixel = 4; // RGBA
     
-    frameData.resize(width * height * bytesPerPixel);
+    frame = allocateFrame(m_screenSize);
+    if (frame.isNull()) {
+        m_d3dContext->Unmap(m_stagingTexture.Get(), 0);
+        m_dxgiOutputDuplication->ReleaseFrame();
+        return NoNewFrame;
+    }
     
     const unsigned char* srcData = static_cast<const unsigned char*>(mappedResource.pData);
-    unsigned char* dstData = reinterpret_cast<unsigned char*>(frameData.data());
+    unsigned char* dstData = frame.data();
     
     // D3D11使用BGRA格式，在小端序系统上与libyuv期望的ARGB内存布局相同，直接复制
     for (int y = 0; y < height; ++y) {
@@ -337,10 +557,10 @@ ScreenCapture::CaptureResult ScreenCapture::captureWithD3D11(QByteArray &frameDa
 }
 #endif
 
-QByteArray ScreenCapture::captureWithQt()
+FrameBuffer ScreenCapture::captureWithQt()
 {
     if (!m_primaryScreen) {
-        return QByteArray();
+        return FrameBuffer();
     }
     
     // 使用Qt进行屏幕截图
@@ -355,7 +575,7 @@ QByteArray ScreenCapture::captureWithQt()
         m_primaryScreen->size().height());
 
     if (screenshot.isNull()) {
-        return QByteArray();
+        return FrameBuffer();
     }
     
     // [Fix] Force devicePixelRatio to 1.0 to ensure consistent pixel dimensions
@@ -364,7 +584,7 @@ QByteArray ScreenCapture::captureWithQt()
     // 转换为QImage
     QImage image = screenshot.toImage();
     if (image.isNull()) {
-        return QByteArray();
+        return FrameBuffer();
     }
 
     // 更新屏幕尺寸（Qt捕获的尺寸可能与D3D11不同，或者是逻辑/物理尺寸变化）
@@ -382,19 +602,190 @@ QByteArray ScreenCapture::captureWithQt()
     int height = image.height();
     int bpp = 4;
     
-    QByteArray frameData;
-    frameData.resize(width * height * bpp);
+    FrameBuffer frame = allocateFrame(image.size());
+    if (frame.isNull()) {
+        return frame;
+    }
     
     if (image.bytesPerLine() == width * bpp) {
-        memcpy(frameData.data(), image.constBits(), frameData.size());
+        memcpy(frame.data(), image.constBits(), frame.byteSize());
     } else {
         const uchar* src = image.constBits();
-        uchar* dst = reinterpret_cast<uchar*>(frameData.data());
+        uchar* dst = frame.data();
         for (int y = 0; y < height; ++y) {
             memcpy(dst + y * width * bpp, src + y * image.bytesPerLine(), width * bpp);
         }
     }
     
-    return frameData;
+    return frame;
+}
+
+#ifdef IRULER_HAVE_X11
+bool ScreenCapture::initializeX11()
+{
+    cleanupX11();
+    if (!m_primaryScreen) {
+        return false;
+    }
+    Display *display = XOpenDisplay(nullptr);
+    if (!display) {
+        return false;
+    }
+    m_x11.reset(new X11State);
+    X11State &x = *m_x11;
+    x.display = display;
+
+    int shmMajor = 0, shmMinor = 0;
+    Bool shmPixmaps = False;
+    int damageEvent = 0, damageError = 0, fixesEvent = 0, fixesError = 0;
+    if (!XShmQueryVersion(display, &shmMajor, &shmMinor, &shmPixmaps)
+        || !XDamageQueryExtension(display, &damageEvent, &damageError)
+        || !XFixesQueryExtension(display, &fixesEvent, &fixesError)) {
+        qWarning() << "[ScreenCapture] X11: XShm/XDamage/XFixes unavailable, using grabWindow";
+        cleanupX11();
+        return false;
+    }
+
+    // 采集区域：目标屏幕在根窗口中的物理坐标
+    const int screen = DefaultScreen(display);
+    x.root = RootWindow(display, screen);
+    const QRect rootRect(0, 0, DisplayWidth(display, screen), DisplayHeight(display, screen));
+    const qreal dpr = m_primaryScreen->devicePixelRatio();
+    const QRect geo = m_primaryScreen->geometry();
+    x.area = QRect(qRound(geo.x() * dpr), qRound(geo.y() * dpr),
+                   m_screenSize.width(), m_screenSize.height()).intersected(rootRect);
+    if (x.area.isEmpty()) {
+        cleanupX11();
+        return false;
+    }
+
+    // 只支持 32 位小端 BGRX（与 libyuv ARGB 内存序一致），其他视觉格式走 grabWindow
+    XWindowAttributes attrs;
+    XGetWindowAttributes(display, x.root, &attrs);
+    x.image = XShmCreateImage(display, attrs.visual, attrs.depth, ZPixmap, nullptr, &x.shm,
+                              x.area.width(), x.area.height());
+    if (!x.image || x.image->bits_per_pixel != 32 || x.image->byte_order != LSBFirst
+        || x.image->red_mask != 0xff0000 || x.image->blue_mask != 0xff) {
+        qWarning() << "[ScreenCapture] X11: unsupported visual format, using grabWindow";
+        cleanupX11();
+        return false;
+    }
+
+    x.shm.shmid = shmget(IPC_PRIVATE, size_t(x.image->bytes_per_line) * x.image->height, IPC_CREAT | 0600);
+    if (x.shm.shmid < 0) {
+        cleanupX11();
+        return false;
+    }
+    void *addr = shmat(x.shm.shmid, nullptr, 0);
+    if (addr == reinterpret_cast<void *>(-1)) {
+        cleanupX11();
+        return false;
+    }
+    x.shm.shmaddr = x.image->data = static_cast<char *>(addr);
+    x.shm.readOnly = False;
+    if (!XShmAttach(display, &x.shm)) {
+        cleanupX11();
+        return false;
+    }
+    XSync(display, False);
+    x.shmAttached = true;
+    // 双方均已映射：立即标记删除，进程异常退出时段随之释放
+    shmctl(x.shm.shmid, IPC_RMID, nullptr);
+    x.shm.shmid = -1;
+
+    x.damage = XDamageCreate(display, x.root, XDamageReportNonEmpty);
+    x.region = XFixesCreateRegion(display, nullptr, 0);
+    x.needFullFrame = true;
+    m_screenSize = x.area.size();
+    qInfo() << "[ScreenCapture] X11 XShm/XDamage capture:" << x.area;
+    return true;
+}
+
+void ScreenCapture::cleanupX11()
+{
+    if (!m_x11) {
+        return;
+    }
+    X11State &x = *m_x11;
+    if (x.display) {
+        if (x.region) {
+            XFixesDestroyRegion(x.display, x.region);
+        }
+        if (x.damage) {
+            XDamageDestroy(x.display, x.damage);
+        }
+        if (x.shmAttached) {
+            XShmDetach(x.display, &x.shm);
+            XSync(x.display, False);
+        }
+        if (x.image) {
+            x.image->data = nullptr; // 共享内存由 shmdt 释放
+            XDestroyImage(x.image);
+        }
+        XCloseDisplay(x.display);
+    }
+    if (x.shm.shmaddr) {
+        shmdt(x.shm.shmaddr);
+    }
+    if (x.shm.shmid >= 0) {
+        shmctl(x.shm.shmid, IPC_RMID, nullptr);
+    }
+    m_x11.reset();
 }
 
+FrameBuffer ScreenCapture::captureWithX11()
+{
+    X11State &x = *m_x11;
+
+    // DamageNotify 事件只用于唤醒，区域本身从 damage 对象中一次取出
+    while (XPending(x.display) > 0) {
+        XEvent event;
+        XNextEvent(x.display, &event);
+    }
+    // 先取走损坏区域再抓图：两者之间发生的变化会同时出现在本帧像素和下一帧区域中（多报不漏报）
+    XDamageSubtract(x.display, x.damage, None, x.region);
+    int count = 0;
+    XRectangle *rects = XFixesFetchRegion(x.display, x.region, &count);
+    const QRect bounds(QPoint(0, 0), x.area.size());
+    m_damage.clear();
+    for (int i = 0; i < count; ++i) {
+        const QRect r = QRect(rects[i].x - x.area.x(), rects[i].y - x.area.y(),
+                              rects[i].width, rects[i].height).intersected(bounds);
+        if (!r.isEmpty()) {
+            m_damage.append(r);
+        }
+    }
+    if (rects) {
+        XFree(rects);
+    }
+
+    // 无损坏区域时共享内存中的上一帧仍然有效，不再向 X 服务器请求像素
+    const bool fullFrame = x.needFullFrame;
+    if (fullFrame || !m_damage.isEmpty()) {
+        if (!XShmGetImage(x.display, x.root, x.image, x.area.x(), x.area.y(), AllPlanes)) {
+            m_damage.clear();
+            return FrameBuffer();
+        }
+        x.needFullFrame = false;
+    }
+    m_hasDamage = !fullFrame;
+
+    const int width = x.area.width();
+    const int height = x.area.height();
+    const int rowBytes = width * 4;
+    FrameBuffer frame = allocateFrame(x.area.size());
+    if (frame.isNull()) {
+        m_hasDamage = false;
+        return frame;
+    }
+    uchar *dst = frame.data();
+    if (x.image->bytes_per_line == rowBytes) {
+        memcpy(dst, x.image->data, frame.byteSize());
+    } else {
+        for (int y = 0; y < height; ++y) {
+            memcpy(dst + y * rowBytes, x.image->data + qint64(y) * x.image->bytes_per_line, rowBytes);
+        }
+    }
+    return frame;
+}
+#endif
@@ -8,6 +8,14 @@
 #include <QPixmap>
 #include <QScreen>
 #include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QRect>
+#include <memory>
+
+#include "RawFrameFile.h"
+#include "FrameBufferPool.h"
+#include "DirtyRegionDetector.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -34,10 +42,25 @@ public:
     bool initialize();
     void cleanup();
     
-    QByteArray captureScreen();
+    // 输出写入缓冲池中的帧缓冲（未设置缓冲池时独立分配），失败返回空句柄
+    FrameBuffer captureScreen();
+    void setFramePool(FrameBufferPool *pool) { m_framePool = pool; }
     QSize getScreenSize() const { return m_screenSize; }
     void setTargetScreenIndex(int index) { m_targetScreenIndex = index; }
 
+    // 回放：以录制文件替代屏幕作为帧源（initialize 前设置），按录制时的时间间隔出帧，
+    // 不依赖显示设备，可配合 -platform offscreen 在无桌面环境运行
+    void setReplaySource(const QString &path, bool loop = true) { m_replayPath = path; m_replayLoop = loop; }
+    bool isReplay() const { return !m_replayPath.isEmpty(); }
+    // 录制：把每次采集到的帧连同时间戳与脏矩形追加写入原始帧文件（尺寸变化后停止录制）
+    void setRecordPath(const QString &path, int fpsHint) { m_recordPath = path; m_recordFpsHint = fpsHint; }
+    // 写入帧索引并关闭录制文件（退出前调用，调用方需持有采集锁）
+    void finishRecording();
+
+    // 最近一次 captureScreen() 相对上一次采集的变化区域（帧像素坐标）。
+    // 返回 false 表示本帧没有可信的区域信息（首帧、整屏重抓或后端不支持），调用方需整帧比较
+    bool takeDamage(QVector<QRect> &rects);
+
 signals:
     void frameReady(const QByteArray &frameData);
     void error(const QString &errorMessage);
@@ -45,8 +68,18 @@ signals:
 private:
     bool initializeD3D11();
     bool initializeDXGI();
-    CaptureResult captureWithD3D11(QByteArray &frameData);
-    QByteArray captureWithQt(); // 备用方案
+    CaptureResult captureWithD3D11(FrameBuffer &frame);
+    FrameBuffer captureWithQt(); // 备用方案
+    FrameBuffer captureFromScreen();
+    FrameBuffer allocateFrame(const QSize &size);
+    bool initializeReplay();
+    FrameBuffer captureFromReplay();
+    void recordFrame(const FrameBuffer &frame);
+#ifdef IRULER_HAVE_X11
+    bool initializeX11();
+    void cleanupX11();
+    FrameBuffer captureWithX11();
+#endif
     
     QSize m_screenSize;
     bool m_initialized;
@@ -70,6 +103,33 @@ private:
     QScreen *m_primaryScreen;
     int m_frameCounter;
     int m_targetScreenIndex;
+    FrameBufferPool *m_framePool = nullptr;
+
+#ifdef IRULER_HAVE_X11
+    // X11 共享内存采集（XShm + XDamage），Xlib 类型只在实现文件中出现，避免其宏污染 Qt 头文件
+    struct X11State;
+    std::unique_ptr<X11State> m_x11;
+    bool m_useX11 = false;
+#endif
+
+    // 变化区域（takeDamage 取走后清空）
+    QVector<QRect> m_damage;
+    bool m_hasDamage = false;
+
+    // 回放
+    QString m_replayPath;
+    bool m_replayLoop = true;
+    RawFrameReader m_replayReader;
+    QElapsedTimer m_replayClock;
+    int m_replayIndex = -1;
+
+    // 录制
+    QString m_recordPath;
+    int m_recordFpsHint = 30;
+    bool m_recordStopped = false;
+    RawFrameWriter m_recorder;
+    QElapsedTimer m_recordClock;
+    DirtyRegionDetector m_recordDetector;
 };
 
 #endif // SCREENCAPTURE_H
\ No newline at end of file
@@ -7,6 +7,18 @@
 // 为编码器并行度获取CPU理想线程数
 #include <QThread>
 
+namespace {
+// 内部缩放模式对应的缩放比例（SVC 层缩放因子）
+void scaleFactorsForMode(int scaleMode, int &num, int &den)
+{
+    num = 1;
+    den = 1;
+    if (scaleMode == VP8E_FOURFIVE) { num = 4; den = 5; }
+    else if (scaleMode == VP8E_THREEFIVE) { num = 3; den = 5; }
+    else if (scaleMode == VP8E_ONETWO) { num = 1; den = 2; }
+}
+}
+
 VP9Encoder::VP9Encoder(QObject *parent)
     : QObject(parent)
     , m_frameRate(30)  // 保持30fps流畅度
@@ -14,13 +26,7 @@ VP9Encoder::VP9Encoder(QObject *parent)
     , m_keyFrameInterval(30) // 30帧关键帧间隔
     , m_initialized(false)
     , m_frameCount(0)
-    , m_forceNextKeyFrame(false) // 初始化强制关键帧标志
     , m_lastWasKey(false)
-    , m_yPlane(nullptr)
-    , m_uPlane(nullptr)
-    , m_vPlane(nullptr)
-    , m_yPlaneSize(0)
-    , m_uvPlaneSize(0)
     // 静态检测参数初始化 - 更激进的流量节省
     , m_enableStaticDetection(true)      // 启用静态检测
     , m_staticThreshold(0.01)            // 降低到1%变化阈值，更敏感
@@ -31,6 +37,12 @@ VP9Encoder::VP9Encoder(QObject *parent)
     , m_lastFrameDifference(0.0)
     , m_staticFrameCount(0)
     , m_originalBitrate(300000)
+    , m_packetPool(32)
+    , m_packetSeq(0)
+    , m_baseLayerSeq(0)
+    , m_streamId(0)
+    , m_temporalLayers(1)
+    , m_appliedScaleMode(VP8E_NORMAL)
 {
     memset(&m_codec, 0, sizeof(m_codec));
     memset(&m_config, 0, sizeof(m_config));
@@ -44,6 +56,11 @@ VP9Encoder::VP9Encoder(QObject *parent)
     m_bufOptimal = 20;
     m_bufTotal = 30;
     m_deadline = VPX_DL_GOOD_QUALITY;
+    // 色彩矩阵默认 BT.601（与解码端 I420ToARGB 一致），保留原有的蓝/黄色偏修正
+    m_colorMatrix = ColorConvert::Matrix::Bt601;
+    m_chromaUGain = 0.95;
+    m_chromaVGain = 1.05;
+    m_colorCoeffs = ColorConvert::makeCoefficients(m_colorMatrix, m_chromaUGain, m_chromaVGain);
 }
 
 VP9Encoder::~VP9Encoder()
@@ -62,27 +79,18 @@ bool VP9Encoder::initialize(int width, int height, int fps)
     m_frameSize = QSize(width, height);
     m_frameRate = fps;
     m_originalBitrate = m_bitrate;
-    m_previousFrameData.clear();
+    m_dirtyDetector.reset();
+    m_inputValid = false;
     m_lastFrameWasStatic = false;
     m_lastFrameDifference = 0.0;
     m_staticFrameCount = 0;
-    m_forceNextKeyFrame = false;
+    m_keyPolicy.reset();
     m_lastWasKey = false;
+    m_appliedScaleMode = VP8E_NORMAL; // 新编码器默认不缩放，已有的缩放请求在首帧前重新应用
     
-    // 分配YUV缓冲区
-    m_yPlaneSize = width * height;
-    m_uvPlaneSize = (width / 2) * (height / 2);
-    
-    m_yPlane = new uint8_t[m_yPlaneSize];
-    m_uPlane = new uint8_t[m_uvPlaneSize];
-    m_vPlane = new uint8_t[m_uvPlaneSize];
+    m_colorCoeffs = ColorConvert::makeCoefficients(m_colorMatrix, m_chromaUGain, m_chromaVGain);
     
-    if (!m_yPlane || !m_uPlane || !m_vPlane) {
-        cleanup();
-        return false;
-    }
-    
-    // 初始化VP9编码器
+    // 初始化VP9编码器（YUV 直接写入 m_rawImage，无需额外平面缓冲）
     if (!initializeEncoder()) {
         cleanup();
         return false;
@@ -95,6 +103,78 @@ bool VP9Encoder::initialize(int width, int height, int fps)
     return true;
 }
 
+bool VP9Encoder::reconfigure(int width, int height, int fps)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_initialized && reconfigureLive(width, height, fps)) {
+            return true;
+        }
+    }
+    // 实时路径不适用：完整重建（新编码器首帧为关键帧）
+    cleanup();
+    return initialize(width, height, fps);
+}
+
+bool VP9Encoder::reconfigureLive(int width, int height, int fps)
+{
+    // 调用方已持有 m_mutex
+    width &= ~1;
+    height &= ~1;
+    if (width <= 0 || height <= 0 || fps != m_frameRate) {
+        return false; // 帧率决定时间基，运行中不改
+    }
+    // libvpx 仅在新尺寸不超过创建时尺寸、且参考帧缩放比例有效（单次缩小不超过 1/2）时不强制关键帧
+    const QSize current = m_frameSize;
+    if (width > m_initialSize.width() || height > m_initialSize.height()
+        || width * 2 < current.width() || height * 2 < current.height()) {
+        return false;
+    }
+
+    const vpx_codec_enc_cfg_t previous = m_config;
+    m_config.g_w = width;
+    m_config.g_h = height;
+    m_config.rc_min_quantizer = m_minQuantizer;
+    m_config.rc_max_quantizer = m_maxQuantizer;
+    m_config.rc_undershoot_pct = m_undershootPct;
+    m_config.rc_overshoot_pct = m_overshootPct;
+    m_config.rc_buf_initial_sz = m_bufInitial;
+    m_config.rc_buf_optimal_sz = m_bufOptimal;
+    m_config.rc_buf_sz = m_bufTotal;
+    m_originalBitrate = m_bitrate;
+    if (!applyRateTargets()) {
+        m_config = previous;
+        applyRateTargets();
+        return false;
+    }
+
+    if (QSize(width, height) != current) {
+        vpx_img_free(&m_rawImage);
+        memset(&m_rawImage, 0, sizeof(m_rawImage));
+        if (!vpx_img_alloc(&m_rawImage, VPX_IMG_FMT_I420, width, height, 1)) {
+            return false;
+        }
+    }
+
+    vpx_codec_control(&m_codec, VP8E_SET_CPUUSED, m_cpuUsed);
+    vpx_codec_control(&m_codec, VP9E_SET_TILE_ROWS, (m_config.g_h >= 1080) ? 1 : 0);
+    if (m_temporalLayers > 1) {
+        // SVC 参数携带各层量化范围与速度，按当前缩放重新下发
+        int num = 1, den = 1;
+        scaleFactorsForMode(m_appliedScaleMode, num, den);
+        applySvcParameters(num, den);
+    }
+
+    // 新尺寸下的分块哈希与静态统计重新开始；帧计数（时间戳）与关键帧策略状态保留
+    m_frameSize = QSize(width, height);
+    m_dirtyDetector.reset();
+    m_inputValid = false;
+    m_lastFrameWasStatic = false;
+    m_lastFrameDifference = 0.0;
+    m_staticFrameCount = 0;
+    return true;
+}
+
 void VP9Encoder::cleanup()
 {
     QMutexLocker locker(&m_mutex);
@@ -104,31 +184,26 @@ void VP9Encoder::cleanup()
         }
     }
     
-    // 释放YUV缓冲区
-    delete[] m_yPlane;
-    delete[] m_uPlane;
-    delete[] m_vPlane;
-    m_yPlane = nullptr;
-    m_uPlane = nullptr;
-    m_vPlane = nullptr;
-    
     // 释放原始图像
     if (m_rawImage.img_data) {
         vpx_img_free(&m_rawImage);
+        memset(&m_rawImage, 0, sizeof(m_rawImage));
     }
     
     m_initialized = false;
-    m_previousFrameData.clear();
+    m_dirtyDetector.reset();
+    m_inputValid = false;
     m_lastFrameWasStatic = false;
     m_lastFrameDifference = 0.0;
     m_staticFrameCount = 0;
     m_frameCount = 0;
-    m_forceNextKeyFrame = false;
+    m_keyPolicy.reset();
     m_lastWasKey = false;
     m_bitrate = m_originalBitrate;
 }
 
-QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int inputHeight)
+QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int inputHeight,
+                              const QVector<QRect> *damage)
 {
     QMutexLocker locker(&m_mutex);
     
@@ -146,13 +221,31 @@ QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int i
         inputHeight = m_frameSize.height();
     }
     
+    // 应用运行时码率/分辨率调整（自适应码率控制器发出）
+    applyRuntimeRequests();
+    
     auto encodeStartTime = std::chrono::high_resolution_clock::now();
     auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(encodeStartTime.time_since_epoch()).count();
     
+    // 分块哈希脏区域检测：单次遍历输入帧，只保留每块哈希，不再保存整帧副本
+    const bool hasDirtyHistory = m_dirtyDetector.hasHistory();
+    if (frameData.size() == inputWidth * inputHeight * 4) {
+        const uint8_t *argb = reinterpret_cast<const uint8_t*>(frameData.constData());
+        if (damage) {
+            m_dirtyDetector.processWithDamage(argb, inputWidth, inputHeight, inputWidth * 4, *damage);
+        } else {
+            m_dirtyDetector.process(argb, inputWidth, inputHeight, inputWidth * 4);
+        }
+    } else {
+        m_dirtyDetector.reset();
+    }
+    // 静态跳帧时也累积，跳过的帧里的小变化在下一次转换时补上
+    accumulateInputDirty(QSize(inputWidth, inputHeight), hasDirtyHistory);
+
     // 静态检测逻辑
     bool isStatic = false;
-    if (m_enableStaticDetection && !m_previousFrameData.isEmpty()) {
-        isStatic = isFrameStatic(frameData);
+    if (m_enableStaticDetection && hasDirtyHistory && m_dirtyDetector.hasHistory()) {
+        isStatic = isFrameStatic();
         adjustBitrateForStaticContent(isStatic);
         
         // 静态检测调试日志（已禁用以提升性能）
@@ -164,17 +257,18 @@ QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int i
         // }
         
         // 如果启用跳帧且当前帧为静态，则跳过编码
-        // [Fix 7] 除非有强制关键帧请求（m_forceNextKeyFrame），否则跳过静态帧
-        // 这解决了新观众加入时如果画面静止无法收到关键帧导致黑屏的问题
-        if (m_skipStaticFrames && isStatic && m_staticFrameCount > 3 && !m_forceNextKeyFrame) {
+        // [Fix 7] 除非有待处理的关键帧请求或周期保活到期，否则跳过静态帧
+        // 这解决了新观众加入时如果画面静止无法收到关键帧导致黑屏的问题；
+        // 静止时采集节奏放慢到空闲间隔，保活关键帧最多推迟一个空闲间隔
+        if (m_skipStaticFrames && isStatic && m_staticFrameCount > 3
+            && !m_keyPolicy.keyFrameDue(QDateTime::currentMSecsSinceEpoch())) {
             // qDebug() << "[VP9Encoder] 跳过静态帧，连续静态帧数:" << m_staticFrameCount;
             return QByteArray(); // 返回空数据表示跳帧
         }
     }
     
-    // 转换RGBA到YUV420
-    uint8_t *yuvPlanes[3] = { m_yPlane, m_uPlane, m_vPlane };
-    if (!convertRGBAToYUV420(frameData, inputWidth, inputHeight, yuvPlanes)) {
+    // 转换RGBA到YUV420（直接写入 m_rawImage）
+    if (!convertRGBAToYUV420(frameData, inputWidth, inputHeight)) {
         return QByteArray();
     }
     
@@ -182,15 +276,11 @@ QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int i
     m_frameCount++;
     
     // 编码帧
-    QByteArray encodedData = encodeFrame(m_yPlane, m_uPlane, m_vPlane);
+    QByteArray encodedData = encodeFrame();
     if (!encodedData.isEmpty()) {
         emit frameEncoded(encodedData);
         emit frameEncodedWithInfo(encodedData, m_lastWasKey);
-        
-        // 保存当前帧数据用于下次比较
-        if (m_enableStaticDetection) {
-            m_previousFrameData = frameData;
-        }
+        emit packetEncoded(encodedData, m_lastPacketMeta);
     } else {
         // 如果编码失败，回退帧计数器
         m_frameCount--;
@@ -199,10 +289,11 @@ QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int i
     auto encodeEndTime = std::chrono::high_resolution_clock::now();
     auto encodeLatency = std::chrono::duration_cast<std::chrono::microseconds>(encodeEndTime - encodeStartTime).count();
     
-    static int encodeCounter = 0;
-    static int totalEncodeTime = 0;
-    static int maxEncodeTime = 0;
-    static int minEncodeTime = INT_MAX;
+    // 多路编码时各编码器运行在不同线程，统计计数按线程独立
+    static thread_local int encodeCounter = 0;
+    static thread_local int totalEncodeTime = 0;
+    static thread_local int maxEncodeTime = 0;
+    static thread_local int minEncodeTime = INT_MAX;
     
     encodeCounter++;
     totalEncodeTime += encodeLatency;
@@ -221,29 +312,157 @@ QByteArray VP9Encoder::encode(const QByteArray &frameData, int inputWidth, int i
 }
 
 void VP9Encoder::forceKeyFrame()
+{
+    // 不取编码器锁：请求只登记到策略，由编码线程在下一帧合并处理
+    m_keyPolicy.request();
+}
+
+void VP9Encoder::setKeyFramePolicy(KeyFramePolicy::Mode mode, int periodMs)
 {
     QMutexLocker locker(&m_mutex);
-    m_forceNextKeyFrame = true;
-    // 移除关键帧请求日志以提升性能
-    // qDebug() << "[VP9Encoder] [首帧策略] 收到强制关键帧请求，下一帧将强制为关键帧";
+    m_keyPolicy.setMode(mode);
+    m_keyPolicy.setPeriodMs(periodMs);
 }
 
 void VP9Encoder::resetStreamingState()
 {
     QMutexLocker locker(&m_mutex);
-    m_previousFrameData.clear();
+    m_dirtyDetector.reset();
+    m_inputValid = false;
     m_lastFrameWasStatic = false;
     m_lastFrameDifference = 0.0;
     m_staticFrameCount = 0;
     m_frameCount = 0;
-    m_forceNextKeyFrame = true;
+    m_keyPolicy.reset();
     m_lastWasKey = false;
 
     m_bitrate = m_originalBitrate;
     if (m_initialized) {
-        m_config.rc_target_bitrate = m_bitrate / 1000;
-        vpx_codec_enc_config_set(&m_codec, &m_config);
+        applyRateTargets();
+    }
+}
+
+void VP9Encoder::requestScaling(int scaleNum, int scaleDen)
+{
+    int mode = VP8E_NORMAL;
+    if (scaleNum * 5 == scaleDen * 4) {
+        mode = VP8E_FOURFIVE;
+    } else if (scaleNum * 5 == scaleDen * 3) {
+        mode = VP8E_THREEFIVE;
+    } else if (scaleNum * 2 == scaleDen) {
+        mode = VP8E_ONETWO;
+    }
+    m_requestedScaleMode.store(mode, std::memory_order_relaxed);
+}
+
+QSize VP9Encoder::scaledFrameSize(int scaleNum, int scaleDen) const
+{
+    const QSize size = m_frameSize;
+    if (scaleNum <= 0 || scaleDen <= 0 || scaleNum >= scaleDen) {
+        return size;
+    }
+    if (m_temporalLayers > 1) {
+        // SVC 层缩放：向下取整后补为偶数
+        int w = size.width() * scaleNum / scaleDen;
+        int h = size.height() * scaleNum / scaleDen;
+        return QSize(w + w % 2, h + h % 2);
+    }
+    // 内部缩放：向上取整
+    return QSize((scaleDen - 1 + size.width() * scaleNum) / scaleDen,
+                 (scaleDen - 1 + size.height() * scaleNum) / scaleDen);
+}
+
+void VP9Encoder::applyRuntimeRequests()
+{
+    // 调用方已持有 m_mutex
+    const int bitrate = m_requestedBitrate.load(std::memory_order_relaxed);
+    if (bitrate > 0 && bitrate != m_originalBitrate) {
+        m_originalBitrate = bitrate;
+        // 静态检测开启时由 adjustBitrateForStaticContent 在本帧按新基准下发，避免重复设置
+        if (!m_enableStaticDetection || !m_dirtyDetector.hasHistory()) {
+            m_bitrate = bitrate;
+            applyRateTargets();
+        }
+    }
+    
+    const int scaleMode = m_requestedScaleMode.load(std::memory_order_relaxed);
+    if (scaleMode != m_appliedScaleMode) {
+        bool ok = false;
+        if (m_temporalLayers > 1) {
+            // SVC 模式下分辨率由层缩放因子决定，内部缩放会被覆盖
+            int num = 1, den = 1;
+            scaleFactorsForMode(scaleMode, num, den);
+            ok = applySvcParameters(num, den);
+        } else {
+            vpx_scaling_mode_t mode;
+            mode.h_scaling_mode = static_cast<VPX_SCALING_MODE>(scaleMode);
+            mode.v_scaling_mode = static_cast<VPX_SCALING_MODE>(scaleMode);
+            ok = vpx_codec_control(&m_codec, VP8E_SET_SCALEMODE, &mode) == VPX_CODEC_OK;
+        }
+        if (ok) {
+            m_appliedScaleMode = scaleMode;
+        } else {
+            m_requestedScaleMode.store(m_appliedScaleMode, std::memory_order_relaxed);
+        }
+    }
+}
+
+void VP9Encoder::configureTemporalLayers()
+{
+    // 时间分层模式：2 层 0101（基础层 1/2 帧率），3 层 0212（基础层 1/4、中间层 1/2 帧率）
+    m_config.ss_number_layers = 1;
+    m_config.ts_number_layers = m_temporalLayers;
+    if (m_temporalLayers == 3) {
+        m_config.temporal_layering_mode = VP9E_TEMPORAL_LAYERING_MODE_0212;
+        m_config.ts_periodicity = 4;
+        const unsigned int ids[4] = { 0, 2, 1, 2 };
+        const unsigned int decimators[3] = { 4, 2, 1 };
+        memcpy(m_config.ts_layer_id, ids, sizeof(ids));
+        memcpy(m_config.ts_rate_decimator, decimators, sizeof(decimators));
+    } else {
+        m_config.temporal_layering_mode = VP9E_TEMPORAL_LAYERING_MODE_0101;
+        m_config.ts_periodicity = 2;
+        const unsigned int ids[2] = { 0, 1 };
+        const unsigned int decimators[2] = { 2, 1 };
+        memcpy(m_config.ts_layer_id, ids, sizeof(ids));
+        memcpy(m_config.ts_rate_decimator, decimators, sizeof(decimators));
+    }
+    // libvpx 的分层码率/静态阈值调整仅在 CBR 下按层生效：开启时间分层即放弃 VBR 的静态画面省流，
+    // 因此默认单层（temporal_layers 配置项显式开启）
+    m_config.rc_end_usage = VPX_CBR;
+}
+
+bool VP9Encoder::applySvcParameters(int scaleNum, int scaleDen)
+{
+    vpx_svc_extra_cfg_t svc;
+    memset(&svc, 0, sizeof(svc));
+    for (int i = 0; i < VPX_MAX_LAYERS; ++i) {
+        svc.max_quantizers[i] = m_maxQuantizer;
+        svc.min_quantizers[i] = m_minQuantizer;
+    }
+    for (int i = 0; i < VPX_SS_MAX_LAYERS; ++i) {
+        svc.scaling_factor_num[i] = scaleNum;
+        svc.scaling_factor_den[i] = scaleDen;
+        svc.speed_per_layer[i] = m_cpuUsed;
+    }
+    svc.temporal_layering_mode = m_config.temporal_layering_mode;
+    return vpx_codec_control(&m_codec, VP9E_SET_SVC_PARAMETERS, &svc) == VPX_CODEC_OK;
+}
+
+bool VP9Encoder::applyRateTargets()
+{
+    m_config.rc_target_bitrate = m_bitrate / 1000; // kbps
+    if (m_config.ts_number_layers > 1) {
+        // 各层为累计码率：基础层占比最高，保证只收基础层的观看端画质
+        static const int kShare2[2] = { 60, 100 };
+        static const int kShare3[3] = { 50, 70, 100 };
+        const int *share = (m_config.ts_number_layers == 3) ? kShare3 : kShare2;
+        for (unsigned int i = 0; i < m_config.ts_number_layers; ++i) {
+            m_config.ts_target_bitrate[i] = m_config.rc_target_bitrate * share[i] / 100;
+            m_config.layer_target_bitrate[i] = m_config.ts_target_bitrate[i];
+        }
     }
+    return vpx_codec_enc_config_set(&m_codec, &m_config) == VPX_CODEC_OK;
 }
 
 bool VP9Encoder::initializeEncoder()
@@ -278,6 +497,7 @@ bool VP9Encoder::initializeEncoder()
     // [Fix 12] 切换到 VBR (Variable Bit Rate) 模式
     // 原因：CBR 模式会为了维持码率而填充无用数据，导致微小变化也产生大数据包。
     // VBR 模式允许编码器根据画面复杂度动态调整码率，实现“画面变动小，数据就小”。
+    // 例外：显式开启时间分层或循环帧内刷新时需要 CBR（见下方）
     m_config.rc_end_usage = VPX_VBR; 
     m_config.rc_min_quantizer = m_minQuantizer;
     m_config.rc_max_quantizer = m_maxQuantizer;
@@ -287,13 +507,22 @@ bool VP9Encoder::initializeEncoder()
     m_config.rc_buf_initial_sz = m_bufInitial;
     m_config.rc_buf_optimal_sz = m_bufOptimal;
     m_config.rc_buf_sz = m_bufTotal;
-    // 关键帧设置 - 减少关键帧频率以节省流量
-    m_config.kf_mode = VPX_KF_AUTO;
+    // 关键帧完全由关键帧策略决定（强制关键帧标志），编码器不再自动插入
+    m_config.kf_mode = VPX_KF_DISABLED;
     m_config.kf_min_dist = 0;
-    m_config.kf_max_dist = 300; // 每300帧一个关键帧（约10秒），大幅节省流量
+    m_config.kf_max_dist = 0;
+    
+    if (m_temporalLayers > 1) {
+        configureTemporalLayers();
+    }
+    // 循环帧内刷新（AQ 模式 3）仅在单遍 CBR 下生效
+    if (m_keyPolicy.mode() == KeyFramePolicy::Mode::IntraRefresh) {
+        m_config.rc_end_usage = VPX_CBR;
+    }
     
     // 更新实际使用的分辨率
     m_frameSize = QSize(width, height);
+    m_initialSize = m_frameSize;
 
     // 设置编码线程数以提升并行度
     // 使用系统理想线程数，至少为1
@@ -305,6 +534,23 @@ bool VP9Encoder::initializeEncoder()
         return false;
     }
     
+    // 启用时间分层：设置各层码率与层参数（失败则退回单层，数据包全部标记为基础层）
+    if (m_temporalLayers > 1) {
+        applyRateTargets();
+        if (vpx_codec_control(&m_codec, VP9E_SET_SVC, 1) != VPX_CODEC_OK || !applySvcParameters(1, 1)) {
+            vpx_codec_destroy(&m_codec);
+            m_temporalLayers = 1;
+            m_config.ts_number_layers = 1;
+            m_config.temporal_layering_mode = VP9E_TEMPORAL_LAYERING_MODE_NOLAYERING;
+            // 回到单层的码率模式：循环帧内刷新仍需 CBR
+            m_config.rc_end_usage = (m_keyPolicy.mode() == KeyFramePolicy::Mode::IntraRefresh) ? VPX_CBR : VPX_VBR;
+            res = vpx_codec_enc_init(&m_codec, vpx_codec_vp9_cx(), &m_config, 0);
+            if (res != VPX_CODEC_OK) {
+                return false;
+            }
+        }
+    }
+    
     // 设置编码器控制参数 - 极速实时编码和多线程优化
     vpx_codec_err_t ctrl_res;
     
@@ -340,12 +586,18 @@ bool VP9Encoder::initializeEncoder()
         
     }
     
-    // 启用自适应量化模式以优化编码效率
+    // 启用自适应量化模式以优化编码效率（模式 3 即循环帧内刷新，每帧以较低量化刷新一部分块）
     ctrl_res = vpx_codec_control(&m_codec, VP9E_SET_AQ_MODE, 3);
     if (ctrl_res != VPX_CODEC_OK) {
         
     }
     
+    // 限制关键帧大小为单帧平均码率的 3 倍，削平关键帧带来的码率尖峰
+    ctrl_res = vpx_codec_control(&m_codec, VP8E_SET_MAX_INTRA_BITRATE_PCT, 300);
+    if (ctrl_res != VPX_CODEC_OK) {
+        
+    }
+    
     // 设置静态阈值参数 - VP9特有的静态检测优化
     ctrl_res = vpx_codec_control(&m_codec, VP8E_SET_STATIC_THRESHOLD, 1);
     if (ctrl_res != VPX_CODEC_OK) {
@@ -360,6 +612,13 @@ bool VP9Encoder::initializeEncoder()
         
     }
     
+    // 在码流中标注色彩空间，解码端据此选择 I420/H420 转换
+    ctrl_res = vpx_codec_control(&m_codec, VP9E_SET_COLOR_SPACE,
+                                 m_colorMatrix == ColorConvert::Matrix::Bt709 ? VPX_CS_BT_709 : VPX_CS_BT_601);
+    if (ctrl_res != VPX_CODEC_OK) {
+        
+    }
+    
     // 设置实时模式 - 禁用自动替代参考帧
     ctrl_res = vpx_codec_control(&m_codec, VP8E_SET_ENABLEAUTOALTREF, 0);
     if (ctrl_res != VPX_CODEC_OK) {
@@ -378,16 +637,31 @@ bool VP9Encoder::initializeEncoder()
     return true;
 }
 
-bool VP9Encoder::convertRGBAToYUV420(const QByteArray &rgbaData, int inputWidth, int inputHeight, uint8_t **yuvPlanes)
+bool VP9Encoder::convertRGBAToYUV420(const QByteArray &rgbaData, int inputWidth, int inputHeight)
 {
     if (rgbaData.size() != inputWidth * inputHeight * 4) {
         return false;
     }
+    if (!m_rawImage.img_data) {
+        return false;
+    }
     
     const uint8_t *rgbaPtr = reinterpret_cast<const uint8_t*>(rgbaData.constData());
     int width = m_frameSize.width();
     int height = m_frameSize.height();
     
+    // 上一帧的转换结果仍有效且变化不多：只重新缩放/转换脏块
+    const QSize inputSize(inputWidth, inputHeight);
+    if (m_inputValid && m_inputSize == inputSize) {
+        int dirtyTiles = 0;
+        for (uint8_t d : m_inputDirty) {
+            dirtyTiles += d;
+        }
+        if (dirtyTiles * 2 <= m_inputDirty.size()) {
+            return convertDirtyTiles(rgbaPtr, inputWidth, inputHeight);
+        }
+    }
+    
     // 如果输入尺寸与目标尺寸不一致，需要进行缩放
     if (inputWidth != width || inputHeight != height) {
         // 调整缓冲区大小
@@ -409,76 +683,140 @@ bool VP9Encoder::convertRGBAToYUV420(const QByteArray &rgbaData, int inputWidth,
         rgbaPtr = dstData;
     }
     
-    // 使用libyuv库进行硬件加速的RGBA到YUV420转换
-    // 修复颜色空间转换，使用正确的BT.709色彩空间
-    int result = libyuv::ARGBToI420(
-        rgbaPtr, width * 4,  // ARGB源数据和步长
-        yuvPlanes[0], width,  // Y平面
-        yuvPlanes[1], width / 2,  // U平面  
-        yuvPlanes[2], width / 2,  // V平面
-        width, height
-    );
-    
-    // 应用BT.709色彩矩阵修正（修复蓝色变黄色问题）
-    // 这是常见的RGB到YUV转换色彩偏移问题
-    if (result == 0) {
-        // 对U和V平面进行轻微调整以修正色彩偏移
-        uint8_t* uPlane = yuvPlanes[1];
-        uint8_t* vPlane = yuvPlanes[2];
-        int uvSize = (width / 2) * (height / 2);
-        
-        for (int i = 0; i < uvSize; i++) {
-            // 修正色彩偏移：减少U分量，增加V分量
-            int u = uPlane[i] - 128;
-            int v = vPlane[i] - 128;
-            
-            // 应用色彩修正矩阵
-            u = u * 0.95;  // 轻微减少蓝色分量
-            v = v * 1.05;  // 轻微增加红色分量
-            
-            uPlane[i] = std::max(0, std::min(255, u + 128));
-            vPlane[i] = std::max(0, std::min(255, v + 128));
-        }
+    // 融合转换：色彩矩阵 + 2x2 色度下采样 + U/V 色偏修正（修复蓝色变黄色问题）一次完成，
+    // 结果直接写入编码器输入图像，省去中间平面、标量修正循环和 memcpy
+    const bool ok = ColorConvert::argbToI420(
+        rgbaPtr, width * 4,
+        m_rawImage.planes[VPX_PLANE_Y], m_rawImage.stride[VPX_PLANE_Y],
+        m_rawImage.planes[VPX_PLANE_U], m_rawImage.stride[VPX_PLANE_U],
+        m_rawImage.planes[VPX_PLANE_V], m_rawImage.stride[VPX_PLANE_V],
+        width, height,
+        m_colorCoeffs);
+
+    // 整帧转换后增量状态从本帧重新开始（需要本帧的块哈希作为后续比较基准）
+    m_inputValid = ok && m_dirtyDetector.hasHistory() && m_dirtyDetector.frameSize() == inputSize;
+    m_inputSize = inputSize;
+    m_inputDirty.fill(0, m_dirtyDetector.dirtyBitmap().size());
+    return ok;
+}
+
+void VP9Encoder::accumulateInputDirty(const QSize &inputSize, bool hadHistory)
+{
+    const QVector<uint8_t> &bitmap = m_dirtyDetector.dirtyBitmap();
+    if (!m_inputValid || !hadHistory || !m_dirtyDetector.hasHistory()
+        || m_inputSize != inputSize || m_dirtyDetector.frameSize() != inputSize
+        || m_inputDirty.size() != bitmap.size()) {
+        m_inputValid = false;
+        return;
     }
-    
-    if (result != 0) {
+    for (int i = 0; i < bitmap.size(); ++i) {
+        m_inputDirty[i] |= bitmap[i];
+    }
+}
+
+bool VP9Encoder::convertDirtyTiles(const uint8_t *argb, int inputWidth, int inputHeight)
+{
+    const int tilesX = m_dirtyDetector.tilesX();
+    const int tilesY = m_dirtyDetector.tilesY();
+    const int tile = DirtyRegionDetector::kTileSize;
+    const int width = m_frameSize.width();
+    const int height = m_frameSize.height();
+    const bool scaling = inputWidth != width || inputHeight != height;
+    if (tilesX * tilesY != m_inputDirty.size()
+        || (scaling && m_scaledArgbBuffer.size() != width * height * 4)) {
+        m_inputValid = false;
         return false;
     }
-    
+
+    // 脏块合并为矩形：每行连续脏块为一段，与上一行相同列范围的段纵向合并
+    QVector<QRect> rects;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ) {
+            if (!m_inputDirty[ty * tilesX + tx]) {
+                ++tx;
+                continue;
+            }
+            int end = tx;
+            while (end < tilesX && m_inputDirty[ty * tilesX + end]) {
+                ++end;
+            }
+            const QRect run(tx * tile, ty * tile,
+                            std::min(end * tile, inputWidth) - tx * tile,
+                            std::min(tile, inputHeight - ty * tile));
+            bool merged = false;
+            for (int i = rects.size() - 1; i >= 0 && rects[i].bottom() + 1 >= run.top(); --i) {
+                if (rects[i].left() == run.left() && rects[i].width() == run.width()
+                    && rects[i].bottom() + 1 == run.top()) {
+                    rects[i].setBottom(run.bottom());
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                rects.append(run);
+            }
+            tx = end;
+        }
+    }
+    m_inputDirty.fill(0);
+
+    uint8_t *scaled = reinterpret_cast<uint8_t*>(m_scaledArgbBuffer.data());
+    for (const QRect &r : rects) {
+        int x0 = r.left();
+        int y0 = r.top();
+        int x1 = r.right() + 1;
+        int y1 = r.bottom() + 1;
+        if (scaling) {
+            // 映射到输出坐标并向外扩展滤波器覆盖范围（输入、输出两侧各 2 像素），
+            // 区域边界像素的滤波输入与整帧缩放一致
+            x0 = int(qint64(std::max(0, x0 - 2)) * width / inputWidth) - 2;
+            y0 = int(qint64(std::max(0, y0 - 2)) * height / inputHeight) - 2;
+            x1 = int((qint64(std::min(inputWidth, x1 + 2)) * width + inputWidth - 1) / inputWidth) + 2;
+            y1 = int((qint64(std::min(inputHeight, y1 + 2)) * height + inputHeight - 1) / inputHeight) + 2;
+        }
+        // 对齐到偶数坐标：2x2 色度块不跨区域，结果与整帧转换逐像素一致
+        x0 = std::max(0, x0) & ~1;
+        y0 = std::max(0, y0) & ~1;
+        x1 = std::min(width, (x1 + 1) & ~1);
+        y1 = std::min(height, (y1 + 1) & ~1);
+        if (x1 <= x0 || y1 <= y0) {
+            continue;
+        }
+
+        const uint8_t *src = argb + qint64(y0) * inputWidth * 4 + x0 * 4;
+        int srcStride = inputWidth * 4;
+        if (scaling) {
+            // 裁剪缩放：沿用整帧的采样坐标，只计算输出区域
+            libyuv::ARGBScaleClip(argb, inputWidth * 4, inputWidth, inputHeight,
+                                  scaled, width * 4, width, height,
+                                  x0, y0, x1 - x0, y1 - y0,
+                                  libyuv::kFilterBox);
+            src = scaled + qint64(y0) * width * 4 + x0 * 4;
+            srcStride = width * 4;
+        }
+        if (!ColorConvert::argbToI420(
+                src, srcStride,
+                m_rawImage.planes[VPX_PLANE_Y] + y0 * m_rawImage.stride[VPX_PLANE_Y] + x0,
+                m_rawImage.stride[VPX_PLANE_Y],
+                m_rawImage.planes[VPX_PLANE_U] + (y0 / 2) * m_rawImage.stride[VPX_PLANE_U] + x0 / 2,
+                m_rawImage.stride[VPX_PLANE_U],
+                m_rawImage.planes[VPX_PLANE_V] + (y0 / 2) * m_rawImage.stride[VPX_PLANE_V] + x0 / 2,
+                m_rawImage.stride[VPX_PLANE_V],
+                x1 - x0, y1 - y0,
+                m_colorCoeffs)) {
+            m_inputValid = false;
+            return false;
+        }
+    }
     return true;
 }
 
-QByteArray VP9Encoder::encodeFrame(const uint8_t *yPlane, const uint8_t *uPlane, const uint8_t *vPlane)
+QByteArray VP9Encoder::encodeFrame()
 {
-    // 复制YUV数据到原始图像
-    memcpy(m_rawImage.planes[VPX_PLANE_Y], yPlane, m_yPlaneSize);
-    memcpy(m_rawImage.planes[VPX_PLANE_U], uPlane, m_uvPlaneSize);
-    memcpy(m_rawImage.planes[VPX_PLANE_V], vPlane, m_uvPlaneSize);
-    
-    // 编码帧 - 超快启动关键帧策略：第一帧立即关键帧，后续渐进式
+    // 关键帧由策略统一决定：首帧、（合并后的）请求、周期模式下的到期
     vpx_enc_frame_flags_t flags = 0;
-    bool shouldForceKeyFrame = false;
-    
-    if (m_frameCount == 1) { // 第一帧必须是关键帧，立即显示
-        shouldForceKeyFrame = true;
-        // 移除帧打印以提升性能
-    } else if (m_frameCount == 2 || m_frameCount == 3) { // 前3帧为关键帧，确保稳定
-        shouldForceKeyFrame = true;
-        // 移除帧打印以提升性能
-    } else if (m_forceNextKeyFrame) {
-        shouldForceKeyFrame = true;
-        // 移除帧打印以提升性能
-        m_forceNextKeyFrame = false;
-    } else if (m_frameCount <= 180) { // 前3秒（60fps * 3秒 = 180帧）
-        // 每30帧生成一个关键帧（约0.5秒间隔），减少编码延迟
-        if (m_frameCount % 30 == 0) {
-            shouldForceKeyFrame = true;
-            // 移除帧打印以提升性能
-        }
-    } else if (m_frameCount % 60 == 0) { // 3秒后每60帧一个关键帧（1秒间隔）
-        shouldForceKeyFrame = true;
-        // 移除帧打印以提升性能
-    }
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    const bool shouldForceKeyFrame = m_keyPolicy.shouldForceKeyFrame(nowMs);
     
     if (shouldForceKeyFrame) {
         flags = VPX_EFLAG_FORCE_KF;
@@ -489,50 +827,43 @@ QByteArray VP9Encoder::encodeFrame(const uint8_t *yPlane, const uint8_t *uPlane,
         return QByteArray();
     }
     
-    // 获取编码后的数据
+    // 本帧所属时间层（编码后查询，关键帧恒为基础层）
+    int temporalId = 0;
+    if (m_temporalLayers > 1) {
+        vpx_svc_layer_id_t layerId;
+        memset(&layerId, 0, sizeof(layerId));
+        if (vpx_codec_control(&m_codec, VP9E_GET_SVC_LAYER_ID, &layerId) == VPX_CODEC_OK) {
+            temporalId = layerId.temporal_layer_id;
+        }
+    }
+    
+    // 获取编码后的数据：头部与负载一次写入池化缓冲，直接交给发送链路
     QByteArray encodedData;
     vpx_codec_iter_t iter = nullptr;
     const vpx_codec_cx_pkt_t *pkt;
     
     while ((pkt = vpx_codec_get_cx_data(&m_codec, &iter)) != nullptr) {
         if (pkt->kind == VPX_CODEC_CX_FRAME_PKT) {
-            const char *frameData = static_cast<const char*>(pkt->data.frame.buf);
-            int frameSize = static_cast<int>(pkt->data.frame.sz);
             m_lastWasKey = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
             
-            // 添加时间戳到编码数据前（8字节，毫秒时间戳）
-            qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
-            QByteArray timestampData;
-            timestampData.resize(8);
-            memcpy(timestampData.data(), &timestamp, 8);
-            
-            // 组合时间戳和编码数据
-            encodedData.append(timestampData);
-            encodedData.append(frameData, frameSize);
+            m_keyPolicy.onFrameEncoded(m_lastWasKey, static_cast<int>(pkt->data.frame.sz), nowMs);
             
-            // 调试信息
-            static int debugFrameCount = 0;
-            
-            // 移除性能统计打印以提升性能
-            // 每20帧统计一次性能 - 已禁用
-            // if (debugFrameCount % 20 == 0) {
-            //     static qint64 lastStatsTime = QDateTime::currentMSecsSinceEpoch();
-            //     qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-            //     qint64 timeDiff = currentTime - lastStatsTime;
-            //     double fps = timeDiff > 0 ? (20.0 * 1000.0 / timeDiff) : 0.0;
-            //     qDebug() << "[VP9Encoder] 性能统计 - 帧" << debugFrameCount << ", 最近20帧用时:" << timeDiff << "ms, 平均FPS:" << QString::number(fps, 'f', 1);
-            //     lastStatsTime = currentTime;
-            // }
-            
-            // 删除详细帧日志以提升性能
-            // if (debugFrameCount < 5) { // 输出前5帧的详细信息 - 已禁用
-            //     bool isKeyFrame = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
-            //     qDebug() << "[VP9Encoder] 编码帧" << debugFrameCount 
-            //              << "大小:" << frameSize << "字节"
-            //              << (isKeyFrame ? "(关键帧)" : "(普通帧)");
-            // }
-            
-            debugFrameCount++; // 每次编码都递增计数器
+            PacketMeta meta;
+            meta.timestampMs = QDateTime::currentMSecsSinceEpoch();
+            meta.seq = ++m_packetSeq;
+            if (m_lastWasKey || temporalId == 0) {
+                if (++m_baseLayerSeq == 0) {
+                    m_baseLayerSeq = 1; // 0 保留为“未携带”
+                }
+            }
+            meta.baseSeq = m_baseLayerSeq;
+            meta.keyFrame = m_lastWasKey;
+            meta.temporalId = static_cast<quint8>(m_lastWasKey ? 0 : temporalId);
+            meta.streamId = m_streamId;
+            encodedData = m_packetPool.build(meta,
+                                             static_cast<const char*>(pkt->data.frame.buf),
+                                             static_cast<int>(pkt->data.frame.sz));
+            m_lastPacketMeta = meta;
             break;
         }
     }
@@ -597,71 +928,17 @@ void VP9Encoder::setQualityPreset(const QString &q)
 }
 
 // 静态检测相关方法实现
-double VP9Encoder::calculateFrameDifference(const QByteArray &currentFrame, const QByteArray &previousFrame)
-{
-    if (currentFrame.size() != previousFrame.size() || currentFrame.isEmpty()) {
-        return 1.0;
-    }
-
-    const int size = currentFrame.size();
-    const uint8_t *curr = reinterpret_cast<const uint8_t*>(currentFrame.constData());
-    const uint8_t *prev = reinterpret_cast<const uint8_t*>(previousFrame.constData());
-
-    // 1. 极速路径：完全内存比较 (O(N/SIMD))
-    // 对于数字信号的屏幕捕获，大多数时候画面是完全静止的。
-    // memcmp 高度优化（使用 AVX/SSE），比任何手动循环都快。
-    if (memcmp(curr, prev, size) == 0) {
-        return 0.0;
-    }
-
-    // 2. 快速扫描与提前退出算法 (O(N/8))
-    // 如果 memcmp 发现差异，我们需要知道差异的幅度。
-    // 使用 uint64_t 步进（一次比较 2 个像素/8字节），大幅减少循环次数。
-    
-    const int stride = sizeof(uint64_t);
-    const int steps = size / stride;
-    const uint64_t *curr64 = reinterpret_cast<const uint64_t*>(curr);
-    const uint64_t *prev64 = reinterpret_cast<const uint64_t*>(prev);
-    
-    int differentBlocks = 0;
-    
-    // 计算提前退出阈值：一旦差异超过此限制，立即判定为动态。
-    // 使用 max(static, lowMotion) 确保我们能捕捉到“低动态”范围的准确差异值
-    // 而不是一超过 static 阈值就直接返回 1.0
-    double exitThreshold = std::max(m_staticThreshold, m_lowMotionThreshold);
-    // 增加一点缓冲，防止边界抖动
-    exitThreshold = std::min(exitThreshold * 1.5, 1.0);
-
-    int diffLimit = static_cast<int>(steps * exitThreshold);
-    if (diffLimit < 1) diffLimit = 1; 
-
-    for (int i = 0; i < steps; ++i) {
-        // 严格比较：任何位变化都被视为差异（符合“捕捉微小变化”的需求）
-        if (curr64[i] != prev64[i]) {
-            differentBlocks++;
-            
-            // 提前退出策略
-            if (differentBlocks > diffLimit) {
-                return 1.0; // 确认为高动态，返回 1.0
-            }
-        }
-    }
-    
-    // 如果循环结束且未超过阈值，返回实际差异比例
-    return (double)differentBlocks / steps;
-}
-
-bool VP9Encoder::isFrameStatic(const QByteArray &frameData)
+bool VP9Encoder::isFrameStatic()
 {
-    if (m_previousFrameData.isEmpty()) {
-        m_previousFrameData = frameData;
+    if (!m_dirtyDetector.hasHistory()) {
         m_lastFrameWasStatic = false;
         m_staticFrameCount = 0;
         return false;
     }
     
-    m_lastFrameDifference = calculateFrameDifference(frameData, m_previousFrameData);
-    bool isStatic = m_lastFrameDifference < m_staticThreshold;
+    // 差异比例 = 脏块面积占比；完全无脏块必为静态
+    m_lastFrameDifference = m_dirtyDetector.dirtyRatio();
+    bool isStatic = m_dirtyDetector.dirtyTileCount() == 0 || m_lastFrameDifference < m_staticThreshold;
     
     if (isStatic) {
         if (m_lastFrameWasStatic) {
@@ -680,7 +957,7 @@ bool VP9Encoder::isFrameStatic(const QByteArray &frameData)
     m_lastFrameWasStatic = isStatic;
     
     // 每100帧输出一次静态检测统计（用于调试）
-    static int staticDebugCounter = 0;
+    static thread_local int staticDebugCounter = 0;
     if (++staticDebugCounter % 100 == 0) {
         
     }
@@ -718,13 +995,7 @@ void VP9Encoder::adjustBitrateForStaticContent(bool isStatic)
     if (targetBitrate != m_bitrate) {
         m_bitrate = targetBitrate;
         
-        // 动态更新编码器码率
-        m_config.rc_target_bitrate = m_bitrate / 1000; // kbps
-        vpx_codec_err_t res = vpx_codec_enc_config_set(&m_codec, &m_config);
-        if (res != VPX_CODEC_OK) {
-            
-        } else {
-            
-        }
+        // 动态更新编码器码率（时间分层时同步更新各层码率）
+        applyRateTargets();
     }
 }
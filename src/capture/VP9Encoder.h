@@ -4,13 +4,21 @@
 #include <QObject>
 #include <QByteArray>
 #include <QSize>
+#include <QVector>
 #include <QMutex>
+#include <atomic>
+#include <algorithm>
 
 // VP9编码库头文件
 #include <vpx/vpx_encoder.h>
 #include <vpx/vp8cx.h>
 #include <libyuv.h>
 
+#include "DirtyRegionDetector.h"
+#include "ColorConvert.h"
+#include "PacketBufferPool.h"
+#include "KeyFramePolicy.h"
+
 class VP9Encoder : public QObject
 {
     Q_OBJECT
@@ -21,12 +29,21 @@ public:
     
     bool initialize(int width, int height, int fps);
     void cleanup();
+    // 运行时重配置：在现有编码器上切换分辨率，并下发当前码率/量化范围/cpu-used（先通过 setBitrate、
+    // setQualityPreset 等设置）。分辨率变化借助 VP9 参考帧缩放直接在码流中切换，不插入关键帧；
+    // 未初始化、帧率变化、尺寸超出首次初始化尺寸或单次缩小超过一半时退回完整重建
+    bool reconfigure(int width, int height, int fps);
     
-    QByteArray encode(const QByteArray &frameData, int inputWidth = -1, int inputHeight = -1);
+    // damage：采集端报告的相对上一输入帧的变化区域（可为 nullptr），用于缩小脏区域检测范围
+    QByteArray encode(const QByteArray &frameData, int inputWidth = -1, int inputHeight = -1,
+                      const QVector<QRect> *damage = nullptr);
     
     // 编码参数
     void setBitrate(int bitrate) { m_bitrate = bitrate; m_originalBitrate = bitrate; }
     void setKeyFrameInterval(int interval) { m_keyFrameInterval = interval; }
+    // 关键帧策略模式与周期（周期模式使用），编码器配置部分下次 initialize 时生效
+    void setKeyFramePolicy(KeyFramePolicy::Mode mode, int periodMs);
+    KeyFramePolicy::Stats keyFrameStats() const { return m_keyPolicy.stats(); }
     
     // 静态检测参数
     void setStaticThreshold(double threshold) { m_staticThreshold = threshold; }
@@ -38,6 +55,13 @@ public:
     void setRateControl(int undershootPct, int overshootPct, int bufInitial, int bufOptimal, int bufTotal) { m_undershootPct = undershootPct; m_overshootPct = overshootPct; m_bufInitial = bufInitial; m_bufOptimal = bufOptimal; m_bufTotal = bufTotal; }
     void setDeadline(int v) { m_deadline = v; }
     void setQualityPreset(const QString &q);
+    // 色彩矩阵与色度修正增益，下次 initialize 时生效（码流同时标注色彩空间）
+    void setColorMatrix(ColorConvert::Matrix matrix) { m_colorMatrix = matrix; }
+    void setChromaCorrection(double uGain, double vGain) { m_chromaUGain = uGain; m_chromaVGain = vGain; }
+    // 时间分层（SVC）层数 1-3，默认 1，下次 initialize 时生效；每个数据包头部携带所属层ID，
+    // 中继可对积压的观看端只转发基础层，实现按观看端降帧率而无需重新编码。多层需 CBR，不再按画面变化省流
+    void setTemporalLayers(int layers) { m_temporalLayers = std::max(1, std::min(layers, PacketHeader::kMaxTemporalLayers)); }
+    int temporalLayers() const { return m_temporalLayers; }
     
     // 状态查询
     bool isInitialized() const { return m_initialized; }
@@ -45,25 +69,47 @@ public:
     int getFrameRate() const { return m_frameRate; }
     double getStaticThreshold() const { return m_staticThreshold; }
     bool isStaticDetectionEnabled() const { return m_enableStaticDetection; }
+    // 最近一次 encode 输入帧的脏块位图/脏矩形（输入帧坐标，供缩放、ROI、分块传输复用）
+    // 仅应在编码线程内或持有外部同步时读取
+    const DirtyRegionDetector &dirtyRegions() const { return m_dirtyDetector; }
+    // 输出缓冲池统计（分配/复用计数，用于确认稳态零分配）
+    const PacketBufferPool &packetPool() const { return m_packetPool; }
+    void setStreamId(quint8 id) { m_streamId = id; }
+    
+    // 运行时调整（任意线程调用，只记录请求；编码线程在下一帧编码前应用，不重建编码器）
+    // 码率作为新的基准码率，静态内容降码策略在其基础上继续生效
+    void requestRuntimeBitrate(int bitrate) { m_requestedBitrate.store(bitrate, std::memory_order_relaxed); }
+    // 编码分辨率内部缩放（VP9 参考帧缩放，码流中直接切换，无需关键帧）；支持 1、4/5、3/5、1/2
+    void requestScaling(int scaleNum, int scaleDen);
+    // 与 libvpx 缩放一致的输出尺寸（观看端解码得到的即为该尺寸）
+    QSize scaledFrameSize(int scaleNum, int scaleDen) const;
     
 signals:
     void frameEncoded(const QByteArray &encodedData);
     void frameEncodedWithInfo(const QByteArray &encodedData, bool keyFrame);
+    void packetEncoded(const QByteArray &packet, const PacketMeta &meta);
     void error(const QString &errorMessage);
 
 public slots:
-    void forceKeyFrame(); // 强制生成关键帧
+    void forceKeyFrame(); // 请求关键帧（交由关键帧策略合并，任意线程调用）
     void resetStreamingState();
 
 private:
     bool initializeEncoder();
-    bool convertRGBAToYUV420(const QByteArray &rgbaData, int inputWidth, int inputHeight, uint8_t **yuvPlanes);
-    QByteArray encodeFrame(const uint8_t *yPlane, const uint8_t *uPlane, const uint8_t *vPlane);
+    bool convertRGBAToYUV420(const QByteArray &rgbaData, int inputWidth, int inputHeight);
+    // 增量输入：累积自上次转换以来的脏块，只重新缩放/转换这些块（m_rawImage 保留上次结果）
+    void accumulateInputDirty(const QSize &inputSize, bool hadHistory);
+    bool convertDirtyTiles(const uint8_t *argb, int inputWidth, int inputHeight);
+    QByteArray encodeFrame();
     
-    // 静态检测相关方法
-    double calculateFrameDifference(const QByteArray &currentFrame, const QByteArray &previousFrame);
-    bool isFrameStatic(const QByteArray &frameData);
+    // 静态检测相关方法（基于分块哈希的脏区域结果）
+    bool isFrameStatic();
     void adjustBitrateForStaticContent(bool isStatic);
+    void applyRuntimeRequests();
+    bool applyRateTargets(); // 下发 m_bitrate（含各时间层的累计码率）
+    bool reconfigureLive(int width, int height, int fps);
+    void configureTemporalLayers();
+    bool applySvcParameters(int scaleNum, int scaleDen);
     
     // VP9编码器相关
     vpx_codec_ctx_t m_codec;
@@ -72,6 +118,7 @@ private:
     
     // 编码参数
     QSize m_frameSize;
+    QSize m_initialSize;                // 编码器创建时的尺寸（实时重配置的上限）
     int m_frameRate;
     int m_bitrate;
     int m_keyFrameInterval;
@@ -82,7 +129,7 @@ private:
     double m_lowMotionThreshold;        // 低动态阈值 (0.0-1.0)
     double m_staticBitrateReduction;    // 静态内容码率减少比例 (0.0-1.0)
     bool m_skipStaticFrames;            // 是否跳过静态帧
-    QByteArray m_previousFrameData;     // 上一帧数据用于比较
+    DirtyRegionDetector m_dirtyDetector; // 分块哈希脏区域检测（替代整帧副本比较）
     double m_lastFrameDifference;       // 上一帧差异比例
     bool m_lastFrameWasStatic;          // 上一帧是否为静态
     int m_staticFrameCount;             // 连续静态帧计数
@@ -91,18 +138,36 @@ private:
     // 状态
     bool m_initialized;
     int m_frameCount;
-    bool m_forceNextKeyFrame; // 强制下一帧为关键帧
+    KeyFramePolicy m_keyPolicy; // 决定哪一帧强制为关键帧
     bool m_lastWasKey;
     
-    // YUV转换缓冲区
-    uint8_t *m_yPlane;
-    uint8_t *m_uPlane;
-    uint8_t *m_vPlane;
-    int m_yPlaneSize;
-    int m_uvPlaneSize;
+    // YUV转换参数（转换结果直接写入 m_rawImage）
+    ColorConvert::Matrix m_colorMatrix;
+    double m_chromaUGain;
+    double m_chromaVGain;
+    ColorConvert::Coefficients m_colorCoeffs;
     
-    // 缩放缓冲
+    // 缩放缓冲（增量转换时保留上次缩放结果，只覆盖脏块对应区域）
     QByteArray m_scaledArgbBuffer;
+    // 增量输入状态：m_rawImage 与 m_inputSize 尺寸的上一输入帧一致时有效
+    bool m_inputValid = false;
+    QSize m_inputSize;
+    QVector<uint8_t> m_inputDirty;      // 与脏区域检测的块位图一一对应
+    
+    // 输出数据包（池化缓冲，头部预留时间戳）
+    PacketBufferPool m_packetPool;
+    quint32 m_packetSeq;
+    quint16 m_baseLayerSeq;             // 基础层序号（TL0PICIDX），观看端据此估算丢包
+    quint8 m_streamId;
+    PacketMeta m_lastPacketMeta;
+    
+    // 时间分层
+    int m_temporalLayers;
+    
+    // 运行时调整请求（0 表示无请求）与已生效的缩放模式
+    std::atomic<int> m_requestedBitrate{0};
+    std::atomic<int> m_requestedScaleMode{VP8E_NORMAL};
+    int m_appliedScaleMode;
     
     // 线程安全
     QMutex m_mutex;
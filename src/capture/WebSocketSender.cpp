@@ -16,6 +16,8 @@
 #include <QUrl>
 #include <QDebug>
 #include "../common/AppConfig.h"
+#include "../common/PacketHeader.h"
+#include "../common/BinaryMessage.h"
 
 WebSocketSender::WebSocketSender(QObject *parent)
     : QObject(parent)
@@ -69,6 +71,7 @@ void WebSocketSender::setupWebSocket()
     connect(m_webSocket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error),
             this, &WebSocketSender::onError);
     connect(m_webSocket, &QWebSocket::textMessageReceived, this, &WebSocketSender::onTextMessageReceived);
+    connect(m_webSocket, &QWebSocket::binaryMessageReceived, this, &WebSocketSender::onBinaryMessageReceived);
 }
 
 bool WebSocketSender::connectToServer(const QString &url)
@@ -141,23 +144,47 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
     if (!m_connected || !m_webSocket || !m_isStreaming) {
         return;
     }
+
+    // 丢弃基础层帧会使该路参考链断开，直到下一个关键帧；每次断开只请求一次关键帧
+    // （高时间层帧不被基础层参考，丢弃后在下一个基础层帧自愈）
+    quint32 newlyBroken = 0;
+    auto noteDropped = [this, &newlyBroken](const QByteArray &dropped) {
+        const PacketHeader::Info info = PacketHeader::read(dropped);
+        if (info.temporalId != 0) {
+            return;
+        }
+        const quint32 bit = 1u << (info.streamId & 0x1F);
+        if (!(m_brokenStreams & bit)) {
+            m_brokenStreams |= bit;
+            newlyBroken |= bit;
+        }
+    };
+    auto requestRecovery = [this, &locker, &newlyBroken]() {
+        locker.unlock();
+        for (int streamId = 0; newlyBroken; ++streamId, newlyBroken >>= 1) {
+            if (newlyBroken & 1u) {
+                emit streamKeyFrameRequested(streamId);
+            }
+        }
+    };
+
     qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     if (frameData.size() >= 8) {
-        qint64 ts;
-        memcpy(&ts, frameData.constData(), 8);
+        const qint64 ts = PacketHeader::timestampMs(frameData);
         if (nowMs - ts > m_queueMaxAgeMs) {
+            noteDropped(frameData);
+            requestRecovery();
             return;
         }
     }
-
     while (!m_frameQueue.isEmpty()) {
         const QByteArray &first = m_frameQueue.head();
         if (first.size() < 8) {
             break;
         }
-        qint64 ots;
-        memcpy(&ots, first.constData(), 8);
+        const qint64 ots = PacketHeader::timestampMs(first);
         if (nowMs - ots > m_queueMaxAgeMs) {
+            noteDropped(first);
             m_frameQueue.dequeue();
             if (!m_keyQueue.isEmpty()) {
                 m_keyQueue.dequeue();
@@ -170,6 +197,9 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
 
     if (m_frameQueue.size() >= m_maxQueueSize) {
         if (keyFrame) {
+            for (const QByteArray &queued : m_frameQueue) {
+                noteDropped(queued);
+            }
             m_frameQueue.clear();
             m_keyQueue.clear();
             m_frameQueue.enqueue(frameData);
@@ -178,9 +208,9 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
             while (!m_frameQueue.isEmpty()) {
                 const QByteArray &first = m_frameQueue.head();
                 if (first.size() >= 8) {
-                    qint64 ots;
-                    memcpy(&ots, first.constData(), 8);
+                    const qint64 ots = PacketHeader::timestampMs(first);
                     if (nowMs - ots > m_queueMaxAgeMs) {
+                        noteDropped(first);
                         m_frameQueue.dequeue();
                         m_keyQueue.dequeue();
                         m_droppedFramesDueToAge++;
@@ -200,6 +230,7 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
                     bool k = m_keyQueue.dequeue();
                     if (!dropped && !k) {
                         dropped = true;
+                        noteDropped(d);
                         m_droppedFramesDueToQueue++;
                         continue;
                     }
@@ -213,6 +244,8 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
             if (m_frameQueue.size() < m_maxQueueSize) {
                 m_frameQueue.enqueue(frameData);
                 m_keyQueue.enqueue(false);
+            } else {
+                noteDropped(frameData);
             }
         }
     } else {
@@ -222,6 +255,66 @@ void WebSocketSender::enqueueFrame(const QByteArray &frameData, bool keyFrame)
     if (m_sendTimer && !m_sendTimer->isActive()) {
         m_sendTimer->start();
     }
+    if (keyFrame) {
+        // 关键帧已入队：该路参考链在此恢复
+        const quint32 keyBit = 1u << (PacketHeader::read(frameData).streamId & 0x1F);
+        m_brokenStreams &= ~keyBit;
+        newlyBroken &= ~keyBit;
+    }
+    if (newlyBroken) {
+        requestRecovery();
+    }
+}
+
+int WebSocketSender::queueDepth() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frameQueue.size();
+}
+
+qint64 WebSocketSender::droppedFramesByAge() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_droppedFramesDueToAge;
+}
+
+qint64 WebSocketSender::droppedFramesByQueue() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_droppedFramesDueToQueue;
+}
+
+qint64 WebSocketSender::bytesToWrite() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_webSocket ? m_webSocket->bytesToWrite() : 0;
+}
+
+void WebSocketSender::setReferenceFrameSize(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_referenceFrameSize = size;
+}
+
+void WebSocketSender::mapToReferenceFrame(const QJsonObject &obj, int &x, int &y) const
+{
+    mapToReferenceFrame(QSize(obj.value("frame_w").toInt(0), obj.value("frame_h").toInt(0)), x, y);
+}
+
+void WebSocketSender::mapToReferenceFrame(const QSize &frameSize, int &x, int &y) const
+{
+    const int frameW = frameSize.width();
+    const int frameH = frameSize.height();
+    QSize ref;
+    {
+        QMutexLocker locker(&m_mutex);
+        ref = m_referenceFrameSize;
+    }
+    if (frameW <= 0 || frameH <= 0 || ref.isEmpty() || (frameW == ref.width() && frameH == ref.height())) {
+        return;
+    }
+    x = qRound(double(x) * ref.width() / frameW);
+    y = qRound(double(y) * ref.height() / frameH);
 }
 
 void WebSocketSender::sendTextMessage(const QString &message)
@@ -259,6 +352,53 @@ void WebSocketSender::sendTextMessage(const QString &message)
     }
 }
 
+void WebSocketSender::sendBinaryMessage(const QByteArray &message)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 与文本消息相同：已连接即发送（仅音频模式下音频同样需要发出），不经过视频发送队列
+    if (m_connected && m_webSocket) {
+        m_webSocket->sendBinaryMessage(message);
+    }
+}
+
+void WebSocketSender::onBinaryMessageReceived(const QByteArray &message)
+{
+    // 推流端只会收到观看端发来的版本 1 消息；旧格式/无效头部直接忽略
+    const PacketHeader::Info info = PacketHeader::read(message);
+    if (!BinaryMessage::isMessage(info)) {
+        return;
+    }
+    switch (info.type) {
+    case PacketHeader::MessageType::ViewerAudio: {
+        BinaryMessage::Audio audio;
+        if (BinaryMessage::decodeAudio(message, info, audio)) {
+            emit viewerAudioOpusReceived(audio.senderId, audio.opus, audio.sampleRate, audio.channels,
+                                         audio.frameSamples > 0 ? audio.frameSamples : 320, info.timestampMs);
+        }
+        break;
+    }
+    case PacketHeader::MessageType::Cursor: {
+        BinaryMessage::Cursor cursor;
+        if (BinaryMessage::decodeCursor(message, info, cursor)) {
+            mapToReferenceFrame(cursor.frameSize, cursor.x, cursor.y);
+            emit viewerCursorReceived(cursor.senderId, cursor.x, cursor.y, cursor.name);
+        }
+        break;
+    }
+    case PacketHeader::MessageType::Annotation: {
+        BinaryMessage::Annotation a;
+        if (BinaryMessage::decodeAnnotation(message, info, a)) {
+            mapToReferenceFrame(a.frameSize, a.x, a.y);
+            emit annotationEventReceived(a.phase, a.x, a.y, a.viewerId, a.colorId);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
 void WebSocketSender::onConnected()
 {
     bool isPublisher = false;
@@ -533,7 +673,16 @@ void WebSocketSender::onTextMessageReceived(const QString &message)
             emit requestKeyFrame();
         }
     } else if (type == "request_keyframe") {
-        emit requestKeyFrame();
+        // 中继为观看端切换流时会指定 stream，只让该路生成关键帧
+        if (obj.contains("stream")) {
+            emit streamKeyFrameRequested(obj.value("stream").toInt(0));
+        } else {
+            emit requestKeyFrame();
+        }
+    } else if (type == "select_stream") {
+        QString vid = obj.value("viewer_id").toString();
+        if (vid.isEmpty()) vid = obj.value("sender_id").toString();
+        emit streamSelectionReceived(vid, obj.value("stream").toInt(0));
     } else if (type == "stop_streaming") {
         QString vid = obj.value("viewer_id").toString();
         if (vid.isEmpty()) vid = obj.value("sender_id").toString();
@@ -549,6 +698,7 @@ void WebSocketSender::onTextMessageReceived(const QString &message)
         QString phase = obj.value("phase").toString();
         int x = obj.value("x").toInt();
         int y = obj.value("y").toInt();
+        mapToReferenceFrame(obj, x, y);
         QString viewerId = obj.value("viewer_id").toString();
         int colorId = obj.value("color_id").toInt(0);
         
@@ -557,6 +707,7 @@ void WebSocketSender::onTextMessageReceived(const QString &message)
         QString txt = obj.value("text").toString();
         int x = obj.value("x").toInt();
         int y = obj.value("y").toInt();
+        mapToReferenceFrame(obj, x, y);
         QString viewerId = obj.value("viewer_id").toString();
         int colorId = obj.value("color_id").toInt(0);
         int fontSize = obj.value("font_size").toInt(16);
@@ -572,8 +723,16 @@ void WebSocketSender::onTextMessageReceived(const QString &message)
         emit switchScreenRequested(direction, index);
     } else if (type == "set_quality") {
         QString quality = obj.value("quality").toString();
+        QString vid = obj.value("viewer_id").toString();
         
-        emit qualityChangeRequested(quality);
+        emit qualityChangeRequested(quality, vid);
+    } else if (type == "receiver_report") {
+        QString vid = obj.value("viewer_id").toString();
+        if (vid.isEmpty()) vid = obj.value("sender_id").toString();
+        double jitterMs = obj.value("jitter_ms").toDouble(0.0);
+        double lossPct = obj.value("loss_pct").toDouble(0.0);
+        double queueDelayMs = obj.value("queue_delay_ms").toDouble(0.0);
+        emit receiverReportReceived(vid, jitterMs, lossPct, queueDelayMs);
     } else if (type == "audio_toggle") {
         bool enabled = obj.value("enabled").toBool(false);
         emit audioToggleRequested(enabled);
@@ -613,6 +772,7 @@ void WebSocketSender::onTextMessageReceived(const QString &message)
         QString vname = obj.value("viewer_name").toString();
         int x = obj.value("x").toInt();
         int y = obj.value("y").toInt();
+        mapToReferenceFrame(obj, x, y);
         emit viewerCursorReceived(vid, x, y, vname);
     } else if (type == "viewer_name_update") {
         QString vid = obj.value("viewer_id").toString();
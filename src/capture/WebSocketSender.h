@@ -8,8 +8,10 @@
 #include <QMutex>
 #include <QVector>
 #include <QQueue>
+#include <QSize>
 
 // 前向声明
+class QJsonObject;
 
 class WebSocketSender : public QObject
 {
@@ -25,6 +27,7 @@ public:
     void sendFrame(const QByteArray &frameData);
     void enqueueFrame(const QByteArray &frameData, bool keyFrame);
     void sendTextMessage(const QString &message); // 新增：发送文本消息
+    void sendBinaryMessage(const QByteArray &message); // 二进制消息（音频、光标等，格式见 BinaryMessage.h）
     
     // 推流控制
     void startStreaming();
@@ -42,6 +45,16 @@ public:
     qint64 getTotalBytesSent() const { return m_totalBytesSent; }
     qint64 getTotalFramesSent() const { return m_totalFramesSent; }
     
+    // 拥塞信号（供自适应码率控制器采样）
+    int queueDepth() const;
+    qint64 droppedFramesByAge() const;
+    qint64 droppedFramesByQueue() const;
+    qint64 bytesToWrite() const; // socket 尚未写出的字节数
+    
+    // 观看端坐标的参考画面尺寸（主编码流的实际输出尺寸）。观看端消息带有其解码画面尺寸
+    // （frame_w/frame_h，多路编码下可能是低分辨率流）时，批注与光标坐标先换算到该尺寸再发出信号
+    void setReferenceFrameSize(const QSize &size);
+    
     // 性能统计结构
     struct SenderStats {
         quint64 totalBytesSent;               // 总发送字节数
@@ -75,6 +88,7 @@ signals:
     void frameSent(int frameSize);
     void error(const QString &errorMessage);
     void requestKeyFrame(); // 请求编码器生成关键帧
+    void streamKeyFrameRequested(int streamId); // 只请求某一路（simulcast）的关键帧
     void streamingStarted(); // 开始推流信号
     void streamingStopped(bool softStop); // 停止推流信号
     
@@ -85,7 +99,7 @@ signals:
     // 切换屏幕请求（观看端发来）
     void switchScreenRequested(const QString &direction, int index);
     // 质量变更请求（观看端发来）
-    void qualityChangeRequested(const QString &quality);
+    void qualityChangeRequested(const QString &quality, const QString &viewerId);
     // 音频测试开关请求（观看端发来）
     void audioToggleRequested(bool enabled);
     void audioGainRequested(int percent);
@@ -98,12 +112,17 @@ signals:
     void viewerJoined(const QString &viewerId);
     void viewerExited(const QString &viewerId);
     void watchRequestReceived(const QString &viewerId, const QString &viewerName, const QString &targetId, int iconId);
+    // 观看端接收质量上报（到达抖动、估算丢包率、排队时延）
+    void receiverReportReceived(const QString &viewerId, double jitterMs, double lossPct, double queueDelayMs);
+    // 观看端选择的流（0 为原始分辨率，数字越大分辨率越低）
+    void streamSelectionReceived(const QString &viewerId, int streamId);
 
 private slots:
     void onConnected();
     void onDisconnected();
     void onError(QAbstractSocket::SocketError socketError);
     void onTextMessageReceived(const QString &message); // 处理文本消息
+    void onBinaryMessageReceived(const QByteArray &message); // 观看端二进制消息（语音、光标、标注）
     void attemptReconnect();
     void onSendTimer();
 
@@ -115,6 +134,8 @@ private:
     void sendApprovalRequired(const QString &viewerId, const QString &targetId);
     void sendWatchAccepted(const QString &viewerId, const QString &targetId);
     void sendWatchRejected(const QString &viewerId, const QString &targetId);
+    void mapToReferenceFrame(const QJsonObject &obj, int &x, int &y) const;
+    void mapToReferenceFrame(const QSize &frameSize, int &x, int &y) const;
 public:
     void approveWatchRequest();
     void localApproveWatchRequest();
@@ -159,6 +180,7 @@ public:
     int m_queueMaxAgeMs = 200;
     qint64 m_droppedFramesDueToQueue = 0;
     qint64 m_droppedFramesDueToAge = 0;
+    quint32 m_brokenStreams = 0;   // 按流ID的位图：丢过基础层帧、尚未送入关键帧
 
     // 手动同意状态
     bool m_waitingForApproval = false;
@@ -168,6 +190,7 @@ public:
     int m_pendingIconId = -1;
     bool m_pendingAudioOnly = false;
     bool m_audioOnlyStreaming = false;
+    QSize m_referenceFrameSize;
 };
 
 #endif // WEBSOCKETSENDER_H
@@ -49,197 +49,18 @@
 #include "../common/ConsoleLogger.h"
 #include "../common/CrashGuard.h"
 #include "../common/AppConfig.h"
+#include "../common/LanRelayServer.h"
+#include "../common/BinaryMessage.h"
 #include "ScreenCapture.h"
 #include "VP9Encoder.h"
+#include "CapturePipeline.h"
+#include "AdaptiveBitrateController.h"
 #include "WebSocketSender.h"
 #include "MouseCapture.h" // 新增：鼠标捕获头文件
 // 性能监控禁用：避免统计带来的额外开销
 #include "AnnotationOverlay.h"
 #include "CursorOverlay.h"
 
-namespace {
-class LanRelayServer final : public QObject
-{
-public:
-    explicit LanRelayServer(QObject *parent = nullptr)
-        : QObject(parent)
-    {
-    }
-
-    bool start(quint16 port)
-    {
-        if (m_server) {
-            return true;
-        }
-
-        m_server = new QWebSocketServer(QStringLiteral("IrulerDeskpro LAN Relay"), QWebSocketServer::NonSecureMode, this);
-        if (!m_server->listen(QHostAddress::AnyIPv4, port)) {
-            m_server->deleteLater();
-            m_server = nullptr;
-            return false;
-        }
-
-        connect(m_server, &QWebSocketServer::newConnection, this, &LanRelayServer::onNewConnection);
-        return true;
-    }
-
-    quint16 port() const
-    {
-        if (!m_server) return 0;
-        return static_cast<quint16>(m_server->serverPort());
-    }
-
-private:
-    struct Room {
-        QWebSocket *publisher = nullptr;
-        QSet<QWebSocket*> subscribers;
-        QVector<QString> pendingTextToPublisher;
-        QVector<QByteArray> pendingBinaryToPublisher;
-    };
-
-    QWebSocketServer *m_server = nullptr;
-    QHash<QString, Room> m_rooms;
-
-    void onNewConnection()
-    {
-        if (!m_server) return;
-        QWebSocket *sock = m_server->nextPendingConnection();
-        if (!sock) return;
-
-        const QString path = sock->requestUrl().path();
-        const QStringList parts = path.split('/', Qt::SkipEmptyParts);
-        if (parts.size() < 2) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        const QString role = parts.value(0);
-        const QString roomId = parts.value(1);
-        if (roomId.isEmpty()) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        if (role != QStringLiteral("publish") && role != QStringLiteral("subscribe")) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        // qInfo().noquote() << "[LanRelay] New connection:" << sock->peerAddress().toString() 
-        //                   << " role=" << role << " roomId=" << roomId;
-
-        Room &room = m_rooms[roomId];
-
-        if (role == QStringLiteral("publish")) {
-            if (room.publisher && room.publisher != sock) {
-                room.publisher->close();
-                room.publisher->deleteLater();
-            }
-            room.publisher = sock;
-            qInfo().noquote() << "[LanRelay] Publisher connected for room:" << roomId;
-
-            if (!room.pendingTextToPublisher.isEmpty()) {
-                qInfo().noquote() << "[LanRelay] Flushing " << room.pendingTextToPublisher.size() << " pending text messages to publisher";
-                for (const QString &msg : room.pendingTextToPublisher) {
-                    if (sock->state() == QAbstractSocket::ConnectedState) {
-                        sock->sendTextMessage(msg);
-                    }
-                }
-                room.pendingTextToPublisher.clear();
-            }
-            if (!room.pendingBinaryToPublisher.isEmpty()) {
-                for (const QByteArray &msg : room.pendingBinaryToPublisher) {
-                    if (sock->state() == QAbstractSocket::ConnectedState) {
-                        sock->sendBinaryMessage(msg);
-                    }
-                }
-                room.pendingBinaryToPublisher.clear();
-            }
-
-            connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                static int binLogCount = 0;
-                if (++binLogCount % 60 == 0) qInfo().noquote() << "[LanRelay] Fwd binary from pub to " << it->subscribers.size() << " subs. Size:" << msg.size();
-                for (QWebSocket *rawSub : it->subscribers) {
-                    QPointer<QWebSocket> sub = rawSub;
-                    if (sub && sub->state() == QAbstractSocket::ConnectedState) {
-                        sub->sendBinaryMessage(msg);
-                    }
-                }
-            });
-
-            connect(sock, &QWebSocket::textMessageReceived, this, [this, roomId](const QString &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                qInfo().noquote() << "[LanRelay] Fwd text from pub to " << it->subscribers.size() << " subs: " << msg.left(200);
-                for (QWebSocket *rawSub : it->subscribers) {
-                    QPointer<QWebSocket> sub = rawSub;
-                    if (sub && sub->state() == QAbstractSocket::ConnectedState) {
-                        sub->sendTextMessage(msg);
-                    }
-                }
-            });
-        } else {
-            room.subscribers.insert(sock);
-            qInfo().noquote() << "[LanRelay] Subscriber connected for room:" << roomId;
-
-            connect(sock, &QWebSocket::textMessageReceived, this, [this, roomId](const QString &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                QPointer<QWebSocket> pub = it->publisher;
-                if (pub && pub->state() == QAbstractSocket::ConnectedState) {
-                    qInfo().noquote() << "[LanRelay] Fwd text from sub to pub: " << msg.left(200);
-                    pub->sendTextMessage(msg);
-                } else {
-                    qInfo().noquote() << "[LanRelay] Buffering text from sub (no pub): " << msg.left(200);
-                    it->pendingTextToPublisher.append(msg);
-                    if (it->pendingTextToPublisher.size() > 12) {
-                        it->pendingTextToPublisher.remove(0, it->pendingTextToPublisher.size() - 12);
-                    }
-                }
-            });
-
-            connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                QPointer<QWebSocket> pub = it->publisher;
-                if (pub && pub->state() == QAbstractSocket::ConnectedState) {
-                    pub->sendBinaryMessage(msg);
-                } else {
-                    it->pendingBinaryToPublisher.append(msg);
-                    if (it->pendingBinaryToPublisher.size() > 6) {
-                        it->pendingBinaryToPublisher.remove(0, it->pendingBinaryToPublisher.size() - 6);
-                    }
-                }
-            });
-        }
-
-        connect(sock, &QWebSocket::disconnected, this, [this, sock, roomId]() {
-            auto it = m_rooms.find(roomId);
-            if (it == m_rooms.end()) {
-                sock->deleteLater();
-                return;
-            }
-
-            if (it->publisher == sock) {
-                it->publisher = nullptr;
-            }
-            it->subscribers.remove(sock);
-
-            if (!it->publisher && it->subscribers.isEmpty()) {
-                m_rooms.erase(it);
-            }
-
-            sock->deleteLater();
-        });
-    }
-};
-}
-
 
 // 新增：读取本地默认质量设置
 QString getLocalQualityFromConfig()
@@ -629,8 +450,17 @@ int main(int argc, char *argv[])
     
     
     // 创建屏幕捕获对象
+    // --replay <file>：以录制文件代替屏幕（--replay-once 播放一遍后停在末帧），可配合 -platform offscreen 无桌面运行
+    // --record <file>：把采集到的帧录制为原始帧文件，供回放与编码基准测试使用
     ScreenCapture *capture = new ScreenCapture(&app);
     capture->setTargetScreenIndex(getScreenIndexFromConfig());
+    for (int i = 0; i < args.size() - 1; ++i) {
+        if (args[i] == "--replay") {
+            capture->setReplaySource(args[i + 1], !args.contains("--replay-once"));
+        } else if (args[i] == "--record") {
+            capture->setRecordPath(args[i + 1], 1000 / AdaptiveBitrateController::levelAt(0).intervalMs);
+        }
+    }
     if (!capture->initialize()) {
         return -1;
     }
@@ -652,6 +482,13 @@ int main(int argc, char *argv[])
     }
     
     VP9Encoder *encoder = new VP9Encoder(&app);
+    // 关键帧策略（keyframe_mode：on_demand / periodic / intra_refresh，周期模式间隔 keyframe_interval_ms）
+    const KeyFramePolicy::Mode keyFrameMode =
+        KeyFramePolicy::modeFromString(AppConfig::keyFrameMode(), KeyFramePolicy::Mode::Periodic);
+    encoder->setKeyFramePolicy(keyFrameMode, AppConfig::keyFrameIntervalMs());
+    encoder->setTemporalLayers(AppConfig::temporalLayers());
+    qDebug() << "[CaptureProcess] KeyFrame policy:" << KeyFramePolicy::modeName(keyFrameMode)
+             << "temporal layers:" << encoder->temporalLayers();
     // 保持现有帧率设置以降低编码负载（避免强制60fps）
     if (!encoder->initialize(initEncodeSize.width(), initEncodeSize.height(), encoder->getFrameRate())) {
         return -1;
@@ -703,19 +540,45 @@ int main(int argc, char *argv[])
     // 已禁用性能监控，减少CPU开销
     // 连接信号槽
     // qDebug() << "[CaptureProcess] 连接编码器和服务器信号槽...";
-    QObject::connect(encoder, &VP9Encoder::frameEncodedWithInfo,
+    // 采集/编码运行在独立线程，编码输出经流水线回到主线程交给发送器
+    CapturePipeline *pipeline = new CapturePipeline(capture, encoder, &app);
+    pipeline->setIdleInterval(AppConfig::captureIdleIntervalMs());
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, pipeline, &CapturePipeline::shutdown);
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, capture, [pipeline, capture]() {
+        QMutexLocker captureLock(pipeline->captureMutex());
+        capture->finishRecording();
+    });
+    QObject::connect(pipeline, &CapturePipeline::packetReady,
                      sender, &WebSocketSender::enqueueFrame);
     if (lanSender) {
-        QObject::connect(encoder, &VP9Encoder::frameEncodedWithInfo,
+        QObject::connect(pipeline, &CapturePipeline::packetReady,
                          lanSender, &WebSocketSender::enqueueFrame);
     }
     
-    // 连接首帧关键帧策略信号槽
+    // 多路编码（simulcast）：附加低分辨率编码器，按观看端选择按需开启（见 updateSimulcast）
+    const int simulcastStreams = std::min(AppConfig::simulcastStreams(), int(CapturePipeline::kMaxStreams));
+    for (int streamId = 1; streamId < simulcastStreams; ++streamId) {
+        VP9Encoder *simEncoder = new VP9Encoder(&app);
+        simEncoder->setStreamId(static_cast<quint8>(streamId));
+        simEncoder->setKeyFramePolicy(keyFrameMode, AppConfig::keyFrameIntervalMs());
+        simEncoder->setTemporalLayers(AppConfig::temporalLayers());
+        simEncoder->setEnableStaticDetection(true);
+        simEncoder->setStaticThreshold(0.0001);
+        simEncoder->setStaticBitrateReduction(0.10);
+        simEncoder->setSkipStaticFrames(false);
+        pipeline->addSimulcastEncoder(streamId, simEncoder);
+    }
+    
+    // 连接首帧关键帧策略信号槽（只置标志，避免主线程等待编码器锁）
     QObject::connect(sender, &WebSocketSender::requestKeyFrame,
-                     encoder, &VP9Encoder::forceKeyFrame);
+                     pipeline, &CapturePipeline::requestKeyFrame);
+    QObject::connect(sender, &WebSocketSender::streamKeyFrameRequested,
+                     pipeline, &CapturePipeline::requestStreamKeyFrame);
     if (lanSender) {
         QObject::connect(lanSender, &WebSocketSender::requestKeyFrame,
-                         encoder, &VP9Encoder::forceKeyFrame);
+                         pipeline, &CapturePipeline::requestKeyFrame);
+        QObject::connect(lanSender, &WebSocketSender::streamKeyFrameRequested,
+                         pipeline, &CapturePipeline::requestStreamKeyFrame);
     }
     // qDebug() << "[CaptureProcess] [首帧策略] 已连接关键帧请求信号槽";
     
@@ -742,12 +605,8 @@ int main(int argc, char *argv[])
     // 鼠标坐标转换的连接将在下面（静态变量声明之后）设置
     // qDebug() << "[CaptureProcess] 鼠标捕获模块初始化成功，已连接到WebSocket发送器";
     
-    // 创建定时器进行屏幕捕获 - 优化：减少lambda捕获开销
-    // qDebug() << "[CaptureProcess] 创建屏幕捕获定时器(60fps)...";
-    QTimer *captureTimer = new QTimer(&app);
-    
     // 优化：使用静态变量避免lambda捕获开销
-    static int frameCount = 0;
+    static CapturePipeline *staticPipeline = pipeline;
     static ScreenCapture *staticCapture = capture;
     static VP9Encoder *staticEncoder = encoder;
     static MouseCapture *staticMouseCapture = mouseCapture; // 新增：静态鼠标捕获指针
@@ -760,6 +619,27 @@ int main(int argc, char *argv[])
     // 新增：质量控制相关静态状态
     static QString currentQuality = getLocalQualityFromConfig();
     static QSize targetEncodeSize = staticEncoder->getFrameSize();
+    // 自适应码率控制器（主线程访问）
+    static AdaptiveBitrateController abrController;
+    // 观看端选择的流（viewerId → streamId），决定开启哪些附加编码
+    static QHash<QString, int> viewerStreams;
+
+    // 观看端批注/光标坐标以主编码流的实际输出尺寸为参考（低分辨率流的坐标由发送器换算）
+    auto publishReferenceFrameSize = [&]() {
+        if (staticSender) staticSender->setReferenceFrameSize(targetEncodeSize);
+        if (staticLanSender) staticLanSender->setReferenceFrameSize(targetEncodeSize);
+    };
+
+    // 编码器重建（画质/切屏/开始推流）后自适应码率回到最高档：取消内部缩放，恢复完整编码尺寸
+    auto resetAdaptiveBitrate = [&]() {
+        abrController.reset(QDateTime::currentMSecsSinceEpoch());
+        staticEncoder->requestScaling(1, 1);
+        staticEncoder->requestRuntimeBitrate(abrController.targetBitrate());
+        staticPipeline->setCaptureInterval(AdaptiveBitrateController::levelAt(0).intervalMs);
+        targetEncodeSize = staticEncoder->getFrameSize();
+        staticMouseCapture->setScreenRect(staticMouseCapture->screenRect(), targetEncodeSize);
+        publishReferenceFrameSize();
+    };
 
     auto isAnyStreaming = [&]() -> bool {
         if (staticSender && staticSender->isStreaming()) return true;
@@ -778,6 +658,76 @@ int main(int argc, char *argv[])
         if (staticLanSender) staticLanSender->sendTextMessage(msg);
     };
 
+    // 高频消息（音频、光标）走二进制格式，见 BinaryMessage.h
+    auto sendBinaryAll = [&](const QByteArray &msg) {
+        if (staticSender) staticSender->sendBinaryMessage(msg);
+        if (staticLanSender) staticLanSender->sendBinaryMessage(msg);
+    };
+
+    // 附加流的编码尺寸：第 1 路不超过 1080p，第 2 路不超过 540p（按主编码尺寸等比缩小）；
+    // 不明显小于主编码尺寸的路不开启，观看端会被中继就近分配到主编码流
+    auto simulcastTargetSize = [&](int streamId) -> QSize {
+        static const QSize kBoxes[CapturePipeline::kMaxStreams] = { QSize(), QSize(1920, 1080), QSize(960, 540) };
+        const QSize primary = staticEncoder->getFrameSize();
+        if (streamId <= 0 || streamId >= CapturePipeline::kMaxStreams || primary.isEmpty()) {
+            return QSize();
+        }
+        const QSize box = primary.height() > primary.width() ? kBoxes[streamId].transposed() : kBoxes[streamId];
+        const double factor = std::min(double(box.width()) / primary.width(), double(box.height()) / primary.height());
+        if (factor >= 0.9) {
+            return QSize();
+        }
+        return QSize(qRound(primary.width() * factor) & ~1, qRound(primary.height() * factor) & ~1);
+    };
+
+    // 按观看端选择开关附加编码器：只在有观看端需要时编码对应分辨率，主编码尺寸变化时随之重建；
+    // 码率按像素面积的 0.75 次方从预设码率折算，并跟随自适应码率的当前比例
+    auto updateSimulcast = [&]() {
+        const bool videoStreaming = isCapturing && isAnyVideoStreaming();
+        const QSize primary = staticEncoder->getFrameSize();
+        const double rateScale = abrController.maxBitrate() > 0
+            ? double(abrController.targetBitrate()) / abrController.maxBitrate() : 1.0;
+        for (int streamId = 1; streamId < CapturePipeline::kMaxStreams; ++streamId) {
+            VP9Encoder *simEncoder = staticPipeline->streamEncoder(streamId);
+            if (!simEncoder) {
+                continue;
+            }
+            bool demanded = false;
+            for (int selected : viewerStreams) {
+                if (selected == streamId) {
+                    demanded = true;
+                    break;
+                }
+            }
+            const QSize target = (videoStreaming && demanded) ? simulcastTargetSize(streamId) : QSize();
+            if (target.isEmpty()) {
+                if (staticPipeline->isStreamEnabled(streamId)) {
+                    staticPipeline->setStreamTarget(streamId, QSize());
+                    simEncoder->cleanup();
+                    qDebug() << "[CaptureProcess] Simulcast stream" << streamId << "stopped";
+                }
+                continue;
+            }
+
+            const double areaRatio = double(target.width()) * target.height()
+                                   / (double(primary.width()) * primary.height());
+            const int bitrate = std::max(60000, int(abrController.maxBitrate() * std::pow(areaRatio, 0.75)));
+            if (!simEncoder->isInitialized() || simEncoder->getFrameSize() != target) {
+                // 附加流固定使用实时档参数，避免高画质档的慢速预设在多路编码下占满 CPU
+                simEncoder->setQualityPreset(currentQuality == QStringLiteral("low") ? QStringLiteral("low") : QStringLiteral("medium"));
+                simEncoder->setBitrate(bitrate);
+                if (!simEncoder->reconfigure(target.width(), target.height(), staticEncoder->getFrameRate())) {
+                    staticPipeline->setStreamTarget(streamId, QSize());
+                    continue;
+                }
+                qDebug() << "[CaptureProcess] Simulcast stream" << streamId << "started | EncodeSize:" << target
+                         << "| Bitrate:" << bitrate;
+            }
+            simEncoder->requestRuntimeBitrate(std::max(60000, int(bitrate * rateScale)));
+            staticPipeline->setStreamTarget(streamId, target);
+        }
+    };
+
     // -------------------------------------------------------------------------
     // 屏幕切换处理逻辑 (Screen Switch Logic)
     // -------------------------------------------------------------------------
@@ -798,13 +748,18 @@ int main(int argc, char *argv[])
         
         // 标记正在切换以避免捕获循环继续抓帧（不断流，仅暂时不发帧）
         isSwitching = true;
+        staticPipeline->setSwitching(true);
 
-        // 重新初始化屏幕捕获到新屏幕
-        staticCapture->cleanup();
-        staticCapture->setTargetScreenIndex(currentScreenIndex);
-        if (!staticCapture->initialize()) {
-            isSwitching = false;
-            return;
+        // 重新初始化屏幕捕获到新屏幕（持有采集锁，等待采集线程当前帧结束）
+        {
+            QMutexLocker captureLock(staticPipeline->captureMutex());
+            staticCapture->cleanup();
+            staticCapture->setTargetScreenIndex(currentScreenIndex);
+            if (!staticCapture->initialize()) {
+                isSwitching = false;
+                staticPipeline->setSwitching(false);
+                return;
+            }
         }
 
         QSize newSize = staticCapture->getScreenSize();
@@ -824,11 +779,11 @@ int main(int argc, char *argv[])
             if (encodeSize.height() % 2 != 0) encodeSize.setHeight(encodeSize.height() - 1);
         }
 
-        // 重新初始化编码器以匹配新分辨率
-        staticEncoder->cleanup();
+        // 在现有编码器上切换到新分辨率（参考帧缩放，无需关键帧；超出创建尺寸时内部完整重建）
         // 切屏后保持既有帧率，避免强制提升到60fps
-        if (!staticEncoder->initialize(encodeSize.width(), encodeSize.height(), staticEncoder->getFrameRate())) {
+        if (!staticEncoder->reconfigure(encodeSize.width(), encodeSize.height(), staticEncoder->getFrameRate())) {
             isSwitching = false;
+            staticPipeline->setSwitching(false);
             return;
         }
         
@@ -848,8 +803,8 @@ int main(int argc, char *argv[])
         }
         
         staticMouseCapture->setScreenRect(newScreenRect, encodeSize);
-        
-        staticEncoder->forceKeyFrame();
+        resetAdaptiveBitrate();
+        updateSimulcast();
 
         if (currentScreenIndex >= 0 && currentScreenIndex < s_overlays.size()) {
             s_overlays[currentScreenIndex]->raise();
@@ -860,6 +815,7 @@ int main(int argc, char *argv[])
 
         // 切换完成，恢复捕获循环发帧
         isSwitching = false;
+        staticPipeline->setSwitching(false);
     };
 
     // 新增：音频发送（改为麦克风采集，基于文本消息）
@@ -1201,9 +1157,6 @@ int main(int argc, char *argv[])
                 }
             }
 
-            auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-
             if (!isAnyStreaming()) {
                 continue; // 未开始推流时不发送音频
             }
@@ -1227,18 +1180,15 @@ int main(int argc, char *argv[])
             }
             opusOut.resize(nbytes);
 
-            QJsonObject msg;
-            msg["type"] = "audio_opus";
-            msg["sample_rate"] = opusSampleRate;
-            msg["channels"] = 1; // 单声道
-            msg["timestamp"] = static_cast<qint64>(timestamp);
-            msg["frame_samples"] = opusFrameSize; // 每帧采样数（20ms）
+            // 二进制音频消息：头部携带序号与时间戳，Opus 数据原样附在后面（不再 base64 + JSON）
+            BinaryMessage::Audio audio;
+            audio.sampleRate = opusSampleRate;
+            audio.channels = 1; // 单声道
+            audio.frameSamples = opusFrameSize; // 每帧采样数（20ms）
+            audio.opus = opusOut;
             static quint32 audioSeq = 0;
-            msg["seq"] = static_cast<qint64>(audioSeq++);
-            msg["data_base64"] = QString::fromUtf8(opusOut.toBase64());
-            
-            QJsonDocument doc(msg);
-            sendTextAll(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+            sendBinaryAll(BinaryMessage::encodeAudio(BinaryMessage::MessageType::Audio, audioSeq++,
+                                                     QDateTime::currentMSecsSinceEpoch(), audio));
             audioFrameSendCount++;
             if (audioFrameSendCount % 100 == 0) {
                 qDebug() << "[Audio] Sent Opus frame #" << audioFrameSendCount << " Bytes:" << nbytes;
@@ -1284,9 +1234,18 @@ int main(int argc, char *argv[])
         if (desired.width() % 2 != 0) desired.setWidth(desired.width() - 1);
         if (desired.height() % 2 != 0) desired.setHeight(desired.height() - 1);
 
+        // 预设码率先行设置，随分辨率与量化参数一并下发到运行中的编码器
+        int presetBitrate = 400000;
+        if (q == "low") {
+            presetBitrate = 200000;
+        } else if (q == "high") {
+            presetBitrate = 500000;
+        } else if (q == "extreme") {
+            presetBitrate = 3000000;
+        }
         staticEncoder->setQualityPreset(q);
-        staticEncoder->cleanup();
-        if (!staticEncoder->initialize(desired.width(), desired.height(), staticEncoder->getFrameRate())) {
+        staticEncoder->setBitrate(presetBitrate);
+        if (!staticEncoder->reconfigure(desired.width(), desired.height(), staticEncoder->getFrameRate())) {
             return; // 保持旧状态以避免崩溃
         }
         targetEncodeSize = staticEncoder->getFrameSize();
@@ -1310,29 +1269,27 @@ int main(int argc, char *argv[])
         staticEncoder->setSkipStaticFrames(false);
 
         if (q == "low") {
-            staticEncoder->setBitrate(200000);
             staticEncoder->setEnableStaticDetection(true);
             staticEncoder->setStaticBitrateReduction(0.05);
             staticEncoder->setStaticThreshold(0.0001); // 降低阈值以检测微小变化
         } else if (q == "medium") {
-            staticEncoder->setBitrate(400000);
             staticEncoder->setEnableStaticDetection(true);
             staticEncoder->setStaticBitrateReduction(0.10);
             staticEncoder->setStaticThreshold(0.0001); // 降低阈值以检测微小变化
         } else if (q == "high") {
-            staticEncoder->setBitrate(500000);
             staticEncoder->setEnableStaticDetection(true);
             staticEncoder->setStaticBitrateReduction(0.15);
             staticEncoder->setStaticThreshold(0.0001); // 降低阈值以检测微小变化
         } else if (q == "extreme") {
-            staticEncoder->setBitrate(3000000);
             staticEncoder->setEnableStaticDetection(true);
             staticEncoder->setStaticBitrateReduction(0.20);
             staticEncoder->setStaticThreshold(0.0001); // 降低阈值以检测微小变化
         }
 
-        // 强制关键帧以快速稳定画面
-        staticEncoder->forceKeyFrame();
+        // 自适应码率上限取预设码率，下限为其 15%（不低于 80kbps）
+        abrController.setBitrateRange(std::max(80000, presetBitrate * 15 / 100), presetBitrate);
+        resetAdaptiveBitrate();
+        updateSimulcast();
 
         
     };
@@ -1419,6 +1376,50 @@ int main(int argc, char *argv[])
         // if (remoteOpusDec) { opus_decoder_destroy(remoteOpusDec); remoteOpusDec = nullptr; }
     };
 
+    // 自适应码率：每秒采样各发送链路的拥塞信号，结合观看端上报调整码率、帧率与分辨率（编码器不重建）
+    QTimer *abrTimer = new QTimer(&app);
+    QObject::connect(abrTimer, &QTimer::timeout, [&]() {
+        // 附加流随推流状态与主编码尺寸开关，码率跟随上一周期的自适应结果
+        updateSimulcast();
+        if (!isCapturing || isSwitching) {
+            return;
+        }
+        QVector<AdaptiveBitrateController::SenderSample> samples;
+        auto addSample = [&samples](WebSocketSender *s, int linkId) {
+            if (!s || !s->isStreaming() || s->isAudioOnlyStreaming()) {
+                return;
+            }
+            AdaptiveBitrateController::SenderSample sample;
+            sample.linkId = linkId;
+            sample.queueDepth = s->queueDepth();
+            sample.droppedByAge = s->droppedFramesByAge();
+            sample.droppedByQueue = s->droppedFramesByQueue();
+            sample.bytesToWrite = s->bytesToWrite();
+            sample.bytesSent = s->getTotalBytesSent();
+            samples.append(sample);
+        };
+        addSample(staticSender, 0);
+        addSample(staticLanSender, 1);
+        if (samples.isEmpty()) {
+            return;
+        }
+
+        const AdaptiveBitrateController::Decision d = abrController.update(samples, QDateTime::currentMSecsSinceEpoch());
+        staticEncoder->requestRuntimeBitrate(d.bitrate);
+        staticPipeline->setCaptureInterval(d.captureIntervalMs);
+        if (d.levelChanged) {
+            // 观看端解码尺寸随内部缩放变化，鼠标/批注坐标同步换算到缩放后的尺寸
+            staticEncoder->requestScaling(d.scaleNum, d.scaleDen);
+            targetEncodeSize = staticEncoder->scaledFrameSize(d.scaleNum, d.scaleDen);
+            staticMouseCapture->setScreenRect(staticMouseCapture->screenRect(), targetEncodeSize);
+            publishReferenceFrameSize();
+            qDebug() << "[CaptureProcess] ABR level" << d.level << "| Bitrate:" << d.bitrate
+                     << "| Interval:" << d.captureIntervalMs << "ms | EncodeSize:" << targetEncodeSize
+                     << "| Congested:" << d.congested;
+        }
+    });
+    abrTimer->start(1000);
+
     // 状态监控定时器：每3秒输出一次音频发送状态
     QTimer *statusTimer = new QTimer(&app);
     QObject::connect(statusTimer, &QTimer::timeout, [&]() {
@@ -1430,6 +1431,35 @@ int main(int argc, char *argv[])
                      << "| Audio Input:" << (audioInput ? "Valid" : "Null")
                      << "| Bytes Avail:" << (audioInput ? audioInput->bytesAvailable() : -1)
                      << "| Sender Connected:" << sender->isConnected();
+            qDebug() << "[CaptureProcess] Pipeline - Captured:" << staticPipeline->capturedFrames()
+                     << "| Encoded:" << staticPipeline->encodedFrames()
+                     << "| CaptureQueue:" << staticPipeline->captureQueueDepth()
+                     << "| SendQueue:" << staticPipeline->sendQueueDepth()
+                     << "| CaptureDrops:" << staticPipeline->captureDrops()
+                     << "| SendDrops:" << staticPipeline->sendDrops()
+                     << "| Simulcast:" << staticPipeline->encodedFrames(1) << "/" << staticPipeline->encodedFrames(2)
+                     << "| PacedInterval:" << staticPipeline->pacedInterval() << "ms";
+            qDebug() << "[CaptureProcess] PacketPool - Built:" << staticEncoder->packetPool().buildCount()
+                     << "| Allocations:" << staticEncoder->packetPool().allocationCount()
+                     << "| Reused:" << staticEncoder->packetPool().reuseCount()
+                     << "| Pooled:" << staticEncoder->packetPool().pooledCount();
+            const FrameBufferPool::Stats framePool = staticPipeline->framePoolStats();
+            qDebug() << "[CaptureProcess] FramePool - Acquired:" << framePool.acquires
+                     << "| Reused:" << framePool.reuses
+                     << "| Allocations:" << framePool.allocations
+                     << "| Exhausted:" << framePool.exhaustions
+                     << "| Slots:" << framePool.inUse << "/" << framePool.slots
+                     << "| ResidentMB:" << framePool.residentBytes / (1024 * 1024)
+                     << "| PeakMB:" << framePool.peakResidentBytes / (1024 * 1024);
+            const KeyFramePolicy::Stats keyStats = staticEncoder->keyFrameStats();
+            qDebug() << "[CaptureProcess] KeyFrames - Count:" << keyStats.keyFrames
+                     << "| AvgBytes:" << (keyStats.keyFrames ? keyStats.keyFrameBytes / keyStats.keyFrames : 0)
+                     << "| LastBytes:" << keyStats.lastKeyFrameBytes
+                     << "| AvgIntervalMs:" << keyStats.avgKeyIntervalMs
+                     << "| ByteShare%:" << (keyStats.keyFrameBytes + keyStats.deltaFrameBytes
+                                            ? 100 * keyStats.keyFrameBytes / (keyStats.keyFrameBytes + keyStats.deltaFrameBytes) : 0)
+                     << "| Requests:" << keyStats.requests
+                     << "| Coalesced:" << keyStats.coalescedRequests;
                      
             // 自动故障恢复：如果音频源停止了，或者长时间没有发送数据，尝试重启
             bool needsRestart = false;
@@ -1483,12 +1513,13 @@ int main(int argc, char *argv[])
         }
         
         // [Fix] Zombie Process Self-Termination
-        // If capture is active but we haven't sent any video frames for 60 seconds (frameCount stuck),
+        // If capture is active but we haven't captured any video frames for 60 seconds (pipeline counter stuck),
         // we assume the capture loop is dead or graphics driver is hung.
         // We exit, letting the Watchdog restart us.
-        static int lastVideoFrameCount = 0;
+        static quint64 lastVideoFrameCount = 0;
         static int stuckVideoCounter = 0;
         if (isCapturing) {
+            const quint64 frameCount = staticPipeline->capturedFrames();
             if (frameCount == lastVideoFrameCount) {
                 stuckVideoCounter++;
                 if (stuckVideoCounter >= 20) { // 20 * 3s = 60s
@@ -1649,7 +1680,7 @@ int main(int argc, char *argv[])
         qDebug() << "[CaptureProcess] Streaming started signal received. isCapturing:" << isCapturing << " audioOnly:" << audioOnly;
         if (audioOnly && isCapturing) {
             isCapturing = false;
-            captureTimer->stop();
+            staticPipeline->stop();
             staticMouseCapture->stopCapture();
         }
         if (!isCapturing) {
@@ -1661,7 +1692,7 @@ int main(int argc, char *argv[])
                 qDebug() << "[CaptureProcess] Quality applied on start. TargetEncodeSize:" << targetEncodeSize;
 
                 isCapturing = true;
-                captureTimer->start(66);
+                staticPipeline->start(66);
                 staticMouseCapture->startCapture();
                 if (currentScreenIndex >= 0 && currentScreenIndex < s_overlays.size()) {
                     s_overlays[currentScreenIndex]->raise();
@@ -1694,7 +1725,7 @@ int main(int argc, char *argv[])
         }
         if (isCapturing) {
             isCapturing = false;
-            captureTimer->stop();
+            staticPipeline->stop();
             staticMouseCapture->stopCapture();
         }
         audioTimer->stop();
@@ -1713,6 +1744,7 @@ int main(int argc, char *argv[])
         }
 
         if (staticCapture) {
+            QMutexLocker captureLock(staticPipeline->captureMutex());
             staticCapture->cleanup();
             staticCapture->initialize();
         }
@@ -1730,7 +1762,7 @@ int main(int argc, char *argv[])
             activeViewerIds.clear();
             if (isCapturing) {
                 isCapturing = false;
-                captureTimer->stop();
+                staticPipeline->stop();
                 staticMouseCapture->stopCapture();
             }
             audioTimer->stop();
@@ -1749,6 +1781,7 @@ int main(int argc, char *argv[])
             }
 
             if (staticCapture) {
+                QMutexLocker captureLock(staticPipeline->captureMutex());
                 staticCapture->cleanup();
                 staticCapture->initialize();
             }
@@ -1760,21 +1793,6 @@ int main(int argc, char *argv[])
         });
     }
 
-    // 响应关键帧请求（带2秒冷却保护）
-    QObject::connect(sender, &WebSocketSender::requestKeyFrame, []() {
-        static qint64 lastKeyFrameRequestTime = 0;
-        qint64 now = QDateTime::currentMSecsSinceEpoch();
-        // 2秒内忽略重复请求，防止多人进场导致的关键帧风暴
-        if (now - lastKeyFrameRequestTime < 2000) {
-            return;
-        }
-        lastKeyFrameRequestTime = now;
-        
-        if (staticEncoder) {
-            staticEncoder->forceKeyFrame();
-        }
-    });
-
     // 将系统全局鼠标坐标转换为当前捕获屏幕的局部坐标后发送到观看端
     QObject::connect(sender, &WebSocketSender::viewerNameChanged, [&](const QString &){ });
     QObject::connect(sender, &WebSocketSender::viewerCursorReceived,
@@ -1916,8 +1934,37 @@ int main(int argc, char *argv[])
         });
     }
 
+    auto onStreamSelected = [&](const QString &viewerId, int streamId) {
+        viewerStreams[viewerId] = std::max(0, std::min(streamId, int(CapturePipeline::kMaxStreams) - 1));
+        updateSimulcast();
+    };
+    QObject::connect(sender, &WebSocketSender::streamSelectionReceived, onStreamSelected);
+    if (lanSender) {
+        QObject::connect(lanSender, &WebSocketSender::streamSelectionReceived, onStreamSelected);
+        QObject::connect(lanSender, &WebSocketSender::viewerExited, [&](const QString &viewerId) {
+            if (viewerStreams.remove(viewerId) > 0) {
+                updateSimulcast();
+            }
+        });
+    }
+
+    QObject::connect(sender, &WebSocketSender::receiverReportReceived,
+                     [&](const QString &viewerId, double jitterMs, double lossPct, double queueDelayMs) {
+        abrController.onReceiverReport(viewerId, jitterMs, lossPct, queueDelayMs, QDateTime::currentMSecsSinceEpoch());
+    });
+    if (lanSender) {
+        QObject::connect(lanSender, &WebSocketSender::receiverReportReceived,
+                         [&](const QString &viewerId, double jitterMs, double lossPct, double queueDelayMs) {
+            abrController.onReceiverReport(viewerId, jitterMs, lossPct, queueDelayMs, QDateTime::currentMSecsSinceEpoch());
+        });
+    }
+
     QObject::connect(sender, &WebSocketSender::viewerExited,
                      [&](const QString &viewerId) {
+        abrController.removeViewer(viewerId);
+        if (viewerStreams.remove(viewerId) > 0) {
+            updateSimulcast();
+        }
         for (auto *cv : s_cursorOverlays) {
             if (cv) cv->onViewerExited(viewerId);
         }
@@ -1960,7 +2007,7 @@ int main(int argc, char *argv[])
     });
 
     QObject::connect(staticMouseCapture, &MouseCapture::mousePositionChanged, sender,
-                     [&, sendTextAll, isAnyVideoStreaming](const QPoint &globalPos) {
+                     [&, sendBinaryAll, isAnyVideoStreaming](const QPoint &globalPos) {
         if (!isAnyVideoStreaming()) {
             return;
         }
@@ -1980,19 +2027,12 @@ int main(int argc, char *argv[])
             return;
         }
 
-        QJsonObject messageObj;
-        messageObj["type"] = "mouse_position";
-        messageObj["x"] = local.x();
-        messageObj["y"] = local.y();
-        if (!currentUserName.isEmpty()) {
-            messageObj["name"] = currentUserName;
-        }
-        // 使用微秒时间戳，与采集端原实现一致
-        auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-        messageObj["timestamp"] = static_cast<qint64>(timestamp);
-        QJsonDocument doc(messageObj);
-        sendTextAll(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+        BinaryMessage::Cursor cursor;
+        cursor.x = local.x();
+        cursor.y = local.y();
+        cursor.name = currentUserName;
+        static quint32 cursorSeq = 0;
+        sendBinaryAll(BinaryMessage::encodeCursor(cursorSeq++, QDateTime::currentMSecsSinceEpoch(), cursor));
     });
 
     
@@ -2047,19 +2087,20 @@ int main(int argc, char *argv[])
     }
 
     // 新增：处理质量变更请求
-    QObject::connect(sender, &WebSocketSender::qualityChangeRequested, [&](const QString &quality) {
+    // 已选流的观看端（新版播放端）画质由中继按流分配，不再为所有人重建主编码器
+    auto onQualityChangeRequested = [&](const QString &quality, const QString &viewerId) {
         if (!isAnyStreaming()) {
             return;
         }
+        if (simulcastStreams > 1 && viewerStreams.contains(viewerId)) {
+            qDebug() << "[CaptureProcess] Quality" << quality << "from" << viewerId << "served by stream" << viewerStreams.value(viewerId);
+            return;
+        }
         applyQualitySetting(quality);
-    });
+    };
+    QObject::connect(sender, &WebSocketSender::qualityChangeRequested, onQualityChangeRequested);
     if (lanSender) {
-        QObject::connect(lanSender, &WebSocketSender::qualityChangeRequested, [&](const QString &quality) {
-            if (!isAnyStreaming()) {
-                return;
-            }
-            applyQualitySetting(quality);
-        });
+        QObject::connect(lanSender, &WebSocketSender::qualityChangeRequested, onQualityChangeRequested);
     }
 
     // 新增：处理音频开关请求（麦克风采集）
@@ -2425,43 +2466,8 @@ int main(int argc, char *argv[])
         });
     }
     
-    QObject::connect(captureTimer, &QTimer::timeout, []() {
-        if (!isCapturing) return; // 只有在推流状态下才捕获
-        if (isSwitching) return;   // 热切换过程中不断流，但暂时不抓帧
-        
-        // 关键帧保活机制：每隔8秒强制发送一个关键帧
-        // 这可以解决网络抖动导致的关键帧丢失，或观看端重连时的黑屏问题
-        static qint64 lastKeyFrameTime = 0;
-        const qint64 keyFrameInterval = 8000; // 8秒，避免流量过大
-        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-        
-        if (staticEncoder && (currentTime - lastKeyFrameTime > keyFrameInterval)) {
-            staticEncoder->forceKeyFrame();
-            lastKeyFrameTime = currentTime;
-            // qDebug() << "[CaptureProcess] 触发保活关键帧";
-        }
-
-        auto captureStartTime = std::chrono::high_resolution_clock::now();
-        QByteArray frameData = staticCapture->captureScreen();
-        if (!frameData.isEmpty()) {
-            auto captureEndTime = std::chrono::high_resolution_clock::now();
-            auto captureLatency = std::chrono::duration_cast<std::chrono::microseconds>(captureEndTime - captureStartTime).count();
-            frameCount++;
-            // 只在延迟过高时输出警告
-            if (captureLatency > 20000) { // 超过20ms时输出警告
-            }
-            
-            // 如果编码目标分辨率与屏幕尺寸不同（例如低质720p），VP9Encoder会自动使用libyuv进行高效缩放
-            // 移除了此前导致4K卡顿和异常的QImage::scaled操作
-            const QSize capSize = staticCapture->getScreenSize();
-            
-            // 继续正常的VP9编码流程，传入实际捕获的尺寸
-            // encode内部会根据初始化尺寸和输入尺寸自动判断是否需要缩放
-            staticEncoder->encode(frameData, capSize.width(), capSize.height());
-        }
-    });
-    
-    
+    // 屏幕捕获与编码由 CapturePipeline 在独立线程中完成；关键帧保活由关键帧策略负责
+    // （默认 periodic 模式每 keyframe_interval_ms 一次，默认 8 秒；intra_refresh / on_demand 模式没有保活）
     
     
     // 连接到WebSocket服务器 - 使用推流URL格式
@@ -139,6 +139,58 @@ inline int lanWsPort()
     return p;
 }
 
+inline int simulcastStreams()
+{
+    const QString v = readConfigValue(QStringLiteral("simulcast_streams")).trimmed();
+    bool ok = false;
+    int n = v.toInt(&ok);
+    if (!ok) {
+        n = 3;
+    }
+    return std::max(1, std::min(n, 3));
+}
+
+// 时间分层层数（temporal_layers，1-3）：默认 1 层保持 VBR；多层时中继可对积压的观看端降帧率，但编码改为 CBR
+inline int temporalLayers()
+{
+    const QString v = readConfigValue(QStringLiteral("temporal_layers")).trimmed();
+    bool ok = false;
+    int n = v.toInt(&ok);
+    if (!ok) {
+        n = 1;
+    }
+    return std::max(1, std::min(n, 3));
+}
+
+inline QString keyFrameMode()
+{
+    const QString v = readConfigValue(QStringLiteral("keyframe_mode")).trimmed().toLower();
+    if (v.isEmpty()) return QStringLiteral("periodic");
+    return v;
+}
+
+inline int keyFrameIntervalMs()
+{
+    const QString v = readConfigValue(QStringLiteral("keyframe_interval_ms")).trimmed();
+    bool ok = false;
+    int ms = v.toInt(&ok);
+    if (!ok || ms <= 0) {
+        ms = 8000;
+    }
+    return std::max(1000, std::min(ms, 600000));
+}
+
+inline int captureIdleIntervalMs()
+{
+    const QString v = readConfigValue(QStringLiteral("capture_idle_interval_ms")).trimmed();
+    bool ok = false;
+    int ms = v.toInt(&ok);
+    if (!ok || ms <= 0) {
+        ms = 500;
+    }
+    return std::max(100, std::min(ms, 2000));
+}
+
 inline QStringList localLanBaseUrls()
 {
     const int port = lanWsPort();
@@ -0,0 +1,253 @@
+#ifndef BINARYMESSAGE_H
+#define BINARYMESSAGE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QSize>
+#include <QtEndian>
+#include <cstring>
+
+#include "PacketHeader.h"
+
+// 版本 1 二进制消息的负载编解码（头部见 PacketHeader.h），采集端、播放端、NewUi 与中继共用。
+// 所有整数小端；字符串为 1 字节长度 + UTF-8（超过 255 字节截断）。
+// 解码对任意输入都只做边界内读取：长度不足、字段越界或类型不符时返回 false，不抛异常、不越界。
+//
+//   Audio/ViewerAudio: u32 采样率 | u8 声道 | u16 每帧采样数 | str 发送端ID | Opus 数据（至消息末尾）
+//   Cursor           : i32 x | i32 y | u16 参考帧宽 | u16 参考帧高 | str 发送端ID | str 名称
+//   Annotation       : i32 x | i32 y | u16 参考帧宽 | u16 参考帧高 | u8 颜色 | str 阶段 | str 观看端ID | str 目标ID
+// 时间戳统一使用头部的毫秒时间戳；参考帧尺寸为 0 表示未知（坐标不做换算）。
+namespace BinaryMessage {
+
+using PacketHeader::MessageType;
+
+struct Audio {
+    QString senderId;          // ViewerAudio：发送端观看者ID；推流端 Audio 为空
+    int sampleRate = 0;
+    int channels = 1;
+    int frameSamples = 0;
+    QByteArray opus;
+};
+
+struct Cursor {
+    int x = 0;
+    int y = 0;
+    QSize frameSize;           // 发送端坐标所在的参考帧尺寸
+    QString senderId;          // 观看端光标：观看者ID；推流端鼠标为空
+    QString name;
+};
+
+struct Annotation {
+    int x = 0;
+    int y = 0;
+    QSize frameSize;
+    int colorId = 0;
+    QString phase;             // "down" / "move" / "up" / "erase_move" / "undo" ...
+    QString viewerId;
+    QString targetId;
+};
+
+namespace detail {
+
+class Writer
+{
+public:
+    explicit Writer(int reserve) { m_data.reserve(PacketHeader::kMessageHeaderSize + reserve); m_data.resize(PacketHeader::kMessageHeaderSize); }
+
+    void u8(quint8 v) { m_data.append(static_cast<char>(v)); }
+    void u16(quint16 v) { char b[2]; qToLittleEndian(v, b); m_data.append(b, 2); }
+    void u32(quint32 v) { char b[4]; qToLittleEndian(v, b); m_data.append(b, 4); }
+    void i32(qint32 v) { u32(static_cast<quint32>(v)); }
+    void size(const QSize &s)
+    {
+        u16(static_cast<quint16>(qBound(0, s.isValid() ? s.width() : 0, 0xFFFF)));
+        u16(static_cast<quint16>(qBound(0, s.isValid() ? s.height() : 0, 0xFFFF)));
+    }
+    void str(const QString &s)
+    {
+        QByteArray utf8 = s.toUtf8();
+        if (utf8.size() > 255) {
+            utf8.truncate(255);
+        }
+        u8(static_cast<quint8>(utf8.size()));
+        m_data.append(utf8);
+    }
+    void bytes(const QByteArray &b) { m_data.append(b); }
+
+    QByteArray finish(MessageType type, quint32 sequence, qint64 timestampMs)
+    {
+        PacketHeader::writeMessage(m_data.data(), type, sequence, timestampMs);
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+};
+
+class Reader
+{
+public:
+    Reader(const QByteArray &data, int offset) : m_p(data.constData()), m_size(data.size()), m_pos(offset) {}
+
+    bool ok() const { return m_ok; }
+    int remaining() const { return m_ok ? m_size - m_pos : 0; }
+
+    quint8 u8() { return need(1) ? static_cast<quint8>(m_p[m_pos++]) : 0; }
+    quint16 u16() { if (!need(2)) return 0; const quint16 v = qFromLittleEndian<quint16>(m_p + m_pos); m_pos += 2; return v; }
+    quint32 u32() { if (!need(4)) return 0; const quint32 v = qFromLittleEndian<quint32>(m_p + m_pos); m_pos += 4; return v; }
+    qint32 i32() { return static_cast<qint32>(u32()); }
+    QSize size() { const int w = u16(); const int h = u16(); return (w > 0 && h > 0) ? QSize(w, h) : QSize(); }
+    QString str()
+    {
+        const int n = u8();
+        if (!need(n)) return QString();
+        const QString s = QString::fromUtf8(m_p + m_pos, n);
+        m_pos += n;
+        return s;
+    }
+    QByteArray rest()
+    {
+        if (!m_ok) return QByteArray();
+        QByteArray b(m_p + m_pos, m_size - m_pos);
+        m_pos = m_size;
+        return b;
+    }
+
+private:
+    bool need(int n)
+    {
+        if (!m_ok || n < 0 || m_size - m_pos < n) {
+            m_ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    const char *m_p;
+    int m_size;
+    int m_pos;
+    bool m_ok = true;
+};
+
+// 头部有效且类型匹配时返回负载读取器的起始偏移，否则 -1
+inline int payloadOffset(const QByteArray &message, const PacketHeader::Info &info, MessageType expected)
+{
+    if (info.headerSize != PacketHeader::kMessageHeaderSize || info.type != expected
+        || message.size() < info.headerSize) {
+        return -1;
+    }
+    return info.headerSize;
+}
+
+} // namespace detail
+
+// 是否为版本 1 消息（旧格式视频包与无效头部返回 false）
+inline bool isMessage(const PacketHeader::Info &info)
+{
+    return info.headerSize == PacketHeader::kMessageHeaderSize;
+}
+
+// type 为 MessageType::Audio 或 MessageType::ViewerAudio
+inline QByteArray encodeAudio(MessageType type, quint32 sequence, qint64 timestampMs, const Audio &audio)
+{
+    detail::Writer w(16 + audio.senderId.size() + audio.opus.size());
+    w.u32(static_cast<quint32>(qMax(0, audio.sampleRate)));
+    w.u8(static_cast<quint8>(qBound(0, audio.channels, 255)));
+    w.u16(static_cast<quint16>(qBound(0, audio.frameSamples, 0xFFFF)));
+    w.str(audio.senderId);
+    w.bytes(audio.opus);
+    return w.finish(type, sequence, timestampMs);
+}
+
+inline bool decodeAudio(const QByteArray &message, const PacketHeader::Info &info, Audio &out)
+{
+    int offset = detail::payloadOffset(message, info, MessageType::Audio);
+    if (offset < 0) {
+        offset = detail::payloadOffset(message, info, MessageType::ViewerAudio);
+    }
+    if (offset < 0) {
+        return false;
+    }
+    detail::Reader r(message, offset);
+    out.sampleRate = static_cast<int>(qMin<quint32>(r.u32(), 384000));
+    out.channels = r.u8();
+    out.frameSamples = r.u16();
+    out.senderId = r.str();
+    out.opus = r.rest();
+    return r.ok() && out.channels > 0 && out.sampleRate > 0;
+}
+
+inline QByteArray encodeCursor(quint32 sequence, qint64 timestampMs, const Cursor &cursor)
+{
+    detail::Writer w(16 + cursor.senderId.size() + cursor.name.size());
+    w.i32(cursor.x);
+    w.i32(cursor.y);
+    w.size(cursor.frameSize);
+    w.str(cursor.senderId);
+    w.str(cursor.name);
+    return w.finish(MessageType::Cursor, sequence, timestampMs);
+}
+
+inline bool decodeCursor(const QByteArray &message, const PacketHeader::Info &info, Cursor &out)
+{
+    const int offset = detail::payloadOffset(message, info, MessageType::Cursor);
+    if (offset < 0) {
+        return false;
+    }
+    detail::Reader r(message, offset);
+    out.x = r.i32();
+    out.y = r.i32();
+    out.frameSize = r.size();
+    out.senderId = r.str();
+    out.name = r.str();
+    return r.ok();
+}
+
+inline QByteArray encodeAnnotation(quint32 sequence, qint64 timestampMs, const Annotation &a)
+{
+    detail::Writer w(24 + a.phase.size() + a.viewerId.size() + a.targetId.size());
+    w.i32(a.x);
+    w.i32(a.y);
+    w.size(a.frameSize);
+    w.u8(static_cast<quint8>(qBound(0, a.colorId, 255)));
+    w.str(a.phase);
+    w.str(a.viewerId);
+    w.str(a.targetId);
+    return w.finish(MessageType::Annotation, sequence, timestampMs);
+}
+
+inline bool decodeAnnotation(const QByteArray &message, const PacketHeader::Info &info, Annotation &out)
+{
+    const int offset = detail::payloadOffset(message, info, MessageType::Annotation);
+    if (offset < 0) {
+        return false;
+    }
+    detail::Reader r(message, offset);
+    out.x = r.i32();
+    out.y = r.i32();
+    out.frameSize = r.size();
+    out.colorId = r.u8();
+    out.phase = r.str();
+    out.viewerId = r.str();
+    out.targetId = r.str();
+    return r.ok() && !out.phase.isEmpty();
+}
+
+// 整帧图片（NewUi JPEG 预览流）：负载即图片数据
+inline QByteArray encodeImage(quint32 sequence, qint64 timestampMs, const QByteArray &image)
+{
+    return PacketHeader::buildMessage(MessageType::Image, sequence, timestampMs, image.constData(), image.size());
+}
+
+// 视频/图片负载（去掉头部）；旧格式视频包同样适用
+inline QByteArray payload(const QByteArray &message, const PacketHeader::Info &info)
+{
+    if (info.headerSize <= 0 || message.size() < info.headerSize) {
+        return QByteArray();
+    }
+    return message.mid(info.headerSize);
+}
+
+} // namespace BinaryMessage
+
+#endif // BINARYMESSAGE_H
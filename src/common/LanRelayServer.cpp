@@ -0,0 +1,268 @@
+#include "LanRelayServer.h"
+#include "WebSocketFrame.h"
+
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QHostAddress>
+#include <QPointer>
+#include <QUrl>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+// 观看端连接的出站帧上限（退回 QWebSocket 成帧时）：Qt 默认 512 KB 以上的消息会拆成多个帧，
+// 放大到单个关键帧的上限后每条消息只写一个帧头
+constexpr quint64 kSubscriberFrameSize = 8 * 1024 * 1024;
+}
+
+LanRelayServer::LanRelayServer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+bool LanRelayServer::start(quint16 port)
+{
+    if (m_server) {
+        return true;
+    }
+
+    m_server = new QWebSocketServer(QStringLiteral("IrulerDeskpro LAN Relay"), QWebSocketServer::NonSecureMode, this);
+    if (!m_server->listen(QHostAddress::AnyIPv4, port)) {
+        m_server->deleteLater();
+        m_server = nullptr;
+        return false;
+    }
+
+    connect(m_server, &QWebSocketServer::newConnection, this, &LanRelayServer::onNewConnection);
+    return true;
+}
+
+quint16 LanRelayServer::port() const
+{
+    if (!m_server) return 0;
+    return static_cast<quint16>(m_server->serverPort());
+}
+
+void LanRelayServer::forwardToSubscribers(Room &room, const QByteArray &msg, const PacketHeader::Info &info)
+{
+    // 按头部信息转发：每个观看端只收其所选的一路流，积压的观看端再按时间层过滤，其余观看端不受影响
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    room.streams.mark(info, nowMs);
+    room.gop.add(msg, info);
+    const quint32 activeStreams = room.streams.activeMask(nowMs);
+
+    // 帧在第一个需要它的观看端处生成一次，其余观看端写入同一份帧；
+    // 观看端断开时已从 subscribers 移除，这里不必逐条建立 QPointer
+    QByteArray frame;
+    for (QWebSocket *sub : room.subscribers) {
+        if (sub->state() != QAbstractSocket::ConnectedState) {
+            continue;
+        }
+        SubscriberRoute &route = room.routes[sub];
+        const qint64 backlog = sub->bytesToWrite();
+        const bool selected = route.stream.accept(info, backlog, activeStreams, nowMs);
+        if (route.stream.takeKeyFrameRequest(nowMs)) {
+            requestKeyFrame(room, route.stream.target());
+        }
+        if (!selected || !route.layers.accept(info, backlog)) {
+            continue;
+        }
+        sendToSubscriber(sub, route.transport, msg, frame);
+    }
+}
+
+void LanRelayServer::sendToSubscriber(QWebSocket *sub, QTcpSocket *transport, const QByteArray &msg, QByteArray &frame)
+{
+    if (!m_preframed || !transport) {
+        sub->sendBinaryMessage(msg);
+        return;
+    }
+    if (frame.isEmpty()) {
+        frame = WebSocketFrame::binary(msg);
+    }
+    transport->write(frame);
+}
+
+void LanRelayServer::requestKeyFrame(Room &room, int stream)
+{
+    if (!room.publisher || room.publisher->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+    QJsonObject req;
+    req["type"] = "request_keyframe";
+    req["stream"] = stream;
+    room.publisher->sendTextMessage(QString::fromUtf8(QJsonDocument(req).toJson(QJsonDocument::Compact)));
+}
+
+void LanRelayServer::handleSubscriberText(Room &room, QWebSocket *sub, const QString &msg)
+{
+    // 选流消息在中继生效，同时照常转发给推流端（推流端据此按需开启对应编码）
+    if (msg.contains(QStringLiteral("select_stream"))) {
+        const QJsonObject obj = QJsonDocument::fromJson(msg.toUtf8()).object();
+        if (obj.value("type").toString() == QStringLiteral("select_stream")) {
+            room.routes[sub].stream.setRequested(obj.value("stream").toInt(0));
+        }
+    }
+
+    QPointer<QWebSocket> pub = room.publisher;
+    if (pub && pub->state() == QAbstractSocket::ConnectedState) {
+        pub->sendTextMessage(msg);
+    } else {
+        room.pendingTextToPublisher.append(msg);
+        if (room.pendingTextToPublisher.size() > 12) {
+            room.pendingTextToPublisher.remove(0, room.pendingTextToPublisher.size() - 12);
+        }
+    }
+}
+
+void LanRelayServer::onNewConnection()
+{
+    if (!m_server) return;
+    QWebSocket *sock = m_server->nextPendingConnection();
+    if (!sock) return;
+
+    const QString path = sock->requestUrl().path();
+    const QStringList parts = path.split('/', Qt::SkipEmptyParts);
+    if (parts.size() < 2) {
+        sock->close();
+        sock->deleteLater();
+        return;
+    }
+
+    const QString role = parts.value(0);
+    const QString roomId = parts.value(1);
+    if (roomId.isEmpty()) {
+        sock->close();
+        sock->deleteLater();
+        return;
+    }
+
+    if (role != QStringLiteral("publish") && role != QStringLiteral("subscribe")) {
+        sock->close();
+        sock->deleteLater();
+        return;
+    }
+
+    Room &room = m_rooms[roomId];
+
+    if (role == QStringLiteral("publish")) {
+        if (room.publisher && room.publisher != sock) {
+            room.publisher->close();
+            room.publisher->deleteLater();
+        }
+        room.publisher = sock;
+        room.gop.clear();
+        qInfo().noquote() << "[LanRelay] Publisher connected for room:" << roomId;
+
+        if (!room.pendingTextToPublisher.isEmpty()) {
+            qInfo().noquote() << "[LanRelay] Flushing " << room.pendingTextToPublisher.size() << " pending text messages to publisher";
+            for (const QString &msg : room.pendingTextToPublisher) {
+                if (sock->state() == QAbstractSocket::ConnectedState) {
+                    sock->sendTextMessage(msg);
+                }
+            }
+            room.pendingTextToPublisher.clear();
+        }
+        if (!room.pendingBinaryToPublisher.isEmpty()) {
+            for (const QByteArray &msg : room.pendingBinaryToPublisher) {
+                if (sock->state() == QAbstractSocket::ConnectedState) {
+                    sock->sendBinaryMessage(msg);
+                }
+            }
+            room.pendingBinaryToPublisher.clear();
+        }
+
+        connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
+            auto it = m_rooms.find(roomId);
+            if (it == m_rooms.end()) return;
+            // 只看头部：视频类按流/层转发，音频/光标等版本 1 消息整包转给全部观看端，版本不支持的丢弃
+            const PacketHeader::Info info = PacketHeader::read(msg);
+            if (info.headerSize == 0) return;
+            if (PacketHeader::isVideoLike(info.type)) {
+                forwardToSubscribers(it.value(), msg, info);
+                return;
+            }
+            QByteArray frame;
+            for (QWebSocket *sub : it->subscribers) {
+                if (sub->state() == QAbstractSocket::ConnectedState) {
+                    const auto route = it->routes.constFind(sub);
+                    sendToSubscriber(sub, route != it->routes.constEnd() ? route->transport : nullptr, msg, frame);
+                }
+            }
+        });
+
+        connect(sock, &QWebSocket::textMessageReceived, this, [this, roomId](const QString &msg) {
+            auto it = m_rooms.find(roomId);
+            if (it == m_rooms.end()) return;
+            for (QWebSocket *rawSub : it->subscribers) {
+                QPointer<QWebSocket> sub = rawSub;
+                if (sub && sub->state() == QAbstractSocket::ConnectedState) {
+                    sub->sendTextMessage(msg);
+                }
+            }
+        });
+    } else {
+        room.subscribers.insert(sock);
+        sock->setOutgoingFrameSize(std::min<quint64>(kSubscriberFrameSize, QWebSocket::maxOutgoingFrameSize()));
+        qInfo().noquote() << "[LanRelay] Subscriber connected for room:" << roomId;
+
+        // 推流中途加入：立即补发缓存的关键帧及后续帧，不等推流端下一个关键帧
+        SubscriberRoute &route = room.routes[sock];
+        route.transport = WebSocketFrame::transport(sock);
+        const int cachedStream = room.gop.nearest(route.stream.requested());
+        if (cachedStream >= 0) {
+            route.stream.startAt(cachedStream);
+            const QVector<QByteArray> burst = room.gop.frames(cachedStream);
+            for (const QByteArray &msg : burst) {
+                QByteArray frame;
+                sendToSubscriber(sock, route.transport, msg, frame);
+            }
+            qInfo().noquote() << "[LanRelay] Sent" << burst.size() << "cached frames of stream" << cachedStream;
+        }
+
+        connect(sock, &QWebSocket::textMessageReceived, this, [this, sock, roomId](const QString &msg) {
+            auto it = m_rooms.find(roomId);
+            if (it == m_rooms.end()) return;
+            handleSubscriberText(it.value(), sock, msg);
+        });
+
+        connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
+            auto it = m_rooms.find(roomId);
+            if (it == m_rooms.end()) return;
+            QPointer<QWebSocket> pub = it->publisher;
+            if (pub && pub->state() == QAbstractSocket::ConnectedState) {
+                pub->sendBinaryMessage(msg);
+            } else {
+                it->pendingBinaryToPublisher.append(msg);
+                if (it->pendingBinaryToPublisher.size() > 6) {
+                    it->pendingBinaryToPublisher.remove(0, it->pendingBinaryToPublisher.size() - 6);
+                }
+            }
+        });
+    }
+
+    connect(sock, &QWebSocket::disconnected, this, [this, sock, roomId]() {
+        auto it = m_rooms.find(roomId);
+        if (it == m_rooms.end()) {
+            sock->deleteLater();
+            return;
+        }
+
+        if (it->publisher == sock) {
+            it->publisher = nullptr;
+            it->gop.clear();
+        }
+        it->subscribers.remove(sock);
+        it->routes.remove(sock);
+
+        if (!it->publisher && it->subscribers.isEmpty()) {
+            m_rooms.erase(it);
+        }
+
+        sock->deleteLater();
+    });
+}
@@ -0,0 +1,61 @@
+#ifndef LANRELAYSERVER_H
+#define LANRELAYSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+
+#include "PacketHeader.h"
+
+class QTcpSocket;
+class QWebSocket;
+class QWebSocketServer;
+
+// 局域网中继：/publish/{room_id} 推流端，/subscribe/{room_id} 观看端
+// 推流端二进制数据转发给房间内所有观看端：每个观看端只接收其选择的一路流（simulcast），
+// 并按其发送缓冲积压过滤时间层；每条消息只成帧一次，所有观看端共享同一份帧（见 WebSocketFrame.h）；中途加入的观看端从 GOP 缓存立即补发最近关键帧及后续帧；
+// 观看端文本/二进制消息转发给推流端（推流端未连接时缓存少量消息）。
+// 主程序与采集进程共用。
+class LanRelayServer final : public QObject
+{
+public:
+    explicit LanRelayServer(QObject *parent = nullptr);
+
+    bool start(quint16 port);
+    quint16 port() const;
+    // 预成帧扇出（默认开启）；关闭时每个观看端由 QWebSocket 各自成帧，供基准对比
+    void setPreframedFanout(bool enabled) { m_preframed = enabled; }
+
+private:
+    // 观看端转发状态：所选流 + 时间层
+    struct SubscriberRoute {
+        PacketHeader::SimulcastSelector stream;
+        PacketHeader::TemporalLayerFilter layers;
+        QTcpSocket *transport = nullptr;    // 底层 socket（QWebSocket 的子对象），写入预成帧
+    };
+
+    struct Room {
+        QWebSocket *publisher = nullptr;
+        QSet<QWebSocket*> subscribers;
+        QHash<QWebSocket*, SubscriberRoute> routes;
+        PacketHeader::StreamActivity streams;
+        PacketHeader::GopCache gop;
+        QVector<QString> pendingTextToPublisher;
+        QVector<QByteArray> pendingBinaryToPublisher;
+    };
+
+    void onNewConnection();
+    void forwardToSubscribers(Room &room, const QByteArray &msg, const PacketHeader::Info &info);
+    void handleSubscriberText(Room &room, QWebSocket *sub, const QString &msg);
+    void requestKeyFrame(Room &room, int stream);
+    void sendToSubscriber(QWebSocket *sub, QTcpSocket *transport, const QByteArray &msg, QByteArray &frame);
+
+    QWebSocketServer *m_server = nullptr;
+    bool m_preframed = true;
+    QHash<QString, Room> m_rooms;
+};
+
+#endif // LANRELAYSERVER_H
@@ -0,0 +1,443 @@
+#ifndef PACKETHEADER_H
+#define PACKETHEADER_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+#include <algorithm>
+
+// 视频数据包 8 字节头部（本机字节序 qint64，与既有线上格式兼容）
+// 毫秒时间戳只占低 48 位，旧版本写入时高 16 位恒为 0；新版本在高 16 位携带标记：
+//   bit 56-63: 0xA5 标记（存在即表示已打标签）
+//   bit 48-49: 时间层ID（SVC temporal layer，0 为基础层）
+//   bit 50   : 关键帧
+//   bit 52-55: 流ID（多路编码时区分）
+// 中继/服务器只需读取这 8 字节即可按层转发，无需解析负载。
+//
+// 版本 1 二进制消息（视频、音频、光标、标注共用，取代高频 JSON + base64）：16 字节头部
+//   字节 0-7  : 同上的 64 位字（小端），标记为 0xA6
+//   字节 8    : 版本号（kMessageVersion）
+//   字节 9    : 消息类型 MessageType
+//   字节 10-11: 视频为基础层序号（小端，见下）；其余类型保留，写 0
+//   字节 12-15: 序号（小端，发送端按类型递增，接收端可据此统计丢包）
+// 基础层序号：每条流的编码器在每个基础层帧（temporalId 0，含关键帧）递增，跳过 0；
+// 增强层帧沿用其所依赖的最近基础层序号（同 RTP VP9 的 TL0PICIDX）。中继会按积压丢弃增强层，
+// 总序号的缺口无法区分网络丢包与主动丢层，观看端据基础层序号的缺口估算丢包。0 表示发送端未携带。
+// 中继仍只读头部：视频类按流/层选择性转发，其余类型按方向转发，不解析负载。
+// 负载格式见 BinaryMessage.h。JSON 只保留给低频信令。
+namespace PacketHeader {
+
+constexpr int kSize = 8;
+constexpr quint64 kTimestampMask = (quint64(1) << 48) - 1;
+constexpr quint64 kTagMarker = 0xA5;
+constexpr quint64 kMessageMarker = 0xA6;
+constexpr int kMessageVersion = 1;
+constexpr int kMessageHeaderSize = 16;
+constexpr int kMaxTemporalLayers = 3;
+constexpr int kMaxSimulcastStreams = 3;   // 0 为原始分辨率，数字越大分辨率越低
+
+enum class MessageType : quint8 {
+    Video = 1,          // VP9 数据包（推流端 → 观看端，按流/层选择性转发）
+    Audio = 2,          // 推流端 Opus 音频（推流端 → 观看端）
+    ViewerAudio = 3,    // 观看端 Opus 音频（观看端 → 推流端与其他观看端）
+    Cursor = 4,         // 光标位置（推流端鼠标 / 观看端光标）
+    Annotation = 5,     // 标注笔迹点（观看端 → 推流端）
+    Image = 6           // 整帧图片（JPEG，NewUi 预览流，按视频方式转发）
+};
+
+struct Info {
+    qint64 timestampMs = 0;
+    int temporalId = 0;
+    bool keyFrame = false;
+    int streamId = 0;
+    bool tagged = false;   // false 表示旧格式（纯时间戳），层信息未知
+    MessageType type = MessageType::Video; // 旧格式数据包均为视频
+    quint32 sequence = 0;  // 仅版本 1 消息有效
+    quint16 baseSequence = 0; // 仅版本 1 视频消息有效，0 表示未携带
+    int headerSize = 0;    // 负载起始偏移：旧格式 8，版本 1 为 16；0 表示头部无效（长度不足/版本不支持）
+};
+
+// 视频类消息（按流/层选择性转发），其余类型中继按方向整包转发
+inline bool isVideoLike(MessageType type)
+{
+    return type == MessageType::Video || type == MessageType::Image;
+}
+
+inline quint64 pack(qint64 timestampMs, int temporalId, bool keyFrame, int streamId)
+{
+    quint64 v = static_cast<quint64>(timestampMs) & kTimestampMask;
+    v |= static_cast<quint64>(temporalId & 0x3) << 48;
+    v |= static_cast<quint64>(keyFrame ? 1 : 0) << 50;
+    v |= static_cast<quint64>(streamId & 0xF) << 52;
+    v |= kTagMarker << 56;
+    return v;
+}
+
+inline void write(char *dst, qint64 timestampMs, int temporalId, bool keyFrame, int streamId)
+{
+    const quint64 v = pack(timestampMs, temporalId, keyFrame, streamId);
+    memcpy(dst, &v, sizeof(v));
+}
+
+// 写入版本 1 消息头部（dst 至少 kMessageHeaderSize 字节）
+inline void writeMessage(char *dst, MessageType type, quint32 sequence, qint64 timestampMs,
+                         int streamId = 0, int temporalId = 0, bool keyFrame = false,
+                         quint16 baseSequence = 0)
+{
+    quint64 v = pack(timestampMs, temporalId, keyFrame, streamId);
+    v = (v & ~(quint64(0xFF) << 56)) | (kMessageMarker << 56);
+    qToLittleEndian<quint64>(v, dst);
+    dst[8] = static_cast<char>(kMessageVersion);
+    dst[9] = static_cast<char>(type);
+    qToLittleEndian<quint16>(type == MessageType::Video ? baseSequence : quint16(0), dst + 10);
+    qToLittleEndian<quint32>(sequence, dst + 12);
+}
+
+// 头部 + 负载一次拼好（非视频消息使用；视频由 PacketBufferPool 写入池化缓冲）
+inline QByteArray buildMessage(MessageType type, quint32 sequence, qint64 timestampMs,
+                               const char *payload, int payloadSize, int streamId = 0)
+{
+    QByteArray out(kMessageHeaderSize + std::max(0, payloadSize), Qt::Uninitialized);
+    writeMessage(out.data(), type, sequence, timestampMs, streamId);
+    if (payloadSize > 0) {
+        memcpy(out.data() + kMessageHeaderSize, payload, payloadSize);
+    }
+    return out;
+}
+
+inline Info read(const char *src, int size)
+{
+    Info info;
+    if (!src || size < kSize) {
+        return info;
+    }
+    quint64 v = 0;
+    memcpy(&v, src, sizeof(v));
+    const quint64 marker = v >> 56;
+    if (marker == kTagMarker || marker == kMessageMarker) {
+        info.timestampMs = static_cast<qint64>(v & kTimestampMask);
+        info.temporalId = static_cast<int>((v >> 48) & 0x3);
+        info.keyFrame = ((v >> 50) & 0x1) != 0;
+        info.streamId = static_cast<int>((v >> 52) & 0xF);
+        info.tagged = true;
+        info.headerSize = kSize;
+        if (marker == kMessageMarker) {
+            // 版本不同的头部长度可能不同：不认识的版本整体视为无效，不猜测负载位置
+            const quint8 type = static_cast<quint8>(size >= kMessageHeaderSize ? src[9] : 0);
+            if (size < kMessageHeaderSize || static_cast<quint8>(src[8]) != kMessageVersion
+                || type < quint8(MessageType::Video) || type > quint8(MessageType::Image)) {
+                info.headerSize = 0;
+                return info;
+            }
+            info.type = static_cast<MessageType>(type);
+            info.sequence = qFromLittleEndian<quint32>(src + 12);
+            if (info.type == MessageType::Video) {
+                info.baseSequence = qFromLittleEndian<quint16>(src + 10);
+            }
+            info.headerSize = kMessageHeaderSize;
+        }
+    } else {
+        info.timestampMs = static_cast<qint64>(v);
+        info.headerSize = kSize;
+    }
+    return info;
+}
+
+inline Info read(const QByteArray &packet)
+{
+    return read(packet.constData(), packet.size());
+}
+
+// 兼容新旧格式的时间戳读取（不足 8 字节返回 0）
+inline qint64 timestampMs(const QByteArray &packet)
+{
+    return read(packet).timestampMs;
+}
+
+// 单个观看端的时间层过滤（中继按其发送缓冲积压决定转发哪些层）
+// - 积压超过高水位：只转发基础层；超过中水位：最多转发到第 1 层
+// - 积压回落到低水位以下：在下一个基础层帧或关键帧处恢复全部层（升层必须从不依赖增强层的帧开始；
+//   0212 结构中基础层帧只参考基础层，其后的增强层帧只参考它及之后的帧，不必等关键帧）
+// 未打标签的旧格式数据包总是转发。
+class TemporalLayerFilter
+{
+public:
+    static constexpr qint64 kHighWatermarkBytes = 512 * 1024;
+    static constexpr qint64 kMidWatermarkBytes = 192 * 1024;
+    static constexpr qint64 kLowWatermarkBytes = 64 * 1024;
+
+    bool accept(const Info &info, qint64 backlogBytes)
+    {
+        if (!info.tagged) {
+            return true;
+        }
+        if (backlogBytes > kHighWatermarkBytes) {
+            m_maxTemporalId = 0;
+        } else if (backlogBytes > kMidWatermarkBytes) {
+            m_maxTemporalId = std::min(m_maxTemporalId, 1);
+        } else if (backlogBytes < kLowWatermarkBytes && (info.keyFrame || info.temporalId == 0)) {
+            m_maxTemporalId = kMaxTemporalLayers - 1;
+        }
+        if (info.keyFrame || info.temporalId <= m_maxTemporalId) {
+            return true;
+        }
+        ++m_dropped;
+        return false;
+    }
+
+    int maxTemporalId() const { return m_maxTemporalId; }
+    quint64 droppedCount() const { return m_dropped; }
+
+private:
+    int m_maxTemporalId = kMaxTemporalLayers - 1;
+    quint64 m_dropped = 0;
+};
+
+// 房间内各路流的活跃情况（中继记录推流端最近发出过数据的流）
+class StreamActivity
+{
+public:
+    static constexpr qint64 kActiveWindowMs = 2000;
+
+    void mark(const Info &info, qint64 nowMs)
+    {
+        const int sid = info.tagged ? info.streamId : 0;
+        if (sid >= 0 && sid < kMaxSimulcastStreams) {
+            m_lastSeenMs[sid] = nowMs;
+        }
+    }
+
+    // 位图：bit i 表示第 i 路流最近有数据
+    quint32 activeMask(qint64 nowMs) const
+    {
+        quint32 mask = 0;
+        for (int i = 0; i < kMaxSimulcastStreams; ++i) {
+            if (m_lastSeenMs[i] > 0 && nowMs - m_lastSeenMs[i] <= kActiveWindowMs) {
+                mask |= (1u << i);
+            }
+        }
+        return mask;
+    }
+
+private:
+    qint64 m_lastSeenMs[kMaxSimulcastStreams] = {};
+};
+
+// 单个观看端的多路流（simulcast）选择
+// - 观看端通过 select_stream 声明期望的流；该流不存在时就近选择，优先更高分辨率
+// - 发送缓冲持续积压时逐级降到更低分辨率的流，积压消除一段时间后逐级回升
+// - 切换只在目标流的关键帧处生效，切换完成前继续转发当前流，画面不中断
+// 未打标签的旧格式数据包视为第 0 路；默认只接收第 0 路，旧版观看端行为不变。
+class SimulcastSelector
+{
+public:
+    static constexpr qint64 kDowngradeHoldMs = 2000;
+    static constexpr qint64 kUpgradeHoldMs = 5000;
+    static constexpr qint64 kKeyFrameRequestIntervalMs = 1000;
+
+    void setRequested(int streamId)
+    {
+        m_requested = std::max(0, std::min(streamId, kMaxSimulcastStreams - 1));
+        m_penalty = 0;
+    }
+
+    int requested() const { return m_requested; }
+    int current() const { return m_current; }
+    int target() const { return m_target; }
+
+    // 新观看端从 GOP 缓存补发时直接从该流开始（缓存以关键帧开头，无需等待切换）
+    void startAt(int streamId)
+    {
+        m_current = m_target = std::max(0, std::min(streamId, kMaxSimulcastStreams - 1));
+    }
+
+    bool accept(const Info &info, qint64 backlogBytes, quint32 activeStreams, qint64 nowMs)
+    {
+        const int sid = info.tagged ? info.streamId : 0;
+
+        if (backlogBytes > TemporalLayerFilter::kHighWatermarkBytes) {
+            m_clearSinceMs = 0;
+            if (m_overloadSinceMs == 0) {
+                m_overloadSinceMs = nowMs;
+            } else if (nowMs - m_overloadSinceMs >= kDowngradeHoldMs && m_penalty < kMaxSimulcastStreams - 1) {
+                ++m_penalty;
+                m_overloadSinceMs = nowMs;
+            }
+        } else {
+            m_overloadSinceMs = 0;
+            if (backlogBytes < TemporalLayerFilter::kLowWatermarkBytes && m_penalty > 0) {
+                if (m_clearSinceMs == 0) {
+                    m_clearSinceMs = nowMs;
+                } else if (nowMs - m_clearSinceMs >= kUpgradeHoldMs) {
+                    --m_penalty;
+                    m_clearSinceMs = nowMs;
+                }
+            }
+        }
+
+        m_target = resolve(activeStreams);
+        if (m_target != m_current && sid == m_target && info.keyFrame) {
+            m_current = m_target;
+        }
+        return sid == m_current;
+    }
+
+    // 目标流尚未切换完成时按间隔返回 true：调用方应向推流端请求目标流的关键帧
+    bool takeKeyFrameRequest(qint64 nowMs)
+    {
+        if (m_target == m_current || nowMs - m_lastKeyFrameRequestMs < kKeyFrameRequestIntervalMs) {
+            return false;
+        }
+        m_lastKeyFrameRequestMs = nowMs;
+        return true;
+    }
+
+private:
+    int resolve(quint32 activeStreams) const
+    {
+        if (activeStreams == 0) {
+            return m_current;
+        }
+        int s = -1;
+        for (int i = m_requested; i >= 0 && s < 0; --i) {
+            if (activeStreams & (1u << i)) s = i;
+        }
+        for (int i = m_requested + 1; i < kMaxSimulcastStreams && s < 0; ++i) {
+            if (activeStreams & (1u << i)) s = i;
+        }
+        for (int step = 0; step < m_penalty; ++step) {
+            int lower = -1;
+            for (int i = s + 1; i < kMaxSimulcastStreams && lower < 0; ++i) {
+                if (activeStreams & (1u << i)) lower = i;
+            }
+            if (lower < 0) break;
+            s = lower;
+        }
+        return s;
+    }
+
+    int m_requested = 0;
+    int m_current = 0;
+    int m_target = 0;
+    int m_penalty = 0;                 // 因积压降低的级数
+    qint64 m_overloadSinceMs = 0;
+    qint64 m_clearSinceMs = 0;
+    qint64 m_lastKeyFrameRequestMs = 0;
+};
+
+// 中继的 GOP 缓存：每路流保存最近一个关键帧及其后的增量帧，新加入的观看端立即补发，
+// 首帧不必等待推流端产生关键帧
+// - 关键帧（整帧图片同样视为关键帧）到达时重置该路缓存
+// - 基础层增量帧到达时丢弃缓存中的增强层帧：后续帧只参考基础层链与本周期内的帧，
+//   补发只需关键帧、基础层链与最新一个周期
+// - 超过字节/帧数上限，或关键帧已超过 kMaxAgeMs（周期保活默认 8 秒，正常不会触发）时清空该路缓存
+//   直到下一个关键帧：补发过长的 GOP 会让新观看端先追很久的旧画面。中继不为补充缓存主动请求关键帧
+//   （按需/帧内刷新模式下会变成每 10 秒一次的强制关键帧），此时新观看端走无缓存路径，
+//   由加入时推流端收到的 watch_request/start_streaming 生成关键帧
+// 未打标签的旧格式包不知道关键帧位置，不缓存。
+class GopCache
+{
+public:
+    static constexpr qint64 kMaxBytesPerStream = 2 * 1024 * 1024;
+    static constexpr int kMaxFramesPerStream = 150;
+    static constexpr qint64 kMaxAgeMs = 10000;
+
+    void add(const QByteArray &msg, const Info &info)
+    {
+        if (!info.tagged || !isVideoLike(info.type) || info.streamId >= kMaxSimulcastStreams) {
+            return;
+        }
+        Stream &s = m_streams[info.streamId];
+        if (info.keyFrame || info.type == MessageType::Image) {
+            reset(s);
+            s.valid = true;
+            s.keyTimestampMs = info.timestampMs;
+        } else if (!s.valid) {
+            return;
+        } else if (info.temporalId == 0) {
+            auto end = std::remove_if(s.frames.begin(), s.frames.end(), [&s](const Entry &e) {
+                if (e.temporalId == 0) return false;
+                s.bytes -= e.message.size();
+                return true;
+            });
+            s.frames.erase(end, s.frames.end());
+        }
+        s.frames.append({msg, info.temporalId});
+        s.bytes += msg.size();
+        if (s.bytes > kMaxBytesPerStream || s.frames.size() > kMaxFramesPerStream
+            || info.timestampMs - s.keyTimestampMs > kMaxAgeMs) {
+            reset(s);
+        }
+    }
+
+    bool has(int streamId) const
+    {
+        return streamId >= 0 && streamId < kMaxSimulcastStreams && m_streams[streamId].valid;
+    }
+
+    // 离 requested 最近的有缓存的流（与 SimulcastSelector 相同的就近规则）；没有返回 -1
+    int nearest(int requested) const
+    {
+        for (int i = std::min(requested, kMaxSimulcastStreams - 1); i >= 0; --i) {
+            if (has(i)) return i;
+        }
+        for (int i = requested + 1; i < kMaxSimulcastStreams; ++i) {
+            if (has(i)) return i;
+        }
+        return -1;
+    }
+
+    // 补发内容：第一个为关键帧，按原顺序
+    QVector<QByteArray> frames(int streamId) const
+    {
+        QVector<QByteArray> out;
+        if (!has(streamId)) {
+            return out;
+        }
+        out.reserve(m_streams[streamId].frames.size());
+        for (const Entry &e : m_streams[streamId].frames) {
+            out.append(e.message);
+        }
+        return out;
+    }
+
+    qint64 bytes() const
+    {
+        qint64 total = 0;
+        for (const Stream &s : m_streams) total += s.bytes;
+        return total;
+    }
+
+    void clear()
+    {
+        for (Stream &s : m_streams) reset(s);
+    }
+
+private:
+    struct Entry {
+        QByteArray message;
+        int temporalId = 0;
+    };
+    struct Stream {
+        QVector<Entry> frames;
+        qint64 bytes = 0;
+        qint64 keyTimestampMs = 0;     // 缓存中关键帧的采集时间戳（推流端时钟）
+        bool valid = false;
+    };
+
+    static void reset(Stream &s)
+    {
+        s.frames.clear();
+        s.bytes = 0;
+        s.keyTimestampMs = 0;
+        s.valid = false;
+    }
+
+    Stream m_streams[kMaxSimulcastStreams];
+};
+
+} // namespace PacketHeader
+
+#endif // PACKETHEADER_H
@@ -0,0 +1,48 @@
+#ifndef WEBSOCKETFRAME_H
+#define WEBSOCKETFRAME_H
+
+#include <QByteArray>
+#include <QTcpSocket>
+#include <QWebSocket>
+
+// 中继扇出用的预成帧：每条消息只生成一次 WebSocket 帧（帧头 + 负载），同一个 QByteArray
+// 写入所有观看端的底层 QTcpSocket。Qt 6 的 QIODevice::write(const QByteArray &) 对 4 KB 以上的数据
+// 直接引用进 socket 写缓冲而不拷贝，N 个观看端共享一份帧；QWebSocket::sendBinaryMessage 则对每个观看端
+// 各组一次帧头并把负载拷入各自的写缓冲。
+// QWebSocket 自身的写出（文本、控制帧）都是同步写完整帧，与这里的整帧写入不会交错。
+namespace WebSocketFrame {
+
+// 服务器发往客户端的单帧二进制消息（FIN + opcode 2，不加掩码，RFC 6455 5.2）
+inline QByteArray binary(const QByteArray &payload)
+{
+    const quint64 size = static_cast<quint64>(payload.size());
+    QByteArray frame;
+    frame.reserve(payload.size() + 10);
+    frame.append(char(0x82));
+    if (size < 126) {
+        frame.append(char(size));
+    } else if (size <= 0xFFFF) {
+        frame.append(char(126));
+        frame.append(char((size >> 8) & 0xFF));
+        frame.append(char(size & 0xFF));
+    } else {
+        frame.append(char(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(char((size >> shift) & 0xFF));
+        }
+    }
+    frame.append(payload);
+    return frame;
+}
+
+// 服务器端连接的底层 socket：QWebSocketServer 接受的连接由 QTcpSocket 升级而来，QTcpSocket 是
+// QWebSocket 的子对象（随 moveToThread 一起迁移）。只用于服务器端（客户端发出的帧必须加掩码）；
+// 找不到时返回 nullptr，调用方退回 sendBinaryMessage
+inline QTcpSocket *transport(QWebSocket *socket)
+{
+    return socket ? socket->findChild<QTcpSocket *>() : nullptr;
+}
+
+} // namespace WebSocketFrame
+
+#endif // WEBSOCKETFRAME_H
@@ -34,180 +34,10 @@
 #include "common/ConsoleLogger.h"
 #include "common/CrashGuard.h"
 #include "common/AppConfig.h"
+#include "common/LanRelayServer.h"
 #include "MainWindow.h"
 #include "NewUi/NewUiWindow.h"
 
-namespace {
-class LanRelayServer final : public QObject
-{
-public:
-    explicit LanRelayServer(QObject *parent = nullptr)
-        : QObject(parent)
-    {
-    }
-
-    bool start(quint16 port)
-    {
-        if (m_server) {
-            return true;
-        }
-
-        m_server = new QWebSocketServer(QStringLiteral("IrulerDeskpro LAN Relay"), QWebSocketServer::NonSecureMode, this);
-        if (!m_server->listen(QHostAddress::AnyIPv4, port)) {
-            m_server->deleteLater();
-            m_server = nullptr;
-            return false;
-        }
-
-        connect(m_server, &QWebSocketServer::newConnection, this, &LanRelayServer::onNewConnection);
-        return true;
-    }
-
-    quint16 port() const
-    {
-        if (!m_server) return 0;
-        return static_cast<quint16>(m_server->serverPort());
-    }
-
-private:
-    struct Room {
-        QWebSocket *publisher = nullptr;
-        QSet<QWebSocket*> subscribers;
-        QVector<QString> pendingTextToPublisher;
-        QVector<QByteArray> pendingBinaryToPublisher;
-    };
-
-    QWebSocketServer *m_server = nullptr;
-    QHash<QString, Room> m_rooms;
-
-    void onNewConnection()
-    {
-        if (!m_server) return;
-        QWebSocket *sock = m_server->nextPendingConnection();
-        if (!sock) return;
-
-        const QString path = sock->requestUrl().path();
-        const QStringList parts = path.split('/', Qt::SkipEmptyParts);
-        if (parts.size() < 2) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        const QString role = parts.value(0);
-        const QString roomId = parts.value(1);
-        if (roomId.isEmpty()) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        if (role != QStringLiteral("publish") && role != QStringLiteral("subscribe")) {
-            sock->close();
-            sock->deleteLater();
-            return;
-        }
-
-        Room &room = m_rooms[roomId];
-
-        if (role == QStringLiteral("publish")) {
-            if (room.publisher && room.publisher != sock) {
-                room.publisher->close();
-                room.publisher->deleteLater();
-            }
-            room.publisher = sock;
-            if (!room.pendingTextToPublisher.isEmpty()) {
-                for (const QString &msg : room.pendingTextToPublisher) {
-                    if (sock->state() == QAbstractSocket::ConnectedState) {
-                        sock->sendTextMessage(msg);
-                    }
-                }
-                room.pendingTextToPublisher.clear();
-            }
-            if (!room.pendingBinaryToPublisher.isEmpty()) {
-                for (const QByteArray &msg : room.pendingBinaryToPublisher) {
-                    if (sock->state() == QAbstractSocket::ConnectedState) {
-                        sock->sendBinaryMessage(msg);
-                    }
-                }
-                room.pendingBinaryToPublisher.clear();
-            }
-
-            connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                for (QWebSocket *rawSub : it->subscribers) {
-                    QPointer<QWebSocket> sub = rawSub;
-                    if (sub && sub->state() == QAbstractSocket::ConnectedState) {
-                        sub->sendBinaryMessage(msg);
-                    }
-                }
-            });
-
-            connect(sock, &QWebSocket::textMessageReceived, this, [this, roomId](const QString &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                for (QWebSocket *rawSub : it->subscribers) {
-                    QPointer<QWebSocket> sub = rawSub;
-                    if (sub && sub->state() == QAbstractSocket::ConnectedState) {
-                        sub->sendTextMessage(msg);
-                    }
-                }
-            });
-        } else {
-            room.subscribers.insert(sock);
-
-            connect(sock, &QWebSocket::textMessageReceived, this, [this, roomId](const QString &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                QPointer<QWebSocket> pub = it->publisher;
-                if (pub && pub->state() == QAbstractSocket::ConnectedState) {
-                    pub->sendTextMessage(msg);
-                } else {
-                    it->pendingTextToPublisher.append(msg);
-                    if (it->pendingTextToPublisher.size() > 12) {
-                        it->pendingTextToPublisher.remove(0, it->pendingTextToPublisher.size() - 12);
-                    }
-                }
-            });
-
-            connect(sock, &QWebSocket::binaryMessageReceived, this, [this, roomId](const QByteArray &msg) {
-                auto it = m_rooms.find(roomId);
-                if (it == m_rooms.end()) return;
-                QPointer<QWebSocket> pub = it->publisher;
-                if (pub && pub->state() == QAbstractSocket::ConnectedState) {
-                    pub->sendBinaryMessage(msg);
-                } else {
-                    it->pendingBinaryToPublisher.append(msg);
-                    if (it->pendingBinaryToPublisher.size() > 6) {
-                        it->pendingBinaryToPublisher.remove(0, it->pendingBinaryToPublisher.size() - 6);
-                    }
-                }
-            });
-        }
-
-        connect(sock, &QWebSocket::disconnected, this, [this, sock, roomId]() {
-            auto it = m_rooms.find(roomId);
-            if (it == m_rooms.end()) {
-                sock->deleteLater();
-                return;
-            }
-
-            if (it->publisher == sock) {
-                it->publisher = nullptr;
-            }
-            it->subscribers.remove(sock);
-
-            if (!it->publisher && it->subscribers.isEmpty()) {
-                m_rooms.erase(it);
-            }
-
-            sock->deleteLater();
-        });
-    }
-};
-}
-
 int main(int argc, char *argv[])
 {
     // 安装崩溃守护与控制台日志重定向
@@ -200,6 +200,15 @@ QByteArray VP9Decoder::convertYUVToRGB(const vpx_image_t *img)
                 rgbBuffer, width * 4,  // ARGB输出缓冲区和步长
                 width, height
             );
+        } else if (colorSpace == 2 && colorRange == 0) {
+            // BT.709 Studio Range - 采集端可配置为 BT.709 矩阵
+            result = libyuv::H420ToARGB(
+                yPlane, yStride,  // Y平面
+                uPlane, uStride,  // U平面
+                vPlane, vStride,  // V平面
+                rgbBuffer, width * 4,  // ARGB输出缓冲区和步长
+                width, height
+            );
         } else if (colorSpace == 1 && colorRange == 0) {
             // BT.601 Studio Range - 使用标准I420转换
             result = libyuv::I420ToARGB(
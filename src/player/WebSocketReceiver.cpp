@@ -21,6 +21,7 @@
 #include <QStringConverter>
 #endif
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <QtMultimedia/QAudioSource>
 #include <QtMultimedia/QMediaDevices>
@@ -28,6 +29,8 @@
 #include <QVector>
 #include <QHostAddress>
 #include "../common/AppConfig.h"
+#include "../common/PacketHeader.h"
+#include "../common/BinaryMessage.h"
 
 static QString roomIdFromWsUrlString(const QString &urlString)
 {
@@ -816,6 +819,9 @@ void WebSocketReceiver::onConnected()
         sendRequestKeyFrame();
     }
 
+    // 新连接上中继的选择状态为默认（第 0 路），重新声明本观看端的流选择
+    applyStreamSelection(true);
+
     if (!viewerIdCopy.isEmpty() && !targetIdCopy.isEmpty()) {
         sendViewerMicState(talkActiveCopy);
         QTimer::singleShot(1200, this, [this]() {
@@ -1001,6 +1007,9 @@ void WebSocketReceiver::onBinaryMessageReceived(const QByteArray &message)
 
     QByteArray frameData;
     qint64 captureTimestamp = 0;
+    bool baseLayer = true; // 时间分层码流中只有基础层保证不被中继丢弃
+    int streamId = 0;
+    quint16 baseSequence = 0; // 基础层序号（版本 1 视频消息），0 表示未携带
 
     bool handledByHeader = false;
     if (message.size() > 4) {
@@ -1023,8 +1032,20 @@ void WebSocketReceiver::onBinaryMessageReceived(const QByteArray &message)
     }
 
     if (!handledByHeader) {
-        memcpy(&captureTimestamp, message.constData(), 8);
-        frameData = message.mid(8);
+        // 8 字节旧格式头部或 16 字节版本 1 消息头部：时间戳（高位携带时间层/关键帧标签）
+        const PacketHeader::Info info = PacketHeader::read(message);
+        if (info.headerSize == 0) {
+            return; // 不支持的消息版本
+        }
+        if (BinaryMessage::isMessage(info) && !PacketHeader::isVideoLike(info.type)) {
+            handleBinaryControlMessage(message, info);
+            return;
+        }
+        captureTimestamp = info.timestampMs;
+        baseLayer = !info.tagged || info.temporalId == 0;
+        streamId = info.streamId;
+        baseSequence = info.baseSequence;
+        frameData = BinaryMessage::payload(message, info);
     }
 
     {
@@ -1042,6 +1063,10 @@ void WebSocketReceiver::onBinaryMessageReceived(const QByteArray &message)
         }
         m_stats.totalFrames++;
         m_stats.totalBytes += frameData.size();
+        if (captureTimestamp > 0) {
+            updateReceiverReportStats(captureTimestamp, QDateTime::currentMSecsSinceEpoch(), frameData.size(), baseLayer,
+                                      streamId, baseSequence);
+        }
         m_frameSizes.append(frameData.size());
         if (m_frameSizes.size() > 100) {
             m_frameSizes.removeFirst();
@@ -1051,6 +1076,38 @@ void WebSocketReceiver::onBinaryMessageReceived(const QByteArray &message)
     emit frameReceivedWithTimestamp(frameData, captureTimestamp > 0 ? captureTimestamp : QDateTime::currentMSecsSinceEpoch());
 }
 
+// 版本 1 二进制音频/光标消息（取代 audio_opus / viewer_audio_opus / mouse_position JSON）
+void WebSocketReceiver::handleBinaryControlMessage(const QByteArray &message, const PacketHeader::Info &info)
+{
+    switch (info.type) {
+    case PacketHeader::MessageType::Audio: {
+        BinaryMessage::Audio audio;
+        if (BinaryMessage::decodeAudio(message, info, audio)) {
+            // 与 JSON 路径一致使用微秒时间戳
+            enqueueProducerOpus(audio.opus, audio.channels, info.timestampMs * 1000, static_cast<int>(info.sequence));
+        }
+        break;
+    }
+    case PacketHeader::MessageType::ViewerAudio: {
+        BinaryMessage::Audio audio;
+        if (BinaryMessage::decodeAudio(message, info, audio)) {
+            enqueuePeerOpus(audio.senderId, audio.opus, audio.channels, info.timestampMs);
+        }
+        break;
+    }
+    case PacketHeader::MessageType::Cursor: {
+        BinaryMessage::Cursor cursor;
+        if (BinaryMessage::decodeCursor(message, info, cursor)) {
+            emit mousePositionReceived(QPoint(cursor.x, cursor.y), info.timestampMs * 1000, cursor.name);
+        }
+        break;
+    }
+    default:
+        // 标注只发往推流端，观看端忽略
+        break;
+    }
+}
+
 void WebSocketReceiver::onTextMessageReceived(const QString &message)
 {
     // 只在调试模式下输出日志，避免影响性能
@@ -1266,11 +1323,6 @@ void WebSocketReceiver::onTextMessageReceived(const QString &message)
         } else if (type == "audio_opus") {
             // Remove target_id filtering as we now use precise room routing on server
             
-            // 如果音频已被停止，直接丢弃数据，防止重启定时器
-            if (m_audioStopped) {
-                return;
-            }
-
             int sampleRate = obj.value("sample_rate").toInt(16000);
             int channels = obj.value("channels").toInt(1);
             int frameSamples = obj.value("frame_samples").toInt(sampleRate / 50);
@@ -1289,109 +1341,14 @@ void WebSocketReceiver::onTextMessageReceived(const QString &message)
                  lastRxTime = now;
             }
 
-            // Force 48kHz for mixing to avoid "alien" sounds when mixing 16k and 48k streams
-            int mixSampleRate = 48000;
-            
-            initOpusDecoderIfNeeded(mixSampleRate, channels);
-            if (!m_opusInitialized || !m_opusDecoder) {
-                return; // 解码器不可用
-            }
-            // 入队以按固定20ms节拍解码，降低颤抖
-            m_opusSampleRate = mixSampleRate;
-            m_opusChannels = channels;
-            // Always use 20ms frame size for 48kHz (960 samples)
-            m_audioFrameSamples = mixSampleRate / 50; 
-            
-            const int MAX_QUEUE_SIZE = 30; 
-            if (m_opusQueue.size() >= MAX_QUEUE_SIZE) {
-                int dropCount = 0;
-                while (m_opusQueue.size() >= MAX_QUEUE_SIZE - 12) {
-                    m_opusQueue.dequeue();
-                    if (!m_opusSeqQueue.isEmpty()) m_opusSeqQueue.dequeue();
-                    dropCount++;
-                }
-                static int dropLogCount = 0;
-                if (++dropLogCount % 10 == 0) {
-                }
-            }
-
-            m_opusQueue.enqueue(opusData);
-            m_opusSeqQueue.enqueue(seq);
-            
-            if (!m_audioTimer->isActive()) {
-                int threshold = 7;
-                if (m_opusQueue.size() >= threshold) {
-                    m_hasAudioStarted = true;
-                    m_producerBuffering = true;
-                    m_audioLastTimestamp = timestamp;
-                    m_nextAudioTick = QDateTime::currentMSecsSinceEpoch();
-                    m_audioTimer->start();
-                }
-            }
+            enqueueProducerOpus(opusData, channels, timestamp, seq);
             return;
         } else if (type == "viewer_audio_opus") {
-            QString fromId = obj.value("viewer_id").toString();
-            if (!fromId.isEmpty()) {
-                QMutexLocker locker(&m_mutex);
-                if (fromId == m_lastViewerId) {
-                    // Debug: Filtered own echo
-                    static int echoFilterCount = 0;
-                    if (++echoFilterCount % 100 == 0) {
-                    }
-                    return;
-                }
-            }
-            int sampleRate = obj.value("sample_rate").toInt(16000);
-            int channels = obj.value("channels").toInt(1);
-            // Force 48kHz mixing for peers
-            int mixSampleRate = 48000;
-            int frameSamples = mixSampleRate / 50; // 960 samples
-            
-            qint64 timestamp = obj.value("timestamp").toVariant().toLongLong();
-            QByteArray opusData = QByteArray::fromBase64(obj.value("data_base64").toString().toUtf8());
-            OpusDecoder* dec = m_peerDecoders.value(fromId, nullptr);
-            // Check if decoder exists and matches mix rate (not source rate)
-            if (!dec || m_peerSampleRates.value(fromId) != mixSampleRate || m_peerChannels.value(fromId) != channels) {
-                if (dec) { opus_decoder_destroy(dec); }
-                int err = OPUS_OK;
-                dec = opus_decoder_create(mixSampleRate, channels, &err);
-                if (err != OPUS_OK || !dec) {
-                    return;
-                }
-                m_peerDecoders[fromId] = dec;
-                m_peerSampleRates[fromId] = mixSampleRate;
-                m_peerChannels[fromId] = channels;
-                m_peerBuffering[fromId] = true; // Initialize buffering state
-            }
-            m_peerFrameSamples[fromId] = frameSamples;
-            m_peerSilenceCounts[fromId] = 0;
-            m_peerLastActiveTimes[fromId] = QDateTime::currentMSecsSinceEpoch();
-            
-            // 延迟控制 (Peer)
-            const int MAX_PEER_QUEUE = 30;
-            QQueue<QByteArray>& q = m_peerQueues[fromId];
-            if (q.size() >= MAX_PEER_QUEUE) {
-                while (q.size() >= MAX_PEER_QUEUE - 12) {
-                    q.dequeue();
-                }
-            }
-            
-            q.enqueue(opusData);
-            if (!m_audioTimer->isActive()) {
-                int threshold = 7;
-                bool ready = m_opusQueue.size() >= threshold;
-                if (!ready) {
-                    for (auto it = m_peerQueues.begin(); it != m_peerQueues.end(); ++it) {
-                        if (it.value().size() >= threshold) { ready = true; break; }
-                    }
-                }
-                if (ready) { 
-                    m_hasAudioStarted = true;
-                    m_audioLastTimestamp = timestamp; 
-                    m_nextAudioTick = QDateTime::currentMSecsSinceEpoch();
-                    m_audioTimer->start(); 
-                }
-            }
+            const QString fromId = obj.value("viewer_id").toString();
+            const int channels = obj.value("channels").toInt(1);
+            const qint64 timestamp = obj.value("timestamp").toVariant().toLongLong();
+            const QByteArray opusData = QByteArray::fromBase64(obj.value("data_base64").toString().toUtf8());
+            enqueuePeerOpus(fromId, opusData, channels, timestamp);
             return;
         } else if (type == "streaming_ok") {
             emit streamingStarted();
@@ -1622,6 +1579,108 @@ void WebSocketReceiver::updateStats()
     m_lastStatsUpdateTime = currentTime;
     
     emit statsUpdated(m_stats);
+    
+    // 每 2 秒向推流端上报一次接收质量（在锁外发送）
+    QJsonObject report = takeReceiverReport(currentTime);
+    locker.unlock();
+    if (!report.isEmpty() && m_connected && m_webSocket) {
+        QJsonDocument doc(report);
+        m_webSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
+    }
+}
+
+void WebSocketReceiver::updateReceiverReportStats(qint64 captureTimestamp, qint64 arrivalMs, int bytes, bool baseLayer,
+                                                  int streamId, quint16 baseSequence)
+{
+    // 调用方已持有 m_mutex
+    static const int kWindow = 30;
+    static const int kMaxBaseSeqStep = 512; // 更大的跳变视为推流端重启/回退，不计丢帧
+    const qint64 transit = arrivalMs - captureTimestamp;
+
+    if (m_reportHasTransit) {
+        const qint64 delta = captureTimestamp - m_reportLastCaptureTs;
+        if (delta <= -5000 || delta > 5000) {
+            // 时间戳回退或长时间无帧（推流暂停/重启）：重新建立基线，不计丢帧
+            m_reportTransits.clear();
+            m_reportLastBaseSeq = 0;
+        } else {
+            // RFC 3550：J += (|D| - J) / 16
+            const double d = std::abs(static_cast<double>(transit - m_reportLastTransit));
+            m_reportJitterMs += (d - m_reportJitterMs) / 16.0;
+        }
+    }
+
+    // 丢帧估算只看基础层序号的缺口：中继对积压的观看端会主动丢弃增强层，不应计为网络丢包；
+    // 采集间隔随自适应帧率与空闲降频变化，不能用来推断丢帧。未携带序号（旧格式/JSON）时不估算。
+    if (baseLayer && baseSequence != 0) {
+        if (m_reportLastBaseSeq != 0 && m_reportBaseStream == streamId) {
+            int step = static_cast<quint16>(baseSequence - m_reportLastBaseSeq);
+            if (baseSequence < m_reportLastBaseSeq) {
+                --step; // 回绕时发送端跳过了 0
+            }
+            if (step >= 1 && step <= kMaxBaseSeqStep) {
+                m_reportLost += step - 1;
+            }
+            // step == 0：重复帧；跳变过大：重新建立基线
+        }
+        m_reportLastBaseSeq = baseSequence;
+        m_reportBaseStream = streamId;
+    }
+
+    m_reportTransits.append(transit);
+    if (m_reportTransits.size() > kWindow * 3) {
+        m_reportTransits.removeFirst();
+    }
+    m_reportLastTransit = transit;
+    m_reportLastCaptureTs = captureTimestamp;
+    if (baseLayer) {
+        m_reportBaseReceived++;
+    }
+    m_reportHasTransit = true;
+    m_reportReceived++;
+    m_reportBytes += bytes;
+}
+
+QJsonObject WebSocketReceiver::takeReceiverReport(qint64 nowMs)
+{
+    // 调用方已持有 m_mutex
+    if (m_lastReceiverReportMs == 0) {
+        m_lastReceiverReportMs = nowMs;
+        return QJsonObject();
+    }
+    const qint64 elapsed = nowMs - m_lastReceiverReportMs;
+    if (elapsed < 2000) {
+        return QJsonObject();
+    }
+    m_lastReceiverReportMs = nowMs;
+    if (m_reportReceived == 0 || m_lastViewerId.isEmpty()) {
+        m_reportBaseReceived = 0;
+        m_reportLost = 0;
+        m_reportBytes = 0;
+        return QJsonObject();
+    }
+
+    qint64 minTransit = m_reportLastTransit;
+    for (qint64 t : m_reportTransits) {
+        minTransit = std::min(minTransit, t);
+    }
+    const int total = m_reportBaseReceived + m_reportLost;
+
+    QJsonObject report;
+    report["type"] = "receiver_report";
+    report["viewer_id"] = m_lastViewerId;
+    report["jitter_ms"] = m_reportJitterMs;
+    report["queue_delay_ms"] = static_cast<double>(m_reportLastTransit - minTransit);
+    report["loss_pct"] = total > 0 ? m_reportLost * 100.0 / total : 0.0;
+    report["fps"] = m_reportReceived * 1000.0 / elapsed;
+    report["kbps"] = m_reportBytes * 8.0 / elapsed;
+    report["timestamp"] = nowMs;
+
+    m_reportReceived = 0;
+    m_reportBaseReceived = 0;
+    m_reportLost = 0;
+    m_reportBytes = 0;
+    return report;
 }
 
 void WebSocketReceiver::initOpusDecoderIfNeeded(int sampleRate, int channels)
@@ -1643,6 +1702,117 @@ void WebSocketReceiver::initOpusDecoderIfNeeded(int sampleRate, int channels)
     }
 }
 
+// 推流端音频（JSON audio_opus 与二进制 Audio 共用）：入队按固定 20ms 节拍解码混音
+void WebSocketReceiver::enqueueProducerOpus(const QByteArray &opusData, int channels, qint64 timestamp, int seq)
+{
+    // 如果音频已被停止，直接丢弃数据，防止重启定时器
+    if (m_audioStopped) {
+        return;
+    }
+
+    // Force 48kHz for mixing to avoid "alien" sounds when mixing 16k and 48k streams
+    int mixSampleRate = 48000;
+    
+    initOpusDecoderIfNeeded(mixSampleRate, channels);
+    if (!m_opusInitialized || !m_opusDecoder) {
+        return; // 解码器不可用
+    }
+    // 入队以按固定20ms节拍解码，降低颤抖
+    m_opusSampleRate = mixSampleRate;
+    m_opusChannels = channels;
+    // Always use 20ms frame size for 48kHz (960 samples)
+    m_audioFrameSamples = mixSampleRate / 50; 
+    
+    const int MAX_QUEUE_SIZE = 30; 
+    if (m_opusQueue.size() >= MAX_QUEUE_SIZE) {
+        int dropCount = 0;
+        while (m_opusQueue.size() >= MAX_QUEUE_SIZE - 12) {
+            m_opusQueue.dequeue();
+            if (!m_opusSeqQueue.isEmpty()) m_opusSeqQueue.dequeue();
+            dropCount++;
+        }
+        static int dropLogCount = 0;
+        if (++dropLogCount % 10 == 0) {
+        }
+    }
+
+    m_opusQueue.enqueue(opusData);
+    m_opusSeqQueue.enqueue(seq);
+    
+    if (!m_audioTimer->isActive()) {
+        int threshold = 7;
+        if (m_opusQueue.size() >= threshold) {
+            m_hasAudioStarted = true;
+            m_producerBuffering = true;
+            m_audioLastTimestamp = timestamp;
+            m_nextAudioTick = QDateTime::currentMSecsSinceEpoch();
+            m_audioTimer->start();
+        }
+    }
+}
+
+// 其他观看端的对讲音频（JSON viewer_audio_opus 与二进制 ViewerAudio 共用）
+void WebSocketReceiver::enqueuePeerOpus(const QString &fromId, const QByteArray &opusData, int channels, qint64 timestamp)
+{
+    if (!fromId.isEmpty()) {
+        QMutexLocker locker(&m_mutex);
+        if (fromId == m_lastViewerId) {
+            // Debug: Filtered own echo
+            static int echoFilterCount = 0;
+            if (++echoFilterCount % 100 == 0) {
+            }
+            return;
+        }
+    }
+    // Force 48kHz mixing for peers
+    int mixSampleRate = 48000;
+    int frameSamples = mixSampleRate / 50; // 960 samples
+
+    OpusDecoder* dec = m_peerDecoders.value(fromId, nullptr);
+    // Check if decoder exists and matches mix rate (not source rate)
+    if (!dec || m_peerSampleRates.value(fromId) != mixSampleRate || m_peerChannels.value(fromId) != channels) {
+        if (dec) { opus_decoder_destroy(dec); }
+        int err = OPUS_OK;
+        dec = opus_decoder_create(mixSampleRate, channels, &err);
+        if (err != OPUS_OK || !dec) {
+            return;
+        }
+        m_peerDecoders[fromId] = dec;
+        m_peerSampleRates[fromId] = mixSampleRate;
+        m_peerChannels[fromId] = channels;
+        m_peerBuffering[fromId] = true; // Initialize buffering state
+    }
+    m_peerFrameSamples[fromId] = frameSamples;
+    m_peerSilenceCounts[fromId] = 0;
+    m_peerLastActiveTimes[fromId] = QDateTime::currentMSecsSinceEpoch();
+    
+    // 延迟控制 (Peer)
+    const int MAX_PEER_QUEUE = 30;
+    QQueue<QByteArray>& q = m_peerQueues[fromId];
+    if (q.size() >= MAX_PEER_QUEUE) {
+        while (q.size() >= MAX_PEER_QUEUE - 12) {
+            q.dequeue();
+        }
+    }
+    
+    q.enqueue(opusData);
+    if (!m_audioTimer->isActive()) {
+        int threshold = 7;
+        bool ready = m_opusQueue.size() >= threshold;
+        if (!ready) {
+            for (auto it = m_peerQueues.begin(); it != m_peerQueues.end(); ++it) {
+                if (it.value().size() >= threshold) { ready = true; break; }
+            }
+        }
+        if (ready) { 
+            m_hasAudioStarted = true;
+            m_audioLastTimestamp = timestamp; 
+            m_nextAudioTick = QDateTime::currentMSecsSinceEpoch();
+            m_audioTimer->start(); 
+        }
+    }
+}
+
 void WebSocketReceiver::setSessionInfo(const QString &viewerId, const QString &targetId)
 {
     QMutexLocker locker(&m_mutex);
@@ -1811,18 +1981,13 @@ void WebSocketReceiver::sendViewerCursor(int x, int y)
     if (viewerId.isEmpty() || targetId.isEmpty()) {
         return;
     }
-    QJsonObject message;
-    message["type"] = "viewer_cursor";
-    message["viewer_id"] = viewerId;
-    message["target_id"] = targetId;
-    message["x"] = x;
-    message["y"] = y;
-    if (!m_lastViewerName.isEmpty()) {
-        message["viewer_name"] = m_lastViewerName;
-    }
-    message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-    QJsonDocument doc(message);
-    m_webSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
+    BinaryMessage::Cursor cursor;
+    cursor.x = x;
+    cursor.y = y;
+    cursor.frameSize = decodedFrameSize();
+    cursor.senderId = viewerId;
+    cursor.name = m_lastViewerName;
+    m_webSocket->sendBinaryMessage(BinaryMessage::encodeCursor(m_cursorSeq++, QDateTime::currentMSecsSinceEpoch(), cursor));
 }
 
 void WebSocketReceiver::sendAnnotationEvent(const QString &phase, int x, int y, int colorId)
@@ -1852,18 +2017,15 @@ void WebSocketReceiver::sendAnnotationEvent(const QString &phase, int x, int y,
         return;
     }
 
-    QJsonObject message;
-    message["type"] = "annotation_event";
-    message["phase"] = phase; // "down" / "move" / "up"
-    message["x"] = x;
-    message["y"] = y;
-    message["viewer_id"] = viewerId;
-    message["target_id"] = targetId;
-    message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-    message["color_id"] = colorId;
-
-    QJsonDocument doc(message);
-    QString jsonString = doc.toJson(QJsonDocument::Compact);
+    BinaryMessage::Annotation annotation;
+    annotation.phase = phase; // "down" / "move" / "up"
+    annotation.x = x;
+    annotation.y = y;
+    annotation.viewerId = viewerId;
+    annotation.targetId = targetId;
+    annotation.colorId = colorId;
+    annotation.frameSize = decodedFrameSize();
+    const QByteArray packet = BinaryMessage::encodeAnnotation(m_annotationSeq++, QDateTime::currentMSecsSinceEpoch(), annotation);
     // 降低日志噪音：不打印高频的 move 事件，仅统计；其他关键阶段简要打印
     static int moveEventCount = 0;
     if (phase == "move") {
@@ -1874,7 +2036,7 @@ void WebSocketReceiver::sendAnnotationEvent(const QString &phase, int x, int y,
                             << " viewer=" << viewerId << " target=" << targetId
                             << " ws=" << wsToUse->requestUrl().toString();
     }
-    wsToUse->sendTextMessage(jsonString);
+    wsToUse->sendBinaryMessage(packet);
 }
 
 void WebSocketReceiver::sendTextAnnotation(const QString &text, int x, int y, int colorId, int fontSize)
@@ -1912,6 +2074,7 @@ void WebSocketReceiver::sendTextAnnotation(const QString &text, int x, int y, in
     message["viewer_id"] = viewerId;
     message["target_id"] = targetId;
     message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+    appendFrameSize(message);
 
     QJsonDocument doc(message);
     wsToUse->sendTextMessage(doc.toJson(QJsonDocument::Compact));
@@ -2070,6 +2233,14 @@ void WebSocketReceiver::sendSetQuality(const QString &quality)
         normalized = "medium";
     }
 
+    // 先声明流选择：支持多路编码的推流端据此只为本观看端切换分辨率，不再重建编码器；
+    // 旧版推流端忽略 select_stream，仍按 set_quality 处理
+    {
+        QMutexLocker locker(&m_mutex);
+        m_qualityStream = (normalized == "low") ? 2 : (normalized == "medium") ? 1 : 0;
+    }
+    applyStreamSelection(true);
+
     QJsonObject message;
     message["type"] = "set_quality";
     message["quality"] = normalized;
@@ -2082,6 +2253,95 @@ void WebSocketReceiver::sendSetQuality(const QString &quality)
     m_webSocket->sendTextMessage(jsonString);
 }
 
+void WebSocketReceiver::sendSelectStream(int streamId)
+{
+    QWebSocket *wsToUse = nullptr;
+    QString viewerId;
+    QString targetId;
+    {
+        QMutexLocker locker(&m_mutex);
+        // 选流在转发视频的中继生效：LAN 直连时发往 LAN 中继
+        if (m_linkState == LinkState::LanActive && m_lanWebSocket && m_lanWebSocket->state() == QAbstractSocket::ConnectedState) {
+            wsToUse = m_lanWebSocket;
+        } else if (m_connected && m_webSocket) {
+            wsToUse = m_webSocket;
+        }
+        viewerId = m_lastViewerId;
+        targetId = m_lastTargetId;
+    }
+
+    if (!wsToUse) {
+        return;
+    }
+
+    QJsonObject message;
+    message["type"] = "select_stream";
+    message["stream"] = std::max(0, std::min(streamId, PacketHeader::kMaxSimulcastStreams - 1));
+    if (!viewerId.isEmpty()) message["viewer_id"] = viewerId;
+    if (!targetId.isEmpty()) message["target_id"] = targetId;
+    wsToUse->sendTextMessage(QJsonDocument(message).toJson(QJsonDocument::Compact));
+}
+
+void WebSocketReceiver::setViewportSize(const QSize &physicalSize)
+{
+    if (physicalSize.isEmpty()) {
+        return;
+    }
+    // 显示区域能容纳在 540p / 1080p 内时选择对应的低分辨率流（与方向无关）
+    const int longEdge = std::max(physicalSize.width(), physicalSize.height());
+    const int shortEdge = std::min(physicalSize.width(), physicalSize.height());
+    int stream = 0;
+    if (longEdge <= 960 && shortEdge <= 540) {
+        stream = 2;
+    } else if (longEdge <= 1920 && shortEdge <= 1080) {
+        stream = 1;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_viewportStream == stream) {
+            return;
+        }
+        m_viewportStream = stream;
+    }
+    applyStreamSelection(false);
+}
+
+void WebSocketReceiver::setDecodedFrameSize(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_decodedFrameSize = size;
+}
+
+void WebSocketReceiver::appendFrameSize(QJsonObject &message)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_decodedFrameSize.isEmpty()) {
+        return;
+    }
+    message["frame_w"] = m_decodedFrameSize.width();
+    message["frame_h"] = m_decodedFrameSize.height();
+}
+
+QSize WebSocketReceiver::decodedFrameSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_decodedFrameSize;
+}
+
+void WebSocketReceiver::applyStreamSelection(bool force)
+{
+    int stream = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        stream = std::max(m_qualityStream, m_viewportStream);
+        if (!force && stream == m_selectedStream) {
+            return;
+        }
+        m_selectedStream = stream;
+    }
+    sendSelectStream(stream);
+}
+
 void WebSocketReceiver::sendAudioToggle(bool enabled)
 {
     QString viewerId;
@@ -2281,17 +2541,7 @@ void WebSocketReceiver::setTalkEnabled(bool enabled)
                     // If not connected to a peer, maybe we shouldn't send? 
                     // But we keep sending to server for routing.
                     
-                    QJsonObject message;
-                    message["type"] = "viewer_audio_opus";
-                    message["sample_rate"] = m_localOpusSampleRate;
-                    message["channels"] = 1;
-                    message["frame_samples"] = m_localOpusFrameSize;
-                    message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-                    message["data_base64"] = QString::fromUtf8(opusOut.toBase64());
-                    message["viewer_id"] = viewerIdCopy;
-                    message["target_id"] = targetIdCopy;
-                    QJsonDocument doc(message);
-                    m_webSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
+                    sendViewerAudio(opusOut, viewerIdCopy);
                 }
             });
         }
@@ -2339,17 +2589,7 @@ void WebSocketReceiver::setTalkEnabled(bool enabled)
                             continue;
                         }
                         
-                        QJsonObject message;
-                        message["type"] = "viewer_audio_opus";
-                        message["sample_rate"] = m_localOpusSampleRate;
-                        message["channels"] = 1;
-                        message["frame_samples"] = m_localOpusFrameSize;
-                        message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-                        message["data_base64"] = QString::fromUtf8(opusOut.toBase64());
-                        message["viewer_id"] = viewerIdCopy;
-                        message["target_id"] = targetIdCopy;
-                        QJsonDocument doc(message);
-                        m_webSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
+                        sendViewerAudio(opusOut, viewerIdCopy);
                     }
                 });
             }
@@ -2453,24 +2693,12 @@ void WebSocketReceiver::recreateLocalAudioSource()
                         opusOut.resize(nbytes);
 
                         QString viewerIdCopy;
-                        QString targetIdCopy;
                         {
                             QMutexLocker locker(&m_mutex);
                             viewerIdCopy = m_lastViewerId;
-                            targetIdCopy = m_lastTargetId;
                         }
                         
-                        QJsonObject message;
-                        message["type"] = "viewer_audio_opus";
-                        message["sample_rate"] = m_localOpusSampleRate;
-                        message["channels"] = 1;
-                        message["frame_samples"] = m_localOpusFrameSize;
-                        message["timestamp"] = QDateTime::currentMSecsSinceEpoch();
-                        message["data_base64"] = QString::fromUtf8(opusOut.toBase64());
-                        if (!viewerIdCopy.isEmpty()) message["viewer_id"] = viewerIdCopy;
-                        if (!targetIdCopy.isEmpty()) message["target_id"] = targetIdCopy;
-                        QJsonDocument doc(message);
-                        m_webSocket->sendTextMessage(doc.toJson(QJsonDocument::Compact));
+                        sendViewerAudio(opusOut, viewerIdCopy);
                     }
                 });
             }
@@ -2478,6 +2706,20 @@ void WebSocketReceiver::recreateLocalAudioSource()
     }
 }
 
+void WebSocketReceiver::sendViewerAudio(const QByteArray &opus, const QString &viewerId)
+{
+    BinaryMessage::Audio audio;
+    audio.senderId = viewerId;
+    audio.sampleRate = m_localOpusSampleRate;
+    audio.channels = 1;
+    audio.frameSamples = m_localOpusFrameSize;
+    audio.opus = opus;
+    m_webSocket->sendBinaryMessage(BinaryMessage::encodeAudio(BinaryMessage::MessageType::ViewerAudio,
+                                                              m_viewerAudioSeq++,
+                                                              QDateTime::currentMSecsSinceEpoch(),
+                                                              audio));
+}
+
 void WebSocketReceiver::handleLocalAudioState(QAudio::State st)
 {
     if (!m_localAudioSource) return;
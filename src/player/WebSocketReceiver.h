@@ -12,6 +12,7 @@
 #include <QByteArray>
 #include <QRecursiveMutex>
 #include <QPoint>
+#include <QSize>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -21,6 +22,8 @@
 #include <QQueue>
 #include <opus/opus.h>
 
+#include "../common/PacketHeader.h"
+
 class WebSocketReceiver : public QObject
 {
     Q_OBJECT
@@ -49,7 +52,14 @@ public:
     // 按索引切换屏幕（不断流热切换，不修改配置）
     void sendSwitchScreenIndex(int index);
     // 发送质量设置（高/中/低）控制被观看者的编码质量
+    // 同时换算为流选择（低→540p，中→1080p，高/极致→原始分辨率），推流端支持多路编码时只影响本观看端
     void sendSetQuality(const QString &quality);
+    // 多路编码（simulcast）流选择：0 为原始分辨率，1 为 1080p，2 为 540p；中继按此只转发对应一路
+    void sendSelectStream(int streamId);
+    // 显示区域（物理像素）变化：小窗口/缩略图自动选择低分辨率流，与画质选择取较低者
+    void setViewportSize(const QSize &physicalSize);
+    // 当前解码画面尺寸：批注与光标坐标附带该尺寸，推流端据此换算到其编码尺寸
+    void setDecodedFrameSize(const QSize &size);
     // 发送音频测试开关（观看端控制被观看者是否发送测试音）
     void sendAudioToggle(bool enabled);
     void sendAudioGain(int percent);
@@ -140,6 +150,18 @@ private:
     void setupWebSocket();
     void startReconnectTimer();
     void stopReconnectTimer();
+    // 接收质量上报（receiver_report）：到达抖动、排队时延、估算丢包，供推流端自适应码率
+    void updateReceiverReportStats(qint64 captureTimestamp, qint64 arrivalMs, int bytes, bool baseLayer,
+                                   int streamId, quint16 baseSequence);
+    QJsonObject takeReceiverReport(qint64 nowMs);
+    // 按画质选择与显示区域计算期望的流，变化（或 force）时发送 select_stream
+    void applyStreamSelection(bool force);
+    // 批注/光标坐标附带当前解码画面尺寸（frame_w/frame_h）
+    void appendFrameSize(QJsonObject &message);
+    // 二进制光标/标注消息携带的参考帧尺寸
+    QSize decodedFrameSize();
+    // 版本 1 二进制非视频消息（音频、光标）分发
+    void handleBinaryControlMessage(const QByteArray &message, const PacketHeader::Info &info);
     
     QWebSocket *m_webSocket;
     QWebSocket *m_lanWebSocket = nullptr;
@@ -165,8 +187,6 @@ private:
     int m_lanOfferRetryCount = 0;
     qint64 m_lastLanOfferRequestAtMs = 0;
     bool m_lanSwitchStartStreamingSent = false;
-    QTimer *m_videoStartRetryTimer = nullptr;
-    int m_videoStartRetryCount = 0;
     bool m_hasAnyVideoFrame = false;
     qint64 m_lastVideoFrameAtMs = 0;
     qint64 m_lastVideoNudgeAtMs = 0;
@@ -185,6 +205,20 @@ private:
     qint64 m_lastStatsUpdateTime;         // 上次统计更新时间
     qint64 m_totalDowntimeStart;          // 断线开始时间
     
+    // 接收质量上报统计（时间戳为推流端时钟，时钟偏差在差值中抵消）
+    double m_reportJitterMs = 0.0;        // RFC 3550 到达抖动
+    qint64 m_reportLastTransit = 0;
+    qint64 m_reportLastCaptureTs = 0;
+    quint16 m_reportLastBaseSeq = 0;      // 上一个基础层帧的基础层序号（0 表示尚无基线）
+    int m_reportBaseStream = -1;          // 基础层序号所属的流ID（切换流后重新建立基线）
+    bool m_reportHasTransit = false;
+    QList<qint64> m_reportTransits;       // 最近传输时延（含时钟偏差），最小值作为排队时延基线
+    int m_reportReceived = 0;
+    int m_reportBaseReceived = 0;
+    int m_reportLost = 0;
+    qint64 m_reportBytes = 0;
+    qint64 m_lastReceiverReportMs = 0;
+    
     QRecursiveMutex m_mutex;
 
     // 最近一次观看请求信息，用于重连后自动重发
@@ -196,6 +230,12 @@ private:
     bool m_hasLastAudioToggle = false;
     bool m_lastAudioToggleEnabled = true;
 
+    // 多路编码流选择
+    int m_qualityStream = 0;              // 画质选择对应的流
+    int m_viewportStream = 0;             // 显示区域对应的流
+    int m_selectedStream = 0;             // 最近一次发送的选择
+    QSize m_decodedFrameSize;
+
     // 音频：Opus 解码器状态
     OpusDecoder *m_opusDecoder = nullptr;
     int m_opusSampleRate = 16000;
@@ -219,6 +259,9 @@ private:
     bool m_producerBuffering = true; // Added for jitter buffering
     int m_lastOpusSeq = -1;
     void initOpusDecoderIfNeeded(int sampleRate, int channels);
+    // 推流端音频/对讲音频入队（JSON 与二进制消息共用）
+    void enqueueProducerOpus(const QByteArray &opusData, int channels, qint64 timestamp, int seq);
+    void enqueuePeerOpus(const QString &fromId, const QByteArray &opusData, int channels, qint64 timestamp);
     QMap<QString, OpusDecoder*> m_peerDecoders;
     QMap<QString, QQueue<QByteArray>> m_peerQueues;
     QMap<QString, int> m_peerSampleRates;
@@ -246,6 +289,11 @@ private:
     void handleLocalAudioState(QAudio::State st);
     int bytesPerSample(QAudioFormat::SampleFormat f) const;
     bool produceOpusFrame(QByteArray &out);
+    void sendViewerAudio(const QByteArray &opus, const QString &viewerId);
+    // 二进制消息序号（按类型递增）
+    quint32 m_viewerAudioSeq = 0;
+    quint32 m_cursorSeq = 0;
+    quint32 m_annotationSeq = 0;
 
 };
 
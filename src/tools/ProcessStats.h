@@ -0,0 +1,112 @@
+#ifndef PROCESSSTATS_H
+#define PROCESSSTATS_H
+
+#include <QtGlobal>
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// 基准/压测工具共用：读取指定进程（可为本进程或被测服务器）的 CPU 时间与常驻内存。
+// 支持 Windows 与 Linux；其他平台或读取失败返回 -1。Linux 读取其他进程时 CPU 时间精度为时钟节拍
+// （通常 10 ms），适合秒级采样；本进程使用 CLOCK_PROCESS_CPUTIME_ID。
+namespace ProcessStats {
+
+#ifdef Q_OS_WIN
+namespace detail {
+// 本进程直接使用伪句柄，其他进程按需打开
+class ProcessHandle
+{
+public:
+    explicit ProcessHandle(qint64 pid)
+    {
+        if (static_cast<DWORD>(pid) == GetCurrentProcessId()) {
+            m_handle = GetCurrentProcess();
+        } else {
+            m_handle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, static_cast<DWORD>(pid));
+            m_owned = m_handle != nullptr;
+        }
+    }
+    ~ProcessHandle() { if (m_owned) CloseHandle(m_handle); }
+    HANDLE get() const { return m_handle; }
+
+private:
+    HANDLE m_handle = nullptr;
+    bool m_owned = false;
+};
+} // namespace detail
+#endif
+
+// 用户 + 内核 CPU 时间（微秒）
+inline qint64 cpuUs(qint64 pid)
+{
+#ifdef Q_OS_WIN
+    detail::ProcessHandle process(pid);
+    FILETIME creation, exitTime, kernel, user;
+    if (!process.get() || !GetProcessTimes(process.get(), &creation, &exitTime, &kernel, &user)) {
+        return -1;
+    }
+    const auto toUs = [](const FILETIME &t) {
+        return static_cast<qint64>((quint64(t.dwHighDateTime) << 32 | t.dwLowDateTime) / 10);
+    };
+    return toUs(kernel) + toUs(user);
+#elif defined(Q_OS_LINUX)
+    if (pid == getpid()) {
+        timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    // 进程名可能含空格，从最后一个 ')' 之后开始按空格切分：第 0 项为状态，utime/stime 为第 11、12 项
+    const QByteArray line = stat.readAll();
+    const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) {
+        return -1;
+    }
+    const qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();
+    return ticks * 1000000 / sysconf(_SC_CLK_TCK);
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
+
+// 常驻内存（字节）
+inline qint64 residentBytes(qint64 pid)
+{
+#ifdef Q_OS_WIN
+    detail::ProcessHandle process(pid);
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!process.get() || !GetProcessMemoryInfo(process.get(), &pmc, sizeof(pmc))) {
+        return -1;
+    }
+    return static_cast<qint64>(pmc.WorkingSetSize);
+#elif defined(Q_OS_LINUX)
+    QFile statm(QStringLiteral("/proc/%1/statm").arg(pid));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) : -1;
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
+
+} // namespace ProcessStats
+
+#endif // PROCESSSTATS_H
@@ -0,0 +1,522 @@
+// 自适应码率闭环仿真：AdaptiveBitrateController 与简化的发送链路/观看端模型按 10 ms 步长回放带宽轨迹，
+// 不依赖网络与编码器，结果可重复（随机数种子固定，可由 --seed 指定）。
+// 链路模型：
+//   - 编码：按决策的码率与采集间隔出帧，帧大小随机波动，每 8 秒一个关键帧（周期保活），时间层 0212
+//   - 发送：帧直接写入 socket 写缓冲（bytesToWrite），按轨迹带宽写出，经固定单向时延与抖动到达观看端
+//   - 观看端：与 WebSocketReceiver 相同的 receiver_report 规则，每 2 秒上报到达抖动、排队时延与基础层丢包
+//     （轨迹中的丢包率作用于基础层帧，模拟中继丢帧）
+// 内置场景逐一断言，失败时输出场景与原因，返回非 0：
+//   steady   带宽充足：保持码率上限与最高档位，不判拥塞
+//   step     带宽骤降到上限的一半：限定时间内码率回到带宽以内并清空积压，其后试探上调的超调、
+//            积压时长有界且利用率不过低
+//   recovery 带宽骤降到 30% 后恢复：骤降时同样限时收敛，恢复后限时回到码率上限与最高档位
+//   （骤降后的带宽不低于码率下限的 2 倍，低档预设下按下限抬高）
+//   loss     1% 随机丢包（低于拥塞阈值的平均水平）：码率不崩塌
+// 也可用 --trace 回放自定义轨迹（CSV 每行：起始秒,带宽kbps[,丢包%]），只输出时间线不做断言。
+//
+// 用法示例：
+//   AbrSimulation
+//   AbrSimulation --scenario recovery --max-kbps 3000 --verbose
+//   AbrSimulation --trace uplink.csv --seconds 300
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include "../capture/AdaptiveBitrateController.h"
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// 与 main_capture 相同的码率下限：预设上限的 15%，不低于 80 kbps
+int minBitrateFor(int maxBps)
+{
+    return std::max(80000, maxBps * 15 / 100);
+}
+
+// 轨迹分段：从 startS 秒起的链路带宽与基础层丢包率
+struct TracePoint {
+    double startS = 0.0;
+    double capacityKbps = 0.0;
+    double lossPct = 0.0;
+};
+
+// 每次 update 后的一条时间线记录
+struct Sample {
+    double t = 0.0;
+    int bitrate = 0;
+    int level = 0;
+    bool congested = false;
+    double capacityKbps = 0.0;
+    double backlogMs = 0.0;      // socket 写缓冲按当前带宽写完所需时间
+};
+
+class Simulation
+{
+public:
+    static constexpr qint64 kTickMs = 10;
+    static constexpr qint64 kOneWayDelayMs = 30;
+    static constexpr qint64 kKeyFrameIntervalMs = 8000;
+    static constexpr qint64 kReportIntervalMs = 2000;
+    static constexpr qint64 kUpdateIntervalMs = 1000;
+
+    Simulation(const QVector<TracePoint> &trace, int maxBps, quint32 seed)
+        : m_trace(trace), m_rng(seed)
+    {
+        m_abr.setBitrateRange(minBitrateFor(maxBps), maxBps);
+        m_abr.reset(0);
+        m_bitrate = m_abr.targetBitrate();
+        m_intervalMs = AdaptiveBitrateController::levelAt(0).intervalMs;
+    }
+
+    const QVector<Sample> &timeline() const { return m_timeline; }
+    int maxBitrate() const { return m_abr.maxBitrate(); }
+
+    void run(double seconds)
+    {
+        const qint64 endMs = static_cast<qint64>(seconds * 1000.0);
+        for (qint64 now = 0; now < endMs; now += kTickMs) {
+            const TracePoint &tp = traceAt(now);
+            encode(now);
+            drain(now, tp);
+            deliver(now, tp);
+            if (now > 0 && now % kReportIntervalMs == 0) {
+                report(now);
+            }
+            if (now > 0 && now % kUpdateIntervalMs == 0) {
+                update(now, tp);
+            }
+        }
+    }
+
+private:
+    struct InFlight {
+        qint64 remaining;
+        qint64 captureMs;
+        bool baseLayer;
+    };
+    struct Arrival {
+        qint64 arriveMs;
+        qint64 captureMs;
+        bool baseLayer;
+    };
+
+    const TracePoint &traceAt(qint64 nowMs) const
+    {
+        int i = 0;
+        while (i + 1 < m_trace.size() && m_trace[i + 1].startS * 1000.0 <= nowMs) {
+            ++i;
+        }
+        return m_trace[i];
+    }
+
+    // 按当前码率与采集间隔出帧：关键帧约为平均帧的 6 倍，增量帧在 0.6~1.4 倍之间波动
+    void encode(qint64 nowMs)
+    {
+        if (nowMs < m_nextFrameMs) {
+            return;
+        }
+        m_nextFrameMs = nowMs + m_intervalMs;
+        const double avgBytes = m_bitrate / 8.0 * m_intervalMs / 1000.0;
+        const bool keyFrame = nowMs - m_lastKeyFrameMs >= kKeyFrameIntervalMs || m_frameIndex == 0;
+        static const int kPattern[4] = {0, 2, 1, 2};
+        const int temporalId = keyFrame ? 0 : kPattern[m_frameIndex % 4];
+        if (keyFrame) {
+            m_lastKeyFrameMs = nowMs;
+            m_frameIndex = 0;
+        }
+        ++m_frameIndex;
+        const double bytes = keyFrame ? avgBytes * 6.0 : avgBytes * (0.6 + 0.8 * m_rng.generateDouble());
+        const qint64 size = std::max<qint64>(64, static_cast<qint64>(bytes));
+        m_socket.push_back({size, nowMs, temporalId == 0});
+        m_bytesToWrite += size;
+        m_bytesSent += size;
+    }
+
+    void drain(qint64 nowMs, const TracePoint &tp)
+    {
+        m_drainCredit += tp.capacityKbps * 1000.0 / 8.0 * kTickMs / 1000.0;
+        while (!m_socket.empty() && m_drainCredit >= 1.0) {
+            InFlight &f = m_socket.front();
+            const qint64 n = std::min<qint64>(f.remaining, static_cast<qint64>(m_drainCredit));
+            f.remaining -= n;
+            m_bytesToWrite -= n;
+            m_drainCredit -= n;
+            if (f.remaining == 0) {
+                const qint64 jitter = static_cast<qint64>(m_rng.bounded(6));
+                m_network.push_back({nowMs + kOneWayDelayMs + jitter, f.captureMs, f.baseLayer});
+                m_socket.pop_front();
+            }
+        }
+        if (m_socket.empty()) {
+            m_drainCredit = 0.0; // 链路空闲时不积累发送额度
+        }
+    }
+
+    // 观看端：与 WebSocketReceiver::updateReceiverReportStats 相同的抖动/排队时延/基础层丢包统计
+    void deliver(qint64 nowMs, const TracePoint &tp)
+    {
+        while (!m_network.empty() && m_network.front().arriveMs <= nowMs) {
+            const Arrival a = m_network.front();
+            m_network.pop_front();
+            if (a.baseLayer && m_rng.generateDouble() * 100.0 < tp.lossPct) {
+                ++m_reportLost;
+                continue;
+            }
+            const qint64 transit = a.arriveMs - a.captureMs;
+            if (m_hasTransit) {
+                const double d = std::abs(static_cast<double>(transit - m_lastTransit));
+                m_jitterMs += (d - m_jitterMs) / 16.0;
+            }
+            m_hasTransit = true;
+            m_lastTransit = transit;
+            ++m_reportReceived;
+            m_transits.push_back(transit);
+            if (m_transits.size() > 90) {
+                m_transits.pop_front();
+            }
+            if (a.baseLayer) {
+                ++m_reportBaseReceived;
+            }
+        }
+    }
+
+    void report(qint64 nowMs)
+    {
+        if (m_reportReceived == 0) {
+            m_reportBaseReceived = 0;
+            m_reportLost = 0;
+            return; // 本周期没有收到帧时不上报，控制器中上一条上报自然超时
+        }
+        const qint64 minTransit = *std::min_element(m_transits.begin(), m_transits.end());
+        const int total = m_reportBaseReceived + m_reportLost;
+        const double lossPct = total > 0 ? m_reportLost * 100.0 / total : 0.0;
+        m_abr.onReceiverReport(QStringLiteral("viewer"), m_jitterMs,
+                               lossPct, static_cast<double>(m_lastTransit - minTransit), nowMs);
+        m_reportReceived = 0;
+        m_reportBaseReceived = 0;
+        m_reportLost = 0;
+    }
+
+    void update(qint64 nowMs, const TracePoint &tp)
+    {
+        AdaptiveBitrateController::SenderSample s;
+        s.linkId = 0;
+        s.bytesToWrite = m_bytesToWrite;
+        s.bytesSent = m_bytesSent;
+        const AdaptiveBitrateController::Decision d = m_abr.update({s}, nowMs);
+        m_bitrate = d.bitrate;
+        m_intervalMs = d.captureIntervalMs;
+
+        Sample rec;
+        rec.t = nowMs / 1000.0;
+        rec.bitrate = d.bitrate;
+        rec.level = d.level;
+        rec.congested = d.congested;
+        rec.capacityKbps = tp.capacityKbps;
+        rec.backlogMs = tp.capacityKbps > 0 ? m_bytesToWrite * 8.0 / tp.capacityKbps : 0.0;
+        m_timeline.append(rec);
+    }
+
+    QVector<TracePoint> m_trace;
+    QRandomGenerator m_rng;
+    AdaptiveBitrateController m_abr;
+    int m_bitrate = 0;
+    int m_intervalMs = 66;
+
+    qint64 m_nextFrameMs = 0;
+    qint64 m_lastKeyFrameMs = 0;
+    int m_frameIndex = 0;
+
+    std::deque<InFlight> m_socket;
+    qint64 m_bytesToWrite = 0;
+    qint64 m_bytesSent = 0;
+    double m_drainCredit = 0.0;
+    std::deque<Arrival> m_network;
+
+    bool m_hasTransit = false;
+    qint64 m_lastTransit = 0;
+    double m_jitterMs = 0.0;
+    std::deque<qint64> m_transits;
+    int m_reportReceived = 0;
+    int m_reportBaseReceived = 0;
+    int m_reportLost = 0;
+
+    QVector<Sample> m_timeline;
+};
+
+void printTimeline(const QVector<Sample> &timeline)
+{
+    out() << "t_s,capacity_kbps,bitrate_kbps,level,congested,backlog_ms" << Qt::endl;
+    for (const Sample &s : timeline) {
+        out() << s.t << ',' << s.capacityKbps << ',' << s.bitrate / 1000 << ',' << s.level << ','
+              << (s.congested ? 1 : 0) << ',' << qRound(s.backlogMs) << Qt::endl;
+    }
+}
+
+// 区间 [from, to) 内的记录
+QVector<Sample> window(const QVector<Sample> &timeline, double from, double to)
+{
+    QVector<Sample> w;
+    for (const Sample &s : timeline) {
+        if (s.t >= from && s.t < to) {
+            w.append(s);
+        }
+    }
+    return w;
+}
+
+double meanBitrate(const QVector<Sample> &w)
+{
+    double sum = 0.0;
+    for (const Sample &s : w) {
+        sum += s.bitrate;
+    }
+    return w.isEmpty() ? 0.0 : sum / w.size();
+}
+
+double maxBacklogMs(const QVector<Sample> &w)
+{
+    double m = 0.0;
+    for (const Sample &s : w) {
+        m = std::max(m, s.backlogMs);
+    }
+    return m;
+}
+
+struct Checker {
+    int failures = 0;
+    QString scenario;
+
+    void expect(bool ok, const QString &what)
+    {
+        if (!ok) {
+            ++failures;
+            out() << "FAIL " << scenario << ": " << what << Qt::endl;
+        }
+    }
+};
+
+// [from, until) 内第一次满足条件的时间（秒，相对 from）；未满足返回 -1
+template <typename Pred>
+double firstTime(const QVector<Sample> &timeline, double from, double until, Pred pred)
+{
+    for (const Sample &s : timeline) {
+        if (s.t >= from && s.t < until && pred(s)) {
+            return s.t - from;
+        }
+    }
+    return -1.0;
+}
+
+// 从 from 秒起第一次满足条件并保持到 until 秒的时间（秒，相对 from）；未满足返回 -1
+template <typename Pred>
+double settleTime(const QVector<Sample> &timeline, double from, double until, Pred pred)
+{
+    double settledAt = -1.0;
+    for (const Sample &s : timeline) {
+        if (s.t < from || s.t >= until) {
+            continue;
+        }
+        if (pred(s)) {
+            if (settledAt < 0) {
+                settledAt = s.t;
+            }
+        } else {
+            settledAt = -1.0;
+        }
+    }
+    return settledAt < 0 ? -1.0 : settledAt - from;
+}
+
+// 带宽骤降后的两个时间点（秒，相对骤降时刻）：码率降到带宽以内（反应），以及写缓冲积压清空（收敛）
+void dropTimes(const QVector<Sample> &timeline, double dropS, double untilS, double capacityBps,
+               double &reactS, double &drainS)
+{
+    reactS = firstTime(timeline, dropS, untilS, [capacityBps](const Sample &s) {
+        return s.bitrate <= capacityBps;
+    });
+    drainS = firstTime(timeline, dropS, untilS, [capacityBps](const Sample &s) {
+        return s.bitrate <= capacityBps && s.backlogMs < 200.0;
+    });
+}
+
+void runScenario(const QString &name, int maxBps, quint32 seed, bool verbose, Checker &checker)
+{
+    checker.scenario = name;
+    const double maxKbps = maxBps / 1000.0;
+    // 骤降后的带宽至少为下限码率的 2 倍，否则控制器停在下限处也要很久才能排空积压
+    const double floorKbps = minBitrateFor(maxBps) / 1000.0 * 2.0;
+    const double stepKbps = std::max(maxKbps * 0.5, floorKbps);
+    const double dipKbps = std::max(maxKbps * 0.3, floorKbps);
+    QVector<TracePoint> trace;
+    double seconds = 60.0;
+
+    if (name == QLatin1String("steady")) {
+        trace = { {0, maxKbps * 2.0, 0.0} };
+    } else if (name == QLatin1String("step")) {
+        trace = { {0, maxKbps * 1.5, 0.0}, {30, stepKbps, 0.0} };
+        seconds = 90.0;
+    } else if (name == QLatin1String("recovery")) {
+        trace = { {0, maxKbps * 1.5, 0.0}, {20, dipKbps, 0.0}, {60, maxKbps * 1.5, 0.0} };
+        seconds = 130.0;
+    } else {
+        trace = { {0, maxKbps * 2.0, 1.0} };
+        seconds = 120.0;
+    }
+
+    Simulation sim(trace, maxBps, seed);
+    sim.run(seconds);
+    const QVector<Sample> &tl = sim.timeline();
+    if (verbose) {
+        printTimeline(tl);
+    }
+
+    if (name == QLatin1String("steady")) {
+        const QVector<Sample> w = window(tl, 5, seconds);
+        bool anyCongested = false;
+        bool allAtMax = true;
+        for (const Sample &s : w) {
+            anyCongested = anyCongested || s.congested;
+            allAtMax = allAtMax && s.bitrate == maxBps && s.level == 0;
+        }
+        checker.expect(!anyCongested, QStringLiteral("congestion reported on an uncongested link"));
+        checker.expect(allAtMax, QStringLiteral("did not hold max bitrate / level 0"));
+        out() << "steady: mean " << qRound(meanBitrate(w) / 1000) << " kbps, max backlog "
+              << qRound(maxBacklogMs(w)) << " ms" << Qt::endl;
+    } else if (name == QLatin1String("step")) {
+        // 收敛后 AIMD 仍会周期性试探上调，只要求超调与积压有界、利用率不过低
+        const double capacityBps = stepKbps * 1000.0;
+        double react = -1.0;
+        double drain = -1.0;
+        dropTimes(tl, 30, seconds, capacityBps, react, drain);
+        const QVector<Sample> w = window(tl, drain < 0 ? seconds : 30 + drain, seconds);
+        double peak = 0.0;
+        for (const Sample &s : w) {
+            peak = std::max(peak, static_cast<double>(s.bitrate));
+        }
+        const double utilisation = meanBitrate(w) / capacityBps;
+        const double backlog = maxBacklogMs(w);
+        out() << "step: react " << react << " s, drained " << drain << " s, utilisation "
+              << qRound(utilisation * 100) << "%, peak " << qRound(peak / capacityBps * 100)
+              << "% of capacity, max backlog " << qRound(backlog) << " ms" << Qt::endl;
+        checker.expect(react >= 0 && react <= 5.0, QStringLiteral("bitrate not below capacity within 5 s of the drop"));
+        checker.expect(drain >= 0 && drain <= 20.0, QStringLiteral("backlog not drained within 20 s of the drop"));
+        checker.expect(utilisation >= 0.5, QStringLiteral("utilisation below 50% after converging"));
+        checker.expect(peak <= capacityBps * 1.6, QStringLiteral("probing overshoot above 160% of capacity"));
+        checker.expect(backlog < 2000.0, QStringLiteral("send backlog above 2 s after converging"));
+    } else if (name == QLatin1String("recovery")) {
+        double react = -1.0;
+        double drain = -1.0;
+        dropTimes(tl, 20, 60, dipKbps * 1000.0, react, drain);
+        const double up = settleTime(tl, 60, seconds, [maxBps](const Sample &s) {
+            return s.bitrate >= maxBps * 0.95 && s.level == 0;
+        });
+        out() << "recovery: react " << react << " s, drained " << drain << " s, back to max in "
+              << up << " s" << Qt::endl;
+        checker.expect(react >= 0 && react <= 5.0, QStringLiteral("bitrate not below capacity within 5 s of the drop"));
+        checker.expect(drain >= 0 && drain <= 20.0, QStringLiteral("backlog not drained within 20 s of the drop"));
+        checker.expect(up >= 0 && up <= 45.0, QStringLiteral("did not recover to max bitrate and level 0 within 45 s"));
+    } else {
+        const QVector<Sample> w = window(tl, 30, seconds);
+        const double ratio = meanBitrate(w) / maxBps;
+        out() << "loss: mean " << qRound(ratio * 100) << "% of max under 1% base-layer loss" << Qt::endl;
+        checker.expect(ratio >= 0.6, QStringLiteral("mean bitrate below 60% of max under sub-threshold loss"));
+    }
+}
+
+bool loadTrace(const QString &path, QVector<TracePoint> &trace)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        const QStringList parts = line.split(QLatin1Char(','));
+        bool okT = false;
+        bool okC = false;
+        TracePoint tp;
+        tp.startS = parts.value(0).toDouble(&okT);
+        tp.capacityKbps = parts.value(1).toDouble(&okC);
+        tp.lossPct = parts.value(2).toDouble();
+        if (okT && okC) {
+            trace.append(tp);
+        }
+    }
+    std::sort(trace.begin(), trace.end(), [](const TracePoint &a, const TracePoint &b) { return a.startS < b.startS; });
+    return !trace.isEmpty();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("AbrSimulation"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Closed-loop trace replay for AdaptiveBitrateController"));
+    parser.addHelpOption();
+    QCommandLineOption scenarioOpt(QStringList() << "scenario", QStringLiteral("steady | step | recovery | loss | all (default all)"), QStringLiteral("name"), QStringLiteral("all"));
+    QCommandLineOption maxKbpsOpt(QStringList() << "max-kbps", QStringLiteral("Bitrate ceiling in kbps (default 400, the medium preset)"), QStringLiteral("kbps"), QStringLiteral("400"));
+    QCommandLineOption traceOpt(QStringList() << "trace", QStringLiteral("Replay a CSV trace (start_s,capacity_kbps[,loss_pct]) without assertions"), QStringLiteral("file"));
+    QCommandLineOption secondsOpt(QStringList() << "seconds", QStringLiteral("Duration for --trace (default 120)"), QStringLiteral("seconds"), QStringLiteral("120"));
+    QCommandLineOption seedOpt(QStringList() << "seed", QStringLiteral("Random seed (default 1)"), QStringLiteral("seed"), QStringLiteral("1"));
+    QCommandLineOption verboseOpt(QStringList() << "verbose", QStringLiteral("Print the per-second timeline as CSV"));
+    parser.addOption(scenarioOpt);
+    parser.addOption(maxKbpsOpt);
+    parser.addOption(traceOpt);
+    parser.addOption(secondsOpt);
+    parser.addOption(seedOpt);
+    parser.addOption(verboseOpt);
+    parser.process(app);
+
+    const int maxBps = std::max(100, parser.value(maxKbpsOpt).toInt()) * 1000;
+    const quint32 seed = parser.value(seedOpt).toUInt();
+
+    if (parser.isSet(traceOpt)) {
+        QVector<TracePoint> trace;
+        if (!loadTrace(parser.value(traceOpt), trace)) {
+            out() << "cannot read trace " << parser.value(traceOpt) << Qt::endl;
+            return 2;
+        }
+        Simulation sim(trace, maxBps, seed);
+        sim.run(std::max(1.0, parser.value(secondsOpt).toDouble()));
+        printTimeline(sim.timeline());
+        return 0;
+    }
+
+    QStringList scenarios = { QStringLiteral("steady"), QStringLiteral("step"), QStringLiteral("recovery"), QStringLiteral("loss") };
+    const QString chosen = parser.value(scenarioOpt);
+    if (chosen != QLatin1String("all")) {
+        if (!scenarios.contains(chosen)) {
+            out() << "unknown scenario " << chosen << Qt::endl;
+            return 2;
+        }
+        scenarios = { chosen };
+    }
+
+    Checker checker;
+    for (const QString &name : scenarios) {
+        runScenario(name, maxBps, seed, parser.isSet(verboseOpt), checker);
+    }
+    out() << "scenarios=" << scenarios.size() << " max_kbps=" << maxBps / 1000 << " seed=" << seed
+          << " failures=" << checker.failures << Qt::endl;
+    return checker.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+// 二进制消息编解码自检：版本 1 头部（PacketHeader.h）与各类负载（BinaryMessage.h）
+// 1. 往返：随机字段编码后解码，逐字段比较，并确认中继只读头部得到的类型/序号/流ID/时间层正确
+// 2. 变异：对合法消息做截断、翻转字节、改写长度字段、拼接随机数据，解码必须不崩溃、不越界，
+//    失败时只返回 false；旧格式 8 字节视频包与随机数据也走同一路径
+// 随机数种子固定（可由 --seed 指定），失败时输出用例编号与十六进制内容，返回非 0。
+// 建议配合 -fsanitize=address,undefined 构建运行。
+//
+// 用法示例：
+//   BinaryMessageFuzz --iterations 200000
+//   BinaryMessageFuzz --seed 42 --iterations 1000000
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+#include "../common/PacketHeader.h"
+#include "../common/BinaryMessage.h"
+
+namespace {
+
+using PacketHeader::MessageType;
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+struct Fuzzer {
+    QRandomGenerator rng;
+    quint64 cases = 0;
+    quint64 failures = 0;
+    quint64 decodedOk = 0;
+
+    explicit Fuzzer(quint32 seed) : rng(seed) {}
+
+    int range(int lo, int hi) { return lo + static_cast<int>(rng.bounded(quint32(hi - lo + 1))); }
+
+    QString randomString(int maxLen)
+    {
+        // 混入多字节 UTF-8 字符，覆盖 255 字节截断
+        static const QString alphabet = QStringLiteral("abcXYZ0189_-观看端推流");
+        QString s;
+        const int n = range(0, maxLen);
+        for (int i = 0; i < n; ++i) {
+            s.append(alphabet.at(range(0, alphabet.size() - 1)));
+        }
+        return s;
+    }
+
+    QByteArray randomBytes(int maxLen)
+    {
+        QByteArray b(range(0, maxLen), Qt::Uninitialized);
+        for (char &c : b) {
+            c = static_cast<char>(rng.bounded(256));
+        }
+        return b;
+    }
+
+    QSize randomSize()
+    {
+        return range(0, 3) == 0 ? QSize() : QSize(range(1, 7680), range(1, 4320));
+    }
+
+    void fail(const char *what, const QByteArray &message)
+    {
+        ++failures;
+        if (failures <= 20) {
+            out() << "FAIL case " << cases << ": " << what << " bytes=" << message.size()
+                  << " hex=" << message.left(64).toHex() << Qt::endl;
+        }
+    }
+
+    // 头部字段（中继依赖的部分）
+    void checkHeader(const QByteArray &msg, MessageType type, quint32 seq, qint64 ts)
+    {
+        const PacketHeader::Info info = PacketHeader::read(msg);
+        if (!BinaryMessage::isMessage(info) || info.type != type || info.sequence != seq
+            || info.timestampMs != (ts & qint64(PacketHeader::kTimestampMask))) {
+            fail("header round-trip", msg);
+        }
+    }
+
+    // UTF-8 截断可能切开多字节字符：比较截断后的期望值
+    static QString clipped(const QString &s)
+    {
+        QByteArray utf8 = s.toUtf8();
+        if (utf8.size() > 255) {
+            utf8.truncate(255);
+        }
+        return QString::fromUtf8(utf8);
+    }
+
+    static QSize expectedSize(const QSize &s)
+    {
+        return s.isValid() && s.width() > 0 && s.height() > 0 ? s : QSize();
+    }
+
+    void roundTrip()
+    {
+        ++cases;
+        const quint32 seq = rng.generate();
+        const qint64 ts = static_cast<qint64>(rng.generate64() & PacketHeader::kTimestampMask);
+        switch (range(0, 4)) {
+        case 0: {
+            BinaryMessage::Audio a;
+            a.senderId = randomString(300);
+            a.sampleRate = range(1, 384000);
+            a.channels = range(1, 2);
+            a.frameSamples = range(0, 5760);
+            a.opus = randomBytes(1500);
+            const MessageType type = range(0, 1) ? MessageType::Audio : MessageType::ViewerAudio;
+            const QByteArray msg = BinaryMessage::encodeAudio(type, seq, ts, a);
+            checkHeader(msg, type, seq, ts);
+            BinaryMessage::Audio d;
+            if (!BinaryMessage::decodeAudio(msg, PacketHeader::read(msg), d)
+                || d.senderId != clipped(a.senderId) || d.sampleRate != a.sampleRate
+                || d.channels != a.channels || d.frameSamples != a.frameSamples || d.opus != a.opus) {
+                fail("audio round-trip", msg);
+            }
+            break;
+        }
+        case 1: {
+            BinaryMessage::Cursor c;
+            c.x = static_cast<int>(rng.generate());
+            c.y = static_cast<int>(rng.generate());
+            c.frameSize = randomSize();
+            c.senderId = randomString(40);
+            c.name = randomString(300);
+            const QByteArray msg = BinaryMessage::encodeCursor(seq, ts, c);
+            checkHeader(msg, MessageType::Cursor, seq, ts);
+            BinaryMessage::Cursor d;
+            if (!BinaryMessage::decodeCursor(msg, PacketHeader::read(msg), d)
+                || d.x != c.x || d.y != c.y || d.frameSize != expectedSize(c.frameSize)
+                || d.senderId != clipped(c.senderId) || d.name != clipped(c.name)) {
+                fail("cursor round-trip", msg);
+            }
+            break;
+        }
+        case 2: {
+            BinaryMessage::Annotation a;
+            a.x = range(-10000, 10000);
+            a.y = range(-10000, 10000);
+            a.frameSize = randomSize();
+            a.colorId = range(0, 255);
+            static const char *phases[] = {"down", "move", "up", "erase_move", "undo", "clear"};
+            a.phase = QString::fromLatin1(phases[range(0, 5)]);
+            a.viewerId = randomString(40);
+            a.targetId = randomString(40);
+            const QByteArray msg = BinaryMessage::encodeAnnotation(seq, ts, a);
+            checkHeader(msg, MessageType::Annotation, seq, ts);
+            BinaryMessage::Annotation d;
+            if (!BinaryMessage::decodeAnnotation(msg, PacketHeader::read(msg), d)
+                || d.x != a.x || d.y != a.y || d.frameSize != expectedSize(a.frameSize)
+                || d.colorId != a.colorId || d.phase != a.phase
+                || d.viewerId != clipped(a.viewerId) || d.targetId != clipped(a.targetId)) {
+                fail("annotation round-trip", msg);
+            }
+            break;
+        }
+        case 3: {
+            const QByteArray jpeg = randomBytes(4096);
+            const QByteArray msg = BinaryMessage::encodeImage(seq, ts, jpeg);
+            checkHeader(msg, MessageType::Image, seq, ts);
+            if (BinaryMessage::payload(msg, PacketHeader::read(msg)) != jpeg) {
+                fail("image round-trip", msg);
+            }
+            break;
+        }
+        default: {
+            // 视频：头部携带流ID/时间层/关键帧，与 PacketBufferPool 写法一致
+            const int sid = range(0, PacketHeader::kMaxSimulcastStreams - 1);
+            const int tid = range(0, PacketHeader::kMaxTemporalLayers - 1);
+            const bool key = range(0, 1) != 0;
+            const quint16 baseSeq = static_cast<quint16>(range(0, 65535));
+            const QByteArray payload = randomBytes(2048);
+            QByteArray msg(PacketHeader::kMessageHeaderSize + payload.size(), Qt::Uninitialized);
+            PacketHeader::writeMessage(msg.data(), MessageType::Video, seq, ts, sid, tid, key, baseSeq);
+            memcpy(msg.data() + PacketHeader::kMessageHeaderSize, payload.constData(), payload.size());
+            const PacketHeader::Info info = PacketHeader::read(msg);
+            checkHeader(msg, MessageType::Video, seq, ts);
+            if (!info.tagged || info.streamId != sid || info.temporalId != tid || info.keyFrame != key
+                || info.baseSequence != baseSeq || BinaryMessage::payload(msg, info) != payload) {
+                fail("video header round-trip", msg);
+            }
+            break;
+        }
+        }
+    }
+
+    QByteArray validMessage()
+    {
+        const quint32 seq = rng.generate();
+        const qint64 ts = QDateTime::currentMSecsSinceEpoch();
+        switch (range(0, 3)) {
+        case 0: {
+            BinaryMessage::Audio a;
+            a.senderId = randomString(20);
+            a.sampleRate = 48000;
+            a.opus = randomBytes(200);
+            return BinaryMessage::encodeAudio(MessageType::ViewerAudio, seq, ts, a);
+        }
+        case 1: {
+            BinaryMessage::Cursor c;
+            c.name = randomString(20);
+            return BinaryMessage::encodeCursor(seq, ts, c);
+        }
+        case 2: {
+            BinaryMessage::Annotation a;
+            a.phase = QStringLiteral("move");
+            a.viewerId = randomString(20);
+            return BinaryMessage::encodeAnnotation(seq, ts, a);
+        }
+        default: {
+            // 旧格式 8 字节视频包
+            QByteArray legacy(PacketHeader::kSize + range(0, 64), '\0');
+            PacketHeader::write(legacy.data(), ts, range(0, 2), range(0, 1) != 0, range(0, 2));
+            return legacy;
+        }
+        }
+    }
+
+    QByteArray mutate(QByteArray msg)
+    {
+        const int ops = range(1, 4);
+        for (int i = 0; i < ops; ++i) {
+            switch (range(0, 5)) {
+            case 0:
+                msg.truncate(range(0, msg.size()));
+                break;
+            case 1:
+                if (!msg.isEmpty()) {
+                    msg[range(0, msg.size() - 1)] = static_cast<char>(rng.bounded(256));
+                }
+                break;
+            case 2:
+                // 改写头部之后的长度/字符串长度字段，制造越界长度
+                if (msg.size() > PacketHeader::kMessageHeaderSize) {
+                    msg[range(PacketHeader::kMessageHeaderSize, msg.size() - 1)] = static_cast<char>(0xFF);
+                }
+                break;
+            case 3:
+                msg.append(randomBytes(32));
+                break;
+            case 4:
+                // 改写版本号/类型
+                if (msg.size() >= PacketHeader::kMessageHeaderSize) {
+                    msg[range(8, 9)] = static_cast<char>(rng.bounded(256));
+                }
+                break;
+            default:
+                msg = randomBytes(64);
+                break;
+            }
+        }
+        return msg;
+    }
+
+    void mutation()
+    {
+        ++cases;
+        const QByteArray msg = mutate(validMessage());
+        const PacketHeader::Info info = PacketHeader::read(msg);
+        if (info.headerSize < 0 || info.headerSize > msg.size()) {
+            fail("header size out of range", msg);
+            return;
+        }
+        // 所有解码器对任意类型都要安全返回（类型不符时 false）
+        BinaryMessage::Audio audio;
+        BinaryMessage::Cursor cursor;
+        BinaryMessage::Annotation annotation;
+        int ok = 0;
+        ok += BinaryMessage::decodeAudio(msg, info, audio) ? 1 : 0;
+        ok += BinaryMessage::decodeCursor(msg, info, cursor) ? 1 : 0;
+        ok += BinaryMessage::decodeAnnotation(msg, info, annotation) ? 1 : 0;
+        if (ok > 1) {
+            fail("decoded as more than one type", msg);
+        }
+        if (ok > 0 && !BinaryMessage::isMessage(info)) {
+            fail("decoded a non-v1 message", msg);
+        }
+        if (audio.opus.size() > msg.size() || cursor.name.size() > 255 || annotation.phase.size() > 255) {
+            fail("decoded field larger than message", msg);
+        }
+        decodedOk += ok;
+        BinaryMessage::payload(msg, info);
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("BinaryMessageFuzz"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Round-trip and mutation fuzz for the versioned binary message format"));
+    parser.addHelpOption();
+    QCommandLineOption iterationsOpt(QStringList() << "n" << "iterations", QStringLiteral("Cases per phase (default 100000)"), QStringLiteral("count"), QStringLiteral("100000"));
+    QCommandLineOption seedOpt(QStringList() << "seed", QStringLiteral("Random seed (default 1)"), QStringLiteral("seed"), QStringLiteral("1"));
+    parser.addOption(iterationsOpt);
+    parser.addOption(seedOpt);
+    parser.process(app);
+
+    const quint64 iterations = qMax<qulonglong>(1, parser.value(iterationsOpt).toULongLong());
+    const quint32 seed = parser.value(seedOpt).toUInt();
+
+    Fuzzer fuzzer(seed);
+    QElapsedTimer timer;
+    timer.start();
+    for (quint64 i = 0; i < iterations; ++i) {
+        fuzzer.roundTrip();
+    }
+    const quint64 roundTripFailures = fuzzer.failures;
+    for (quint64 i = 0; i < iterations; ++i) {
+        fuzzer.mutation();
+    }
+
+    out() << "seed=" << seed << " cases=" << fuzzer.cases
+          << " round_trip_failures=" << roundTripFailures
+          << " mutation_failures=" << (fuzzer.failures - roundTripFailures)
+          << " mutated_decoded_ok=" << fuzzer.decodedOk
+          << " elapsed_ms=" << timer.elapsed() << Qt::endl;
+    return fuzzer.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+// 色彩转换自检：ColorConvert（单次遍历 BGRA -> I420，含色度增益）
+// 1. SIMD 与标量：同一输入分别走 argbToI420 与 argbToI420Scalar，输出必须逐字节一致，
+//    覆盖奇数宽高、非 16 对齐宽度与带行填充的 stride，BT.601 / BT.709 与多组色度增益
+// 2. 与旧流程对比：libyuv::ARGBToI420 + 逐样本色度校正（U*0.95、V*1.05，截断取整），
+//    逐平面计算 PSNR，低于 --min-psnr 视为回归
+// 测试图像为确定性合成画面（渐变、色块与细线文字、随机噪声、彩条），失败时输出用例与平面，返回非 0。
+//
+// 用法示例：
+//   ColorConvertCheck
+//   ColorConvertCheck --min-psnr 48 --seed 7
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <libyuv.h>
+#include "../capture/ColorConvert.h"
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    std::vector<uint8_t> bgra;
+
+    Image(int w, int h, int padding = 0)
+        : width(w), height(h), stride(w * 4 + padding), bgra(static_cast<size_t>(stride) * h, 0xCD) {}
+
+    void set(int x, int y, int r, int g, int b)
+    {
+        uint8_t *p = bgra.data() + static_cast<size_t>(y) * stride + x * 4;
+        p[0] = static_cast<uint8_t>(b);
+        p[1] = static_cast<uint8_t>(g);
+        p[2] = static_cast<uint8_t>(r);
+        p[3] = 0xFF;
+    }
+};
+
+struct I420 {
+    int width = 0;
+    int height = 0;
+    int chromaWidth = 0;
+    int chromaHeight = 0;
+    std::vector<uint8_t> y, u, v;
+
+    I420(int w, int h)
+        : width(w), height(h), chromaWidth((w + 1) / 2), chromaHeight((h + 1) / 2),
+          y(static_cast<size_t>(w) * h), u(static_cast<size_t>(chromaWidth) * chromaHeight),
+          v(static_cast<size_t>(chromaWidth) * chromaHeight) {}
+};
+
+enum class Pattern { Gradient, Desktop, Noise, ColorBars };
+
+const char *patternName(Pattern p)
+{
+    switch (p) {
+    case Pattern::Gradient: return "gradient";
+    case Pattern::Desktop: return "desktop";
+    case Pattern::Noise: return "noise";
+    case Pattern::ColorBars: return "colorbars";
+    }
+    return "?";
+}
+
+void fillImage(Image &img, Pattern pattern, QRandomGenerator &rng)
+{
+    const int w = img.width;
+    const int h = img.height;
+    switch (pattern) {
+    case Pattern::Gradient:
+        // 水平 R、垂直 G、对角 B，遍历整个色立方体的一个切面
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                img.set(x, y, x * 255 / std::max(1, w - 1), y * 255 / std::max(1, h - 1),
+                        ((x + y) * 255 / std::max(1, w + h - 2)));
+            }
+        }
+        break;
+    case Pattern::Desktop: {
+        // 桌面类画面：浅色背景、饱和色窗口块、1 像素细线与点阵“文字”（色度边缘最难）
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                img.set(x, y, 240, 240, 244);
+            }
+        }
+        static const int kColors[][3] = { {0, 120, 215}, {232, 17, 35}, {16, 124, 16}, {255, 185, 0}, {30, 30, 30} };
+        for (int i = 0; i < 12; ++i) {
+            const int *c = kColors[rng.bounded(5)];
+            const int x0 = static_cast<int>(rng.bounded(quint32(w)));
+            const int y0 = static_cast<int>(rng.bounded(quint32(h)));
+            const int bw = 1 + static_cast<int>(rng.bounded(quint32(std::max(1, w / 3))));
+            const int bh = 1 + static_cast<int>(rng.bounded(quint32(std::max(1, h / 3))));
+            for (int y = y0; y < std::min(h, y0 + bh); ++y) {
+                for (int x = x0; x < std::min(w, x0 + bw); ++x) {
+                    img.set(x, y, c[0], c[1], c[2]);
+                }
+            }
+        }
+        for (int y = 2; y + 1 < h; y += 9) {
+            for (int x = 0; x < w; ++x) {
+                if (((x * 7 + y) % 11) < 4) {
+                    img.set(x, y, 0, 0, 0);
+                    img.set(x, y + 1, (x & 1) ? 0 : 200, 0, (x & 1) ? 200 : 0);
+                }
+            }
+        }
+        break;
+    }
+    case Pattern::Noise:
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const quint32 r = rng.generate();
+                img.set(x, y, r & 0xFF, (r >> 8) & 0xFF, (r >> 16) & 0xFF);
+            }
+        }
+        break;
+    case Pattern::ColorBars: {
+        static const int kBars[][3] = { {255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0},
+                                        {255, 0, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0} };
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const int *c = kBars[x * 8 / w];
+                img.set(x, y, c[0], c[1], c[2]);
+            }
+        }
+        break;
+    }
+    }
+}
+
+// 旧流程（9329af2 之前的采集端）：libyuv 转换后对每个色度样本做增益校正
+void convertLegacy(const Image &img, I420 &dst, double uGain, double vGain)
+{
+    libyuv::ARGBToI420(img.bgra.data(), img.stride,
+                       dst.y.data(), dst.width,
+                       dst.u.data(), dst.chromaWidth,
+                       dst.v.data(), dst.chromaWidth,
+                       dst.width, dst.height);
+    const size_t samples = dst.u.size();
+    for (size_t i = 0; i < samples; ++i) {
+        int u = dst.u[i] - 128;
+        int v = dst.v[i] - 128;
+        u = u * uGain;
+        v = v * vGain;
+        dst.u[i] = static_cast<uint8_t>(std::max(0, std::min(255, u + 128)));
+        dst.v[i] = static_cast<uint8_t>(std::max(0, std::min(255, v + 128)));
+    }
+}
+
+bool convertNew(const Image &img, I420 &dst, const ColorConvert::Coefficients &coeffs, bool scalar)
+{
+    auto fn = scalar ? &ColorConvert::argbToI420Scalar : &ColorConvert::argbToI420;
+    return fn(img.bgra.data(), img.stride,
+              dst.y.data(), dst.width,
+              dst.u.data(), dst.chromaWidth,
+              dst.v.data(), dst.chromaWidth,
+              dst.width, dst.height, coeffs);
+}
+
+double psnr(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, int *maxDiff)
+{
+    double sse = 0.0;
+    int worst = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const int d = int(a[i]) - int(b[i]);
+        sse += double(d) * d;
+        worst = std::max(worst, std::abs(d));
+    }
+    *maxDiff = worst;
+    if (sse == 0.0) {
+        return 99.0;
+    }
+    const double mse = sse / double(a.size());
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+struct Checker {
+    QRandomGenerator rng;
+    double minPsnr = 45.0;
+    int cases = 0;
+    int failures = 0;
+
+    explicit Checker(quint32 seed) : rng(seed) {}
+
+    void fail(const QString &what)
+    {
+        ++failures;
+        out() << "FAIL " << what << Qt::endl;
+    }
+
+    // SIMD 路径与标量路径必须逐字节一致
+    void checkSimdMatchesScalar(int w, int h, int padding, Pattern pattern,
+                                ColorConvert::Matrix matrix, double uGain, double vGain)
+    {
+        ++cases;
+        Image img(w, h, padding);
+        fillImage(img, pattern, rng);
+        const ColorConvert::Coefficients coeffs = ColorConvert::makeCoefficients(matrix, uGain, vGain);
+        I420 simd(w, h);
+        I420 scalar(w, h);
+        if (!convertNew(img, simd, coeffs, false) || !convertNew(img, scalar, coeffs, true)) {
+            fail(QStringLiteral("simd/scalar %1x%2 %3: conversion rejected input").arg(w).arg(h).arg(QLatin1String(patternName(pattern))));
+            return;
+        }
+        const char *plane = nullptr;
+        if (simd.y != scalar.y) {
+            plane = "Y";
+        } else if (simd.u != scalar.u) {
+            plane = "U";
+        } else if (simd.v != scalar.v) {
+            plane = "V";
+        }
+        if (plane) {
+            fail(QStringLiteral("simd/scalar %1x%2 stride=%3 %4 %5 gains=%6/%7: plane %8 differs")
+                     .arg(w).arg(h).arg(img.stride).arg(QLatin1String(patternName(pattern)))
+                     .arg(QLatin1String(matrix == ColorConvert::Matrix::Bt709 ? "bt709" : "bt601"))
+                     .arg(uGain).arg(vGain).arg(QLatin1String(plane)));
+        }
+    }
+
+    // 与旧 libyuv + 色度校正流程的 PSNR（仅偶数宽高，旧流程要求）
+    void checkAgainstLegacy(int w, int h, Pattern pattern)
+    {
+        ++cases;
+        const double uGain = 0.95;
+        const double vGain = 1.05;
+        Image img(w, h);
+        fillImage(img, pattern, rng);
+        I420 legacy(w, h);
+        I420 current(w, h);
+        convertLegacy(img, legacy, uGain, vGain);
+        convertNew(img, current, ColorConvert::makeCoefficients(ColorConvert::Matrix::Bt601, uGain, vGain), false);
+
+        int maxY = 0, maxU = 0, maxV = 0;
+        const double py = psnr(legacy.y, current.y, &maxY);
+        const double pu = psnr(legacy.u, current.u, &maxU);
+        const double pv = psnr(legacy.v, current.v, &maxV);
+        out() << QStringLiteral("legacy %1x%2 %3: PSNR Y=%4 U=%5 V=%6 dB, max diff %7/%8/%9")
+                     .arg(w).arg(h).arg(QLatin1String(patternName(pattern)), -9)
+                     .arg(py, 0, 'f', 2).arg(pu, 0, 'f', 2).arg(pv, 0, 'f', 2)
+                     .arg(maxY).arg(maxU).arg(maxV)
+              << Qt::endl;
+        if (py < minPsnr || pu < minPsnr || pv < minPsnr) {
+            fail(QStringLiteral("legacy %1x%2 %3: PSNR below %4 dB").arg(w).arg(h).arg(QLatin1String(patternName(pattern))).arg(minPsnr));
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("ColorConvertCheck"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Check ColorConvert SIMD/scalar paths and compare against the legacy libyuv pipeline"));
+    parser.addHelpOption();
+    QCommandLineOption minPsnrOpt(QStringList() << "min-psnr", QStringLiteral("Minimum per-plane PSNR against the legacy pipeline in dB (default 45)"), QStringLiteral("db"), QStringLiteral("45"));
+    QCommandLineOption seedOpt(QStringList() << "seed", QStringLiteral("Random seed (default 1)"), QStringLiteral("seed"), QStringLiteral("1"));
+    parser.addOption(minPsnrOpt);
+    parser.addOption(seedOpt);
+    parser.process(app);
+
+    Checker checker(parser.value(seedOpt).toUInt());
+    checker.minPsnr = parser.value(minPsnrOpt).toDouble();
+
+    const Pattern patterns[] = { Pattern::Gradient, Pattern::Desktop, Pattern::Noise, Pattern::ColorBars };
+
+    // 1. SIMD 与标量一致性：奇数尺寸、SIMD 块边界附近的宽度、行填充
+    struct Size { int w; int h; int padding; };
+    const Size simdSizes[] = { {1, 1, 0}, {2, 2, 0}, {7, 5, 0}, {15, 3, 4}, {16, 2, 0}, {17, 9, 12},
+                               {31, 31, 0}, {33, 17, 8}, {641, 359, 0}, {1920, 1080, 0}, {1921, 1081, 64} };
+    const struct { ColorConvert::Matrix matrix; double uGain; double vGain; } variants[] = {
+        { ColorConvert::Matrix::Bt601, 1.0, 1.0 },
+        { ColorConvert::Matrix::Bt601, 0.95, 1.05 },
+        { ColorConvert::Matrix::Bt709, 1.0, 1.0 },
+        { ColorConvert::Matrix::Bt709, 1.2, 0.8 },
+    };
+    for (const Size &s : simdSizes) {
+        for (Pattern p : patterns) {
+            for (const auto &v : variants) {
+                checker.checkSimdMatchesScalar(s.w, s.h, s.padding, p, v.matrix, v.uGain, v.vGain);
+            }
+        }
+    }
+    out() << "simd/scalar: " << checker.cases << " cases, " << checker.failures << " failures" << Qt::endl;
+
+    // 2. 与旧流程的 PSNR
+    const int simdCases = checker.cases;
+    const Size legacySizes[] = { {64, 64, 0}, {1280, 720, 0}, {1920, 1080, 0} };
+    for (const Size &s : legacySizes) {
+        for (Pattern p : patterns) {
+            checker.checkAgainstLegacy(s.w, s.h, p);
+        }
+    }
+
+    out() << "total: " << checker.cases << " cases (" << simdCases << " simd/scalar, "
+          << (checker.cases - simdCases) << " legacy), " << checker.failures << " failures, min PSNR "
+          << checker.minPsnr << " dB" << Qt::endl;
+    return checker.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,474 @@
+// 编码器基准测试：读取录制的原始 ARGB 帧序列（内存映射），按画质预设 × 码率 × 时间层数逐组驱动
+// VP9Encoder，统计单帧编码耗时分位数、实际码率、关键帧大小，并用 libvpx 解码与源画面比较 PSNR/SSIM。
+// 结果输出为 JSON，便于版本间回归对比。纯命令行程序，不依赖显示环境（Linux 无头可运行）。
+//
+// 用法示例：
+//   EncoderBenchmark capture.irraw --presets low,medium --bitrates 200000,400000 --output result.json
+//   EncoderBenchmark desktop.bgra --raw 1920x1080 --fps 15 --switch-at 120
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QDateTime>
+#include <QSysInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <vpx/vpx_decoder.h>
+#include <vpx/vp8dx.h>
+#include <libyuv.h>
+
+#include "../capture/VP9Encoder.h"
+#include "../capture/RawFrameFile.h"
+#include "../capture/ColorConvert.h"
+#include "../common/PacketHeader.h"
+
+namespace {
+
+struct RunConfig {
+    QString preset;
+    int bitrate = 0;
+    int temporalLayers = 1;
+};
+
+// 与 CaptureProcess 的 applyQualitySetting 一致的预设码率
+int presetBitrate(const QString &preset)
+{
+    if (preset == QStringLiteral("low")) return 200000;
+    if (preset == QStringLiteral("high")) return 500000;
+    if (preset == QStringLiteral("extreme")) return 3000000;
+    return 400000;
+}
+
+qint64 percentile(const std::vector<qint64> &sorted, double q)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t idx = std::min(sorted.size() - 1, size_t(std::floor(q * (sorted.size() - 1) + 0.5)));
+    return sorted[idx];
+}
+
+// I420 平面缓冲（参考画面）
+struct I420Buffer {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> y, u, v;
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        y.resize(size_t(w) * h);
+        u.resize(size_t((w + 1) / 2) * ((h + 1) / 2));
+        v.resize(u.size());
+    }
+    int strideY() const { return width; }
+    int strideUV() const { return (width + 1) / 2; }
+};
+
+// 解码端：把编码输出还原为 I420，用于画质比较
+class QualityProbe
+{
+public:
+    bool init()
+    {
+        vpx_codec_dec_cfg_t cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.threads = 1;
+        m_ok = vpx_codec_dec_init(&m_codec, vpx_codec_vp9_dx(), &cfg, 0) == VPX_CODEC_OK;
+        return m_ok;
+    }
+    ~QualityProbe()
+    {
+        if (m_ok) {
+            vpx_codec_destroy(&m_codec);
+        }
+    }
+
+    // 返回解码后的最后一帧（无输出时为 nullptr）
+    vpx_image_t *decode(const char *data, int size)
+    {
+        if (!m_ok || vpx_codec_decode(&m_codec, reinterpret_cast<const uint8_t *>(data),
+                                      static_cast<unsigned int>(size), nullptr, 0) != VPX_CODEC_OK) {
+            return nullptr;
+        }
+        vpx_image_t *last = nullptr;
+        vpx_codec_iter_t iter = nullptr;
+        while (vpx_image_t *img = vpx_codec_get_frame(&m_codec, &iter)) {
+            last = img;
+        }
+        return last;
+    }
+
+private:
+    vpx_codec_ctx_t m_codec;
+    bool m_ok = false;
+};
+
+struct FrameResult {
+    qint64 encodeNs = 0;
+    int bytes = 0;          // 负载字节（不含 8 字节头部）
+    bool keyFrame = false;
+    bool produced = false;
+};
+
+QJsonObject runBenchmark(const RunConfig &run, const RawFrameReader &reader, const QSize &encodeSize,
+                         int fps, int frameLimit, int switchAt, bool measureQuality,
+                         KeyFramePolicy::Mode keyMode, bool staticDetection)
+{
+    QJsonObject result;
+    result["preset"] = run.preset;
+    result["bitrate"] = run.bitrate;
+    result["temporal_layers"] = run.temporalLayers;
+
+    VP9Encoder encoder;
+    encoder.setQualityPreset(run.preset);
+    encoder.setBitrate(run.bitrate);
+    encoder.setTemporalLayers(run.temporalLayers);
+    encoder.setKeyFramePolicy(keyMode, 8000);
+    encoder.setEnableStaticDetection(staticDetection);
+    encoder.setSkipStaticFrames(false);
+    if (!encoder.initialize(encodeSize.width(), encodeSize.height(), fps)) {
+        result["error"] = QStringLiteral("encoder initialize failed");
+        return result;
+    }
+    // 初始化失败回退单层时以实际层数为准
+    result["temporal_layers"] = encoder.temporalLayers();
+
+    FrameResult current;
+    QObject::connect(&encoder, &VP9Encoder::packetEncoded, &encoder,
+                     [&current](const QByteArray &packet, const PacketMeta &meta) {
+        current.produced = true;
+        current.keyFrame = meta.keyFrame;
+        current.bytes = std::max(0, int(packet.size()) - kPacketHeaderSize);
+    }, Qt::DirectConnection);
+
+    QualityProbe probe;
+    const bool qualityEnabled = measureQuality && probe.init();
+    const ColorConvert::Coefficients coeffs = ColorConvert::makeCoefficients(ColorConvert::Matrix::Bt601, 0.95, 1.05);
+    I420Buffer reference;
+
+    const QSize sourceSize = reader.frameSize();
+    const bool needScale = sourceSize != encodeSize;
+    QByteArray scaled;
+    if (needScale) {
+        scaled.resize(encodeSize.width() * encodeSize.height() * 4);
+    }
+
+    const int total = frameLimit > 0 ? std::min(frameLimit, reader.frameCount()) : reader.frameCount();
+    std::vector<FrameResult> frames;
+    frames.reserve(size_t(total));
+    double psnrSum = 0.0, psnrYSum = 0.0, ssimSum = 0.0, ssimYSum = 0.0;
+    double psnrMin = 1e9, ssimMin = 1e9;
+    int qualityFrames = 0;
+    bool switched = false;
+    QJsonObject switchInfo;
+
+    for (int i = 0; i < total; ++i) {
+        const RawFrameReader::Frame src = reader.frame(i);
+        if (!src.argb) {
+            break;
+        }
+
+        // 编码器输入需为紧凑 ARGB；尺寸不一致（奇数宽高）时先缩放，参考画面与编码输入保持一致
+        QByteArray input;
+        if (needScale) {
+            libyuv::ARGBScale(src.argb, src.stride, sourceSize.width(), sourceSize.height(),
+                              reinterpret_cast<uint8_t *>(scaled.data()), encodeSize.width() * 4,
+                              encodeSize.width(), encodeSize.height(), libyuv::kFilterBox);
+            input = QByteArray::fromRawData(scaled.constData(), scaled.size());
+        } else {
+            input = QByteArray::fromRawData(reinterpret_cast<const char *>(src.argb),
+                                            src.stride * sourceSize.height());
+        }
+
+        if (switchAt > 0 && i == switchAt && !switched) {
+            // 运行时切换到半分辨率：记录重配置耗时与切换后首帧开销
+            const QSize half(encodeSize.width() / 2 & ~1, encodeSize.height() / 2 & ~1);
+            QElapsedTimer t;
+            t.start();
+            const bool ok = encoder.reconfigure(half.width(), half.height(), fps);
+            switchInfo["reconfigure_us"] = double(t.nsecsElapsed()) / 1000.0;
+            switchInfo["ok"] = ok;
+            switchInfo["to_width"] = half.width();
+            switchInfo["to_height"] = half.height();
+            switched = true;
+        }
+
+        current = FrameResult();
+        QElapsedTimer timer;
+        timer.start();
+        const QByteArray packet = encoder.encode(input, encodeSize.width(), encodeSize.height());
+        current.encodeNs = timer.nsecsElapsed();
+        frames.push_back(current);
+
+        if (switched && switchInfo.contains("ok") && !switchInfo.contains("first_frame_bytes") && current.produced) {
+            switchInfo["first_frame_bytes"] = current.bytes;
+            switchInfo["first_frame_key"] = current.keyFrame;
+            switchInfo["first_frame_encode_us"] = double(current.encodeNs) / 1000.0;
+        }
+
+        // 画质：切换分辨率后的帧与源尺寸不同，不参与比较
+        if (qualityEnabled && current.produced && !switched && packet.size() > kPacketHeaderSize) {
+            vpx_image_t *img = probe.decode(packet.constData() + kPacketHeaderSize,
+                                            packet.size() - kPacketHeaderSize);
+            if (img && int(img->d_w) == encodeSize.width() && int(img->d_h) == encodeSize.height()) {
+                reference.resize(encodeSize.width(), encodeSize.height());
+                ColorConvert::argbToI420(reinterpret_cast<const uint8_t *>(input.constData()), encodeSize.width() * 4,
+                                         reference.y.data(), reference.strideY(),
+                                         reference.u.data(), reference.strideUV(),
+                                         reference.v.data(), reference.strideUV(),
+                                         encodeSize.width(), encodeSize.height(), coeffs);
+                const int w = encodeSize.width();
+                const int h = encodeSize.height();
+                const double psnr = libyuv::I420Psnr(reference.y.data(), reference.strideY(),
+                                                     reference.u.data(), reference.strideUV(),
+                                                     reference.v.data(), reference.strideUV(),
+                                                     img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y],
+                                                     img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U],
+                                                     img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V], w, h);
+                const double psnrY = libyuv::CalcFramePsnr(reference.y.data(), reference.strideY(),
+                                                           img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y], w, h);
+                const double ssim = libyuv::I420Ssim(reference.y.data(), reference.strideY(),
+                                                     reference.u.data(), reference.strideUV(),
+                                                     reference.v.data(), reference.strideUV(),
+                                                     img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y],
+                                                     img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U],
+                                                     img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V], w, h);
+                const double ssimY = libyuv::CalcFrameSsim(reference.y.data(), reference.strideY(),
+                                                           img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y], w, h);
+                psnrSum += psnr;
+                psnrYSum += psnrY;
+                ssimSum += ssim;
+                ssimYSum += ssimY;
+                psnrMin = std::min(psnrMin, psnr);
+                ssimMin = std::min(ssimMin, ssim);
+                ++qualityFrames;
+            }
+        }
+    }
+
+    // 汇总
+    std::vector<qint64> latencies;
+    latencies.reserve(frames.size());
+    qint64 payloadBytes = 0;
+    qint64 latencySum = 0;
+    int produced = 0;
+    QJsonArray keyFrameSizes;
+    qint64 keyBytes = 0;
+    qint64 preSwitchDeltaBytes = 0;
+    int preSwitchDeltaFrames = 0;
+    qint64 switchWindowBytes = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const FrameResult &f = frames[i];
+        latencies.push_back(f.encodeNs);
+        latencySum += f.encodeNs;
+        if (!f.produced) {
+            continue;
+        }
+        ++produced;
+        payloadBytes += f.bytes;
+        if (f.keyFrame) {
+            keyFrameSizes.append(f.bytes);
+            keyBytes += f.bytes;
+        }
+        if (switchAt > 0) {
+            const int idx = int(i);
+            if (idx < switchAt && idx >= switchAt - fps && !f.keyFrame) {
+                preSwitchDeltaBytes += f.bytes;
+                ++preSwitchDeltaFrames;
+            } else if (idx >= switchAt && idx < switchAt + fps) {
+                switchWindowBytes += f.bytes;
+            }
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    QJsonObject latency;
+    latency["mean_us"] = latencies.empty() ? 0.0 : double(latencySum) / latencies.size() / 1000.0;
+    latency["p50_us"] = double(percentile(latencies, 0.50)) / 1000.0;
+    latency["p90_us"] = double(percentile(latencies, 0.90)) / 1000.0;
+    latency["p99_us"] = double(percentile(latencies, 0.99)) / 1000.0;
+    latency["max_us"] = latencies.empty() ? 0.0 : double(latencies.back()) / 1000.0;
+
+    result["frames"] = int(frames.size());
+    result["encoded_frames"] = produced;
+    result["payload_bytes"] = double(payloadBytes);
+    result["achieved_bitrate"] = frames.empty() ? 0.0 : double(payloadBytes) * 8.0 * fps / frames.size();
+    result["latency"] = latency;
+
+    QJsonObject keyFrames;
+    keyFrames["count"] = keyFrameSizes.size();
+    keyFrames["total_bytes"] = double(keyBytes);
+    keyFrames["avg_bytes"] = keyFrameSizes.isEmpty() ? 0.0 : double(keyBytes) / keyFrameSizes.size();
+    keyFrames["sizes"] = keyFrameSizes;
+    result["key_frames"] = keyFrames;
+
+    if (qualityFrames > 0) {
+        QJsonObject quality;
+        quality["frames"] = qualityFrames;
+        quality["psnr"] = psnrSum / qualityFrames;
+        quality["psnr_y"] = psnrYSum / qualityFrames;
+        quality["psnr_min"] = psnrMin;
+        quality["ssim"] = ssimSum / qualityFrames;
+        quality["ssim_y"] = ssimYSum / qualityFrames;
+        quality["ssim_min"] = ssimMin;
+        result["quality"] = quality;
+    }
+
+    if (switched) {
+        // 切换代价：切换后 1 秒内的字节数对比切换前 1 秒的平均帧大小
+        switchInfo["pre_switch_avg_delta_bytes"] = preSwitchDeltaFrames ? double(preSwitchDeltaBytes) / preSwitchDeltaFrames : 0.0;
+        switchInfo["window_bytes"] = double(switchWindowBytes);
+        result["switch"] = switchInfo;
+    }
+
+    const KeyFramePolicy::Stats keyStats = encoder.keyFrameStats();
+    result["key_frame_requests"] = double(keyStats.requests);
+    return result;
+}
+
+QStringList splitList(const QString &value)
+{
+    QStringList out;
+    for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+        out.append(part.trimmed());
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("EncoderBenchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("VP9Encoder benchmark over recorded raw ARGB frame sequences"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("input"), QStringLiteral("Recorded frame file (.irraw) or headerless ARGB with --raw"));
+    const QCommandLineOption rawOpt(QStringLiteral("raw"), QStringLiteral("Headerless input frame size, e.g. 1920x1080"), QStringLiteral("WxH"));
+    const QCommandLineOption fpsOpt(QStringLiteral("fps"), QStringLiteral("Encode frame rate (default: recording hint)"), QStringLiteral("fps"));
+    const QCommandLineOption presetsOpt(QStringLiteral("presets"), QStringLiteral("Quality presets"), QStringLiteral("list"),
+                                        QStringLiteral("low,medium,high,extreme"));
+    const QCommandLineOption bitratesOpt(QStringLiteral("bitrates"), QStringLiteral("Bitrates in bps (default: preset bitrate)"), QStringLiteral("list"));
+    const QCommandLineOption layersOpt(QStringLiteral("layers"), QStringLiteral("Temporal layer counts (1 = single-layer VBR)"), QStringLiteral("list"),
+                                       QStringLiteral("1,3"));
+    const QCommandLineOption framesOpt(QStringLiteral("frames"), QStringLiteral("Limit frame count (0 = all)"), QStringLiteral("n"), QStringLiteral("0"));
+    const QCommandLineOption switchOpt(QStringLiteral("switch-at"), QStringLiteral("Reconfigure to half resolution at this frame"), QStringLiteral("n"), QStringLiteral("0"));
+    const QCommandLineOption keyModeOpt(QStringLiteral("keyframe-mode"), QStringLiteral("on_demand | periodic | intra_refresh"), QStringLiteral("mode"),
+                                        QStringLiteral("periodic"));
+    const QCommandLineOption noQualityOpt(QStringLiteral("no-quality"), QStringLiteral("Skip PSNR/SSIM (decode) measurement"));
+    const QCommandLineOption noStaticOpt(QStringLiteral("no-static-detection"), QStringLiteral("Disable static-content bitrate reduction"));
+    const QCommandLineOption outputOpt(QStringLiteral("output"), QStringLiteral("JSON result file"), QStringLiteral("file"),
+                                       QStringLiteral("encoder_benchmark.json"));
+    parser.addOptions({ rawOpt, fpsOpt, presetsOpt, bitratesOpt, layersOpt, framesOpt, switchOpt,
+                        keyModeOpt, noQualityOpt, noStaticOpt, outputOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+    const QString inputPath = parser.positionalArguments().first();
+
+    RawFrameReader reader;
+    bool opened = false;
+    if (parser.isSet(rawOpt)) {
+        const QStringList wh = parser.value(rawOpt).toLower().split('x');
+        const QSize size = wh.size() == 2 ? QSize(wh[0].toInt(), wh[1].toInt()) : QSize();
+        opened = reader.openRaw(inputPath, size, parser.value(fpsOpt).toInt());
+    } else {
+        opened = reader.open(inputPath);
+    }
+    if (!opened || reader.frameCount() == 0) {
+        err << "Failed to open input: " << inputPath << " (" << reader.errorString() << ")\n";
+        return 2;
+    }
+
+    const int fps = parser.isSet(fpsOpt) ? std::max(1, parser.value(fpsOpt).toInt()) : reader.fpsHint();
+    const QSize sourceSize = reader.frameSize();
+    const QSize encodeSize(sourceSize.width() & ~1, sourceSize.height() & ~1);
+    const KeyFramePolicy::Mode keyMode =
+        KeyFramePolicy::modeFromString(parser.value(keyModeOpt), KeyFramePolicy::Mode::Periodic);
+
+    QVector<RunConfig> runs;
+    const QStringList bitrateList = splitList(parser.value(bitratesOpt));
+    for (const QString &preset : splitList(parser.value(presetsOpt))) {
+        QVector<int> bitrates;
+        for (const QString &b : bitrateList) {
+            if (b.toInt() > 0) bitrates.append(b.toInt());
+        }
+        if (bitrates.isEmpty()) {
+            bitrates.append(presetBitrate(preset.toLower()));
+        }
+        for (int bitrate : bitrates) {
+            for (const QString &l : splitList(parser.value(layersOpt))) {
+                RunConfig run;
+                run.preset = preset.toLower();
+                run.bitrate = bitrate;
+                run.temporalLayers = std::max(1, std::min(l.toInt(), PacketHeader::kMaxTemporalLayers));
+                runs.append(run);
+            }
+        }
+    }
+
+    QJsonObject source;
+    source["path"] = inputPath;
+    source["width"] = sourceSize.width();
+    source["height"] = sourceSize.height();
+    source["frames"] = reader.frameCount();
+    source["fps"] = fps;
+
+    QJsonArray results;
+    out << "preset    bitrate   layers  kbps      p50us    p99us    keyfr  keyavgB   psnrY   ssimY\n";
+    for (const RunConfig &run : runs) {
+        const QJsonObject r = runBenchmark(run, reader, encodeSize, fps, parser.value(framesOpt).toInt(),
+                                           parser.value(switchOpt).toInt(), !parser.isSet(noQualityOpt),
+                                           keyMode, !parser.isSet(noStaticOpt));
+        results.append(r);
+        const QJsonObject lat = r.value("latency").toObject();
+        const QJsonObject key = r.value("key_frames").toObject();
+        const QJsonObject q = r.value("quality").toObject();
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n")
+                   .arg(run.preset, -9)
+                   .arg(run.bitrate, -9)
+                   .arg(r.value("temporal_layers").toInt(), -7)
+                   .arg(r.value("achieved_bitrate").toDouble() / 1000.0, -9, 'f', 1)
+                   .arg(lat.value("p50_us").toDouble(), -8, 'f', 0)
+                   .arg(lat.value("p99_us").toDouble(), -8, 'f', 0)
+                   .arg(key.value("count").toInt(), -6)
+                   .arg(key.value("avg_bytes").toDouble(), -9, 'f', 0)
+                   .arg(q.value("psnr_y").toDouble(), -7, 'f', 2)
+                   .arg(q.value("ssim_y").toDouble(), -7, 'f', 4);
+        out.flush();
+    }
+
+    QJsonObject root;
+    root["tool"] = QStringLiteral("EncoderBenchmark");
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["host"] = QSysInfo::machineHostName();
+    root["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    root["keyframe_mode"] = KeyFramePolicy::modeName(keyMode);
+    root["source"] = source;
+    root["runs"] = results;
+
+    QFile file(parser.value(outputOpt));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        err << "Failed to write " << file.fileName() << "\n";
+        return 3;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    file.close();
+    out << "Results written to " << file.fileName() << "\n";
+    return 0;
+}
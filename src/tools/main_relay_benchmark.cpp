@@ -0,0 +1,389 @@
+// 中继扇出基准：本机回环上 1 个推流端 → N 个观看端，测量 LanRelayServer 的 CPU 与内存随观看端数量的变化。
+// 中继运行在本进程，推流端与观看端运行在子进程（同一可执行文件，--client 模式），
+// 因此统计到的进程 CPU 时间与常驻内存（RSS）只包含中继一侧：
+//   - CPU：推流期间中继进程 CPU 时间，折算为每条消息、每条消息×观看端的耗时与占用率
+//   - 内存：连接 N 个观看端后、推流期间峰值相对基线的增量，折算到每个观看端
+// 推流端按给定码率/帧率发送带标签的合成视频消息（时间层 0212，按 GOP 插入关键帧），
+// 观看端统计收到的字节数，确认扇出完整（未被积压过滤）。结果输出为 JSON，便于版本间对比。
+//
+// 用法示例：
+//   RelayBenchmark
+//   RelayBenchmark --subscribers 1,10,50 --bitrate-kbps 6000 --fps 30 --seconds 10 --output fanout.json
+//   RelayBenchmark --qt-framing --output fanout_qt.json   # 对比：每个观看端由 QWebSocket 各自成帧
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+#include <QWebSocket>
+#include <algorithm>
+#include <functional>
+
+#include "../common/LanRelayServer.h"
+#include "../common/PacketHeader.h"
+#include "ProcessStats.h"
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// 中继所在的本进程
+qint64 processCpuUs()
+{
+    return ProcessStats::cpuUs(QCoreApplication::applicationPid());
+}
+
+qint64 residentBytes()
+{
+    return ProcessStats::residentBytes(QCoreApplication::applicationPid());
+}
+
+// 运行事件循环直到条件满足或超时
+bool waitFor(const std::function<bool()> &done, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+    }
+    return true;
+}
+
+struct StreamConfig {
+    int subscribers = 1;
+    int fps = 30;
+    int bitrateKbps = 4000;
+    int seconds = 5;
+    int gop = 120;      // 关键帧间隔（帧）
+    bool preframed = true;  // 中继预成帧扇出（--qt-framing 关闭）
+};
+
+// ---- 子进程：推流端 + N 个观看端 ----
+// 标准输出逐行汇报："connected"（全部连接完成），"done <json>"（发送结束并收齐/超时）
+int runClient(quint16 port, const StreamConfig &cfg)
+{
+    const QString base = QStringLiteral("ws://127.0.0.1:%1/").arg(port);
+    const QString room = QStringLiteral("bench");
+
+    QVector<QWebSocket*> subscribers;
+    QVector<qint64> receivedBytes(cfg.subscribers, 0);
+    QVector<qint64> receivedMessages(cfg.subscribers, 0);
+    for (int i = 0; i < cfg.subscribers; ++i) {
+        QWebSocket *sub = new QWebSocket;
+        QObject::connect(sub, &QWebSocket::binaryMessageReceived, sub, [&receivedBytes, &receivedMessages, i](const QByteArray &msg) {
+            receivedBytes[i] += msg.size();
+            ++receivedMessages[i];
+        });
+        sub->open(QUrl(base + QStringLiteral("subscribe/") + room));
+        subscribers.append(sub);
+    }
+    QWebSocket publisher;
+    publisher.open(QUrl(base + QStringLiteral("publish/") + room));
+
+    const bool connected = waitFor([&] {
+        if (publisher.state() != QAbstractSocket::ConnectedState) return false;
+        for (QWebSocket *s : subscribers) {
+            if (s->state() != QAbstractSocket::ConnectedState) return false;
+        }
+        return true;
+    }, 15000);
+    if (!connected) {
+        out() << "error connect\n";
+        out().flush();
+        return 2;
+    }
+    // 给中继处理完握手与房间登记
+    waitFor([] { return false; }, 300);
+    out() << "connected\n";
+    out().flush();
+
+    // 平均帧大小按码率折算；关键帧按 6 倍增量帧估算
+    const qint64 avgBytes = std::max<qint64>(64, qint64(cfg.bitrateKbps) * 1000 / 8 / cfg.fps);
+    const qint64 deltaBytes = std::max<qint64>(32, avgBytes * cfg.gop / (cfg.gop - 1 + 6));
+    const qint64 keyBytes = deltaBytes * 6;
+    const int totalFrames = cfg.fps * cfg.seconds;
+
+    qint64 sentBytes = 0;
+    int sentFrames = 0;
+    QElapsedTimer clock;
+    clock.start();
+    QTimer sendTimer;
+    sendTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&sendTimer, &QTimer::timeout, [&] {
+        // 按时钟补齐应发帧数，定时器抖动不影响平均帧率
+        const int due = std::min<int>(totalFrames, int(clock.elapsed() * cfg.fps / 1000) + 1);
+        while (sentFrames < due) {
+            const int pos = sentFrames % cfg.gop;
+            const bool key = pos == 0;
+            static const int kPattern[4] = {0, 2, 1, 2};
+            const int tid = key ? 0 : kPattern[pos % 4];
+            QByteArray msg(PacketHeader::kMessageHeaderSize + (key ? keyBytes : deltaBytes), char(0x5A));
+            PacketHeader::writeMessage(msg.data(), PacketHeader::MessageType::Video, quint32(sentFrames),
+                                       QDateTime::currentMSecsSinceEpoch(), 0, tid, key);
+            publisher.sendBinaryMessage(msg);
+            sentBytes += msg.size();
+            ++sentFrames;
+        }
+        if (sentFrames >= totalFrames) {
+            sendTimer.stop();
+        }
+    });
+    sendTimer.start(std::max(1, 1000 / cfg.fps / 2));
+    waitFor([&] { return !sendTimer.isActive(); }, cfg.seconds * 1000 + 10000);
+
+    // 等待观看端收齐（或 3 秒内不再有进展）
+    qint64 lastTotal = -1;
+    QElapsedTimer idle;
+    idle.start();
+    waitFor([&] {
+        qint64 total = 0;
+        for (qint64 b : receivedBytes) total += b;
+        if (total != lastTotal) {
+            lastTotal = total;
+            idle.restart();
+        }
+        return total >= sentBytes * cfg.subscribers || idle.elapsed() > 3000;
+    }, 60000);
+
+    qint64 minBytes = sentBytes;
+    qint64 sumBytes = 0;
+    qint64 minMessages = sentFrames;
+    for (int i = 0; i < cfg.subscribers; ++i) {
+        minBytes = std::min(minBytes, receivedBytes[i]);
+        minMessages = std::min(minMessages, receivedMessages[i]);
+        sumBytes += receivedBytes[i];
+    }
+    QJsonObject r;
+    r["sent_messages"] = sentFrames;
+    r["sent_bytes"] = sentBytes;
+    r["received_bytes_min"] = minBytes;
+    r["received_bytes_avg"] = double(sumBytes) / cfg.subscribers;
+    r["received_messages_min"] = minMessages;
+    out() << "done " << QJsonDocument(r).toJson(QJsonDocument::Compact) << "\n";
+    out().flush();
+
+    publisher.close();
+    for (QWebSocket *s : subscribers) {
+        s->close();
+    }
+    waitFor([] { return false; }, 200);
+    qDeleteAll(subscribers);
+    return 0;
+}
+
+// ---- 主进程：中继 + 测量 ----
+QJsonObject runFanout(const StreamConfig &cfg, const QStringList &clientArgs)
+{
+    QJsonObject result;
+    result["subscribers"] = cfg.subscribers;
+
+    LanRelayServer relay;
+    relay.setPreframedFanout(cfg.preframed);
+    if (!relay.start(0)) {
+        result["error"] = QStringLiteral("listen failed");
+        return result;
+    }
+
+    const qint64 rssBase = residentBytes();
+    qint64 rssConnected = -1;
+    qint64 rssPeak = rssBase;
+    qint64 cpuStart = 0;
+    qint64 cpuEnd = 0;
+    qint64 streamStartMs = 0;
+    qint64 streamEndMs = 0;
+    QJsonObject clientReport;
+    bool failed = false;
+
+    QTimer rssSampler;
+    QObject::connect(&rssSampler, &QTimer::timeout, [&] { rssPeak = std::max(rssPeak, residentBytes()); });
+
+    QProcess client;
+    client.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    QObject::connect(&client, &QProcess::readyReadStandardOutput, [&] {
+        while (client.canReadLine()) {
+            const QByteArray line = client.readLine().trimmed();
+            if (line == "connected") {
+                rssConnected = residentBytes();
+                cpuStart = processCpuUs();
+                streamStartMs = QDateTime::currentMSecsSinceEpoch();
+                rssSampler.start(100);
+            } else if (line.startsWith("done ")) {
+                cpuEnd = processCpuUs();
+                streamEndMs = QDateTime::currentMSecsSinceEpoch();
+                rssSampler.stop();
+                clientReport = QJsonDocument::fromJson(line.mid(5)).object();
+            } else if (line.startsWith("error")) {
+                failed = true;
+            }
+        }
+    });
+
+    QStringList args = clientArgs;
+    args << QStringLiteral("--client") << QStringLiteral("--port") << QString::number(relay.port())
+         << QStringLiteral("--subscribers") << QString::number(cfg.subscribers);
+    client.start(QCoreApplication::applicationFilePath(), args);
+    waitFor([&] { return client.state() == QProcess::NotRunning; }, cfg.seconds * 1000 + 90000);
+    if (client.state() != QProcess::NotRunning) {
+        client.kill();
+        client.waitForFinished(3000);
+    }
+    if (failed || clientReport.isEmpty()) {
+        result["error"] = QStringLiteral("client failed");
+        return result;
+    }
+
+    const qint64 messages = clientReport.value("sent_messages").toInteger();
+    const qint64 sentBytes = clientReport.value("sent_bytes").toInteger();
+    const double cpuUs = double(cpuEnd - cpuStart);
+    const double wallMs = double(std::max<qint64>(1, streamEndMs - streamStartMs));
+    const qint64 deliveries = messages * cfg.subscribers;
+
+    QJsonObject cpu;
+    cpu["total_ms"] = cpuUs / 1000.0;
+    cpu["percent_of_core"] = cpuUs / 1000.0 / wallMs * 100.0;
+    cpu["us_per_message"] = messages > 0 ? cpuUs / messages : 0.0;
+    cpu["us_per_delivery"] = deliveries > 0 ? cpuUs / deliveries : 0.0;
+    cpu["ns_per_delivered_kb"] = sentBytes > 0 ? cpuUs * 1000.0 / (double(sentBytes) * cfg.subscribers / 1024.0) : 0.0;
+    result["cpu"] = cpu;
+
+    QJsonObject memory;
+    memory["baseline_bytes"] = rssBase;
+    memory["connected_bytes_per_subscriber"] = (rssBase >= 0 && rssConnected >= 0)
+        ? double(rssConnected - rssBase) / cfg.subscribers : -1.0;
+    memory["peak_bytes_per_subscriber"] = (rssBase >= 0 && rssPeak >= 0)
+        ? double(rssPeak - rssBase) / cfg.subscribers : -1.0;
+    result["memory"] = memory;
+
+    result["messages"] = messages;
+    result["sent_bytes"] = sentBytes;
+    result["delivered_ratio_min"] = sentBytes > 0 ? clientReport.value("received_bytes_min").toDouble() / sentBytes : 0.0;
+    result["delivered_ratio_avg"] = sentBytes > 0 ? clientReport.value("received_bytes_avg").toDouble() / sentBytes : 0.0;
+    return result;
+}
+
+QVector<int> parseCounts(const QString &value)
+{
+    QVector<int> counts;
+    for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+        const int n = part.trimmed().toInt();
+        if (n > 0) counts.append(n);
+    }
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("RelayBenchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("LanRelayServer loopback fan-out benchmark (1 publisher -> N subscribers)"));
+    parser.addHelpOption();
+    const QCommandLineOption subscribersOpt(QStringLiteral("subscribers"), QStringLiteral("Subscriber counts to sweep"), QStringLiteral("list"),
+                                            QStringLiteral("1,2,5,10,20,50"));
+    const QCommandLineOption fpsOpt(QStringLiteral("fps"), QStringLiteral("Publisher frame rate"), QStringLiteral("fps"), QStringLiteral("30"));
+    const QCommandLineOption bitrateOpt(QStringLiteral("bitrate-kbps"), QStringLiteral("Publisher bitrate"), QStringLiteral("kbps"), QStringLiteral("4000"));
+    const QCommandLineOption secondsOpt(QStringLiteral("seconds"), QStringLiteral("Streaming duration per run"), QStringLiteral("s"), QStringLiteral("5"));
+    const QCommandLineOption gopOpt(QStringLiteral("gop"), QStringLiteral("Key frame interval in frames"), QStringLiteral("n"), QStringLiteral("120"));
+    const QCommandLineOption qtFramingOpt(QStringLiteral("qt-framing"), QStringLiteral("Let QWebSocket frame every message per subscriber (baseline for the pre-framed fan-out)"));
+    const QCommandLineOption outputOpt(QStringLiteral("output"), QStringLiteral("JSON result file"), QStringLiteral("file"),
+                                       QStringLiteral("relay_benchmark.json"));
+    // 内部使用：子进程模式
+    const QCommandLineOption clientOpt(QStringLiteral("client"), QStringLiteral("Internal: run publisher/subscribers against --port"));
+    const QCommandLineOption portOpt(QStringLiteral("port"), QStringLiteral("Internal: relay port"), QStringLiteral("port"));
+    clientOpt.setFlags(QCommandLineOption::HiddenFromHelp);
+    portOpt.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({ subscribersOpt, fpsOpt, bitrateOpt, secondsOpt, gopOpt, qtFramingOpt, outputOpt, clientOpt, portOpt });
+    parser.process(app);
+
+    StreamConfig cfg;
+    cfg.fps = std::max(1, parser.value(fpsOpt).toInt());
+    cfg.bitrateKbps = std::max(1, parser.value(bitrateOpt).toInt());
+    cfg.seconds = std::max(1, parser.value(secondsOpt).toInt());
+    cfg.gop = std::max(2, parser.value(gopOpt).toInt());
+    cfg.preframed = !parser.isSet(qtFramingOpt);
+
+    if (parser.isSet(clientOpt)) {
+        cfg.subscribers = std::max(1, parser.value(subscribersOpt).toInt());
+        return runClient(static_cast<quint16>(parser.value(portOpt).toUInt()), cfg);
+    }
+
+    const QVector<int> counts = parseCounts(parser.value(subscribersOpt));
+    if (counts.isEmpty()) {
+        parser.showHelp(1);
+    }
+    const QStringList clientArgs = {
+        QStringLiteral("--fps"), QString::number(cfg.fps),
+        QStringLiteral("--bitrate-kbps"), QString::number(cfg.bitrateKbps),
+        QStringLiteral("--seconds"), QString::number(cfg.seconds),
+        QStringLiteral("--gop"), QString::number(cfg.gop)
+    };
+
+    QJsonArray results;
+    out() << "subs  msgs    cpu%    us/msg   us/deliv  KB/sub(conn)  KB/sub(peak)  delivered\n";
+    for (int n : counts) {
+        cfg.subscribers = n;
+        const QJsonObject r = runFanout(cfg, clientArgs);
+        results.append(r);
+        if (r.contains("error")) {
+            out() << QString("%1 error: %2\n").arg(n, -5).arg(r.value("error").toString());
+            out().flush();
+            continue;
+        }
+        const QJsonObject cpu = r.value("cpu").toObject();
+        const QJsonObject mem = r.value("memory").toObject();
+        out() << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                     .arg(n, -5)
+                     .arg(r.value("messages").toInteger(), -7)
+                     .arg(cpu.value("percent_of_core").toDouble(), -7, 'f', 1)
+                     .arg(cpu.value("us_per_message").toDouble(), -8, 'f', 1)
+                     .arg(cpu.value("us_per_delivery").toDouble(), -9, 'f', 2)
+                     .arg(mem.value("connected_bytes_per_subscriber").toDouble() / 1024.0, -13, 'f', 1)
+                     .arg(mem.value("peak_bytes_per_subscriber").toDouble() / 1024.0, -13, 'f', 1)
+                     .arg(r.value("delivered_ratio_min").toDouble(), -9, 'f', 3);
+        out().flush();
+    }
+
+    QJsonObject config;
+    config["fps"] = cfg.fps;
+    config["bitrate_kbps"] = cfg.bitrateKbps;
+    config["seconds"] = cfg.seconds;
+    config["gop"] = cfg.gop;
+    config["preframed"] = cfg.preframed;
+
+    QJsonObject root;
+    root["tool"] = QStringLiteral("RelayBenchmark");
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["host"] = QSysInfo::machineHostName();
+    root["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    root["config"] = config;
+    root["runs"] = results;
+
+    QFile file(parser.value(outputOpt));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QTextStream(stderr) << "Failed to write " << file.fileName() << "\n";
+        return 3;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    file.close();
+    out() << "Results written to " << file.fileName() << "\n";
+    return 0;
+}
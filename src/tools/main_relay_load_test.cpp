@@ -0,0 +1,701 @@
+// 中继压测：在 127.0.0.1 上模拟 R 个房间（每个房间 1 个推流端 + S 个观看端），对云服务器或 LanRelayServer
+// 施加负载，测量推流端→观看端延迟分位数、吞吐、丢包与服务器进程 CPU/RSS，找出延迟开始劣化的规模。
+// - 目标：默认启动子进程运行 LanRelayServer（--serve-lan，同一可执行文件）；--server 指定已运行的服务器
+//   （如 websocket_server_with_routing），配合 --server-pid 采集其 CPU/内存
+// - 推流端：视频为录制的 VP9 流（--replay，IVF 文件，循环回放，关键帧从码流帧头判断）或合成帧，
+//   另按设定速率混入音频（Opus 大小的负载）与光标消息，均为版本 1 二进制消息
+// - 延迟：推流端与观看端在同一进程，按（房间，序号）记录发送时刻，观看端收到时用同一单调时钟计算
+// - 丢包：按消息类型统计序号缺口（包含中继按积压主动丢弃的增强层/溢出帧）
+// --rooms 可给列表逐级加压；每级先预热再测量，结果（含每秒时间线）写入 JSON 报告。
+//
+// 用法示例：
+//   RelayLoadTest --rooms 1,5,10,20 --subscribers-per-room 5 --seconds 20
+//   RelayLoadTest --server ws://127.0.0.1:8765 --server-pid 12345 --replay desktop.ivf --rooms 50
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+#include <QWebSocket>
+#include <QtEndian>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "../common/LanRelayServer.h"
+#include "../common/PacketHeader.h"
+#include "../common/BinaryMessage.h"
+#include "ProcessStats.h"
+
+namespace {
+
+using PacketHeader::MessageType;
+
+constexpr int kTypeSlots = 8;        // 按 MessageType 数值索引
+constexpr int kSendRing = 1024;      // 每个推流端保留最近的视频发送时刻
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+bool waitFor(const std::function<bool()> &done, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+    }
+    return true;
+}
+
+struct LoadConfig {
+    QString serverUrl;          // ws://host:port，不含路径
+    qint64 serverPid = 0;       // 0 表示不采集服务器 CPU/内存
+    int subscribersPerRoom = 5;
+    int seconds = 10;
+    int warmupSeconds = 2;
+    int fps = 30;
+    int bitrateKbps = 2000;
+    int gop = 120;
+    int audioPps = 50;
+    int cursorHz = 30;
+    QString runTag;
+};
+
+// ---- 录制的 VP9 流（IVF 容器） ----
+struct ReplayFrame {
+    QByteArray data;
+    bool keyFrame = false;
+};
+
+// VP9 非压缩帧头：frame_marker(2) profile(2)[profile 3 多 1 位保留] show_existing_frame(1) frame_type(1)，
+// frame_type 为 0 表示关键帧；超级帧的第一帧帧头同样位于起始字节
+bool vp9IsKeyFrame(const QByteArray &frame)
+{
+    if (frame.isEmpty()) {
+        return false;
+    }
+    const quint8 b = static_cast<quint8>(frame.at(0));
+    if ((b >> 6) != 0x2) {
+        return false;
+    }
+    const int profile = ((b >> 5) & 1) | (((b >> 4) & 1) << 1);
+    const int showExistingBit = profile == 3 ? 2 : 3;
+    if ((b >> showExistingBit) & 1) {
+        return false;
+    }
+    return ((b >> (showExistingBit - 1)) & 1) == 0;
+}
+
+bool loadIvf(const QString &path, QVector<ReplayFrame> &frames, int &fps, QString &error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    if (data.size() < 32 || !data.startsWith("DKIF")) {
+        error = QStringLiteral("not an IVF file");
+        return false;
+    }
+    const int headerSize = qFromLittleEndian<quint16>(data.constData() + 6);
+    const quint32 rate = qFromLittleEndian<quint32>(data.constData() + 16);
+    const quint32 scale = qFromLittleEndian<quint32>(data.constData() + 20);
+    if (rate > 0 && scale > 0) {
+        fps = std::max<int>(1, std::min<int>(240, int(rate / scale)));
+    }
+    int pos = std::max(32, headerSize);
+    while (pos + 12 <= data.size()) {
+        const quint32 size = qFromLittleEndian<quint32>(data.constData() + pos);
+        pos += 12;
+        if (size == 0 || size > quint32(data.size() - pos)) {
+            break;
+        }
+        ReplayFrame f;
+        f.data = data.mid(pos, int(size));
+        f.keyFrame = vp9IsKeyFrame(f.data);
+        frames.append(f);
+        pos += int(size);
+    }
+    // 回放从关键帧开始，观看端才能从第一帧解码
+    while (!frames.isEmpty() && !frames.first().keyFrame) {
+        frames.removeFirst();
+    }
+    if (frames.isEmpty()) {
+        error = QStringLiteral("no VP9 key frame found");
+        return false;
+    }
+    return true;
+}
+
+// ---- 压测过程中的统计 ----
+struct Publisher {
+    QWebSocket *socket = nullptr;
+    qint64 phaseNs = 0;                  // 错开各房间的发送时刻
+    int frameIndex = 0;
+    quint32 seq[kTypeSlots] = {};
+    quint32 ringSeq[kSendRing] = {};
+    qint64 ringSentNs[kSendRing] = {};
+};
+
+struct Subscriber {
+    QWebSocket *socket = nullptr;
+    int room = 0;
+    bool hasLast[kTypeSlots] = {};
+    quint32 last[kTypeSlots] = {};
+};
+
+struct Counters {
+    quint64 sent[kTypeSlots] = {};
+    quint64 received[kTypeSlots] = {};
+    quint64 gaps[kTypeSlots] = {};
+    quint64 sentBytes = 0;
+    quint64 receivedBytes = 0;
+};
+
+double percentile(std::vector<qint32> &samples, double p)
+{
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t idx = std::min(samples.size() - 1, size_t(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx] / 1000.0;   // 微秒 → 毫秒
+}
+
+QJsonObject latencyJson(std::vector<qint32> &samples)
+{
+    QJsonObject o;
+    o["samples"] = qint64(samples.size());
+    o["p50_ms"] = percentile(samples, 0.50);
+    o["p90_ms"] = percentile(samples, 0.90);
+    o["p99_ms"] = percentile(samples, 0.99);
+    o["max_ms"] = samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()) / 1000.0;
+    return o;
+}
+
+class LoadRun
+{
+public:
+    LoadRun(const LoadConfig &cfg, const QVector<ReplayFrame> &replay, int rooms, int step)
+        : m_cfg(cfg), m_replay(replay), m_rooms(rooms), m_step(step)
+    {
+    }
+
+    ~LoadRun()
+    {
+        for (auto &p : m_publishers) delete p.socket;
+        for (auto &s : m_subscribers) delete s.socket;
+    }
+
+    QJsonObject run()
+    {
+        QJsonObject result;
+        result["rooms"] = m_rooms;
+        result["subscribers_per_room"] = m_cfg.subscribersPerRoom;
+
+        const int failures = connectAll();
+        result["connect_failures"] = failures;
+        if (failures == m_rooms * (1 + m_cfg.subscribersPerRoom)) {
+            result["error"] = QStringLiteral("no connection");
+            return result;
+        }
+
+        m_clock.start();
+        QTimer sendTimer;
+        sendTimer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&sendTimer, &QTimer::timeout, [this] { sendDue(); });
+        sendTimer.start(2);
+
+        // 预热：连接与首个关键帧的开销不计入
+        waitFor([] { return false; }, m_cfg.warmupSeconds * 1000);
+        m_counters = Counters();
+        m_latency.clear();
+        m_measuring = true;
+        const qint64 serverCpu0 = serverCpu();
+        const qint64 clientCpu0 = ProcessStats::cpuUs(QCoreApplication::applicationPid());
+        const qint64 serverRss0 = serverRss();
+        qint64 serverRssPeak = serverRss0;
+        QElapsedTimer window;
+        window.start();
+
+        QJsonArray timeline;
+        qint64 lastCpu = serverCpu0;
+        qint64 lastClientCpu = clientCpu0;
+        quint64 lastReceived = 0;
+        quint64 lastBytes = 0;
+        qint64 lastMs = 0;
+        QTimer sampler;
+        QObject::connect(&sampler, &QTimer::timeout, [&] {
+            const qint64 ms = window.elapsed();
+            const double span = double(std::max<qint64>(1, ms - lastMs));
+            const qint64 cpu = serverCpu();
+            const qint64 clientCpu = ProcessStats::cpuUs(QCoreApplication::applicationPid());
+            const qint64 rss = serverRss();
+            serverRssPeak = std::max(serverRssPeak, rss);
+            quint64 received = 0;
+            for (quint64 r : m_counters.received) received += r;
+
+            QJsonObject t;
+            t["t_s"] = ms / 1000.0;
+            t["delivered_msgs_per_s"] = double(received - lastReceived) * 1000.0 / span;
+            t["delivered_mbps"] = double(m_counters.receivedBytes - lastBytes) * 8.0 / 1000.0 / span;
+            t["latency_p50_ms"] = percentile(m_windowLatency, 0.50);
+            t["latency_p99_ms"] = percentile(m_windowLatency, 0.99);
+            t["server_cpu_percent"] = (cpu >= 0 && lastCpu >= 0) ? (cpu - lastCpu) / 10.0 / span : -1.0;
+            t["server_rss_mb"] = rss >= 0 ? rss / 1024.0 / 1024.0 : -1.0;
+            t["client_cpu_percent"] = (clientCpu - lastClientCpu) / 10.0 / span;
+            timeline.append(t);
+
+            m_windowLatency.clear();
+            lastCpu = cpu;
+            lastClientCpu = clientCpu;
+            lastReceived = received;
+            lastBytes = m_counters.receivedBytes;
+            lastMs = ms;
+        });
+        sampler.start(1000);
+
+        waitFor([] { return false; }, m_cfg.seconds * 1000);
+        sendTimer.stop();
+        const qint64 sendMs = window.elapsed();
+        // 停止发送后留 1 秒让在途消息到达
+        waitFor([] { return false; }, 1000);
+        sampler.stop();
+        m_measuring = false;
+
+        const double seconds = sendMs / 1000.0;
+        const qint64 serverCpu1 = serverCpu();
+        const qint64 clientCpu1 = ProcessStats::cpuUs(QCoreApplication::applicationPid());
+        const qint64 wallMs = window.elapsed();
+
+        quint64 sent = 0;
+        quint64 received = 0;
+        for (int t = 0; t < kTypeSlots; ++t) {
+            sent += m_counters.sent[t];
+            received += m_counters.received[t];
+        }
+        QJsonObject throughput;
+        throughput["sent_msgs_per_s"] = sent / seconds;
+        throughput["sent_mbps"] = m_counters.sentBytes * 8.0 / 1e6 / seconds;
+        throughput["delivered_msgs_per_s"] = received / seconds;
+        throughput["delivered_mbps"] = m_counters.receivedBytes * 8.0 / 1e6 / seconds;
+        result["throughput"] = throughput;
+        result["latency"] = latencyJson(m_latency);
+
+        QJsonObject drops;
+        const struct { MessageType type; const char *name; } types[] = {
+            { MessageType::Video, "video" }, { MessageType::Audio, "audio" }, { MessageType::Cursor, "cursor" }
+        };
+        for (const auto &t : types) {
+            const int i = int(t.type);
+            const quint64 expected = m_counters.received[i] + m_counters.gaps[i];
+            QJsonObject d;
+            d["sent"] = qint64(m_counters.sent[i]);
+            d["received"] = qint64(m_counters.received[i]);
+            d["gaps"] = qint64(m_counters.gaps[i]);
+            d["drop_ratio"] = expected > 0 ? double(m_counters.gaps[i]) / expected : 0.0;
+            drops[QLatin1String(t.name)] = d;
+        }
+        result["drops"] = drops;
+
+        QJsonObject server;
+        server["cpu_percent_avg"] = (serverCpu0 >= 0 && serverCpu1 >= 0)
+            ? (serverCpu1 - serverCpu0) / 10.0 / std::max<qint64>(1, wallMs) : -1.0;
+        server["rss_start_bytes"] = serverRss0;
+        server["rss_peak_bytes"] = serverRssPeak;
+        result["server"] = server;
+        // 客户端自身接近满核时结果受压测端限制，不代表服务器上限
+        result["client_cpu_percent_avg"] = (clientCpu1 - clientCpu0) / 10.0 / std::max<qint64>(1, wallMs);
+        result["timeline"] = timeline;
+        return result;
+    }
+
+private:
+    QString roomId(int room) const
+    {
+        return QStringLiteral("load-%1-%2-%3").arg(m_cfg.runTag).arg(m_step).arg(room);
+    }
+
+    int connectAll()
+    {
+        const qint64 frameNs = 1000000000LL / m_cfg.fps;
+        m_publishers.resize(m_rooms);
+        for (int r = 0; r < m_rooms; ++r) {
+            Publisher &p = m_publishers[r];
+            p.socket = new QWebSocket;
+            p.phaseNs = frameNs * r / m_rooms;
+            p.socket->open(QUrl(m_cfg.serverUrl + QStringLiteral("/publish/") + roomId(r)));
+        }
+        waitFor([this] {
+            return std::all_of(m_publishers.begin(), m_publishers.end(), [](const Publisher &p) {
+                return p.socket->state() == QAbstractSocket::ConnectedState;
+            });
+        }, 15000);
+
+        m_subscribers.resize(m_rooms * m_cfg.subscribersPerRoom);
+        for (int i = 0; i < int(m_subscribers.size()); ++i) {
+            Subscriber &s = m_subscribers[i];
+            s.room = i / m_cfg.subscribersPerRoom;
+            s.socket = new QWebSocket;
+            QObject::connect(s.socket, &QWebSocket::binaryMessageReceived, s.socket, [this, i](const QByteArray &msg) {
+                onReceived(m_subscribers[i], msg);
+            });
+            s.socket->open(QUrl(m_cfg.serverUrl + QStringLiteral("/subscribe/") + roomId(s.room)));
+        }
+        waitFor([this] {
+            return std::all_of(m_subscribers.begin(), m_subscribers.end(), [](const Subscriber &s) {
+                return s.socket->state() == QAbstractSocket::ConnectedState;
+            });
+        }, 30000);
+        // 给服务器完成房间登记（云服务器在工作线程中排队接管连接）
+        waitFor([] { return false; }, 500);
+
+        int failures = 0;
+        for (const Publisher &p : m_publishers) {
+            if (p.socket->state() != QAbstractSocket::ConnectedState) ++failures;
+        }
+        for (const Subscriber &s : m_subscribers) {
+            if (s.socket->state() != QAbstractSocket::ConnectedState) ++failures;
+        }
+        return failures;
+    }
+
+    // 各推流端按各自相位补齐应发的视频/音频/光标消息
+    void sendDue()
+    {
+        const qint64 nowNs = m_clock.nsecsElapsed();
+        for (Publisher &p : m_publishers) {
+            if (p.socket->state() != QAbstractSocket::ConnectedState || nowNs < p.phaseNs) {
+                continue;
+            }
+            const qint64 elapsedNs = nowNs - p.phaseNs;
+            sendType(p, MessageType::Video, elapsedNs, m_cfg.fps);
+            sendType(p, MessageType::Audio, elapsedNs, m_cfg.audioPps);
+            sendType(p, MessageType::Cursor, elapsedNs, m_cfg.cursorHz);
+        }
+    }
+
+    void sendType(Publisher &p, MessageType type, qint64 elapsedNs, int rate)
+    {
+        if (rate <= 0) {
+            return;
+        }
+        const int t = int(type);
+        const quint32 due = quint32(elapsedNs * rate / 1000000000LL) + 1;
+        while (p.seq[t] < due) {
+            const quint32 seq = p.seq[t]++;
+            const QByteArray msg = buildMessage(p, type, seq);
+            if (type == MessageType::Video) {
+                p.ringSeq[seq % kSendRing] = seq;
+                p.ringSentNs[seq % kSendRing] = m_clock.nsecsElapsed();
+            }
+            p.socket->sendBinaryMessage(msg);
+            if (m_measuring) {
+                ++m_counters.sent[t];
+                m_counters.sentBytes += msg.size();
+            }
+        }
+    }
+
+    QByteArray buildMessage(Publisher &p, MessageType type, quint32 seq)
+    {
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        if (type == MessageType::Audio) {
+            BinaryMessage::Audio audio;
+            audio.sampleRate = 48000;
+            audio.channels = 2;
+            audio.frameSamples = 48000 / std::max(1, m_cfg.audioPps);
+            audio.opus = QByteArray(160, char(0x33));   // 约 64 kbps 的 20 ms Opus 包
+            return BinaryMessage::encodeAudio(type, seq, nowMs, audio);
+        }
+        if (type == MessageType::Cursor) {
+            BinaryMessage::Cursor cursor;
+            cursor.x = int(seq * 7 % 1920);
+            cursor.y = int(seq * 3 % 1080);
+            cursor.frameSize = QSize(1920, 1080);
+            return BinaryMessage::encodeCursor(seq, nowMs, cursor);
+        }
+
+        QByteArray payload;
+        bool keyFrame = false;
+        int temporalId = 0;
+        if (!m_replay.isEmpty()) {
+            // 录制流不含时间层信息，全部按基础层标记
+            const ReplayFrame &f = m_replay[p.frameIndex];
+            p.frameIndex = (p.frameIndex + 1) % m_replay.size();
+            payload = f.data;
+            keyFrame = f.keyFrame;
+        } else {
+            const qint64 avgBytes = std::max<qint64>(64, qint64(m_cfg.bitrateKbps) * 1000 / 8 / m_cfg.fps);
+            const qint64 deltaBytes = std::max<qint64>(32, avgBytes * m_cfg.gop / (m_cfg.gop - 1 + 6));
+            const int pos = int(seq % quint32(m_cfg.gop));
+            static const int kPattern[4] = {0, 2, 1, 2};
+            keyFrame = pos == 0;
+            temporalId = keyFrame ? 0 : kPattern[pos % 4];
+            payload = QByteArray(keyFrame ? deltaBytes * 6 : deltaBytes, char(0x5A));
+        }
+        QByteArray msg(PacketHeader::kMessageHeaderSize + payload.size(), Qt::Uninitialized);
+        PacketHeader::writeMessage(msg.data(), MessageType::Video, seq, nowMs, 0, temporalId, keyFrame);
+        memcpy(msg.data() + PacketHeader::kMessageHeaderSize, payload.constData(), payload.size());
+        return msg;
+    }
+
+    void onReceived(Subscriber &s, const QByteArray &msg)
+    {
+        const PacketHeader::Info info = PacketHeader::read(msg);
+        if (info.headerSize != PacketHeader::kMessageHeaderSize) {
+            return;
+        }
+        const int t = int(info.type);
+        // 序号缺口即丢包（中继丢弃的帧同样计入）；序号回退（重复/乱序）不计
+        quint64 gap = 0;
+        if (s.hasLast[t] && info.sequence > s.last[t] + 1) {
+            gap = info.sequence - s.last[t] - 1;
+        }
+        if (!s.hasLast[t] || info.sequence > s.last[t]) {
+            s.last[t] = info.sequence;
+            s.hasLast[t] = true;
+        }
+        if (!m_measuring) {
+            return;
+        }
+        m_counters.gaps[t] += gap;
+        ++m_counters.received[t];
+        m_counters.receivedBytes += msg.size();
+
+        if (info.type == MessageType::Video) {
+            const Publisher &p = m_publishers[s.room];
+            const int slot = int(info.sequence % kSendRing);
+            if (p.ringSeq[slot] == info.sequence && p.ringSentNs[slot] > 0) {
+                const qint32 us = qint32((m_clock.nsecsElapsed() - p.ringSentNs[slot]) / 1000);
+                m_latency.push_back(us);
+                m_windowLatency.push_back(us);
+            }
+        }
+    }
+
+    qint64 serverCpu() const { return m_cfg.serverPid > 0 ? ProcessStats::cpuUs(m_cfg.serverPid) : -1; }
+    qint64 serverRss() const { return m_cfg.serverPid > 0 ? ProcessStats::residentBytes(m_cfg.serverPid) : -1; }
+
+    const LoadConfig &m_cfg;
+    const QVector<ReplayFrame> &m_replay;
+    const int m_rooms;
+    const int m_step;
+    std::vector<Publisher> m_publishers;
+    std::vector<Subscriber> m_subscribers;
+    QElapsedTimer m_clock;
+    bool m_measuring = false;
+    Counters m_counters;
+    std::vector<qint32> m_latency;
+    std::vector<qint32> m_windowLatency;
+};
+
+// 子进程：LanRelayServer，监听临时端口并在标准输出汇报
+int serveLan()
+{
+    LanRelayServer relay;
+    if (!relay.start(0)) {
+        out() << "error listen\n";
+        out().flush();
+        return 2;
+    }
+    out() << "listening " << relay.port() << "\n";
+    out().flush();
+    return QCoreApplication::exec();
+}
+
+// 启动 LanRelayServer 子进程，返回端口；失败返回 0
+quint16 startLanServer(QProcess &process)
+{
+    quint16 port = 0;
+    bool failed = false;
+    const QMetaObject::Connection reader = QObject::connect(&process, &QProcess::readyReadStandardOutput, &process, [&process, &port, &failed] {
+        while (process.canReadLine()) {
+            const QByteArray line = process.readLine().trimmed();
+            if (line.startsWith("listening ")) {
+                port = static_cast<quint16>(line.mid(10).toUInt());
+            } else if (line.startsWith("error")) {
+                failed = true;
+            }
+        }
+    });
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(QCoreApplication::applicationFilePath(), { QStringLiteral("--serve-lan") });
+    waitFor([&] { return port != 0 || failed || process.state() == QProcess::NotRunning; }, 10000);
+    QObject::disconnect(reader);
+    return port;
+}
+
+QVector<int> parseCounts(const QString &value)
+{
+    QVector<int> counts;
+    for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+        const int n = part.trimmed().toInt();
+        if (n > 0) counts.append(n);
+    }
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("RelayLoadTest"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Loopback load generator for the cloud relay server and LanRelayServer"));
+    parser.addHelpOption();
+    const QCommandLineOption serverOpt(QStringLiteral("server"), QStringLiteral("Relay URL, e.g. ws://127.0.0.1:8765 (default: spawn LanRelayServer)"), QStringLiteral("url"));
+    const QCommandLineOption serverPidOpt(QStringLiteral("server-pid"), QStringLiteral("Process id of --server for CPU/RSS sampling"), QStringLiteral("pid"));
+    const QCommandLineOption roomsOpt(QStringLiteral("rooms"), QStringLiteral("Room (publisher) counts to step through"), QStringLiteral("list"), QStringLiteral("1,5,10"));
+    const QCommandLineOption subsOpt(QStringLiteral("subscribers-per-room"), QStringLiteral("Subscribers in each room"), QStringLiteral("n"), QStringLiteral("5"));
+    const QCommandLineOption secondsOpt(QStringLiteral("seconds"), QStringLiteral("Measured duration per step"), QStringLiteral("s"), QStringLiteral("10"));
+    const QCommandLineOption warmupOpt(QStringLiteral("warmup"), QStringLiteral("Warm-up before measuring"), QStringLiteral("s"), QStringLiteral("2"));
+    const QCommandLineOption replayOpt(QStringLiteral("replay"), QStringLiteral("Recorded VP9 stream (IVF) to replay instead of synthetic frames"), QStringLiteral("file"));
+    const QCommandLineOption fpsOpt(QStringLiteral("fps"), QStringLiteral("Video frame rate (default: IVF rate or 30)"), QStringLiteral("fps"));
+    const QCommandLineOption bitrateOpt(QStringLiteral("bitrate-kbps"), QStringLiteral("Synthetic video bitrate"), QStringLiteral("kbps"), QStringLiteral("2000"));
+    const QCommandLineOption gopOpt(QStringLiteral("gop"), QStringLiteral("Synthetic key frame interval in frames"), QStringLiteral("n"), QStringLiteral("120"));
+    const QCommandLineOption audioOpt(QStringLiteral("audio-pps"), QStringLiteral("Audio packets per second per publisher (0 = off)"), QStringLiteral("n"), QStringLiteral("50"));
+    const QCommandLineOption cursorOpt(QStringLiteral("cursor-hz"), QStringLiteral("Cursor messages per second per publisher (0 = off)"), QStringLiteral("n"), QStringLiteral("30"));
+    const QCommandLineOption outputOpt(QStringLiteral("output"), QStringLiteral("JSON report file"), QStringLiteral("file"), QStringLiteral("relay_load_test.json"));
+    const QCommandLineOption serveLanOpt(QStringLiteral("serve-lan"), QStringLiteral("Internal: run LanRelayServer on an ephemeral port"));
+    serveLanOpt.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({ serverOpt, serverPidOpt, roomsOpt, subsOpt, secondsOpt, warmupOpt, replayOpt, fpsOpt,
+                        bitrateOpt, gopOpt, audioOpt, cursorOpt, outputOpt, serveLanOpt });
+    parser.process(app);
+
+    if (parser.isSet(serveLanOpt)) {
+        return serveLan();
+    }
+
+    QTextStream err(stderr);
+    LoadConfig cfg;
+    cfg.subscribersPerRoom = std::max(0, parser.value(subsOpt).toInt());
+    cfg.seconds = std::max(1, parser.value(secondsOpt).toInt());
+    cfg.warmupSeconds = std::max(0, parser.value(warmupOpt).toInt());
+    cfg.bitrateKbps = std::max(1, parser.value(bitrateOpt).toInt());
+    cfg.gop = std::max(2, parser.value(gopOpt).toInt());
+    cfg.audioPps = std::max(0, parser.value(audioOpt).toInt());
+    cfg.cursorHz = std::max(0, parser.value(cursorOpt).toInt());
+    cfg.runTag = QString::number(QDateTime::currentMSecsSinceEpoch() % 1000000);
+
+    QVector<ReplayFrame> replay;
+    int fps = 30;
+    if (parser.isSet(replayOpt)) {
+        QString error;
+        if (!loadIvf(parser.value(replayOpt), replay, fps, error)) {
+            err << "Failed to load " << parser.value(replayOpt) << ": " << error << "\n";
+            return 2;
+        }
+    }
+    cfg.fps = parser.isSet(fpsOpt) ? std::max(1, parser.value(fpsOpt).toInt()) : fps;
+
+    const QVector<int> steps = parseCounts(parser.value(roomsOpt));
+    if (steps.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QJsonObject config;
+    config["target"] = parser.isSet(serverOpt) ? parser.value(serverOpt) : QStringLiteral("LanRelayServer");
+    config["subscribers_per_room"] = cfg.subscribersPerRoom;
+    config["seconds"] = cfg.seconds;
+    config["warmup_seconds"] = cfg.warmupSeconds;
+    config["video"] = replay.isEmpty() ? QStringLiteral("synthetic") : parser.value(replayOpt);
+    config["fps"] = cfg.fps;
+    config["bitrate_kbps"] = replay.isEmpty() ? cfg.bitrateKbps : 0;
+    config["audio_pps"] = cfg.audioPps;
+    config["cursor_hz"] = cfg.cursorHz;
+
+    QJsonObject root;
+    root["tool"] = QStringLiteral("RelayLoadTest");
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["host"] = QSysInfo::machineHostName();
+    root["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    root["config"] = config;
+
+    QJsonArray results;
+    out() << "rooms subs   deliv/s   Mbps     p50ms   p99ms   maxms   vdrop%  srvCPU%  srvRSSMB  cliCPU%\n";
+    for (int step = 0; step < steps.size(); ++step) {
+        const int rooms = steps[step];
+        // LanRelayServer 每级重启，内存与 CPU 从干净状态开始
+        QProcess lanServer;
+        if (parser.isSet(serverOpt)) {
+            cfg.serverUrl = parser.value(serverOpt);
+            cfg.serverPid = parser.value(serverPidOpt).toLongLong();
+        } else {
+            const quint16 port = startLanServer(lanServer);
+            if (port == 0) {
+                err << "Failed to start LanRelayServer\n";
+                return 2;
+            }
+            cfg.serverUrl = QStringLiteral("ws://127.0.0.1:%1").arg(port);
+            cfg.serverPid = lanServer.processId();
+        }
+        while (cfg.serverUrl.endsWith('/')) {
+            cfg.serverUrl.chop(1);
+        }
+
+        QJsonObject r;
+        {
+            LoadRun run(cfg, replay, rooms, step);
+            r = run.run();
+        }
+        results.append(r);
+
+        if (lanServer.state() != QProcess::NotRunning) {
+            lanServer.kill();
+            lanServer.waitForFinished(3000);
+        }
+
+        if (r.contains("error")) {
+            out() << QString("%1 error: %2\n").arg(rooms, -5).arg(r.value("error").toString());
+        } else {
+            const QJsonObject tp = r.value("throughput").toObject();
+            const QJsonObject lat = r.value("latency").toObject();
+            const QJsonObject video = r.value("drops").toObject().value("video").toObject();
+            const QJsonObject srv = r.value("server").toObject();
+            const qint64 rss = srv.value("rss_peak_bytes").toInteger();
+            out() << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11\n")
+                         .arg(rooms, -5)
+                         .arg(rooms * cfg.subscribersPerRoom, -6)
+                         .arg(tp.value("delivered_msgs_per_s").toDouble(), -9, 'f', 0)
+                         .arg(tp.value("delivered_mbps").toDouble(), -8, 'f', 1)
+                         .arg(lat.value("p50_ms").toDouble(), -7, 'f', 2)
+                         .arg(lat.value("p99_ms").toDouble(), -7, 'f', 2)
+                         .arg(lat.value("max_ms").toDouble(), -7, 'f', 1)
+                         .arg(video.value("drop_ratio").toDouble() * 100.0, -7, 'f', 2)
+                         .arg(srv.value("cpu_percent_avg").toDouble(), -8, 'f', 1)
+                         .arg(rss >= 0 ? rss / 1024.0 / 1024.0 : -1.0, -9, 'f', 1)
+                         .arg(r.value("client_cpu_percent_avg").toDouble(), -8, 'f', 1);
+        }
+        out().flush();
+
+        // 每级结束即写报告，中途中断也保留已完成的结果
+        root["steps"] = results;
+        QFile file(parser.value(outputOpt));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Failed to write " << file.fileName() << "\n";
+            return 3;
+        }
+        file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    }
+    out() << "Report written to " << parser.value(outputOpt) << "\n";
+    return 0;
+}
@@ -55,6 +55,7 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget *parent)
     m_decoder = std::make_unique<DxvaVP9Decoder>();
     m_receiver = std::make_unique<WebSocketReceiver>();
     m_receiver->setAudioOnly(m_audioOnlySession);
+    updateReceiverViewport();
     if (!m_decoderInitialized) {
         m_decoderInitialized = m_decoder->initialize();
     }
@@ -501,10 +502,14 @@ void VideoDisplayWidget::renderFrame(const QByteArray &frameData, const QSize &f
         QPixmap scaledPixmap = pixmap.scaled(labelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
         
         // 使用QTimer确保UI更新在主线程中进行，避免闪烁
-        QTimer::singleShot(0, this, [this, scaledPixmap]() {
+        QTimer::singleShot(0, this, [this, scaledPixmap, frameSize]() {
             m_videoLabel->setPixmap(scaledPixmap);
             m_videoLabel->setAlignment(Qt::AlignCenter);
             stopWaitingSplash();
+            // 多路编码下解码尺寸可能小于推流端原始尺寸，批注/光标坐标据此换算
+            if (m_receiver) {
+                m_receiver->setDecodedFrameSize(frameSize);
+            }
         });
         
         m_stats.framesDisplayed++;
@@ -712,6 +717,17 @@ void VideoDisplayWidget::resizeEvent(QResizeEvent *event)
         m_offlineLabel->move(x, y);
         m_offlineLabel->raise();
     }
+    updateReceiverViewport();
+}
+
+void VideoDisplayWidget::updateReceiverViewport()
+{
+    // 按显示区域的物理像素选择合适分辨率的流（小窗口无需接收原始分辨率）
+    if (!m_receiver || !m_videoLabel) {
+        return;
+    }
+    const QSize physical = m_videoLabel->size() * devicePixelRatioF();
+    m_receiver->setViewportSize(physical);
 }
 
 
@@ -1448,6 +1464,7 @@ void VideoDisplayWidget::recreateReceiver()
     if (!m_viewerName.isEmpty()) {
         m_receiver->setViewerName(m_viewerName);
     }
+    updateReceiverViewport();
     // 日志清理：移除接收器重建提示
 
     connect(m_receiver.get(), &WebSocketReceiver::frameReceivedWithTimestamp,
@@ -140,6 +140,8 @@ private slots:
 private:
     // 重新创建并连接WebSocket接收器，防止旧实例卡死或残留状态
     void recreateReceiver();
+    // 将显示区域尺寸告知接收器，用于自动选择多路编码中的流
+    void updateReceiverViewport();
     void setupUI();
     void updateButtonText();
     void drawMouseCursor(QPixmap &pixmap, const QPoint &position, const QString &name = QString()); // 保留旧接口（不再使用远端叠加）